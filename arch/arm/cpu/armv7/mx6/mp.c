@@ -73,7 +73,7 @@ int is_core_valid(unsigned int core)
 {
 	uint32_t nr_cores = get_nr_cpus();
 
-	if (core > nr_cores)
+	if (core >= nr_cores)
 		return 0;
 
 	return 1;
@@ -0,0 +1,31 @@
+/*
+ * CRC32 using the ARMv8 CRC32 instructions
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <u-boot/crc.h>
+
+uint32_t crc32_arch(uint32_t crc, const unsigned char *buf, uint len)
+{
+	u64 val;
+
+	/* Keep the loads aligned, as they may be to memory with the MMU off */
+	for (; len && ((ulong)buf & 7); len--) {
+		val = *buf++;
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (val));
+	}
+
+	for (; len >= 8; len -= 8, buf += 8) {
+		val = le64_to_cpu(*(const u64 *)buf);
+		asm("crc32x %w0, %w0, %x1" : "+r" (crc) : "r" (val));
+	}
+
+	while (len--) {
+		val = *buf++;
+		asm("crc32b %w0, %w0, %w1" : "+r" (crc) : "r" (val));
+	}
+
+	return crc;
+}
@@ -14,4 +14,16 @@ void sandbox_eth_disable_response(int index, bool disable);
 
 void sandbox_eth_skip_timeout(void);
 
+void sandbox_eth_tftp_serve(ulong size, int max_windowsize, ulong drop_block,
+			    int rtt_ms);
+
+void sandbox_eth_nfs_serve(ulong size, int version, int read_size,
+			   ulong drop_offset, int rtt_ms);
+
+/* Contents of the file served by the fake TFTP and NFS servers */
+static inline uchar sandbox_eth_file_byte(ulong offset)
+{
+	return offset * 7 + (offset >> 9);
+}
+
 #endif /* __ETH_H */
@@ -19,6 +19,13 @@
 
 #define SANDBOX_CLK_RATE		32768
 
+/* Time the sandbox MMC takes to transfer each block it reads */
+#define SANDBOX_MMC_US_PER_BLOCK	20
+
+/* Tap an emulated eMMC needs at HS200, and the time to tune for it */
+#define SANDBOX_MMC_TUNING_TAP		0x1a
+#define SANDBOX_MMC_TUNING_US		20000
+
 /* System controller driver data */
 enum {
 	SYSCON0		= 32,
@@ -79,4 +86,12 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * sandbox_mmc_get_tunings() - get the number of times a host was tuned
+ *
+ * @dev:	sandbox MMC device
+ * @return number of execute_tuning() calls since the device was bound
+ */
+uint sandbox_mmc_get_tunings(struct udevice *dev);
+
 #endif
@@ -571,6 +571,7 @@ int mp_init_cpu(struct udevice *cpu, void *unused)
 	 */
 	cpu->req_seq = fdtdec_get_int(gd->fdt_blob, dev_of_offset(cpu), "reg",
 				      -1);
+	uclass_index_device(cpu);
 	plat->ucode_version = microcode_read_rev();
 	plat->device_id = gd->arch.x86_device;
 
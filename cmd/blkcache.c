@@ -14,30 +14,38 @@ static int blkc_show(cmd_tbl_t *cmdtp, int flag,
 		     int argc, char * const argv[])
 {
 	struct block_cache_stats stats;
+	unsigned lookups;
+
 	blkcache_stats(&stats);
+	lookups = stats.hits + stats.misses;
 
 	printf("hits: %u\n"
 	       "misses: %u\n"
+	       "hit rate: %u%%\n"
+	       "evictions: %u\n"
 	       "entries: %u\n"
-	       "max blocks/entry: %u\n"
-	       "max cache entries: %u\n",
-	       stats.hits, stats.misses, stats.entries,
-	       stats.max_blocks_per_entry, stats.max_entries);
+	       "max cache entries: %u\n"
+	       "entry size: %u bytes\n"
+	       "cache size: %u bytes\n",
+	       stats.hits, stats.misses,
+	       lookups ? (unsigned)((u64)stats.hits * 100 / lookups) : 0,
+	       stats.evictions, stats.entries, stats.max_entries,
+	       stats.entry_bytes, stats.max_bytes);
 	return 0;
 }
 
 static int blkc_configure(cmd_tbl_t *cmdtp, int flag,
 			  int argc, char * const argv[])
 {
-	unsigned blocks_per_entry, max_entries;
+	unsigned max_bytes, entry_bytes;
 	if (argc != 3)
 		return CMD_RET_USAGE;
 
-	blocks_per_entry = simple_strtoul(argv[1], 0, 0);
-	max_entries = simple_strtoul(argv[2], 0, 0);
-	blkcache_configure(blocks_per_entry, max_entries);
-	printf("changed to max of %u entries of %u blocks each\n",
-	       max_entries, blocks_per_entry);
+	max_bytes = simple_strtoul(argv[1], 0, 0);
+	entry_bytes = simple_strtoul(argv[2], 0, 0);
+	blkcache_configure(max_bytes, entry_bytes);
+	printf("changed to %u bytes in entries of %u bytes each\n",
+	       max_bytes, entry_bytes);
 	return 0;
 }
 
@@ -83,5 +91,5 @@ U_BOOT_CMD(
 	blkcache, 4, 0, do_blkcache,
 	"block cache diagnostics and control",
 	"show - show and reset statistics\n"
-	"blkcache configure blocks entries\n"
+	"blkcache configure size entry_size - set cache and entry size in bytes\n"
 );
@@ -15,6 +15,7 @@
 #include <asm/global_data.h>
 #include <libfdt.h>
 #include <fdt_support.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
 
@@ -640,26 +641,52 @@ static int do_fdt(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 #ifdef CONFIG_OF_LIBFDT_OVERLAY
 	/* apply an overlay */
 	else if (strncmp(argv[1], "ap", 2) == 0) {
+		struct fdt_overlay_session session;
 		unsigned long addr;
 		struct fdt_header *blob;
+		void *buf = NULL;
+		int size, i;
 		int ret;
 
-		if (argc != 3)
+		if (argc < 3)
 			return CMD_RET_USAGE;
 
 		if (!working_fdt)
 			return CMD_RET_FAILURE;
 
-		addr = simple_strtoul(argv[2], NULL, 16);
-		blob = map_sysmem(addr, 0);
-		if (!fdt_valid(&blob))
-			return CMD_RET_FAILURE;
-
-		ret = fdt_overlay_apply(working_fdt, blob);
+		/*
+		 * Apply all the overlays in one session, so that the base
+		 * tree's phandles and symbols are only looked up once. If
+		 * there is no memory for the index, look them up each time.
+		 */
+		size = fdt_overlay_session_size(working_fdt);
+		if (size > 0)
+			buf = malloc(size);
+		ret = fdt_overlay_session_init(&session, working_fdt, buf,
+					       buf ? size : 0);
 		if (ret) {
-			printf("fdt_overlay_apply(): %s\n", fdt_strerror(ret));
+			printf("fdt_overlay_session_init(): %s\n",
+			       fdt_strerror(ret));
+			free(buf);
 			return CMD_RET_FAILURE;
 		}
+
+		for (i = 2; i < argc; i++) {
+			addr = simple_strtoul(argv[i], NULL, 16);
+			blob = map_sysmem(addr, 0);
+			if (!fdt_valid(&blob))
+				break;
+
+			ret = fdt_overlay_session_apply(&session, blob);
+			if (ret) {
+				printf("fdt_overlay_apply(): %s\n",
+				       fdt_strerror(ret));
+				break;
+			}
+		}
+		free(buf);
+		if (i < argc)
+			return CMD_RET_FAILURE;
 	}
 #endif
 	/* resize the fdt */
@@ -1054,7 +1081,7 @@ static int fdt_print(const char *pathp, char *prop, int depth)
 static char fdt_help_text[] =
 	"addr [-c]  <addr> [<length>]   - Set the [control] fdt location to <addr>\n"
 #ifdef CONFIG_OF_LIBFDT_OVERLAY
-	"fdt apply <addr>                    - Apply overlay to the DT\n"
+	"fdt apply <addr> [<addr> ...]       - Apply overlays to the DT in turn\n"
 #endif
 #ifdef CONFIG_OF_BOARD_SETUP
 	"fdt boardsetup                      - Do board-specific set up\n"
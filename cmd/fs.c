@@ -44,6 +44,25 @@ U_BOOT_CMD(
 	"      If 'pos' is 0 or omitted, the file is read from the start."
 )
 
+#ifdef CONFIG_GZIP
+static int do_gzload_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
+			     char * const argv[])
+{
+	return do_gzload(cmdtp, flag, argc, argv, FS_TYPE_ANY);
+}
+
+U_BOOT_CMD(
+	gzload,	6,	0,	do_gzload_wrapper,
+	"load and decompress a gzip file from a filesystem",
+	"<interface> [<dev[:part]> [<addr> [<filename> [maxsize]]]]\n"
+	"    - Read gzip file 'filename' from partition 'part' on device\n"
+	"       type 'interface' instance 'dev' and decompress it to address\n"
+	"       'addr' while it is being read.\n"
+	"      'maxsize' limits the size of the decompressed data.\n"
+	"      If 'maxsize' is 0 or omitted, there is no limit."
+);
+#endif
+
 static int do_save_wrapper(cmd_tbl_t *cmdtp, int flag, int argc,
 				char * const argv[])
 {
@@ -308,6 +308,17 @@ static int initr_noncached(void)
 }
 #endif
 
+#ifdef CONFIG_OF_LIBFDT_INDEX
+static int initr_fdt_index(void)
+{
+	/* Without an index, lookups are just slower */
+	if (fdtdec_build_index(gd->fdt_blob))
+		debug("%s: Cannot index device tree\n", __func__);
+
+	return 0;
+}
+#endif
+
 #ifdef CONFIG_DM
 static int initr_dm(void)
 {
@@ -794,6 +805,9 @@ static init_fnc_t init_sequence_r[] = {
 	initr_console_record,
 #ifdef CONFIG_SYS_NONCACHED_MEMORY
 	initr_noncached,
+#endif
+#ifdef CONFIG_OF_LIBFDT_INDEX
+	initr_fdt_index,
 #endif
 	bootstage_relocate,
 #ifdef CONFIG_DM
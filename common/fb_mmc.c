@@ -68,6 +68,20 @@ static lbaint_t fb_mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+#ifdef CONFIG_FASTBOOT_MMC_SPARSE_ERASE
+static lbaint_t fb_mmc_sparse_erase(struct sparse_storage *info,
+		lbaint_t blk, lbaint_t blkcnt)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+	struct blk_desc *dev_desc = sparse->dev_desc;
+	lbaint_t blks;
+
+	blks = blk_derase(dev_desc, blk, blkcnt);
+
+	return blks == blkcnt ? blks : 0;
+}
+#endif
+
 static void write_raw_image(struct blk_desc *dev_desc, disk_partition_t *info,
 		const char *part_name, void *buffer,
 		unsigned int download_bytes)
@@ -162,6 +176,9 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 	if (is_sparse_image(download_buffer)) {
 		struct fb_mmc_sparse sparse_priv;
 		struct sparse_storage sparse;
+#ifdef CONFIG_FASTBOOT_MMC_SPARSE_ERASE
+		struct mmc *mmc;
+#endif
 
 		sparse_priv.dev_desc = dev_desc;
 
@@ -170,6 +187,15 @@ void fb_mmc_flash_write(const char *cmd, void *download_buffer,
 		sparse.size = info.size;
 		sparse.write = fb_mmc_sparse_write;
 		sparse.reserve = fb_mmc_sparse_reserve;
+		sparse.erase = NULL;
+#ifdef CONFIG_FASTBOOT_MMC_SPARSE_ERASE
+		mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+		if (mmc) {
+			sparse.erase = fb_mmc_sparse_erase;
+			sparse.erase_grp = mmc->erase_grp_size;
+			sparse.erase_zeroes = mmc_erased_byte(mmc) == 0;
+		}
+#endif
 
 		printf("Flashing sparse image at offset " LBAFU "\n",
 		       sparse.start);
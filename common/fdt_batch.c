@@ -0,0 +1,631 @@
+/*
+ * Making a batch of changes to a flattened device tree in one pass
+ *
+ * Changes are recorded against the nodes they apply to and the tree is left
+ * alone until the batch is committed. The new tree is then written out by
+ * copying the old one, replacing, dropping and adding properties and nodes
+ * on the way, and copied back over the old one. Each change made with
+ * fdt_rw instead moves the rest of the tree, which adds up to a great deal
+ * of copying when dozens of fixups are made to a large tree.
+ *
+ * The original strings block is kept as it is, with any new property names
+ * added to the end, so unchanged parts of the structure block can be copied
+ * without looking at them. Properties and nodes are added in the same place
+ * as fdt_setprop() and fdt_add_subnode() would put them, so the result is
+ * the same as making the changes one at a time.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <fdt_support.h>
+#include <malloc.h>
+
+/* Deepest node which can be changed */
+#define FDT_BATCH_MAX_DEPTH	32
+
+#define FDT_BATCH_ALIGN(x)	ALIGN(x, FDT_TAGSIZE)
+
+/**
+ * struct fdt_batch_prop - A property to set or delete
+ *
+ * @node_list:	List of changes to the node, newest first
+ * @batch_list:	List of properties which have been set, in the order they
+ *		were first set
+ * @name:	Property name
+ * @val:	New value, or NULL to delete the property
+ * @len:	Length of @val
+ * @readded:	True if the property was deleted and then set again, so
+ *		that it moves to the start of the node
+ * @exists:	True if the property is in the tree (set when committing)
+ * @nameoff:	Offset of @name in the new strings block (set when
+ *		committing, for properties which are added)
+ */
+struct fdt_batch_prop {
+	struct list_head node_list;
+	struct list_head batch_list;
+	char *name;
+	void *val;
+	int len;
+	bool readded;
+	bool exists;
+	int nameoff;
+};
+
+/**
+ * struct fdt_batch_node - A node with changes, or a node to add
+ *
+ * @list:	List of all nodes in the batch
+ * @sibling:	Entry in the parent's list of nodes to add
+ * @offset:	Offset of the node in the tree, or -1 if it is to be added
+ * @name:	Name of the node
+ * @props:	Property changes, newest first
+ * @children:	Subnodes to add, newest first
+ */
+struct fdt_batch_node {
+	struct list_head list;
+	struct list_head sibling;
+	int offset;
+	char *name;
+	struct list_head props;
+	struct list_head children;
+};
+
+void fdt_batch_init(struct fdt_batch *batch, void *fdt)
+{
+	batch->fdt = fdt;
+	INIT_LIST_HEAD(&batch->nodes);
+	INIT_LIST_HEAD(&batch->props);
+	batch->err = 0;
+}
+
+static int fdt_batch_error(struct fdt_batch *batch, int err)
+{
+	if (!batch->err)
+		batch->err = err;
+
+	return err;
+}
+
+static struct fdt_batch_node *fdt_batch_new_node(struct fdt_batch *batch,
+						 const char *name, int offset)
+{
+	struct fdt_batch_node *node;
+
+	node = calloc(1, sizeof(*node) + strlen(name) + 1);
+	if (!node)
+		return NULL;
+	node->name = (char *)(node + 1);
+	strcpy(node->name, name);
+	node->offset = offset;
+	INIT_LIST_HEAD(&node->props);
+	INIT_LIST_HEAD(&node->children);
+	list_add_tail(&node->list, &batch->nodes);
+
+	return node;
+}
+
+/* Check a node name against a name to look up, as libfdt does */
+static bool fdt_batch_name_eq(const char *node_name, const char *name)
+{
+	int len = strlen(name);
+
+	if (strncmp(node_name, name, len))
+		return false;
+
+	return !node_name[len] || (node_name[len] == '@' && !strchr(name, '@'));
+}
+
+/*
+ * Find the record for a node, adding one if needed. A node which is not in
+ * the tree is added to the batch, along with any missing parents, if @add
+ * is true.
+ */
+static int fdt_batch_get_node(struct fdt_batch *batch, const char *path,
+			      bool add, struct fdt_batch_node **nodep)
+{
+	struct fdt_batch_node *node, *parent;
+	char *parent_path, *name;
+	int offset, len, ret;
+
+	if (*path != '/')
+		return -FDT_ERR_BADPATH;
+	len = strlen(path);
+	if (len > 1 && path[len - 1] == '/')
+		return -FDT_ERR_BADPATH;
+
+	offset = fdt_path_offset(batch->fdt, path);
+	if (offset >= 0) {
+		list_for_each_entry(node, &batch->nodes, list) {
+			if (node->offset == offset) {
+				*nodep = node;
+				return 0;
+			}
+		}
+		node = fdt_batch_new_node(batch, "", offset);
+		if (!node)
+			return -FDT_ERR_NOSPACE;
+		*nodep = node;
+		return 0;
+	}
+	if (offset != -FDT_ERR_NOTFOUND)
+		return offset;
+
+	/* Look for the node among those to be added to its parent */
+	parent_path = strdup(path);
+	if (!parent_path)
+		return -FDT_ERR_NOSPACE;
+	name = strrchr(parent_path, '/');
+	*name++ = '\0';
+	ret = fdt_batch_get_node(batch, *parent_path ? parent_path : "/", add,
+				 &parent);
+	if (ret)
+		goto out;
+	list_for_each_entry(node, &parent->children, sibling) {
+		if (fdt_batch_name_eq(node->name, name)) {
+			*nodep = node;
+			goto out;
+		}
+	}
+	if (!add) {
+		ret = -FDT_ERR_NOTFOUND;
+		goto out;
+	}
+
+	/* Add it as the newest child of its parent */
+	node = fdt_batch_new_node(batch, name, -1);
+	if (!node) {
+		ret = -FDT_ERR_NOSPACE;
+		goto out;
+	}
+	list_add(&node->sibling, &parent->children);
+	*nodep = node;
+out:
+	free(parent_path);
+
+	return ret;
+}
+
+static struct fdt_batch_prop *fdt_batch_find_prop(struct fdt_batch_node *node,
+						  const char *name, int len)
+{
+	struct fdt_batch_prop *prop;
+
+	list_for_each_entry(prop, &node->props, node_list) {
+		if (!strncmp(prop->name, name, len) && !prop->name[len])
+			return prop;
+	}
+
+	return NULL;
+}
+
+/* Record setting a property to @val, or deleting it if @set is false */
+static int fdt_batch_change(struct fdt_batch *batch, const char *path,
+			    const char *name, bool set, const void *val,
+			    int len)
+{
+	struct fdt_batch_node *node;
+	struct fdt_batch_prop *prop;
+	void *copy = NULL;
+	int ret;
+
+	ret = fdt_batch_get_node(batch, path, set, &node);
+	if (ret == -FDT_ERR_NOTFOUND && !set)
+		return 0;
+	if (ret)
+		return fdt_batch_error(batch, ret);
+
+	if (set) {
+		/* Allocate something even for an empty property */
+		copy = malloc(len ? len : 1);
+		if (!copy)
+			return fdt_batch_error(batch, -FDT_ERR_NOSPACE);
+		if (val)
+			memcpy(copy, val, len);
+		else
+			memset(copy, '\0', len);
+	}
+
+	/* A later change to the same property replaces the earlier one */
+	prop = fdt_batch_find_prop(node, name, strlen(name));
+	if (!prop) {
+		prop = calloc(1, sizeof(*prop) + strlen(name) + 1);
+		if (!prop) {
+			free(copy);
+			return fdt_batch_error(batch, -FDT_ERR_NOSPACE);
+		}
+		prop->name = (char *)(prop + 1);
+		strcpy(prop->name, name);
+		INIT_LIST_HEAD(&prop->batch_list);
+		list_add(&prop->node_list, &node->props);
+	} else if (set && !prop->val) {
+		/* fdt_setprop() would add it again at the start */
+		prop->readded = true;
+		list_move(&prop->node_list, &node->props);
+	}
+	if (set && list_empty(&prop->batch_list))
+		list_add_tail(&prop->batch_list, &batch->props);
+	free(prop->val);
+	prop->val = copy;
+	prop->len = len;
+
+	return 0;
+}
+
+int fdt_batch_add_node(struct fdt_batch *batch, const char *path)
+{
+	struct fdt_batch_node *node;
+	int ret;
+
+	ret = fdt_batch_get_node(batch, path, true, &node);
+	if (ret)
+		return fdt_batch_error(batch, ret);
+
+	return 0;
+}
+
+int fdt_batch_setprop(struct fdt_batch *batch, const char *path,
+		      const char *name, const void *val, int len)
+{
+	if (len < 0)
+		return fdt_batch_error(batch, -FDT_ERR_BADVALUE);
+
+	return fdt_batch_change(batch, path, name, true, val, len);
+}
+
+int fdt_batch_delprop(struct fdt_batch *batch, const char *path,
+		      const char *name)
+{
+	return fdt_batch_change(batch, path, name, false, NULL, 0);
+}
+
+void fdt_batch_abort(struct fdt_batch *batch)
+{
+	struct fdt_batch_node *node, *node_tmp;
+	struct fdt_batch_prop *prop, *prop_tmp;
+
+	list_for_each_entry_safe(node, node_tmp, &batch->nodes, list) {
+		list_for_each_entry_safe(prop, prop_tmp, &node->props,
+					 node_list) {
+			free(prop->val);
+			free(prop);
+		}
+		free(node);
+	}
+	fdt_batch_init(batch, batch->fdt);
+}
+
+/* Return the space a property takes in the structure block */
+static int fdt_batch_prop_size(int len)
+{
+	return sizeof(struct fdt_property) + FDT_BATCH_ALIGN(len);
+}
+
+/* Return the space an added node takes, not counting its contents */
+static int fdt_batch_node_size(const char *name)
+{
+	return 2 * FDT_TAGSIZE + FDT_BATCH_ALIGN(strlen(name) + 1);
+}
+
+/* Find a string in a strings block, returning its offset or -1 */
+static int fdt_batch_find_string(const char *strtab, int size, const char *s)
+{
+	int len = strlen(s) + 1;
+	const char *p;
+
+	for (p = strtab; p + len <= strtab + size; p++) {
+		if (!memcmp(p, s, len))
+			return p - strtab;
+	}
+
+	return -1;
+}
+
+/*
+ * Get the size of the tree's structure block. Version 16 headers do not
+ * record it, so walk the block to find its end, as fdt_open_into() does.
+ */
+static int fdt_batch_struct_size(const void *fdt)
+{
+	int size = 0;
+
+	if (fdt_version(fdt) >= 17)
+		return fdt_size_dt_struct(fdt);
+	while (fdt_next_tag(fdt, size, &size) != FDT_END)
+		;
+
+	return size;
+}
+
+/*
+ * Work out the size of the new structure block, starting from @struct_size
+ * for the old one, and of the new strings
+ */
+static void fdt_batch_sizes(struct fdt_batch *batch, int struct_size,
+			    int *struct_sizep, int *strings_sizep)
+{
+	const void *fdt = batch->fdt;
+	struct fdt_batch_node *node;
+	struct fdt_batch_prop *prop;
+	int strings_size = 0;
+	int oldlen;
+
+	list_for_each_entry(node, &batch->nodes, list) {
+		if (node->offset < 0)
+			struct_size += fdt_batch_node_size(node->name);
+		list_for_each_entry(prop, &node->props, node_list) {
+			prop->exists = node->offset >= 0 &&
+				fdt_get_property(fdt, node->offset, prop->name,
+						 &oldlen);
+			if (prop->exists)
+				struct_size -= fdt_batch_prop_size(oldlen);
+			if (prop->val)
+				struct_size += fdt_batch_prop_size(prop->len);
+		}
+	}
+	list_for_each_entry(prop, &batch->props, batch_list) {
+		if (!prop->exists)
+			strings_size += strlen(prop->name) + 1;
+	}
+	*struct_sizep = struct_size;
+	*strings_sizep = strings_size;
+}
+
+/*
+ * Add the names of new properties to the strings block, in the order the
+ * properties were set, as fdt_setprop() would. This includes properties
+ * which were set and then deleted again. Return the new size.
+ */
+static int fdt_batch_add_strings(struct fdt_batch *batch, char *strtab,
+				 int size)
+{
+	struct fdt_batch_prop *prop;
+	int len;
+
+	list_for_each_entry(prop, &batch->props, batch_list) {
+		if (prop->exists && !prop->readded)
+			continue;
+		prop->nameoff = fdt_batch_find_string(strtab, size, prop->name);
+		if (prop->nameoff < 0) {
+			len = strlen(prop->name) + 1;
+			memcpy(strtab + size, prop->name, len);
+			prop->nameoff = size;
+			size += len;
+		}
+	}
+
+	return size;
+}
+
+static char *fdt_batch_put_prop(char *p, int nameoff, const void *val,
+				int len)
+{
+	struct fdt_property *prop = (struct fdt_property *)p;
+	int size = FDT_BATCH_ALIGN(len);
+
+	prop->tag = cpu_to_fdt32(FDT_PROP);
+	prop->len = cpu_to_fdt32(len);
+	prop->nameoff = cpu_to_fdt32(nameoff);
+	memcpy(prop->data, val, len);
+	memset(prop->data + len, '\0', size - len);
+
+	return p + sizeof(*prop) + size;
+}
+
+/* Write out the new properties of a node */
+static char *fdt_batch_put_new_props(char *p, struct fdt_batch_node *node)
+{
+	struct fdt_batch_prop *prop;
+
+	list_for_each_entry(prop, &node->props, node_list) {
+		if (prop->val && (!prop->exists || prop->readded))
+			p = fdt_batch_put_prop(p, prop->nameoff, prop->val,
+					       prop->len);
+	}
+
+	return p;
+}
+
+/* Write out the nodes added under a node, with their contents */
+static char *fdt_batch_put_new_nodes(char *p, struct fdt_batch_node *parent)
+{
+	struct fdt_batch_node *node;
+	int len;
+
+	list_for_each_entry(node, &parent->children, sibling) {
+		*(fdt32_t *)p = cpu_to_fdt32(FDT_BEGIN_NODE);
+		p += FDT_TAGSIZE;
+		len = strlen(node->name) + 1;
+		memcpy(p, node->name, len);
+		memset(p + len, '\0', FDT_BATCH_ALIGN(len) - len);
+		p += FDT_BATCH_ALIGN(len);
+		p = fdt_batch_put_new_props(p, node);
+		p = fdt_batch_put_new_nodes(p, node);
+		*(fdt32_t *)p = cpu_to_fdt32(FDT_END_NODE);
+		p += FDT_TAGSIZE;
+	}
+
+	return p;
+}
+
+/* Copy the unchanged part of the structure block up to @upto */
+static char *fdt_batch_copy(char *p, const char *in, int *copiedp, int upto)
+{
+	memcpy(p, in + *copiedp, upto - *copiedp);
+	p += upto - *copiedp;
+	*copiedp = upto;
+
+	return p;
+}
+
+static int fdt_batch_node_cmp(const void *a, const void *b)
+{
+	const struct fdt_batch_node *node_a = *(struct fdt_batch_node **)a;
+	const struct fdt_batch_node *node_b = *(struct fdt_batch_node **)b;
+
+	return node_a->offset - node_b->offset;
+}
+
+/*
+ * Copy the structure block to @out, making the changes on the way. @size is
+ * the size the new block should come to.
+ */
+static int fdt_batch_put_struct(struct fdt_batch *batch, char *out, int size)
+{
+	struct fdt_batch_node *stack[FDT_BATCH_MAX_DEPTH];
+	bool added[FDT_BATCH_MAX_DEPTH];
+	const void *fdt = batch->fdt;
+	const char *in = fdt_offset_ptr(fdt, 0, 0);
+	struct fdt_batch_node **nodes, *node;
+	const struct fdt_property *oldprop;
+	struct fdt_batch_prop *prop;
+	int count = 0, next_node = 0;
+	int offset, next = 0, copied = 0;
+	int depth = -1;
+	const char *name;
+	uint32_t tag;
+	char *p = out;
+
+	/* The tree is walked in offset order, so sort the nodes to match */
+	list_for_each_entry(node, &batch->nodes, list) {
+		if (node->offset >= 0)
+			count++;
+	}
+	nodes = malloc(count * sizeof(*nodes) + 1);
+	if (!nodes)
+		return -FDT_ERR_NOSPACE;
+	count = 0;
+	list_for_each_entry(node, &batch->nodes, list) {
+		if (node->offset >= 0)
+			nodes[count++] = node;
+	}
+	qsort(nodes, count, sizeof(*nodes), fdt_batch_node_cmp);
+
+	do {
+		offset = next;
+		tag = fdt_next_tag(fdt, offset, &next);
+		if (next < 0)
+			break;
+
+		/* New subnodes go after the properties, before the others */
+		if ((tag == FDT_BEGIN_NODE || tag == FDT_END_NODE) &&
+		    depth >= 0 && stack[depth] && !added[depth]) {
+			p = fdt_batch_copy(p, in, &copied, offset);
+			p = fdt_batch_put_new_nodes(p, stack[depth]);
+			added[depth] = true;
+		}
+
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			if (++depth >= FDT_BATCH_MAX_DEPTH) {
+				next = -FDT_ERR_BADSTRUCTURE;
+				break;
+			}
+			node = NULL;
+			if (next_node < count &&
+			    nodes[next_node]->offset == offset)
+				node = nodes[next_node++];
+			stack[depth] = node;
+			added[depth] = false;
+
+			/* New properties go first, as fdt_setprop() puts them */
+			if (node) {
+				p = fdt_batch_copy(p, in, &copied, next);
+				p = fdt_batch_put_new_props(p, node);
+			}
+			break;
+		case FDT_PROP:
+			node = stack[depth];
+			if (!node || list_empty(&node->props))
+				break;
+			oldprop = fdt_get_property_by_offset(fdt, offset, NULL);
+			name = fdt_string(fdt, fdt32_to_cpu(oldprop->nameoff));
+			prop = fdt_batch_find_prop(node, name, strlen(name));
+			if (!prop)
+				break;
+			p = fdt_batch_copy(p, in, &copied, offset);
+			if (prop->val && !prop->readded)
+				p = fdt_batch_put_prop(p,
+						fdt32_to_cpu(oldprop->nameoff),
+						prop->val, prop->len);
+			copied = next;
+			break;
+		case FDT_END_NODE:
+			depth--;
+			break;
+		}
+	} while (next >= 0 && tag != FDT_END);
+	free(nodes);
+	if (next < 0)
+		return next;
+	p = fdt_batch_copy(p, in, &copied, next);
+	if (depth != -1 || next_node != count || p - out != size)
+		return -FDT_ERR_BADSTRUCTURE;
+
+	return 0;
+}
+
+int fdt_batch_commit(struct fdt_batch *batch)
+{
+	void *fdt = batch->fdt;
+	int mem_rsv_off, mem_rsv_size, struct_off, struct_size;
+	int strings_off, strings_size, new_strings;
+	void *out;
+	int ret;
+
+	ret = batch->err;
+	if (ret || list_empty(&batch->nodes))
+		goto done;
+	ret = fdt_check_header(fdt);
+	if (ret)
+		goto done;
+	ret = fdt_batch_struct_size(fdt);
+	if (ret < 0)
+		goto done;
+
+	fdt_batch_sizes(batch, ret, &struct_size, &new_strings);
+	mem_rsv_off = ALIGN(sizeof(struct fdt_header), 8);
+	mem_rsv_size = (fdt_num_mem_rsv(fdt) + 1) *
+		sizeof(struct fdt_reserve_entry);
+	struct_off = mem_rsv_off + mem_rsv_size;
+	strings_off = struct_off + struct_size;
+	strings_size = fdt_size_dt_strings(fdt);
+	/* New names may turn out to be there already, so check that later */
+	if (strings_off + strings_size > fdt_totalsize(fdt)) {
+		ret = -FDT_ERR_NOSPACE;
+		goto done;
+	}
+
+	out = malloc(strings_off + strings_size + new_strings);
+	if (!out) {
+		ret = -FDT_ERR_NOSPACE;
+		goto done;
+	}
+	memcpy(out + mem_rsv_off, fdt + fdt_off_mem_rsvmap(fdt), mem_rsv_size);
+	memcpy(out + strings_off, fdt + fdt_off_dt_strings(fdt), strings_size);
+	strings_size = fdt_batch_add_strings(batch, out + strings_off,
+					     strings_size);
+	ret = fdt_batch_put_struct(batch, out + struct_off, struct_size);
+	if (!ret) {
+		memset(out, '\0', sizeof(struct fdt_header));
+		fdt_set_magic(out, FDT_MAGIC);
+		fdt_set_totalsize(out, strings_off + strings_size);
+		fdt_set_off_dt_struct(out, struct_off);
+		fdt_set_off_dt_strings(out, strings_off);
+		fdt_set_off_mem_rsvmap(out, mem_rsv_off);
+		fdt_set_version(out, 17);
+		fdt_set_last_comp_version(out, 16);
+		fdt_set_boot_cpuid_phys(out, fdt_boot_cpuid_phys(fdt));
+		fdt_set_size_dt_strings(out, strings_size);
+		fdt_set_size_dt_struct(out, struct_size);
+
+		/* This fails if there is no room, and keeps the buffer size */
+		ret = fdt_open_into(out, fdt, fdt_totalsize(fdt));
+	}
+	free(out);
+done:
+	fdt_batch_abort(batch);
+
+	return ret;
+}
@@ -125,20 +125,20 @@ int fdt_find_or_add_subnode(void *fdt, int parentoffset, const char *name)
 
 /* rename to CONFIG_OF_STDOUT_PATH ? */
 #if defined(OF_STDOUT_PATH)
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static int fdt_fixup_stdout(struct fdt_batch *batch)
 {
-	return fdt_setprop(fdt, chosenoff, "linux,stdout-path",
-			      OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
+	return fdt_batch_setprop(batch, "/chosen", "linux,stdout-path",
+				 OF_STDOUT_PATH, strlen(OF_STDOUT_PATH) + 1);
 }
 #elif defined(CONFIG_OF_STDOUT_VIA_ALIAS) && defined(CONFIG_CONS_INDEX)
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static int fdt_fixup_stdout(struct fdt_batch *batch)
 {
+	void *fdt = batch->fdt;
 	int err;
 	int aliasoff;
 	char sername[9] = { 0 };
 	const void *path;
 	int len;
-	char tmp[256]; /* long enough */
 
 	sprintf(sername, "serial%d", CONFIG_CONS_INDEX - 1);
 
@@ -154,10 +154,8 @@ static int fdt_fixup_stdout(void *fdt, int chosenoff)
 		goto noalias;
 	}
 
-	/* fdt_setprop may break "path" so we copy it to tmp buffer */
-	memcpy(tmp, path, len);
-
-	err = fdt_setprop(fdt, chosenoff, "linux,stdout-path", tmp, len);
+	err = fdt_batch_setprop(batch, "/chosen", "linux,stdout-path", path,
+				len);
 	if (err < 0)
 		printf("WARNING: could not set linux,stdout-path %s.\n",
 		       fdt_strerror(err));
@@ -171,7 +169,7 @@ noalias:
 	return 0;
 }
 #else
-static int fdt_fixup_stdout(void *fdt, int chosenoff)
+static int fdt_fixup_stdout(struct fdt_batch *batch)
 {
 	return 0;
 }
@@ -186,12 +184,30 @@ static inline int fdt_setprop_uxx(void *fdt, int nodeoffset, const char *name,
 		return fdt_setprop_u32(fdt, nodeoffset, name, (uint32_t)val);
 }
 
-int fdt_root(void *fdt)
+/*
+ * Commit a batch filled in by one of the *_batch() functions, or drop it if
+ * that returned an error in @err
+ */
+static int fdt_run_batch(struct fdt_batch *batch, int err, const char *what)
+{
+	if (err < 0) {
+		fdt_batch_abort(batch);
+		return err;
+	}
+	err = fdt_batch_commit(batch);
+	if (err < 0)
+		printf("WARNING: could not update %s: %s.\n", what,
+		       fdt_strerror(err));
+
+	return err;
+}
+
+int fdt_root_batch(struct fdt_batch *batch)
 {
 	char *serial;
 	int err;
 
-	err = fdt_check_header(fdt);
+	err = fdt_check_header(batch->fdt);
 	if (err < 0) {
 		printf("fdt_root: %s\n", fdt_strerror(err));
 		return err;
@@ -199,8 +215,8 @@ int fdt_root(void *fdt)
 
 	serial = getenv("serial#");
 	if (serial) {
-		err = fdt_setprop(fdt, 0, "serial-number", serial,
-				  strlen(serial) + 1);
+		err = fdt_batch_setprop_string(batch, "/", "serial-number",
+					       serial);
 
 		if (err < 0) {
 			printf("WARNING: could not set serial-number %s.\n",
@@ -212,6 +228,15 @@ int fdt_root(void *fdt)
 	return 0;
 }
 
+int fdt_root(void *fdt)
+{
+	struct fdt_batch batch;
+
+	fdt_batch_init(&batch, fdt);
+
+	return fdt_run_batch(&batch, fdt_root_batch(&batch), "root node");
+}
+
 int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 {
 	int   nodeoffset;
@@ -272,27 +297,26 @@ int fdt_initrd(void *fdt, ulong initrd_start, ulong initrd_end)
 	return 0;
 }
 
-int fdt_chosen(void *fdt)
+int fdt_chosen_batch(struct fdt_batch *batch)
 {
-	int   nodeoffset;
 	int   err;
 	char  *str;		/* used to set string properties */
 
-	err = fdt_check_header(fdt);
+	err = fdt_check_header(batch->fdt);
 	if (err < 0) {
 		printf("fdt_chosen: %s\n", fdt_strerror(err));
 		return err;
 	}
 
 	/* find or create "/chosen" node. */
-	nodeoffset = fdt_find_or_add_subnode(fdt, 0, "chosen");
-	if (nodeoffset < 0)
-		return nodeoffset;
+	err = fdt_batch_add_node(batch, "/chosen");
+	if (err < 0)
+		return err;
 
 	str = getenv("bootargs");
 	if (str) {
-		err = fdt_setprop(fdt, nodeoffset, "bootargs", str,
-				  strlen(str) + 1);
+		err = fdt_batch_setprop_string(batch, "/chosen", "bootargs",
+					       str);
 		if (err < 0) {
 			printf("WARNING: could not set bootargs %s.\n",
 			       fdt_strerror(err));
@@ -300,7 +324,16 @@ int fdt_chosen(void *fdt)
 		}
 	}
 
-	return fdt_fixup_stdout(fdt, nodeoffset);
+	return fdt_fixup_stdout(batch);
+}
+
+int fdt_chosen(void *fdt)
+{
+	struct fdt_batch batch;
+
+	fdt_batch_init(&batch, fdt);
+
+	return fdt_run_batch(&batch, fdt_chosen_batch(&batch), "/chosen");
 }
 
 void do_fixup_by_path(void *fdt, const char *path, const char *prop,
@@ -415,9 +448,11 @@ static int fdt_pack_reg(const void *fdt, void *buf, u64 *address, u64 *size,
 #else
 #define MEMORY_BANKS_MAX 4
 #endif
-int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
+int fdt_fixup_memory_banks_batch(struct fdt_batch *batch, u64 start[],
+				 u64 size[], int banks)
 {
-	int err, nodeoffset;
+	void *blob = batch->fdt;
+	int err;
 	int len;
 	u8 tmp[MEMORY_BANKS_MAX * 16]; /* Up to 64-bit address + 64-bit size */
 
@@ -435,12 +470,8 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 	}
 
 	/* find or create "/memory" node. */
-	nodeoffset = fdt_find_or_add_subnode(blob, 0, "memory");
-	if (nodeoffset < 0)
-			return nodeoffset;
-
-	err = fdt_setprop(blob, nodeoffset, "device_type", "memory",
-			sizeof("memory"));
+	err = fdt_batch_setprop_string(batch, "/memory", "device_type",
+				       "memory");
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n", "device_type",
 				fdt_strerror(err));
@@ -452,7 +483,7 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 
 	len = fdt_pack_reg(blob, tmp, start, size, banks);
 
-	err = fdt_setprop(blob, nodeoffset, "reg", tmp, len);
+	err = fdt_batch_setprop(batch, "/memory", "reg", tmp, len);
 	if (err < 0) {
 		printf("WARNING: could not set %s %s.\n",
 				"reg", fdt_strerror(err));
@@ -460,6 +491,17 @@ int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
 	}
 	return 0;
 }
+
+int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks)
+{
+	struct fdt_batch batch;
+	int err;
+
+	fdt_batch_init(&batch, blob);
+	err = fdt_fixup_memory_banks_batch(&batch, start, size, banks);
+
+	return fdt_run_batch(&batch, err, "/memory");
+}
 #endif
 
 int fdt_fixup_memory(void *blob, u64 start, u64 size)
@@ -467,59 +509,103 @@ int fdt_fixup_memory(void *blob, u64 start, u64 size)
 	return fdt_fixup_memory_banks(blob, &start, &size, 1);
 }
 
-void fdt_fixup_ethernet(void *fdt)
+/* Record the MAC address fixups for an alias, if it is an ethernet one */
+static void fdt_fixup_ethernet_alias(struct fdt_batch *batch, int offset)
 {
-	int i, j, prop;
+	void *fdt = batch->fdt;
+	int i, j;
 	char *tmp, *end;
 	char mac[16];
-	const char *path;
+	const char *path, *name;
 	unsigned char mac_addr[ARP_HLEN];
-	int offset;
+	int len = strlen("ethernet");
 
-	if (fdt_path_offset(fdt, "/aliases") < 0)
+	path = fdt_getprop_by_offset(fdt, offset, &name, NULL);
+	if (strncmp(name, "ethernet", len))
+		return;
+	i = trailing_strtol(name);
+	if (i != -1) {
+		if (i == 0)
+			strcpy(mac, "ethaddr");
+		else
+			sprintf(mac, "eth%daddr", i);
+	} else {
+		return;
+	}
+	tmp = getenv(mac);
+	if (!tmp)
 		return;
 
-	/* Cycle through all aliases */
-	for (prop = 0; ; prop++) {
-		const char *name;
-		int len = strlen("ethernet");
+	for (j = 0; j < 6; j++) {
+		mac_addr[j] = tmp ? simple_strtoul(tmp, &end, 16) : 0;
+		if (tmp)
+			tmp = (*end) ? end + 1 : end;
+	}
 
-		/* FDT might have been edited, recompute the offset */
-		offset = fdt_first_property_offset(fdt,
-			fdt_path_offset(fdt, "/aliases"));
-		/* Select property number 'prop' */
-		for (i = 0; i < prop; i++)
-			offset = fdt_next_property_offset(fdt, offset);
+	j = *path == '/' ? fdt_path_offset(fdt, path) : -FDT_ERR_BADPATH;
+	/* An alias for a node which is not there is skipped quietly */
+	if (j == -FDT_ERR_NOTFOUND)
+		return;
+	if (j < 0) {
+		printf("Unable to update property %s:%s, err=%s\n",
+		       path, "local-mac-address", fdt_strerror(j));
+		return;
+	}
+	if (fdt_getprop(fdt, j, "mac-address", NULL))
+		fdt_batch_setprop(batch, path, "mac-address", mac_addr, 6);
+	fdt_batch_setprop(batch, path, "local-mac-address", mac_addr, 6);
+}
 
-		if (offset < 0)
-			break;
+void fdt_fixup_ethernet_batch(struct fdt_batch *batch)
+{
+	void *fdt = batch->fdt;
+	int node, offset;
 
-		path = fdt_getprop_by_offset(fdt, offset, &name, NULL);
-		if (!strncmp(name, "ethernet", len)) {
-			i = trailing_strtol(name);
-			if (i != -1) {
-				if (i == 0)
-					strcpy(mac, "ethaddr");
-				else
-					sprintf(mac, "eth%daddr", i);
-			} else {
-				continue;
-			}
-			tmp = getenv(mac);
-			if (!tmp)
-				continue;
-
-			for (j = 0; j < 6; j++) {
-				mac_addr[j] = tmp ?
-					      simple_strtoul(tmp, &end, 16) : 0;
-				if (tmp)
-					tmp = (*end) ? end + 1 : end;
-			}
+	node = fdt_path_offset(fdt, "/aliases");
+	if (node < 0)
+		return;
+
+	/* Cycle through all aliases, the tree is not changed until commit */
+	fdt_for_each_property_offset(offset, fdt, node)
+		fdt_fixup_ethernet_alias(batch, offset);
+}
+
+void fdt_fixup_ethernet(void *fdt)
+{
+	struct fdt_batch batch;
+	const char *path;
+	int i, n, node, offset;
+	int err;
+
+	fdt_batch_init(&batch, fdt);
+	fdt_fixup_ethernet_batch(&batch);
+	if (!fdt_batch_commit(&batch))
+		return;
+
+	/*
+	 * Fall back to fixing up one alias at a time, so that one node which
+	 * cannot be updated does not hold up the others. Each change moves
+	 * the tree about, so look the alias up again each time.
+	 */
+	for (i = 0; ; i++) {
+		node = fdt_path_offset(fdt, "/aliases");
+		if (node < 0)
+			return;
+		n = 0;
+		fdt_for_each_property_offset(offset, fdt, node) {
+			if (n++ == i)
+				break;
+		}
+		if (offset < 0)
+			return;
 
-			do_fixup_by_path(fdt, path, "mac-address",
-					 &mac_addr, 6, 0);
-			do_fixup_by_path(fdt, path, "local-mac-address",
-					 &mac_addr, 6, 1);
+		fdt_batch_init(&batch, fdt);
+		fdt_fixup_ethernet_alias(&batch, offset);
+		err = fdt_batch_commit(&batch);
+		if (err < 0) {
+			path = fdt_getprop_by_offset(fdt, offset, NULL, NULL);
+			printf("Unable to update property %s:%s, err=%s\n",
+			       path, "local-mac-address", fdt_strerror(err));
 		}
 	}
 }
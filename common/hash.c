@@ -115,7 +115,8 @@ static int hash_finish_crc32(struct hash_algo *algo, void *ctx, void *dest_buf,
 /*
  * These are the hash algorithms we support. Chips which support accelerated
  * crypto could perhaps add named version of these algorithms here. Note that
- * algorithm names must be in lower case.
+ * algorithm names must be in lower case. Other providers can be declared
+ * anywhere with U_BOOT_HASH_ALGO().
  */
 static struct hash_algo hash_algo[] = {
 	/*
@@ -124,57 +125,67 @@ static struct hash_algo hash_algo[] = {
 	 */
 #ifdef CONFIG_SHA_HW_ACCEL
 	{
-		"sha1",
-		SHA1_SUM_LEN,
-		hw_sha1,
-		CHUNKSZ_SHA1,
+		.name		= "sha1",
+		.digest_size	= SHA1_SUM_LEN,
+		.hash_func_ws	= hw_sha1,
+		.chunk_size	= CHUNKSZ_SHA1,
 #ifdef CONFIG_SHA_PROG_HW_ACCEL
-		hw_sha_init,
-		hw_sha_update,
-		hw_sha_finish,
+		.hash_init	= hw_sha_init,
+		.hash_update	= hw_sha_update,
+		.hash_finish	= hw_sha_finish,
 #endif
+		.driver		= "hw",
+		.priority	= HASH_PRIO_HW,
 	}, {
-		"sha256",
-		SHA256_SUM_LEN,
-		hw_sha256,
-		CHUNKSZ_SHA256,
+		.name		= "sha256",
+		.digest_size	= SHA256_SUM_LEN,
+		.hash_func_ws	= hw_sha256,
+		.chunk_size	= CHUNKSZ_SHA256,
 #ifdef CONFIG_SHA_PROG_HW_ACCEL
-		hw_sha_init,
-		hw_sha_update,
-		hw_sha_finish,
+		.hash_init	= hw_sha_init,
+		.hash_update	= hw_sha_update,
+		.hash_finish	= hw_sha_finish,
 #endif
+		.driver		= "hw",
+		.priority	= HASH_PRIO_HW,
 	},
 #endif
 #ifdef CONFIG_SHA1
 	{
-		"sha1",
-		SHA1_SUM_LEN,
-		sha1_csum_wd,
-		CHUNKSZ_SHA1,
-		hash_init_sha1,
-		hash_update_sha1,
-		hash_finish_sha1,
+		.name		= "sha1",
+		.digest_size	= SHA1_SUM_LEN,
+		.hash_func_ws	= sha1_csum_wd,
+		.chunk_size	= CHUNKSZ_SHA1,
+		.hash_init	= hash_init_sha1,
+		.hash_update	= hash_update_sha1,
+		.hash_finish	= hash_finish_sha1,
+		.driver		= "sw",
+		.priority	= HASH_PRIO_SW,
 	},
 #endif
 #ifdef CONFIG_SHA256
 	{
-		"sha256",
-		SHA256_SUM_LEN,
-		sha256_csum_wd,
-		CHUNKSZ_SHA256,
-		hash_init_sha256,
-		hash_update_sha256,
-		hash_finish_sha256,
+		.name		= "sha256",
+		.digest_size	= SHA256_SUM_LEN,
+		.hash_func_ws	= sha256_csum_wd,
+		.chunk_size	= CHUNKSZ_SHA256,
+		.hash_init	= hash_init_sha256,
+		.hash_update	= hash_update_sha256,
+		.hash_finish	= hash_finish_sha256,
+		.driver		= "sw",
+		.priority	= HASH_PRIO_SW,
 	},
 #endif
 	{
-		"crc32",
-		4,
-		crc32_wd_buf,
-		CHUNKSZ_CRC32,
-		hash_init_crc32,
-		hash_update_crc32,
-		hash_finish_crc32,
+		.name		= "crc32",
+		.digest_size	= 4,
+		.hash_func_ws	= crc32_wd_buf,
+		.chunk_size	= CHUNKSZ_CRC32,
+		.hash_init	= hash_init_crc32,
+		.hash_update	= hash_update_crc32,
+		.hash_finish	= hash_finish_crc32,
+		.driver		= "sw",
+		.priority	= HASH_PRIO_SW,
 	},
 };
 
@@ -193,39 +204,149 @@ static struct hash_algo hash_algo[] = {
 #define multi_hash()	0
 #endif
 
-int hash_lookup_algo(const char *algo_name, struct hash_algo **algop)
+struct hash_algo *hash_get_provider(int index)
 {
+#ifndef USE_HOSTCC
+	struct hash_algo *list = ll_entry_start(struct hash_algo, hash_algo);
+	int count = ll_entry_count(struct hash_algo, hash_algo);
+#endif
+
+	if (index < ARRAY_SIZE(hash_algo))
+		return &hash_algo[index];
+#ifndef USE_HOSTCC
+	index -= ARRAY_SIZE(hash_algo);
+	if (index < count)
+		return &list[index];
+#endif
+
+	return NULL;
+}
+
+/* Check whether a provider can be used, as it may depend on the hardware */
+static bool hash_provider_usable(struct hash_algo *algo)
+{
+	return !algo->probe || !algo->probe(algo);
+}
+
+/* Find the usable provider of @algo_name with the highest priority */
+static int hash_find_provider(const char *algo_name, bool progressive,
+			      struct hash_algo **algop)
+{
+	struct hash_algo *algo, *best = NULL;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
-		if (!strcmp(algo_name, hash_algo[i].name)) {
-			*algop = &hash_algo[i];
-			return 0;
-		}
+	for (i = 0; (algo = hash_get_provider(i)); i++) {
+		if (strcmp(algo_name, algo->name))
+			continue;
+		if (progressive && !algo->hash_init)
+			continue;
+		if (best && algo->priority <= best->priority)
+			continue;
+		if (hash_provider_usable(algo))
+			best = algo;
+	}
+	if (!best) {
+		debug("Unknown hash algorithm '%s'\n", algo_name);
+		return -EPROTONOSUPPORT;
 	}
+	*algop = best;
 
-	debug("Unknown hash algorithm '%s'\n", algo_name);
-	return -EPROTONOSUPPORT;
+	return 0;
+}
+
+int hash_lookup_algo(const char *algo_name, struct hash_algo **algop)
+{
+	return hash_find_provider(algo_name, false, algop);
 }
 
 int hash_progressive_lookup_algo(const char *algo_name,
 				 struct hash_algo **algop)
 {
+	return hash_find_provider(algo_name, true, algop);
+}
+
+int hash_lookup_provider(const char *algo_name, const char *driver,
+			 struct hash_algo **algop)
+{
+	struct hash_algo *algo;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(hash_algo); i++) {
-		if (!strcmp(algo_name, hash_algo[i].name)) {
-			if (hash_algo[i].hash_init) {
-				*algop = &hash_algo[i];
-				return 0;
-			}
-		}
+	for (i = 0; (algo = hash_get_provider(i)); i++) {
+		if (strcmp(algo_name, algo->name) ||
+		    strcmp(driver, algo->driver))
+			continue;
+		if (!hash_provider_usable(algo))
+			return -ENODEV;
+		*algop = algo;
+		return 0;
 	}
 
-	debug("Unknown hash algorithm '%s'\n", algo_name);
 	return -EPROTONOSUPPORT;
 }
 
+/* Throw away a progressive hash context, which only hash_finish() frees */
+static void hash_stream_abort_ctx(struct hash_algo *algo, void *ctx)
+{
+	uint8_t scratch[HASH_MAX_DIGEST_SIZE];
+
+	algo->hash_finish(algo, ctx, scratch, sizeof(scratch));
+}
+
+int hash_stream_init(struct hash_stream *hs, const char *algo_name)
+{
+	int ret;
+
+	hs->algo = NULL;
+	hs->ctx = NULL;
+	ret = hash_progressive_lookup_algo(algo_name, &hs->algo);
+	if (ret)
+		return ret;
+	if (hs->algo->hash_init(hs->algo, &hs->ctx) || !hs->ctx) {
+		hs->algo = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int hash_stream_update(struct hash_stream *hs, const void *buf,
+		       unsigned int size)
+{
+	if (!hs->algo)
+		return -EINVAL;
+	if (hs->algo->hash_update(hs->algo, hs->ctx, buf, size, 0)) {
+		/* The context has already been freed */
+		hs->algo = NULL;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int hash_stream_finish(struct hash_stream *hs, void *output, int size)
+{
+	struct hash_algo *algo = hs->algo;
+
+	if (!algo)
+		return -EINVAL;
+	hs->algo = NULL;
+	if (size < algo->digest_size) {
+		hash_stream_abort_ctx(algo, hs->ctx);
+		return -ENOSPC;
+	}
+	if (algo->hash_finish(algo, hs->ctx, output, size))
+		return -EIO;
+
+	return algo->digest_size;
+}
+
+void hash_stream_abort(struct hash_stream *hs)
+{
+	if (hs->algo)
+		hash_stream_abort_ctx(hs->algo, hs->ctx);
+	hs->algo = NULL;
+}
+
 #ifndef USE_HOSTCC
 int hash_parse_string(const char *algo_name, const char *str, uint8_t *result)
 {
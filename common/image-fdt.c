@@ -492,15 +492,26 @@ int image_setup_libfdt(bootm_headers_t *images, void *blob,
 {
 	ulong *initrd_start = &images->initrd_start;
 	ulong *initrd_end = &images->initrd_end;
+	struct fdt_batch batch;
 	int ret = -EPERM;
 	int fdt_ret;
 
-	if (fdt_root(blob) < 0) {
+	/* Make the generic changes in one go */
+	fdt_batch_init(&batch, blob);
+	if (fdt_root_batch(&batch) < 0) {
 		printf("ERROR: root node setup failed\n");
+		fdt_batch_abort(&batch);
 		goto err;
 	}
-	if (fdt_chosen(blob) < 0) {
+	if (fdt_chosen_batch(&batch) < 0) {
 		printf("ERROR: /chosen node create failed\n");
+		fdt_batch_abort(&batch);
+		goto err;
+	}
+	fdt_ret = fdt_batch_commit(&batch);
+	if (fdt_ret < 0) {
+		printf("ERROR: root and /chosen node setup failed: %s\n",
+		       fdt_strerror(fdt_ret));
 		goto err;
 	}
 	if (arch_fixup_fdt(blob) < 0) {
@@ -18,6 +18,7 @@
 #include <common.h>
 #include <errno.h>
 #include <mapmem.h>
+#include <watchdog.h>
 #include <asm/io.h>
 DECLARE_GLOBAL_DATA_PTR;
 #endif /* !USE_HOSTCC*/
@@ -970,6 +971,16 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 	return 0;
 }
 
+/*
+ * SHA1 and SHA256 go through hash_lookup_algo(), so that a faster provider
+ * is used where there is one. SPL may be built without common/hash.c.
+ */
+#if defined(CONFIG_SPL_BUILD) && !defined(CONFIG_SPL_HASH_SUPPORT)
+#define FIT_HASH_PROVIDERS	0
+#else
+#define FIT_HASH_PROVIDERS	1
+#endif
+
 /**
  * calculate_hash - calculate and return hash for provided input data
  * @data: pointer to the input data
@@ -991,6 +1002,19 @@ int fit_set_timestamp(void *fit, int noffset, time_t timestamp)
 int calculate_hash(const void *data, int data_len, const char *algo,
 			uint8_t *value, int *value_len)
 {
+#if FIT_HASH_PROVIDERS
+	struct hash_algo *ha;
+
+	if ((IMAGE_ENABLE_SHA1 && strcmp(algo, "sha1") == 0) ||
+	    (IMAGE_ENABLE_SHA256 && strcmp(algo, "sha256") == 0)) {
+		if (hash_lookup_algo(algo, &ha))
+			return -1;
+		ha->hash_func_ws((unsigned char *)data, data_len,
+				 (unsigned char *)value, ha->chunk_size);
+		*value_len = ha->digest_size;
+		return 0;
+	}
+#endif
 	if (IMAGE_ENABLE_CRC32 && strcmp(algo, "crc32") == 0) {
 		*((uint32_t *)value) = crc32_wd(0, data, data_len,
 							CHUNKSZ_CRC32);
@@ -1014,15 +1038,26 @@ int calculate_hash(const void *data, int data_len, const char *algo,
 	return 0;
 }
 
+/* A hash value worked out in advance, e.g. while copying the image */
+struct fit_hash_value {
+	int noffset;		/* Hash node, or -1 if not used */
+	uint8_t value[FIT_MAX_HASH_LEN];
+	int value_len;
+};
+
 static int fit_image_check_hash(const void *fit, int noffset, const void *data,
-				size_t size, char **err_msgp)
+				size_t size,
+				const struct fit_hash_value *hashes,
+				int count, char **err_msgp)
 {
-	uint8_t value[FIT_MAX_HASH_LEN];
+	uint8_t value_buf[FIT_MAX_HASH_LEN];
+	const uint8_t *value = value_buf;
 	int value_len;
 	char *algo;
 	uint8_t *fit_value;
 	int fit_value_len;
 	int ignore;
+	int i;
 
 	*err_msgp = NULL;
 
@@ -1046,7 +1081,13 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 		return -1;
 	}
 
-	if (calculate_hash(data, size, algo, value, &value_len)) {
+	/* Use the value worked out in advance if there is one */
+	for (i = 0; i < count && hashes[i].noffset != noffset; i++)
+		;
+	if (i < count) {
+		value = hashes[i].value;
+		value_len = hashes[i].value_len;
+	} else if (calculate_hash(data, size, algo, value_buf, &value_len)) {
 		*err_msgp = "Unsupported hash algorithm";
 		return -1;
 	}
@@ -1062,20 +1103,13 @@ static int fit_image_check_hash(const void *fit, int noffset, const void *data,
 	return 0;
 }
 
-/**
- * fit_image_verify - verify data integrity
- * @fit: pointer to the FIT format image header
- * @image_noffset: component image node offset
- *
- * fit_image_verify() goes over component image hash nodes,
- * re-calculates each data hash and compares with the value stored in hash
- * node.
- *
- * returns:
- *     1, if all hashes are valid
- *     0, otherwise (or on error)
+/*
+ * As fit_image_verify(), using the values in @hashes for the hash nodes
+ * they were worked out for
  */
-int fit_image_verify(const void *fit, int image_noffset)
+static int fit_image_verify_hashes(const void *fit, int image_noffset,
+				   const struct fit_hash_value *hashes,
+				   int count)
 {
 	const void	*data;
 	size_t		size;
@@ -1110,7 +1144,7 @@ int fit_image_verify(const void *fit, int image_noffset)
 		if (!strncmp(name, FIT_HASH_NODENAME,
 			     strlen(FIT_HASH_NODENAME))) {
 			if (fit_image_check_hash(fit, noffset, data, size,
-						 &err_msg))
+						 hashes, count, &err_msg))
 				goto error;
 			puts("+ ");
 		} else if (IMAGE_ENABLE_VERIFY && verify_all &&
@@ -1146,6 +1180,24 @@ error:
 	return 0;
 }
 
+/**
+ * fit_image_verify - verify data integrity
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ *
+ * fit_image_verify() goes over component image hash nodes,
+ * re-calculates each data hash and compares with the value stored in hash
+ * node.
+ *
+ * returns:
+ *     1, if all hashes are valid
+ *     0, otherwise (or on error)
+ */
+int fit_image_verify(const void *fit, int image_noffset)
+{
+	return fit_image_verify_hashes(fit, image_noffset, NULL, 0);
+}
+
 /**
  * fit_all_image_verify - verify data integrity for all images
  * @fit: pointer to the FIT format image header
@@ -1599,6 +1651,164 @@ static int fit_image_select(const void *fit, int rd_noffset, int verify)
 	return 0;
 }
 
+/*
+ * Images which fit_image_load() moves to their load address are hashed in
+ * the same pass that copies them. Hashing needs the progressive hash_algo
+ * interface, and post-processing changes the data before it is copied.
+ */
+#if defined(USE_HOSTCC) || defined(CONFIG_FIT_IMAGE_POST_PROCESS) || \
+	(defined(CONFIG_SPL_BUILD) && !defined(CONFIG_SPL_HASH_SUPPORT))
+#define FIT_LOAD_HASH		0
+#else
+#define FIT_LOAD_HASH		1
+#endif
+
+/* Most hash nodes which are worked out while copying an image */
+#define FIT_LOAD_HASHES		4
+
+/* Bytes copied at a time, small enough to still be in cache when hashed */
+#define FIT_LOAD_CHUNK		(64 << 10)
+
+#if FIT_LOAD_HASH
+/**
+ * fit_image_copy_hashed - copy image data, hashing it on the way
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @dst: where to copy the data to
+ * @src: image data, which must not overlap @dst
+ * @len: number of bytes to copy
+ * @hashes: table of hash values, filled in
+ * @countp: returns the number of entries of @hashes in use
+ *
+ * fit_image_copy_hashed() starts a hash stream for each hash subnode of the
+ * image and then copies the data a chunk at a time, feeding each chunk to
+ * the streams while it is still in the cache. The results are left in
+ * @hashes, so that fit_image_check_hash() just compares them. Hash nodes
+ * whose algorithm cannot be streamed are left out, and
+ * fit_image_check_hash() calculates them as before.
+ */
+static void fit_image_copy_hashed(const void *fit, int image_noffset,
+				  void *dst, const void *src, size_t len,
+				  struct fit_hash_value *hashes, int *countp)
+{
+	struct hash_stream hs[FIT_LOAD_HASHES];
+	const char *algos[FIT_LOAD_HASHES];
+	struct fit_hash_value *hv;
+	size_t pos, chunk;
+	int count = 0;
+	int noffset;
+	char *algo;
+	int ignore;
+	int ret;
+	int i;
+
+	fdt_for_each_subnode(noffset, fit, image_noffset) {
+		const char *name = fit_get_name(fit, noffset, NULL);
+
+		if (count == FIT_LOAD_HASHES)
+			break;
+		if (strncmp(name, FIT_HASH_NODENAME,
+			    strlen(FIT_HASH_NODENAME)))
+			continue;
+		if (fit_image_hash_get_algo(fit, noffset, &algo))
+			continue;
+		if (IMAGE_ENABLE_IGNORE) {
+			fit_image_hash_get_ignore(fit, noffset, &ignore);
+			if (ignore)
+				continue;
+		}
+		if (hash_stream_init(&hs[count], algo))
+			continue;
+
+		algos[count] = algo;
+		hashes[count++].noffset = noffset;
+	}
+
+	for (pos = 0; pos < len; pos += chunk) {
+		chunk = min_t(size_t, len - pos, FIT_LOAD_CHUNK);
+		memcpy(dst + pos, src + pos, chunk);
+		for (i = 0; i < count; i++)
+			hash_stream_update(&hs[i], dst + pos, chunk);
+		WATCHDOG_RESET();
+	}
+
+	for (i = 0; i < count; i++) {
+		hv = &hashes[i];
+		ret = hash_stream_finish(&hs[i], hv->value, sizeof(hv->value));
+		if (ret < 0) {
+			/* Leave it to fit_image_check_hash() */
+			hv->noffset = -1;
+			continue;
+		}
+		hv->value_len = ret;
+		if (!strcmp(algos[i], "crc32"))
+			*((uint32_t *)hv->value) =
+				cpu_to_uimage(*((uint32_t *)hv->value));
+	}
+	*countp = count;
+}
+
+/**
+ * fit_image_load_verify - move image data to its load address and verify it
+ * @fit: pointer to the FIT format image header
+ * @image_noffset: component image node offset
+ * @dst: load address
+ * @src: image data
+ * @len: number of bytes of image data
+ *
+ * Where @dst is clear of both @src and the FIT itself the hashes are
+ * worked out while copying, so the data is only read once. If the
+ * verification fails @dst may then have been written to, but the caller
+ * will refuse to use it. Otherwise the data is verified before it is
+ * moved, as the copy may overwrite the data or the hash and signature
+ * nodes that are read back to check it.
+ *
+ * returns:
+ *     0, if the image was moved and all hashes are valid
+ *     -EACCES, otherwise
+ */
+static int fit_image_load_verify(const void *fit, int image_noffset,
+				 void *dst, const void *src, size_t len)
+{
+	struct fit_hash_value hashes[FIT_LOAD_HASHES];
+	const void *fit_end = fit + fit_get_size(fit);
+	int count = 0;
+	int ok;
+
+	puts("   Verifying Hash Integrity ... ");
+	if ((dst < src + len && src < dst + len) ||
+	    (dst < fit_end && fit < dst + len)) {
+		ok = fit_image_verify(fit, image_noffset);
+		if (ok)
+			memmove(dst, src, len);
+	} else {
+		fit_image_copy_hashed(fit, image_noffset, dst, src, len, hashes,
+				      &count);
+		ok = fit_image_verify_hashes(fit, image_noffset, hashes, count);
+	}
+	if (!ok) {
+		puts("Bad Data Hash\n");
+		return -EACCES;
+	}
+	puts("OK\n");
+
+	return 0;
+}
+#endif
+
+/* Check whether fit_image_load() will move an image to its load address */
+static bool fit_image_will_load(const void *fit, int noffset,
+				enum fit_load_op load_op)
+{
+	ulong load;
+
+	if (load_op == FIT_LOAD_IGNORED ||
+	    fit_image_get_load(fit, noffset, &load))
+		return false;
+
+	return load_op != FIT_LOAD_OPTIONAL_NON_ZERO || load;
+}
+
 int fit_get_node_from_config(bootm_headers_t *images, const char *prop_name,
 			ulong addr)
 {
@@ -1675,6 +1885,7 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	uint8_t os_arch;
 #endif
 	const char *prop_name;
+	bool verify_on_load;
 	int ret;
 
 	fit = map_sysmem(addr, 0);
@@ -1743,7 +1954,11 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 
 	printf("   Trying '%s' %s subimage\n", fit_uname, prop_name);
 
-	ret = fit_image_select(fit, noffset, images->verify);
+	/* Images which are moved are verified as they are copied, below */
+	verify_on_load = FIT_LOAD_HASH && images->verify &&
+			 fit_image_will_load(fit, noffset, load_op);
+	ret = fit_image_select(fit, noffset,
+			       images->verify && !verify_on_load);
 	if (ret) {
 		bootstage_error(bootstage_id + BOOTSTAGE_SUB_HASH);
 		return ret;
@@ -1863,7 +2078,18 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 		       prop_name, data, load);
 
 		dst = map_sysmem(load, len);
-		memmove(dst, buf, len);
+#if FIT_LOAD_HASH
+		if (verify_on_load) {
+			ret = fit_image_load_verify(fit, noffset, dst, buf,
+						    len);
+			if (ret) {
+				bootstage_error(bootstage_id +
+						BOOTSTAGE_SUB_HASH);
+				return ret;
+			}
+		} else
+#endif
+			memmove(dst, buf, len);
 		data = load;
 	}
 	bootstage_mark(bootstage_id + BOOTSTAGE_SUB_LOAD);
@@ -49,6 +49,30 @@
 #define CONFIG_FASTBOOT_FLASH_FILLBUF_SIZE (1024 * 512)
 #endif
 
+/*
+ * Find the whole erase groups within @blkcnt blocks at @blk. Returns the
+ * number of blocks in them, and in @headp the number of blocks before the
+ * first one.
+ */
+static lbaint_t sparse_erase_range(struct sparse_storage *info, lbaint_t blk,
+				   lbaint_t blkcnt, lbaint_t *headp)
+{
+	lbaint_t head;
+	u32 rem;
+
+	if (!info->erase || !info->erase_grp)
+		return 0;
+
+	div_u64_rem(blk, info->erase_grp, &rem);
+	head = rem ? info->erase_grp - rem : 0;
+	if (head >= blkcnt)
+		return 0;
+	div_u64_rem(blkcnt - head, info->erase_grp, &rem);
+	*headp = head;
+
+	return blkcnt - head - rem;
+}
+
 void write_sparse_image(
 		struct sparse_storage *info, const char *part_name,
 		void *data, unsigned sz)
@@ -57,6 +81,10 @@ void write_sparse_image(
 	lbaint_t blkcnt;
 	lbaint_t blks;
 	uint32_t bytes_written = 0;
+	lbaint_t blks_erased = 0;
+	lbaint_t erase_cnt;
+	lbaint_t head = 0;
+	ulong start_time;
 	unsigned int chunk;
 	unsigned int offset;
 	unsigned int chunk_data_sz;
@@ -106,6 +134,7 @@ void write_sparse_image(
 	}
 
 	puts("Flashing Sparse Image\n");
+	start_time = get_timer(0);
 
 	/* Start processing chunks */
 	blk = info->start;
@@ -203,10 +232,36 @@ void write_sparse_image(
 				return;
 			}
 
+			/* Zeroes can be erased rather than written */
+			erase_cnt = 0;
+			if (!fill_val && info->erase_zeroes)
+				erase_cnt = sparse_erase_range(info, blk,
+							       blkcnt, &head);
+
 			for (i = 0; i < blkcnt;) {
+				if (erase_cnt && i == head) {
+					blks = info->erase(info, blk,
+							   erase_cnt);
+					if (blks < erase_cnt) {
+						printf("%s: %s " LBAFU " [" LBAFU "]\n",
+						       __func__,
+						       "Erase failed, block #",
+						       blk, erase_cnt);
+						fastboot_fail(
+							"flash erase failure");
+						free(fill_buf);
+						return;
+					}
+					blk += blks;
+					i += erase_cnt;
+					blks_erased += erase_cnt;
+					continue;
+				}
 				j = blkcnt - i;
 				if (j > fill_buf_num_blks)
 					j = fill_buf_num_blks;
+				if (erase_cnt && i < head && j > head - i)
+					j = head - i;
 				blks = info->write(info, blk, j, fill_buf);
 				/* blks might be > j (eg. NAND bad-blocks) */
 				if (blks < j) {
@@ -222,12 +277,17 @@ void write_sparse_image(
 				blk += blks;
 				i += j;
 			}
-			bytes_written += blkcnt * info->blksz;
+			bytes_written += (blkcnt - erase_cnt) * info->blksz;
 			total_blocks += chunk_data_sz / sparse_header->blk_sz;
 			free(fill_buf);
 			break;
 
 		case CHUNK_TYPE_DONT_CARE:
+			/*
+			 * Not erased: the host splits large images into
+			 * several sparse files, each marking the ranges of the
+			 * others as don't-care
+			 */
 			blk += info->reserve(info, blk, blkcnt);
 			total_blocks += chunk_header->chunk_sz;
 			break;
@@ -254,6 +314,10 @@ void write_sparse_image(
 	debug("Wrote %d blocks, expected to write %d blocks\n",
 	      total_blocks, sparse_header->total_blks);
 	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	if (blks_erased)
+		printf("........ erased " LBAFU " bytes\n",
+		       blks_erased * info->blksz);
+	printf("........ took %lu ms\n", get_timer(start_time));
 
 	if (total_blocks != sparse_header->total_blks)
 		fastboot_fail("sparse image write failure");
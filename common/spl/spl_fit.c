@@ -121,6 +121,63 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return (data_size + info->bl_len - 1) / info->bl_len;
 }
 
+#if defined(CONFIG_SPL_OS_BOOT) && defined(CONFIG_SPL_GZIP)
+struct spl_fit_gz_priv {
+	struct spl_load_info *info;
+	ulong sector;		/* start of the FIT image on the device */
+	int offset;		/* next compressed byte, relative to the FIT */
+	int left;		/* compressed bytes still to be read */
+};
+
+static int spl_fit_gz_read(void *priv, void *buf, int size)
+{
+	struct spl_fit_gz_priv *gz = priv;
+	struct spl_load_info *info = gz->info;
+	int unit = info->filename ? 1 : info->bl_len;
+	int overhead, count, len;
+
+	if (!gz->left)
+		return 0;
+
+	overhead = get_aligned_image_overhead(info, gz->offset);
+	count = min(size / unit, get_aligned_image_size(info, gz->left,
+							  gz->offset));
+	if (info->read(info, gz->sector +
+		       get_aligned_image_offset(info, gz->offset),
+		       count, buf) != count)
+		return -EIO;
+
+	len = min(count * unit - overhead, gz->left);
+	if (overhead)
+		memmove(buf, buf + overhead, len);
+	gz->offset += len;
+	gz->left -= len;
+
+	return len;
+}
+
+/*
+ * Inflate external image data while it is read from the device, instead of
+ * reading it all to the load address first and decompressing in place
+ */
+static int spl_load_fit_gz(struct spl_load_info *info, ulong sector,
+			   int offset, int len, ulong load_addr, ulong *sizep)
+{
+	struct spl_fit_gz_priv gz = {
+		.info = info,
+		.sector = sector,
+		.offset = offset,
+		.left = len,
+	};
+
+	debug("External gzip data: dst=%lx, offset=%x, size=%x\n",
+	      load_addr, offset, len);
+
+	return gunzip_stream((void *)load_addr, CONFIG_SYS_BOOTM_LEN,
+			     spl_fit_gz_read, &gz, sizep);
+}
+#endif
+
 /**
  * spl_load_fit_image(): load the image described in a certain FIT node
  * @info:	points to information about the device to load data from
@@ -182,6 +239,19 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		if (fit_image_get_data_size(fit, node, &len))
 			return -ENOENT;
 
+#if defined(CONFIG_SPL_OS_BOOT) && defined(CONFIG_SPL_GZIP) && \
+	!defined(CONFIG_SPL_FIT_IMAGE_POST_PROCESS)
+		if (image_comp == IH_COMP_GZIP && type == IH_TYPE_KERNEL) {
+			if (spl_load_fit_gz(info, sector, offset, len,
+					    load_addr, &size)) {
+				puts("Uncompressing error\n");
+				return -EIO;
+			}
+			length = size;
+			goto done;
+		}
+#endif
+
 		load_ptr = (load_addr + align_len) & ~align_len;
 		length = len;
 
@@ -226,6 +296,10 @@ static int spl_load_fit_image(struct spl_load_info *info, ulong sector,
 		memcpy((void *)load_addr, src, length);
 	}
 
+#if defined(CONFIG_SPL_OS_BOOT) && defined(CONFIG_SPL_GZIP) && \
+	!defined(CONFIG_SPL_FIT_IMAGE_POST_PROCESS)
+done:
+#endif
 	if (image_info) {
 		image_info->load_addr = load_addr;
 		image_info->size = length;
@@ -8,6 +8,8 @@
 #include <common.h>
 #include <command.h>
 #include <errno.h>
+#include <fat.h>
+#include <fs.h>
 #include <ide.h>
 #include <malloc.h>
 #include <part.h>
@@ -218,6 +220,8 @@ void part_init(struct blk_desc *dev_desc)
 	struct part_driver *entry;
 
 	blkcache_invalidate(dev_desc->if_type, dev_desc->devnum);
+	fs_dcache_invalidate();
+	fat_invalidate_open_file();
 
 	dev_desc->part_type = PART_TYPE_UNKNOWN;
 	for (entry = drv; entry != drv + n_ents; entry++) {
@@ -10,6 +10,7 @@
 #include <dm.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
+#include <watchdog.h>
 
 static const char *if_typename_str[IF_TYPE_COUNT] = {
 	[IF_TYPE_IDE]		= "ide",
@@ -314,6 +315,7 @@ int blk_select_hwpart(struct udevice *dev, int hwpart)
 	if (!ops->select_hwpart)
 		return 0;
 
+	blk_readahead_invalidate(dev);
 	return ops->select_hwpart(dev, hwpart);
 }
 
@@ -399,7 +401,11 @@ unsigned long blk_dread(struct blk_desc *block_dev, lbaint_t start,
 	if (blkcache_read(block_dev->if_type, block_dev->devnum,
 			  start, blkcnt, block_dev->blksz, buffer))
 		return blkcnt;
+#ifdef CONFIG_BLOCK_READAHEAD
+	blks_read = blk_readahead_read(dev, start, blkcnt, buffer);
+#else
 	blks_read = ops->read(dev, start, blkcnt, buffer);
+#endif
 	if (blks_read == blkcnt)
 		blkcache_fill(block_dev->if_type, block_dev->devnum,
 			      start, blkcnt, block_dev->blksz, buffer);
@@ -417,6 +423,8 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blk_readahead_invalidate(dev);
+	block_dev->write_gen++;
 	return ops->write(dev, start, blkcnt, buffer);
 }
 
@@ -430,9 +438,88 @@ unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 		return -ENOSYS;
 
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	blk_readahead_invalidate(dev);
+	block_dev->write_gen++;
 	return ops->erase(dev, start, blkcnt);
 }
 
+#ifdef CONFIG_BLK_ASYNC
+int blk_read_submit(struct blk_desc *block_dev, lbaint_t start,
+		    lbaint_t blkcnt, void *buffer, struct blk_req *req)
+{
+	struct udevice *dev = block_dev->bdev;
+	const struct blk_ops *ops = blk_get_ops(dev);
+	ulong blks_read;
+	int ret;
+
+	memset(req, '\0', sizeof(*req));
+	req->dev = dev;
+	req->start = start;
+	req->blkcnt = blkcnt;
+	req->buffer = buffer;
+
+	if (!blkcnt || blkcache_read(block_dev->if_type, block_dev->devnum,
+				     start, blkcnt, block_dev->blksz, buffer)) {
+		req->done = blkcnt;
+		req->busy = true;
+		return 0;
+	}
+
+	/* Without driver support the read completes right here */
+	if (!ops->read_start || !ops->read_poll) {
+		blks_read = blk_dread(block_dev, start, blkcnt, buffer);
+		if (IS_ERR_VALUE(blks_read))
+			return blks_read;
+		if (blks_read != blkcnt)
+			return -EIO;
+		req->done = blkcnt;
+		req->busy = true;
+		return 0;
+	}
+
+	ret = ops->read_start(dev, req);
+	if (ret)
+		return ret;
+	req->busy = true;
+
+	return 0;
+}
+
+long blk_read_poll(struct blk_req *req)
+{
+	struct udevice *dev = req->dev;
+	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+	const struct blk_ops *ops = blk_get_ops(dev);
+	long ret;
+
+	if (!req->busy || (req->done == req->blkcnt && !req->cur)) {
+		req->busy = false;
+		return req->done;
+	}
+
+	ret = ops->read_poll(dev, req);
+	if (ret == -EBUSY)
+		return ret;
+	req->busy = false;
+	if (ret == req->blkcnt)
+		blkcache_fill(block_dev->if_type, block_dev->devnum,
+			      req->start, req->blkcnt, block_dev->blksz,
+			      req->buffer);
+
+	return ret;
+}
+
+long blk_read_wait(struct blk_req *req)
+{
+	long ret;
+
+	while ((ret = blk_read_poll(req)) == -EBUSY)
+		WATCHDOG_RESET();
+
+	return ret;
+}
+#endif
+
 int blk_prepare_device(struct udevice *dev)
 {
 	struct blk_desc *desc = dev_get_uclass_platdata(dev);
@@ -542,8 +629,21 @@ int blk_unbind_all(int if_type)
 	return 0;
 }
 
+#ifdef CONFIG_BLOCK_READAHEAD
+static int blk_pre_remove(struct udevice *dev)
+{
+	blk_readahead_free(dev);
+
+	return 0;
+}
+#endif
+
 UCLASS_DRIVER(blk) = {
 	.id		= UCLASS_BLK,
 	.name		= "blk",
 	.per_device_platdata_auto_alloc_size = sizeof(struct blk_desc),
+#ifdef CONFIG_BLOCK_READAHEAD
+	.pre_remove	= blk_pre_remove,
+	.per_device_auto_alloc_size = sizeof(struct blk_readahead),
+#endif
 };
@@ -0,0 +1,146 @@
+/*
+ * Sequential read-ahead for block devices
+ *
+ * Filesystems tend to load files with many small reads of adjacent
+ * blocks. Once two reads in a row are found to be adjacent, the next
+ * small read is turned into a single transfer of a whole window of
+ * blocks into a staging buffer, and the following reads are served
+ * from there.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <blk.h>
+#include <dm.h>
+#include <malloc.h>
+#include <memalign.h>
+
+/* Number of adjacent reads needed before read-ahead kicks in */
+#define BLK_RA_TRIGGER		2
+
+static ulong blk_ra_read_direct(struct udevice *dev, lbaint_t start,
+				lbaint_t blkcnt, void *buffer)
+{
+	const struct blk_ops *ops = blk_get_ops(dev);
+
+	return ops->read(dev, start, blkcnt, buffer);
+}
+
+/* Fill the staging buffer with up to a window of blocks from @start */
+static int blk_ra_fill(struct udevice *dev, struct blk_readahead *ra,
+		       lbaint_t start)
+{
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+	lbaint_t count = CONFIG_BLOCK_READAHEAD_WINDOW;
+	ulong n;
+
+	if (!ra->buf) {
+		ra->buf = malloc_cache_aligned(CONFIG_BLOCK_READAHEAD_WINDOW *
+					       desc->blksz);
+		if (!ra->buf)
+			return -ENOMEM;
+		ra->blksz = desc->blksz;
+	}
+
+	/* Never read beyond the end of the device */
+	if (desc->lba && start >= desc->lba)
+		return -EINVAL;
+	if (desc->lba && start + count > desc->lba)
+		count = desc->lba - start;
+
+	ra->count = 0;
+	n = blk_ra_read_direct(dev, start, count, ra->buf);
+	if (IS_ERR_VALUE(n) || !n)
+		return -EIO;
+
+	debug("%s: start " LBAF ", count %lu\n", __func__, start, n);
+	ra->start = start;
+	ra->count = n;
+
+	return 0;
+}
+
+ulong blk_readahead_read(struct udevice *dev, lbaint_t start,
+			 lbaint_t blkcnt, void *buffer)
+{
+	struct blk_readahead *ra = dev_get_uclass_priv(dev);
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+	lbaint_t done = 0;
+	ulong n;
+
+	/* Devices which have not been probed have no read-ahead state */
+	if (!ra)
+		return blk_ra_read_direct(dev, start, blkcnt, buffer);
+
+	if (start != ra->next)
+		ra->seq = 0;
+	else if (ra->seq < BLK_RA_TRIGGER)
+		ra->seq++;
+	ra->next = start + blkcnt;
+
+	if (ra->buf && ra->blksz != desc->blksz)
+		blk_readahead_invalidate(dev);
+
+	while (done < blkcnt) {
+		lbaint_t pos = start + done;
+		lbaint_t left = blkcnt - done;
+		char *dst = (char *)buffer + done * desc->blksz;
+
+		/* Serve what we can from the staging buffer */
+		if (ra->count && pos >= ra->start &&
+		    pos < ra->start + ra->count) {
+			lbaint_t avail = ra->start + ra->count - pos;
+
+			n = min(avail, left);
+			memcpy(dst, ra->buf + (pos - ra->start) * desc->blksz,
+			       n * desc->blksz);
+			done += n;
+			continue;
+		}
+
+		/*
+		 * Random access, or a request big enough to be efficient on
+		 * its own: hand it straight to the driver
+		 */
+		if (ra->seq < BLK_RA_TRIGGER ||
+		    left >= CONFIG_BLOCK_READAHEAD_WINDOW) {
+			n = blk_ra_read_direct(dev, pos, left, dst);
+			if (IS_ERR_VALUE(n))
+				return done ? done : n;
+			return done + n;
+		}
+
+		if (blk_ra_fill(dev, ra, pos)) {
+			n = blk_ra_read_direct(dev, pos, left, dst);
+			if (IS_ERR_VALUE(n))
+				return done ? done : n;
+			return done + n;
+		}
+	}
+
+	return done;
+}
+
+void blk_readahead_invalidate(struct udevice *dev)
+{
+	struct blk_readahead *ra = dev_get_uclass_priv(dev);
+	struct blk_desc *desc = dev_get_uclass_platdata(dev);
+
+	if (!ra)
+		return;
+	ra->count = 0;
+	ra->seq = 0;
+	if (ra->buf && ra->blksz != desc->blksz) {
+		free(ra->buf);
+		ra->buf = NULL;
+	}
+}
+
+void blk_readahead_free(struct udevice *dev)
+{
+	struct blk_readahead *ra = dev_get_uclass_priv(dev);
+
+	free(ra->buf);
+	memset(ra, '\0', sizeof(*ra));
+}
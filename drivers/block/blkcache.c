@@ -12,8 +12,15 @@
 #include <linux/ctype.h>
 #include <linux/list.h>
 
+/*
+ * The cache is a fixed number of equally-sized entries carved out of a
+ * single arena. Entries in use are kept on an LRU list and in a hash
+ * table keyed by (iftype, devnum, start); unused entries sit on a free
+ * list. Nothing is allocated once the arena has been set up.
+ */
 struct block_cache_node {
-	struct list_head lh;
+	struct list_head lh;		/* LRU or free list */
+	struct hlist_node hn;		/* hash bucket chain */
 	int iftype;
 	int devnum;
 	lbaint_t start;
@@ -23,32 +30,116 @@ struct block_cache_node {
 };
 
 static LIST_HEAD(block_cache);
+static LIST_HEAD(block_cache_free);
+
+static struct block_cache_node *cache_nodes;
+static struct hlist_head *cache_buckets;
+static unsigned int cache_bucket_mask;
+static char *cache_arena;
 
 static struct block_cache_stats _stats = {
-	.max_blocks_per_entry = 2,
-	.max_entries = 32
+	.max_bytes = CONFIG_BLOCK_CACHE_SIZE,
+	.entry_bytes = CONFIG_BLOCK_CACHE_ENTRY_SIZE,
 };
 
+static unsigned int cache_hash(int iftype, int devnum, lbaint_t start)
+{
+	u32 key;
+
+	key = (u32)start ^ (u32)((u64)start >> 32);
+	key ^= ((u32)iftype << 24) ^ ((u32)devnum << 16);
+
+	/* Fibonacci hashing spreads adjacent block numbers over buckets */
+	return (key * 0x9e370001U) >> 8 & cache_bucket_mask;
+}
+
+static void cache_release(void)
+{
+	free(cache_arena);
+	free(cache_nodes);
+	free(cache_buckets);
+	cache_arena = NULL;
+	cache_nodes = NULL;
+	cache_buckets = NULL;
+	INIT_LIST_HEAD(&block_cache);
+	INIT_LIST_HEAD(&block_cache_free);
+	_stats.entries = 0;
+	_stats.max_entries = 0;
+}
+
+static int cache_setup(void)
+{
+	unsigned int count, buckets, i;
+
+	if (cache_arena)
+		return 0;
+	if (!_stats.entry_bytes)
+		return -EINVAL;
+
+	count = _stats.max_bytes / _stats.entry_bytes;
+	if (!count)
+		return -EINVAL;
+
+	/* Keep the chains short: at least one bucket per entry */
+	for (buckets = 1; buckets < count; buckets <<= 1)
+		;
+
+	cache_arena = malloc(count * _stats.entry_bytes);
+	cache_nodes = calloc(count, sizeof(*cache_nodes));
+	cache_buckets = calloc(buckets, sizeof(*cache_buckets));
+	if (!cache_arena || !cache_nodes || !cache_buckets) {
+		debug("%s: cannot allocate %u entries\n", __func__, count);
+		cache_release();
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < count; i++) {
+		struct block_cache_node *node = &cache_nodes[i];
+
+		node->cache = cache_arena + i * _stats.entry_bytes;
+		INIT_HLIST_NODE(&node->hn);
+		list_add_tail(&node->lh, &block_cache_free);
+	}
+	cache_bucket_mask = buckets - 1;
+	_stats.max_entries = count;
+
+	return 0;
+}
+
+static void cache_drop(struct block_cache_node *node)
+{
+	debug("drop: start " LBAF ", count " LBAFU "\n",
+	      node->start, node->blkcnt);
+	hlist_del_init(&node->hn);
+	list_move(&node->lh, &block_cache_free);
+	_stats.entries--;
+}
+
 static struct block_cache_node *cache_find(int iftype, int devnum,
 					   lbaint_t start, lbaint_t blkcnt,
 					   unsigned long blksz)
 {
 	struct block_cache_node *node;
+	struct hlist_node *pos;
+
+	if (!cache_buckets)
+		return NULL;
 
-	list_for_each_entry(node, &block_cache, lh)
+	hlist_for_each_entry(node, pos,
+			     &cache_buckets[cache_hash(iftype, devnum, start)],
+			     hn)
 		if ((node->iftype == iftype) &&
 		    (node->devnum == devnum) &&
+		    (node->start == start) &&
 		    (node->blksz == blksz) &&
-		    (node->start <= start) &&
-		    (node->start + node->blkcnt >= start + blkcnt)) {
+		    (node->blkcnt >= blkcnt)) {
 			if (block_cache.next != &node->lh) {
 				/* maintain MRU ordering */
-				list_del(&node->lh);
-				list_add(&node->lh, &block_cache);
+				list_move(&node->lh, &block_cache);
 			}
 			return node;
 		}
-	return 0;
+	return NULL;
 }
 
 int blkcache_read(int iftype, int devnum,
@@ -58,8 +149,7 @@ int blkcache_read(int iftype, int devnum,
 	struct block_cache_node *node = cache_find(iftype, devnum, start,
 						   blkcnt, blksz);
 	if (node) {
-		const char *src = node->cache + (start - node->start) * blksz;
-		memcpy(buffer, src, blksz * blkcnt);
+		memcpy(buffer, node->cache, blksz * blkcnt);
 		debug("hit: start " LBAF ", count " LBAFU "\n",
 		      start, blkcnt);
 		++_stats.hits;
@@ -80,37 +170,28 @@ void blkcache_fill(int iftype, int devnum,
 	struct block_cache_node *node;
 
 	/* don't cache big stuff */
-	if (blkcnt > _stats.max_blocks_per_entry)
+	bytes = blksz * blkcnt;
+	if (!bytes || bytes > _stats.entry_bytes)
 		return;
 
-	if (_stats.max_entries == 0)
+	if (cache_setup())
 		return;
 
-	bytes = blksz * blkcnt;
-	if (_stats.max_entries <= _stats.entries) {
-		/* pop LRU */
-		node = (struct block_cache_node *)block_cache.prev;
-		list_del(&node->lh);
-		_stats.entries--;
-		debug("drop: start " LBAF ", count " LBAFU "\n",
-		      node->start, node->blkcnt);
-		if (node->blkcnt * node->blksz < bytes) {
-			free(node->cache);
-			node->cache = 0;
+	/* a shorter read of the same start may already be cached */
+	node = cache_find(iftype, devnum, start, 1, blksz);
+	if (!node) {
+		if (list_empty(&block_cache_free)) {
+			/* pop LRU */
+			cache_drop(list_entry(block_cache.prev,
+					      struct block_cache_node, lh));
+			++_stats.evictions;
 		}
+		node = list_first_entry(&block_cache_free,
+					struct block_cache_node, lh);
+		list_move(&node->lh, &block_cache);
+		_stats.entries++;
 	} else {
-		node = malloc(sizeof(*node));
-		if (!node)
-			return;
-		node->cache = 0;
-	}
-
-	if (!node->cache) {
-		node->cache = malloc(bytes);
-		if (!node->cache) {
-			free(node);
-			return;
-		}
+		hlist_del_init(&node->hn);
 	}
 
 	debug("fill: start " LBAF ", count " LBAFU "\n",
@@ -122,47 +203,35 @@ void blkcache_fill(int iftype, int devnum,
 	node->blkcnt = blkcnt;
 	node->blksz = blksz;
 	memcpy(node->cache, buffer, bytes);
-	list_add(&node->lh, &block_cache);
-	_stats.entries++;
+	hlist_add_head(&node->hn,
+		       &cache_buckets[cache_hash(iftype, devnum, start)]);
 }
 
 void blkcache_invalidate(int iftype, int devnum)
 {
-	struct list_head *entry, *n;
-	struct block_cache_node *node;
+	struct block_cache_node *node, *n;
 
-	list_for_each_safe(entry, n, &block_cache) {
-		node = (struct block_cache_node *)entry;
+	list_for_each_entry_safe(node, n, &block_cache, lh) {
 		if ((node->iftype == iftype) &&
-		    (node->devnum == devnum)) {
-			list_del(entry);
-			free(node->cache);
-			free(node);
-			--_stats.entries;
-		}
+		    (node->devnum == devnum))
+			cache_drop(node);
 	}
 }
 
-void blkcache_configure(unsigned blocks, unsigned entries)
+void blkcache_configure(unsigned max_bytes, unsigned entry_bytes)
 {
-	struct block_cache_node *node;
-	if ((blocks != _stats.max_blocks_per_entry) ||
-	    (entries != _stats.max_entries)) {
-		/* invalidate cache */
-		while (!list_empty(&block_cache)) {
-			node = (struct block_cache_node *)block_cache.next;
-			list_del(&node->lh);
-			free(node->cache);
-			free(node);
-		}
-		_stats.entries = 0;
+	if ((max_bytes != _stats.max_bytes) ||
+	    (entry_bytes != _stats.entry_bytes)) {
+		/* invalidate cache, the arena is rebuilt on the next fill */
+		cache_release();
 	}
 
-	_stats.max_blocks_per_entry = blocks;
-	_stats.max_entries = entries;
+	_stats.max_bytes = max_bytes;
+	_stats.entry_bytes = entry_bytes;
 
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
 }
 
 void blkcache_stats(struct block_cache_stats *stats)
@@ -170,4 +239,5 @@ void blkcache_stats(struct block_cache_stats *stats)
 	memcpy(stats, &_stats, sizeof(*stats));
 	_stats.hits = 0;
 	_stats.misses = 0;
+	_stats.evictions = 0;
 }
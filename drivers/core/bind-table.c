@@ -0,0 +1,236 @@
+/*
+ * Binding devices using a table built from the device tree
+ *
+ * dtoc writes out the nodes of the control device tree which have a
+ * compatible string, with links from each node to its children, and a hash
+ * table of all the compatible strings used. Once relocated, driver model
+ * uses this to bind devices instead of walking the device tree and matching
+ * every compatible string against every driver. Each compatible string is
+ * matched to its driver just once, by looking up the compatible strings of
+ * each driver in the hash table.
+ *
+ * The table only describes the device tree it was built from. If the
+ * device tree in use is a different one, or nodes or properties have been
+ * added or removed since, devices are bound from the device tree as usual.
+ * The device tree is checked against the table again at the start of each
+ * full scan, and the status of each node is read from the device tree
+ * itself, since it may have been changed in place.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <fdtdec.h>
+#include <malloc.h>
+#include <dm/bind-table.h>
+#include <dm/device-internal.h>
+#include <dm/util.h>
+#include <u-boot/crc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* The driver which binds to each compatible string, and how */
+struct dm_bind_match {
+	struct driver *driver;
+	const struct udevice_id *of_id;
+};
+
+static const struct dm_bind_table *bind_table = &dm_bind_table;
+static const void *bind_blob;		/* Last blob checked against table */
+static bool bind_blob_ok;		/* True if it matched */
+static struct dm_bind_match *bind_match;
+
+void dm_bind_table_recheck(void)
+{
+	bind_blob = NULL;
+}
+
+void dm_bind_table_select(const struct dm_bind_table *table)
+{
+	free(bind_match);
+	bind_match = NULL;
+	bind_table = table;
+	dm_bind_table_recheck();
+}
+
+int dm_bind_table_lookup(const char *compat)
+{
+	u32 hash = dm_hash_str(compat);
+	uint i, slot;
+
+	for (i = hash & bind_table->index_mask; (slot = bind_table->index[i]);
+	     i = (i + 1) & bind_table->index_mask) {
+		const struct dm_bind_compat *entry =
+			&bind_table->compats[slot - 1];
+
+		if (entry->hash != hash)
+			continue;
+		dm_stats_add(compat_compares, 1);
+		if (!strcmp(bind_table->strings + entry->name, compat))
+			return slot - 1;
+	}
+
+	return -ENOENT;
+}
+
+/* Find the driver for each compatible string, as lists_bind_fdt() would */
+static int dm_bind_table_match(void)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *of_id;
+	struct driver *entry;
+	int idx;
+
+	bind_match = calloc(bind_table->compat_count, sizeof(*bind_match));
+	if (!bind_match)
+		return -ENOMEM;
+
+	/* The first driver in the list wins */
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (of_id = entry->of_match; of_id && of_id->compatible;
+		     of_id++) {
+			idx = dm_bind_table_lookup(of_id->compatible);
+			if (idx >= 0 && !bind_match[idx].driver) {
+				bind_match[idx].driver = entry;
+				bind_match[idx].of_id = of_id;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static bool dm_bind_table_usable(const void *blob)
+{
+	/* Before relocation there is too little heap for the matches */
+	if (!(gd->flags & GD_FLG_RELOC) || !blob)
+		return false;
+
+	if (blob != bind_blob) {
+		bind_blob = blob;
+		bind_blob_ok = fdt_totalsize(blob) == bind_table->fdt_size &&
+			crc32(0, blob, fdt_totalsize(blob)) ==
+				bind_table->fdt_crc;
+		if (bind_blob_ok && !bind_match && dm_bind_table_match())
+			bind_blob_ok = false;
+		debug("%s: device tree %p %s the binding table\n", __func__,
+		      blob, bind_blob_ok ? "matches" : "does not match");
+	}
+
+	/* Adding or removing anything moves the nodes which follow it */
+	return bind_blob_ok &&
+		fdt_size_dt_struct(blob) == bind_table->fdt_struct_size;
+}
+
+static const struct dm_bind_node *dm_bind_table_find_node(int offset)
+{
+	int low = 0, high = bind_table->node_count - 1;
+
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		const struct dm_bind_node *node = &bind_table->nodes[mid];
+
+		if (node->offset == offset)
+			return node;
+		if (node->offset < offset)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+
+	return NULL;
+}
+
+/* Bind one node, as lists_bind_fdt() does, counting the same statistics */
+static int dm_bind_table_bind(struct udevice *parent, const void *blob,
+			      const struct dm_bind_node *node)
+{
+	const char *name = fdt_get_name(blob, node->offset, NULL);
+	const struct dm_bind_match *match;
+	struct udevice *dev;
+	bool found = false;
+	int result = 0;
+	int ret = 0;
+	int i;
+#if CONFIG_IS_ENABLED(DM_STATS)
+	ulong start = dm_stats_timer_us();
+#endif
+
+	dm_dbg("bind node %s\n", name);
+	dm_stats_add(bind_nodes, 1);
+	for (i = 0; i < node->compat_count; i++) {
+		/* Matched through the hash table by dm_bind_table_match() */
+		dm_stats_add(compat_lookups, 1);
+		dm_stats_add(compat_hashed, 1);
+		match = &bind_match[bind_table->compat_list[node->compats + i]];
+		if (!match->driver)
+			continue;
+
+		dm_dbg("   - found match at '%s'\n", match->driver->name);
+		ret = device_bind_with_driver_data(parent, match->driver, name,
+						   match->of_id->data,
+						   node->offset, &dev);
+		if (ret == -ENODEV) {
+			dm_dbg("Driver '%s' refuses to bind\n",
+			       match->driver->name);
+			continue;
+		}
+		if (ret) {
+			dm_warn("Error binding driver '%s': %d\n",
+				match->driver->name, ret);
+			result = ret;
+		} else {
+			found = true;
+			dm_stats_add(bind_devices, 1);
+		}
+		break;
+	}
+
+	if (!found && !result && ret != -ENODEV) {
+		dm_dbg("No match for node '%s'\n", name);
+		dm_stats_add(bind_nomatch, 1);
+	}
+#if CONFIG_IS_ENABLED(DM_STATS)
+	if (start)
+		dm_stats_add(bind_us, dm_stats_timer_us() - start);
+#endif
+
+	return result;
+}
+
+int dm_bind_table_scan(struct udevice *parent, const void *blob, int offset,
+		       bool pre_reloc_only)
+{
+	const struct dm_bind_node *node, *child;
+	int ret = 0, err;
+	int i;
+
+	if (!dm_bind_table_usable(blob))
+		return -ENOSYS;
+	node = dm_bind_table_find_node(offset);
+	if (!node)
+		return -ENOSYS;
+
+	for (i = node->first_child; i; i = child->next_sibling) {
+		child = &bind_table->nodes[i];
+		if (pre_reloc_only && !(child->flags & DM_BIND_NODE_PRE_RELOC))
+			continue;
+		if (!fdtdec_get_is_enabled(blob, child->offset)) {
+			dm_dbg("   - ignoring disabled device\n");
+			continue;
+		}
+		err = dm_bind_table_bind(parent, blob, child);
+		if (err && !ret) {
+			ret = err;
+			debug("%s: ret=%d\n",
+			      fdt_get_name(blob, child->offset, NULL), ret);
+		}
+	}
+
+	if (ret)
+		dm_warn("Some drivers failed to bind\n");
+
+	return ret;
+}
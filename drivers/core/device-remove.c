@@ -190,6 +190,7 @@ int device_remove(struct udevice *dev)
 	device_free(dev);
 
 	dev->seq = -1;
+	uclass_index_device(dev);
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
 	return ret;
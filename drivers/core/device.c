@@ -164,6 +164,9 @@ static int device_bind_common(struct udevice *parent, const struct driver *drv,
 			goto fail_uclass_post_bind;
 	}
 
+	/* bind() methods may have changed the name, node or req_seq */
+	uclass_index_device(dev);
+
 	if (parent)
 		dm_dbg("Bound device %s to %s\n", dev->name, parent->name);
 	if (devp)
@@ -267,7 +270,7 @@ static void *alloc_priv(int size, uint flags)
 	return priv;
 }
 
-int device_probe(struct udevice *dev)
+static int device_do_probe(struct udevice *dev)
 {
 	const struct driver *drv;
 	int size = 0;
@@ -336,6 +339,7 @@ int device_probe(struct udevice *dev)
 		goto fail;
 	}
 	dev->seq = seq;
+	uclass_index_device(dev);
 
 	dev->flags |= DM_FLAG_ACTIVATED;
 
@@ -357,6 +361,11 @@ int device_probe(struct udevice *dev)
 	}
 #endif
 
+	/* Probe the providers this device refers to before the device */
+	ret = device_probe_deps(dev);
+	if (ret)
+		goto fail;
+
 	ret = uclass_pre_probe_device(dev);
 	if (ret)
 		goto fail;
@@ -398,11 +407,49 @@ fail:
 	dev->flags &= ~DM_FLAG_ACTIVATED;
 
 	dev->seq = -1;
+	uclass_index_device(dev);
 	device_free(dev);
 
 	return ret;
 }
 
+#if CONFIG_IS_ENABLED(DM_STATS)
+int device_probe(struct udevice *dev)
+{
+	struct dm_stats *stats = &gd->dm_stats;
+	ulong start, nested, total;
+	uint count;
+	int ret;
+
+	if (!dev || (dev->flags & DM_FLAG_ACTIVATED))
+		return device_do_probe(dev);
+
+	/* Time spent probing parents and providers is theirs, not ours */
+	count = stats->probe_count;
+	nested = stats->probe_nested_us;
+	stats->probe_nested_us = 0;
+	start = dm_stats_timer_us();
+	ret = device_do_probe(dev);
+	total = start ? dm_stats_timer_us() - start : 0;
+
+	/* If a parent probed this device, that call has recorded it */
+	if (!ret && dev->probe_order <= count) {
+		dev->probe_order = ++stats->probe_count;
+		dev->probe_us = total > stats->probe_nested_us ?
+			total - stats->probe_nested_us : 0;
+		stats->probe_us += dev->probe_us;
+	}
+	stats->probe_nested_us = nested + total;
+
+	return ret;
+}
+#else
+int device_probe(struct udevice *dev)
+{
+	return device_do_probe(dev);
+}
+#endif
+
 void *dev_get_platdata(struct udevice *dev)
 {
 	if (!dev) {
@@ -804,10 +851,17 @@ int device_set_name(struct udevice *dev, const char *name)
 		return -ENOMEM;
 	dev->name = name;
 	device_set_name_alloced(dev);
+	uclass_index_device(dev);
 
 	return 0;
 }
 
+void dev_set_of_offset(struct udevice *dev, int of_offset)
+{
+	dev->of_offset = of_offset;
+	uclass_index_device(dev);
+}
+
 bool of_device_is_compatible(struct udevice *dev, const char *compat)
 {
 	const void *fdt = gd->fdt_blob;
@@ -6,9 +6,13 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <mapmem.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 static void show_devices(struct udevice *dev, int depth, int last_flag)
 {
 	int i, is_last;
@@ -94,3 +98,81 @@ void dm_dump_uclass(void)
 		puts("\n");
 	}
 }
+
+#if CONFIG_IS_ENABLED(DM_STATS)
+void dm_dump_stats(void)
+{
+	struct dm_stats *stats = &gd->dm_stats;
+
+	printf("Nodes bound from device tree: %u\n", stats->bind_nodes);
+	printf("   devices bound:     %u\n", stats->bind_devices);
+	printf("   no driver found:   %u\n", stats->bind_nomatch);
+	printf("   time:              %lu us\n", stats->bind_us);
+	printf("Compatible strings looked up: %u\n", stats->compat_lookups);
+	printf("   using hash table:  %u\n", stats->compat_hashed);
+	printf("   string compares:   %lu\n", stats->compat_compares);
+#if CONFIG_IS_ENABLED(DM_COMPAT_HASH)
+	if (gd->driver_compat_table) {
+		struct driver_compat_table *table = gd->driver_compat_table;
+
+		printf("Hash table: %u strings in %u slots, longest probe %u\n",
+		       table->count, table->mask + 1, table->max_probe);
+	}
+#endif
+	printf("Devices probed: %u, time %lu us\n", stats->probe_count,
+	       stats->probe_us);
+}
+
+/* Collect the probed devices in the tree below @dev into @list */
+static int dm_find_probed(struct udevice *dev, struct udevice **list,
+			  int count)
+{
+	struct udevice *child;
+
+	if (dev->probe_order) {
+		if (list)
+			list[count] = dev;
+		count++;
+	}
+	list_for_each_entry(child, &dev->child_head, sibling_node)
+		count = dm_find_probed(child, list, count);
+
+	return count;
+}
+
+static int dm_probe_order_cmp(const void *a, const void *b)
+{
+	const struct udevice *deva = *(struct udevice **)a;
+	const struct udevice *devb = *(struct udevice **)b;
+
+	return deva->probe_order - devb->probe_order;
+}
+
+void dm_dump_probes(void)
+{
+	struct udevice *root = dm_root();
+	struct udevice **list;
+	int count, i;
+
+	if (!root)
+		return;
+	count = dm_find_probed(root, NULL, 0);
+	list = malloc(count * sizeof(*list));
+	if (!list) {
+		printf("Out of memory\n");
+		return;
+	}
+	dm_find_probed(root, list, 0);
+	qsort(list, count, sizeof(*list), dm_probe_order_cmp);
+
+	printf(" Order  Time (us)  Class        Name\n");
+	printf("----------------------------------------\n");
+	for (i = 0; i < count; i++) {
+		struct udevice *dev = list[i];
+
+		printf(" %5u %10lu  %-12s %s\n", dev->probe_order,
+		       dev->probe_us, dev->uclass->uc_drv->name, dev->name);
+	}
+	free(list);
+}
+#endif
@@ -16,8 +16,11 @@
 #include <dm/uclass.h>
 #include <dm/util.h>
 #include <fdtdec.h>
+#include <malloc.h>
 #include <linux/compiler.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 struct driver *lists_driver_lookup_name(const char *name)
 {
 	struct driver *drv =
@@ -116,6 +119,7 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 		return -ENOENT;
 
 	while (of_match->compatible) {
+		dm_stats_add(compat_compares, 1);
 		if (!strcmp(of_match->compatible, compat)) {
 			*of_idp = of_match;
 			return 0;
@@ -126,11 +130,117 @@ static int driver_check_compatible(const struct udevice_id *of_match,
 	return -ENOENT;
 }
 
-int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
-		   struct udevice **devp)
+#if CONFIG_IS_ENABLED(DM_COMPAT_HASH)
+static struct driver_compat_entry *driver_compat_find(
+		struct driver_compat_table *table, const char *compat,
+		u32 hash, uint *probesp)
+{
+	struct driver_compat_entry *entry;
+	uint i, probes = 0;
+
+	for (i = hash & table->mask;; i = (i + 1) & table->mask) {
+		entry = &table->slot[i];
+		probes++;
+		if (!entry->driver)
+			break;
+		if (entry->hash == hash) {
+			dm_stats_add(compat_compares, 1);
+			if (!strcmp(entry->of_id->compatible, compat))
+				break;
+		}
+	}
+	if (probesp)
+		*probesp = probes;
+
+	return entry;
+}
+
+static struct driver_compat_table *driver_compat_build(void)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver_compat_table *table;
+	struct driver_compat_entry *slot;
+	const struct udevice_id *of_id;
+	struct driver *entry;
+	uint count = 0, size, probes;
+	u32 hash;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (of_id = entry->of_match; of_id && of_id->compatible;
+		     of_id++)
+			count++;
+	}
+
+	/* Keep the table no more than half full */
+	for (size = 16; size < count * 2; size <<= 1)
+		;
+	table = calloc(1, sizeof(*table) + size * sizeof(table->slot[0]));
+	if (!table)
+		return NULL;
+	table->mask = size - 1;
+
+	/* The first driver in the list wins, as with a linear search */
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (of_id = entry->of_match; of_id && of_id->compatible;
+		     of_id++) {
+			hash = dm_hash_str(of_id->compatible);
+			slot = driver_compat_find(table, of_id->compatible,
+						  hash, &probes);
+			if (slot->driver)
+				continue;
+			slot->hash = hash;
+			slot->driver = entry;
+			slot->of_id = of_id;
+			table->count++;
+			table->max_probe = max(table->max_probe, probes);
+		}
+	}
+	debug("%s: %u compatible strings in %u slots, max probe %u\n",
+	      __func__, table->count, size, table->max_probe);
+
+	return table;
+}
+#endif
+
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **of_idp)
 {
 	struct driver *driver = ll_entry_start(struct driver, driver);
 	const int n_ents = ll_entry_count(struct driver, driver);
+	struct driver *entry;
+
+	dm_stats_add(compat_lookups, 1);
+#if CONFIG_IS_ENABLED(DM_COMPAT_HASH)
+	/* Leave the pre-relocation heap alone */
+	if (!gd->driver_compat_table &&
+	    (gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		gd->driver_compat_table = driver_compat_build();
+	if (gd->driver_compat_table) {
+		struct driver_compat_entry *slot;
+
+		dm_stats_add(compat_hashed, 1);
+		slot = driver_compat_find(gd->driver_compat_table, compat,
+					  dm_hash_str(compat), NULL);
+		if (!slot->driver)
+			return NULL;
+		*of_idp = slot->of_id;
+
+		return slot->driver;
+	}
+#endif
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		if (!driver_check_compatible(entry->of_match, of_idp, compat))
+			return entry;
+	}
+
+	return NULL;
+}
+
+int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
+		   struct udevice **devp)
+{
 	const struct udevice_id *id;
 	struct driver *entry;
 	struct udevice *dev;
@@ -139,6 +249,9 @@ int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
 	int compat_length, i;
 	int result = 0;
 	int ret = 0;
+#if CONFIG_IS_ENABLED(DM_STATS)
+	ulong start = dm_stats_timer_us();
+#endif
 
 	name = fdt_get_name(blob, offset, NULL);
 	dm_dbg("bind node %s\n", name);
@@ -155,6 +268,7 @@ int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
 		dm_warn("Device tree error at offset %d\n", offset);
 		return compat_length;
 	}
+	dm_stats_add(bind_nodes, 1);
 
 	/*
 	 * Walk through the compatible string list, attempting to match each
@@ -166,13 +280,8 @@ int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
 		dm_dbg("   - attempt to match compatible string '%s'\n",
 		       compat);
 
-		for (entry = driver; entry != driver + n_ents; entry++) {
-			ret = driver_check_compatible(entry->of_match, &id,
-						      compat);
-			if (!ret)
-				break;
-		}
-		if (entry == driver + n_ents)
+		entry = lists_driver_lookup_compat(compat, &id);
+		if (!entry)
 			continue;
 
 		dm_dbg("   - found match at '%s'\n", entry->name);
@@ -185,17 +294,24 @@ int lists_bind_fdt(struct udevice *parent, const void *blob, int offset,
 		if (ret) {
 			dm_warn("Error binding driver '%s': %d\n", entry->name,
 				ret);
-			return ret;
+			result = ret;
 		} else {
 			found = true;
+			dm_stats_add(bind_devices, 1);
 			if (devp)
 				*devp = dev;
 		}
 		break;
 	}
 
-	if (!found && !result && ret != -ENODEV)
+	if (!found && !result && ret != -ENODEV) {
 		dm_dbg("No match for node '%s'\n", name);
+		dm_stats_add(bind_nomatch, 1);
+	}
+#if CONFIG_IS_ENABLED(DM_STATS)
+	if (start)
+		dm_stats_add(bind_us, dm_stats_timer_us() - start);
+#endif
 
 	return result;
 }
@@ -0,0 +1,103 @@
+/*
+ * Probing the providers a device depends on
+ *
+ * A device's node refers to the clocks, resets, power domains and
+ * regulators it needs by phandle. Probing those providers just before the
+ * device means that they are set up in dependency order, and only when a
+ * device which needs them is itself used.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <fdtdec.h>
+#include <dm/device-internal.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Phandle lists which point at providers, with the uclass of each */
+static const struct {
+	const char *list;
+	const char *cells;
+	enum uclass_id id;
+} probe_deps[] = {
+#if CONFIG_IS_ENABLED(CLK)
+	{ "clocks", "#clock-cells", UCLASS_CLK },
+#endif
+#if CONFIG_IS_ENABLED(DM_RESET)
+	{ "resets", "#reset-cells", UCLASS_RESET },
+#endif
+#if CONFIG_IS_ENABLED(POWER_DOMAIN)
+	{ "power-domains", "#power-domain-cells", UCLASS_POWER_DOMAIN },
+#endif
+};
+
+int device_probe_dep(struct udevice *dev, enum uclass_id id, int node)
+{
+	struct udevice *dep;
+	int ret;
+
+	/*
+	 * A provider with no device bound to it, or whose uclass is not
+	 * built in, is left to the driver
+	 */
+	ret = uclass_get_device_by_of_offset(id, node, &dep);
+	if (ret == -ENODEV || ret == -EPFNOSUPPORT) {
+		debug("%s: provider '%s' of '%s' not found\n", __func__,
+		      fdt_get_name(gd->fdt_blob, node, NULL), dev->name);
+		return 0;
+	}
+
+	return ret;
+}
+
+int device_probe_deps(struct udevice *dev)
+{
+	const void *blob = gd->fdt_blob;
+	struct fdtdec_phandle_args args;
+	int node = dev_of_offset(dev);
+	const fdt32_t *phandle;
+	const char *name;
+	int i, index, offset, supply, len;
+	int ret;
+
+	if (node < 0)
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(probe_deps); i++) {
+		for (index = 0;
+		     !fdtdec_parse_phandle_with_args(blob, node,
+						     probe_deps[i].list,
+						     probe_deps[i].cells, 0,
+						     index, &args);
+		     index++) {
+			ret = device_probe_dep(dev, probe_deps[i].id,
+					       args.node);
+			if (ret)
+				return ret;
+		}
+	}
+
+	if (!CONFIG_IS_ENABLED(DM_REGULATOR))
+		return 0;
+
+	/* Regulators are referred to by properties named <name>-supply */
+	fdt_for_each_property_offset(offset, blob, node) {
+		phandle = fdt_getprop_by_offset(blob, offset, &name, &len);
+		if (!phandle || len != sizeof(*phandle))
+			continue;
+		len = strlen(name);
+		if (len <= 7 || strcmp(name + len - 7, "-supply"))
+			continue;
+		supply = fdt_node_offset_by_phandle(blob,
+						    fdt32_to_cpu(*phandle));
+		if (supply < 0)
+			continue;
+		ret = device_probe_dep(dev, UCLASS_REGULATOR, supply);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
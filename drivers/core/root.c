@@ -12,6 +12,7 @@
 #include <fdtdec.h>
 #include <malloc.h>
 #include <libfdt.h>
+#include <dm/bind-table.h>
 #include <dm/device.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
@@ -154,6 +155,15 @@ int dm_init(void)
 		return -EINVAL;
 	}
 	INIT_LIST_HEAD(&DM_UCLASS_ROOT_NON_CONST);
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (gd->uclass_table) {
+		memset(gd->uclass_table, '\0',
+		       UCLASS_COUNT * sizeof(*gd->uclass_table));
+	} else if (gd->flags & GD_FLG_FULL_MALLOC_INIT) {
+		gd->uclass_table = calloc(UCLASS_COUNT,
+					  sizeof(*gd->uclass_table));
+	}
+#endif
 
 #if defined(CONFIG_NEEDS_MANUAL_RELOC)
 	fix_drivers();
@@ -165,7 +175,7 @@ int dm_init(void)
 	if (ret)
 		return ret;
 #if CONFIG_IS_ENABLED(OF_CONTROL)
-	DM_ROOT_NON_CONST->of_offset = 0;
+	dev_set_of_offset(DM_ROOT_NON_CONST, 0);
 #endif
 	ret = device_probe(DM_ROOT_NON_CONST);
 	if (ret)
@@ -201,6 +211,13 @@ int dm_scan_fdt_node(struct udevice *parent, const void *blob, int offset,
 {
 	int ret = 0, err;
 
+#if CONFIG_IS_ENABLED(DM_BIND_TABLE)
+	ret = dm_bind_table_scan(parent, blob, offset, pre_reloc_only);
+	if (ret != -ENOSYS)
+		return ret;
+	ret = 0;
+#endif
+
 	for (offset = fdt_first_subnode(blob, offset);
 	     offset > 0;
 	     offset = fdt_next_subnode(blob, offset)) {
@@ -236,6 +253,9 @@ int dm_scan_fdt_dev(struct udevice *dev)
 
 int dm_scan_fdt(const void *blob, bool pre_reloc_only)
 {
+#if CONFIG_IS_ENABLED(DM_BIND_TABLE)
+	dm_bind_table_recheck();
+#endif
 	return dm_scan_fdt_node(gd->dm_root, blob, 0, pre_reloc_only);
 }
 #endif
@@ -25,11 +25,11 @@ struct uclass *uclass_find(enum uclass_id key)
 
 	if (!gd->dm_root)
 		return NULL;
-	/*
-	 * TODO(sjg@chromium.org): Optimise this, perhaps moving the found
-	 * node to the start of the list, or creating a linear array mapping
-	 * id to node.
-	 */
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (gd->uclass_table)
+		return key >= 0 && key < UCLASS_COUNT ?
+			gd->uclass_table[key] : NULL;
+#endif
 	list_for_each_entry(uc, &gd->uclass_root, sibling_node) {
 		if (uc->uc_drv->id == key)
 			return uc;
@@ -38,6 +38,226 @@ struct uclass *uclass_find(enum uclass_id key)
 	return NULL;
 }
 
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+/* Number of buckets in each index when the first device is bound */
+#define UCLASS_INDEX_MIN_BUCKETS	4
+
+/* Devices per bucket at which an index is doubled in size */
+#define UCLASS_INDEX_LOAD		2
+
+static uint uclass_index_hash_int(uint val)
+{
+	return val * 0x9e370001U >> 8;
+}
+
+static uint uclass_index_hash_str(const char *str)
+{
+	uint hash = 0;
+
+	while (*str)
+		hash = hash * 31 + *str++;
+
+	return hash;
+}
+
+static uint uclass_index_phandle(struct udevice *dev)
+{
+#if CONFIG_IS_ENABLED(OF_CONTROL) && !CONFIG_IS_ENABLED(OF_PLATDATA)
+	if (gd->fdt_blob && dev_of_offset(dev) >= 0)
+		return fdt_get_phandle(gd->fdt_blob, dev_of_offset(dev));
+#endif
+	return 0;
+}
+
+/**
+ * uclass_index_value() - Get the value of an integer key of a device
+ *
+ * @dev:	Device to check
+ * @key:	Key to get, anything but UCLASS_INDEX_NAME
+ * @valp:	Returns the value of the key
+ * @return true if the device has this key, false if it is not set
+ */
+static bool uclass_index_value(struct udevice *dev, enum uclass_index_key key,
+			       uint *valp)
+{
+	int val;
+
+	switch (key) {
+	case UCLASS_INDEX_SEQ:
+		val = dev->seq;
+		break;
+	case UCLASS_INDEX_REQ_SEQ:
+		val = dev->req_seq;
+		break;
+	case UCLASS_INDEX_NODE:
+		val = dev_of_offset(dev);
+		break;
+	case UCLASS_INDEX_PHANDLE:
+		*valp = uclass_index_phandle(dev);
+		return *valp && *valp != -1U;
+	default:
+		return false;
+	}
+	*valp = val;
+
+	return val >= 0;
+}
+
+static struct hlist_head *uclass_index_bucket(struct uclass *uc,
+					      enum uclass_index_key key,
+					      uint hash)
+{
+	return &uc->index[key * (uc->index_mask + 1) + (hash & uc->index_mask)];
+}
+
+/* Add a device, which must not be in any of the indexes, to each of them */
+static void uclass_index_add(struct uclass *uc, struct udevice *dev)
+{
+	enum uclass_index_key key;
+	uint val, hash;
+
+	for (key = 0; key < UCLASS_INDEX_COUNT; key++) {
+		if (key == UCLASS_INDEX_NAME)
+			hash = uclass_index_hash_str(dev->name);
+		else if (uclass_index_value(dev, key, &val))
+			hash = uclass_index_hash_int(val);
+		else
+			continue;
+		hlist_add_head(&dev->uclass_index[key],
+			       uclass_index_bucket(uc, key, hash));
+	}
+}
+
+static void uclass_index_remove(struct udevice *dev)
+{
+	enum uclass_index_key key;
+
+	for (key = 0; key < UCLASS_INDEX_COUNT; key++)
+		hlist_del_init(&dev->uclass_index[key]);
+}
+
+/* Set up the indexes with a new size, adding all the devices again */
+static int uclass_index_resize(struct uclass *uc, uint buckets)
+{
+	struct hlist_head *index;
+	enum uclass_index_key key;
+	struct udevice *dev;
+
+	index = calloc(buckets * UCLASS_INDEX_COUNT, sizeof(*index));
+	if (!index)
+		return -ENOMEM;
+	free(uc->index);
+	uc->index = index;
+	uc->index_mask = buckets - 1;
+
+	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
+		for (key = 0; key < UCLASS_INDEX_COUNT; key++)
+			INIT_HLIST_NODE(&dev->uclass_index[key]);
+		uclass_index_add(uc, dev);
+	}
+
+	return 0;
+}
+
+/* Index a device which has just been added to the uclass's list */
+static void uclass_index_bind(struct uclass *uc, struct udevice *dev)
+{
+	uint buckets = uc->index_mask + 1;
+
+	uc->dev_count++;
+
+	/* Pre-relocation heaps are tiny, and freeing does not work there */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return;
+
+	if (!uc->index) {
+		uclass_index_resize(uc, UCLASS_INDEX_MIN_BUCKETS);
+		return;
+	}
+	if (uc->dev_count > buckets * UCLASS_INDEX_LOAD &&
+	    !uclass_index_resize(uc, buckets * 2))
+		return;
+
+	/* If the index could not grow, carry on with longer chains */
+	uclass_index_add(uc, dev);
+}
+
+static void uclass_index_unbind(struct uclass *uc, struct udevice *dev)
+{
+	uclass_index_remove(dev);
+	uc->dev_count--;
+}
+
+void uclass_index_device(struct udevice *dev)
+{
+	struct uclass *uc = dev->uclass;
+
+	if (!uc || !uc->index || list_empty(&dev->uclass_node))
+		return;
+	uclass_index_remove(dev);
+	uclass_index_add(uc, dev);
+}
+
+/**
+ * uclass_index_find() - Look up a device in one of a uclass's indexes
+ *
+ * @uc:		Uclass to search
+ * @key:	Index to use
+ * @val:	Value to find, for anything but UCLASS_INDEX_NAME
+ * @name:	Name to find, for UCLASS_INDEX_NAME
+ * @devp:	Returns the device found
+ * @return 0 if found, -ENODEV if there is no such device, -EAGAIN if the
+ * index cannot tell: either there is no index, or more than one device
+ * matches and the list must be walked to find the first one
+ */
+static int uclass_index_find(struct uclass *uc, enum uclass_index_key key,
+			     uint val, const char *name, struct udevice **devp)
+{
+	struct udevice *dev, *found = NULL;
+	struct hlist_node *pos;
+	uint hash, dev_val;
+
+	if (!uc->index)
+		return -EAGAIN;
+
+	hash = name ? uclass_index_hash_str(name) : uclass_index_hash_int(val);
+	hlist_for_each_entry(dev, pos, uclass_index_bucket(uc, key, hash),
+			     uclass_index[key]) {
+		if (name) {
+			if (strcmp(dev->name, name))
+				continue;
+		} else if (!uclass_index_value(dev, key, &dev_val) ||
+			   dev_val != val) {
+			continue;
+		}
+		if (found)
+			return -EAGAIN;
+		found = dev;
+	}
+	if (!found)
+		return -ENODEV;
+	*devp = found;
+
+	return 0;
+}
+#else
+static inline void uclass_index_bind(struct uclass *uc, struct udevice *dev)
+{
+}
+
+static inline void uclass_index_unbind(struct uclass *uc,
+				       struct udevice *dev)
+{
+}
+
+static inline int uclass_index_find(struct uclass *uc,
+				    enum uclass_index_key key, uint val,
+				    const char *name, struct udevice **devp)
+{
+	return -EAGAIN;
+}
+#endif
+
 /**
  * uclass_add() - Create new uclass in list
  * @id: Id number to create
@@ -79,6 +299,10 @@ static int uclass_add(enum uclass_id id, struct uclass **ucp)
 	INIT_LIST_HEAD(&uc->sibling_node);
 	INIT_LIST_HEAD(&uc->dev_head);
 	list_add(&uc->sibling_node, &DM_UCLASS_ROOT_NON_CONST);
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (gd->uclass_table)
+		gd->uclass_table[id] = uc;
+#endif
 
 	if (uc_drv->init) {
 		ret = uc_drv->init(uc);
@@ -95,6 +319,10 @@ fail:
 		uc->priv = NULL;
 	}
 	list_del(&uc->sibling_node);
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (gd->uclass_table)
+		gd->uclass_table[id] = NULL;
+#endif
 fail_mem:
 	free(uc);
 
@@ -128,6 +356,11 @@ int uclass_destroy(struct uclass *uc)
 	if (uc_drv->destroy)
 		uc_drv->destroy(uc);
 	list_del(&uc->sibling_node);
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	if (gd->uclass_table && gd->uclass_table[uc_drv->id] == uc)
+		gd->uclass_table[uc_drv->id] = NULL;
+	free(uc->index);
+#endif
 	if (uc_drv->priv_auto_alloc_size)
 		free(uc->priv);
 	free(uc);
@@ -213,8 +446,9 @@ int uclass_find_next_device(struct udevice **devp)
 int uclass_find_device_by_name(enum uclass_id id, const char *name,
 			       struct udevice **devp)
 {
+	struct udevice *dev, *prefix = NULL;
 	struct uclass *uc;
-	struct udevice *dev;
+	int len;
 	int ret;
 
 	*devp = NULL;
@@ -224,14 +458,24 @@ int uclass_find_device_by_name(enum uclass_id id, const char *name,
 	if (ret)
 		return ret;
 
+	if (!uclass_index_find(uc, UCLASS_INDEX_NAME, 0, name, devp))
+		return 0;
+
+	/* Prefer an exact match, else take the first name starting with it */
+	len = strlen(name);
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
-		if (!strncmp(dev->name, name, strlen(name))) {
+		if (!strcmp(dev->name, name)) {
 			*devp = dev;
 			return 0;
 		}
+		if (!prefix && !strncmp(dev->name, name, len))
+			prefix = dev;
 	}
+	if (!prefix)
+		return -ENODEV;
+	*devp = prefix;
 
-	return -ENODEV;
+	return 0;
 }
 
 int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
@@ -249,6 +493,13 @@ int uclass_find_device_by_seq(enum uclass_id id, int seq_or_req_seq,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find(uc, find_req_seq ? UCLASS_INDEX_REQ_SEQ :
+				UCLASS_INDEX_SEQ, seq_or_req_seq, NULL, devp);
+	if (ret != -EAGAIN) {
+		debug("   - %s\n", ret ? "not found" : "found");
+		return ret;
+	}
+
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		debug("   - %d %d\n", dev->req_seq, dev->seq);
 		if ((find_req_seq ? dev->req_seq : dev->seq) ==
@@ -277,6 +528,10 @@ int uclass_find_device_by_of_offset(enum uclass_id id, int node,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find(uc, UCLASS_INDEX_NODE, node, NULL, devp);
+	if (ret != -EAGAIN)
+		return ret;
+
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		if (dev_of_offset(dev) == node) {
 			*devp = dev;
@@ -307,6 +562,11 @@ static int uclass_find_device_by_phandle(enum uclass_id id,
 	if (ret)
 		return ret;
 
+	ret = uclass_index_find(uc, UCLASS_INDEX_PHANDLE, find_phandle, NULL,
+				devp);
+	if (ret != -EAGAIN)
+		return ret;
+
 	list_for_each_entry(dev, &uc->dev_head, uclass_node) {
 		uint phandle;
 
@@ -464,6 +724,7 @@ int uclass_bind_device(struct udevice *dev)
 
 	uc = dev->uclass;
 	list_add_tail(&dev->uclass_node, &uc->dev_head);
+	uclass_index_bind(uc, dev);
 
 	if (dev->parent) {
 		struct uclass_driver *uc_drv = dev->parent->uclass->uc_drv;
@@ -478,6 +739,7 @@ int uclass_bind_device(struct udevice *dev)
 	return 0;
 err:
 	/* There is no need to undo the parent's post_bind call */
+	uclass_index_unbind(uc, dev);
 	list_del(&dev->uclass_node);
 
 	return ret;
@@ -496,6 +758,7 @@ int uclass_unbind_device(struct udevice *dev)
 			return ret;
 	}
 
+	uclass_index_unbind(uc, dev);
 	list_del(&dev->uclass_node);
 	return 0;
 }
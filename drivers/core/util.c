@@ -7,6 +7,8 @@
 #include <common.h>
 #include <vsprintf.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 void dm_warn(const char *fmt, ...)
 {
 	va_list args;
@@ -35,3 +37,18 @@ int list_count_items(struct list_head *head)
 
 	return count;
 }
+
+#if CONFIG_IS_ENABLED(DM_STATS)
+ulong dm_stats_timer_us(void)
+{
+#ifdef CONFIG_TIMER
+	if (!gd->timer && !IS_ENABLED(CONFIG_TIMER_EARLY))
+		return 0;
+#else
+	if (!(gd->flags & GD_FLG_RELOC))
+		return 0;
+#endif
+
+	return timer_get_us();
+}
+#endif
@@ -12,6 +12,7 @@
 #include "jr.h"
 #include "fsl_hash.h"
 #include <hw_sha.h>
+#include <image.h>
 #include <linux/errno.h>
 
 #define CRYPTO_MAX_ALG_NAME	80
@@ -211,3 +212,36 @@ int hw_sha_finish(struct hash_algo *algo, void *ctx, void *dest_buf,
 {
 	return caam_hash_finish(ctx, dest_buf, size, get_hash_type(algo));
 }
+
+#ifdef CONFIG_FSL_CAAM_HASH
+static int caam_hash_probe(struct hash_algo *algo)
+{
+	return jr_ready() ? 0 : -ENODEV;
+}
+
+U_BOOT_HASH_ALGO(sha1_caam) = {
+	.name		= "sha1",
+	.digest_size	= SHA1_DIGEST_SIZE,
+	.hash_func_ws	= hw_sha1,
+	.chunk_size	= CHUNKSZ_SHA1,
+	.hash_init	= hw_sha_init,
+	.hash_update	= hw_sha_update,
+	.hash_finish	= hw_sha_finish,
+	.driver		= "caam",
+	.priority	= HASH_PRIO_HW,
+	.probe		= caam_hash_probe,
+};
+
+U_BOOT_HASH_ALGO(sha256_caam) = {
+	.name		= "sha256",
+	.digest_size	= SHA256_DIGEST_SIZE,
+	.hash_func_ws	= hw_sha256,
+	.chunk_size	= CHUNKSZ_SHA256,
+	.hash_init	= hw_sha_init,
+	.hash_update	= hw_sha_update,
+	.hash_finish	= hw_sha_finish,
+	.driver		= "caam",
+	.priority	= HASH_PRIO_HW,
+	.probe		= caam_hash_probe,
+};
+#endif
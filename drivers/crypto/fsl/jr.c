@@ -387,6 +387,11 @@ out:
 	return ret;
 }
 
+int jr_ready(void)
+{
+	return jr0[0].input_ring != NULL;
+}
+
 int run_descriptor_jr(uint32_t *desc)
 {
 	return run_descriptor_jr_idx(desc, 0);
@@ -102,5 +102,7 @@ struct result {
 
 void caam_jr_strstatus(u32 status);
 int run_descriptor_jr(uint32_t *desc);
+/* Check whether sec_init() has set up the job ring */
+int jr_ready(void);
 
 #endif
@@ -31,6 +31,10 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+#if defined(CONFIG_FSL_ESDHC_ADMA) && defined(CONFIG_SYS_FSL_ESDHC_USE_PIO)
+#error "CONFIG_FSL_ESDHC_ADMA cannot be used with CONFIG_SYS_FSL_ESDHC_USE_PIO"
+#endif
+
 #define SDHCI_IRQ_EN_BITS		(IRQSTATEN_CC | IRQSTATEN_TC | \
 				IRQSTATEN_CINT | \
 				IRQSTATEN_CTOE | IRQSTATEN_CCE | IRQSTATEN_CEBE | \
@@ -122,6 +126,14 @@ struct esdhc_soc_data {
  * @wp_enable: 1: enable checking wp; 0: no check
  * @cd_gpio: gpio for card detection
  * @wp_gpio: gpio for write protection
+ * Following is used when ADMA2 is enabled
+ * @adma_desc_table: descriptor table describing one whole transfer
+ * @adma_desc_count: number of descriptors in the table
+ * @adma_bounce: bounce buffer for the partial cache lines at the head (first
+ *	ARCH_DMA_MINALIGN bytes) and tail (second ARCH_DMA_MINALIGN bytes) of a
+ *	transfer
+ * @adma_head: number of bytes bounced at the head of the current transfer
+ * @adma_tail: number of bytes bounced at the tail of the current transfer
  */
 struct fsl_esdhc_priv {
 	struct fsl_esdhc *esdhc_regs;
@@ -150,6 +162,13 @@ struct fsl_esdhc_priv {
 	struct gpio_desc cd_gpio;
 	struct gpio_desc wp_gpio;
 #endif
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	struct fsl_esdhc_adma_desc *adma_desc_table;
+	uint adma_desc_count;
+	void *adma_bounce;
+	int adma_head;
+	int adma_tail;
+#endif
 };
 
 static void esdhc_dump(struct mmc *mmc)
@@ -280,6 +299,152 @@ esdhc_pio_read_write(struct mmc *mmc, struct mmc_data *data)
 }
 #endif
 
+#ifdef CONFIG_FSL_ESDHC_ADMA
+static dma_addr_t esdhc_adma_addr(const void *ptr)
+{
+#if defined(CONFIG_FSL_LAYERSCAPE) || defined(CONFIG_S32V234) || \
+	defined(CONFIG_IMX8) || defined(CONFIG_IMX8M)
+	return virt_to_phys((void *)ptr);
+#else
+	return (ulong)ptr;
+#endif
+}
+
+static void esdhc_adma_write_desc(struct fsl_esdhc_adma_desc **desc,
+				  dma_addr_t addr, int len, bool end)
+{
+	struct fsl_esdhc_adma_desc *dma_desc = *desc;
+	u16 attr = ESDHC_ADMA_VALID | ESDHC_ADMA_TRAN;
+
+	if (end)
+		attr |= ESDHC_ADMA_END;
+
+	/* A 64KiB chunk wraps to 0, which the controller reads as 64KiB */
+	dma_desc->attr = cpu_to_le16(attr);
+	dma_desc->len = cpu_to_le16(len);
+	dma_desc->addr = cpu_to_le32(lower_32_bits(addr));
+	(*desc)++;
+}
+
+/*
+ * Describe the whole transfer in the ADMA2 descriptor table and point the
+ * controller at it, so that every block is moved without CPU intervention.
+ * Cache maintenance works on whole cache lines, and on ARMv7 an invalidate
+ * of a range which is not aligned to them is not done at all, so the partial
+ * cache lines at each end of the buffer go through the adma_bounce buffer.
+ * The rest is transferred in place.
+ */
+static int esdhc_adma_setup(struct fsl_esdhc_priv *priv,
+			    struct mmc_data *data)
+{
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	struct fsl_esdhc_adma_desc *desc = priv->adma_desc_table;
+	bool is_read = data->flags & MMC_DATA_READ;
+	const void *buf = is_read ? data->dest : data->src;
+	void *tail_bounce = priv->adma_bounce + ARCH_DMA_MINALIGN;
+	int trans_bytes = data->blocks * data->blocksize;
+	int head, tail, len, left;
+	dma_addr_t addr;
+
+	head = (ARCH_DMA_MINALIGN - ((ulong)buf & (ARCH_DMA_MINALIGN - 1))) &
+	       (ARCH_DMA_MINALIGN - 1);
+	head = min(head, trans_bytes);
+	tail = head < trans_bytes ?
+	       ((ulong)buf + trans_bytes) & (ARCH_DMA_MINALIGN - 1) : 0;
+	left = trans_bytes - head - tail;
+
+	if (2 + DIV_ROUND_UP(left, ESDHC_ADMA_MAX_LEN) >
+	    priv->adma_desc_count) {
+		printf("%s: %d bytes do not fit the descriptor table\n",
+		       __func__, trans_bytes);
+		return -EINVAL;
+	}
+
+	addr = esdhc_adma_addr(buf);
+	if (upper_32_bits(addr + trans_bytes - 1)) {
+		printf("Error found for upper 32 bits\n");
+		return -EINVAL;
+	}
+
+	if (head || tail) {
+		if (!is_read) {
+			memcpy(priv->adma_bounce, buf, head);
+			memcpy(tail_bounce, buf + trans_bytes - tail, tail);
+		}
+		flush_dcache_range((ulong)priv->adma_bounce,
+				   (ulong)priv->adma_bounce +
+				   2 * ARCH_DMA_MINALIGN);
+	}
+
+	if (head)
+		esdhc_adma_write_desc(&desc, esdhc_adma_addr(priv->adma_bounce),
+				      head, head == trans_bytes);
+
+	addr += head;
+	while (left) {
+		len = min(left, ESDHC_ADMA_MAX_LEN);
+		left -= len;
+		esdhc_adma_write_desc(&desc, addr, len, !left && !tail);
+		addr += len;
+	}
+
+	if (tail)
+		esdhc_adma_write_desc(&desc, esdhc_adma_addr(tail_bounce),
+				      tail, true);
+
+	flush_dcache_range((ulong)priv->adma_desc_table,
+			   ALIGN((ulong)desc, ARCH_DMA_MINALIGN));
+	priv->adma_head = head;
+	priv->adma_tail = tail;
+
+	esdhc_write32(&regs->adsaddr,
+		      lower_32_bits(esdhc_adma_addr(priv->adma_desc_table)));
+
+	return 0;
+}
+
+static void esdhc_adma_finish(struct fsl_esdhc_priv *priv,
+			      struct mmc_data *data)
+{
+	int trans_bytes = data->blocks * data->blocksize;
+
+	if (!(priv->adma_head || priv->adma_tail) ||
+	    !(data->flags & MMC_DATA_READ))
+		return;
+
+	invalidate_dcache_range((ulong)priv->adma_bounce,
+				(ulong)priv->adma_bounce +
+				2 * ARCH_DMA_MINALIGN);
+	memcpy(data->dest, priv->adma_bounce, priv->adma_head);
+	memcpy(data->dest + trans_bytes - priv->adma_tail,
+	       priv->adma_bounce + ARCH_DMA_MINALIGN, priv->adma_tail);
+}
+
+static int esdhc_adma_init(struct fsl_esdhc_priv *priv)
+{
+	uint count, size;
+
+	/* One descriptor per 64KiB of the largest transfer, plus head and tail */
+	count = DIV_ROUND_UP(priv->cfg.b_max * MMC_MAX_BLOCK_LEN,
+			     ESDHC_ADMA_MAX_LEN) + 2;
+	size = ALIGN(count * sizeof(*priv->adma_desc_table),
+		     ARCH_DMA_MINALIGN);
+	priv->adma_desc_table = memalign(ARCH_DMA_MINALIGN, size);
+	priv->adma_bounce = memalign(ARCH_DMA_MINALIGN, 2 * ARCH_DMA_MINALIGN);
+	if (!priv->adma_desc_table || !priv->adma_bounce) {
+		printf("%s: ADMA descriptor table alloc failed\n", __func__);
+		free(priv->adma_desc_table);
+		free(priv->adma_bounce);
+		priv->adma_desc_table = NULL;
+		priv->adma_bounce = NULL;
+		return -ENOMEM;
+	}
+	priv->adma_desc_count = count;
+
+	return 0;
+}
+#endif
+
 static int esdhc_setup_data(struct mmc *mmc, struct mmc_data *data)
 {
 	int timeout;
@@ -349,6 +514,11 @@ static int esdhc_setup_data(struct mmc *mmc, struct mmc_data *data)
 #endif
 	}
 
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	if (esdhc_adma_setup(priv, data))
+		return -EINVAL;
+#endif
+
 	esdhc_write32(&regs->blkattr, data->blocks << 16 | data->blocksize);
 
 	/* Calculate the timeout period for data transactions */
@@ -415,15 +585,55 @@ static void check_and_invalidate_dcache_range
 	start = (unsigned)data->dest;
 #endif
 	end = start + size;
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	/* The partial cache lines at each end are bounced */
+	end = start + data->blocks * data->blocksize;
+	start = ALIGN(start, ARCH_DMA_MINALIGN);
+	end &= ~(ARCH_DMA_MINALIGN - 1);
+	if (end <= start)
+		return;
+#endif
 	invalidate_dcache_range(start, end);
 }
 
+/* Clear the status, resetting the CMD and DATA portions after an error */
+static void esdhc_cmd_end(struct mmc *mmc, struct mmc_cmd *cmd,
+			  struct mmc_data *data, int err)
+{
+	struct fsl_esdhc_priv *priv = mmc->priv;
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+
+	if (err) {
+		esdhc_dump(mmc);
+
+		esdhc_write32(&regs->sysctl, esdhc_read32(&regs->sysctl) |
+			      SYSCTL_RSTC);
+		while (esdhc_read32(&regs->sysctl) & SYSCTL_RSTC)
+			;
+
+		if (data) {
+			esdhc_write32(&regs->sysctl,
+				      esdhc_read32(&regs->sysctl) |
+				      SYSCTL_RSTD);
+			while ((esdhc_read32(&regs->sysctl) & SYSCTL_RSTD))
+				;
+		}
+
+		/* If this was CMD11, then notify that power cycle is needed */
+		if (cmd && cmd->cmdidx == SD_CMD_SWITCH_UHS18V)
+			printf("CMD11 to switch to 1.8V mode failed, card requires power cycle.\n");
+	}
+
+	esdhc_write32(&regs->irqstat, -1);
+}
+
 /*
- * Sends a command out on the bus.  Takes the mmc pointer,
- * a command pointer, and an optional data pointer.
+ * Sends a command out on the bus and waits for its response.  Takes the
+ * mmc pointer, a command pointer, and an optional data pointer.  The data
+ * transfer is left running: see esdhc_data_check().
  */
 static int
-esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
+esdhc_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
 	int	err = 0;
 	uint	xfertyp;
@@ -548,69 +758,96 @@ esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 	} else
 		cmd->response[0] = esdhc_read32(&regs->cmdrsp0);
 
-	/* Wait until all of the blocks are transferred */
-	if (data) {
-#ifdef CONFIG_SYS_FSL_ESDHC_USE_PIO
-		esdhc_pio_read_write(mmc, data);
-#else
-		flags = DATA_COMPLETE;
-		if ((cmd->cmdidx == MMC_SEND_TUNING_BLOCK) ||
-		    (cmd->cmdidx == MMC_SEND_TUNING_BLOCK_HS200)) {
-			flags = IRQSTAT_BRR;
-		}
+	/* The data transfer is left running */
+	if (data)
+		return 0;
 
-		do {
-			irqstat = esdhc_read32(&regs->irqstat);
+out:
+	esdhc_cmd_end(mmc, cmd, data, err);
 
-			if (irqstat & IRQSTAT_DTOE) {
-				err = -ETIMEDOUT;
-				goto out;
-			}
+	return err;
+}
 
-			if (irqstat & DATA_ERR) {
-				err = -ECOMM;
-				goto out;
-			}
-		} while (((irqstat & flags) != flags));
+#ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
+/*
+ * Check once on the data transfer of a command sent by esdhc_cmd_start().
+ * Returns -EBUSY until all of @flags are set in IRQSTAT.
+ */
+static int esdhc_data_check(struct mmc *mmc, struct mmc_data *data,
+			    uint flags)
+{
+	struct fsl_esdhc_priv *priv = mmc->priv;
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	uint irqstat;
+	int err = 0;
 
+	irqstat = esdhc_read32(&regs->irqstat);
+	if (irqstat & IRQSTAT_DTOE) {
+		err = -ETIMEDOUT;
+	} else if (irqstat & DATA_ERR) {
+		err = -ECOMM;
+	} else if ((irqstat & flags) != flags) {
+		return -EBUSY;
+	} else {
 		/*
 		 * Need invalidate the dcache here again to avoid any
 		 * cache-fill during the DMA operations such as the
 		 * speculative pre-fetching etc.
 		 */
 		if (data->flags & MMC_DATA_READ)
-			check_and_invalidate_dcache_range(cmd, data);
+			check_and_invalidate_dcache_range(NULL, data);
+#ifdef CONFIG_FSL_ESDHC_ADMA
+		esdhc_adma_finish(priv, data);
 #endif
 	}
 
-out:
-	/* Reset CMD and DATA portions on error */
-	if (err) {
-		esdhc_dump(mmc);
+	esdhc_cmd_end(mmc, NULL, data, err);
 
-		esdhc_write32(&regs->sysctl, esdhc_read32(&regs->sysctl) |
-			      SYSCTL_RSTC);
-		while (esdhc_read32(&regs->sysctl) & SYSCTL_RSTC)
-			;
+	return err;
+}
+#endif
 
-		if (data) {
-			esdhc_write32(&regs->sysctl,
-				      esdhc_read32(&regs->sysctl) |
-				      SYSCTL_RSTD);
-			while ((esdhc_read32(&regs->sysctl) & SYSCTL_RSTD))
-				;
-		}
+/*
+ * Sends a command out on the bus.  Takes the mmc pointer,
+ * a command pointer, and an optional data pointer.
+ */
+static int
+esdhc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
+{
+#ifndef CONFIG_SYS_FSL_ESDHC_USE_PIO
+	uint flags;
+#endif
+	int err;
 
-		/* If this was CMD11, then notify that power cycle is needed */
-		if (cmd->cmdidx == SD_CMD_SWITCH_UHS18V)
-			printf("CMD11 to switch to 1.8V mode failed, card requires power cycle.\n");
+	err = esdhc_cmd_start(mmc, cmd, data);
+	if (err || !data)
+		return err;
+
+	/* Wait until all of the blocks are transferred */
+#ifdef CONFIG_SYS_FSL_ESDHC_USE_PIO
+	esdhc_pio_read_write(mmc, data);
+	esdhc_cmd_end(mmc, cmd, data, 0);
+#else
+	flags = DATA_COMPLETE;
+	if ((cmd->cmdidx == MMC_SEND_TUNING_BLOCK) ||
+	    (cmd->cmdidx == MMC_SEND_TUNING_BLOCK_HS200)) {
+		flags = IRQSTAT_BRR;
 	}
 
-	esdhc_write32(&regs->irqstat, -1);
+	while ((err = esdhc_data_check(mmc, data, flags)) == -EBUSY)
+		;
+#endif
 
 	return err;
 }
 
+#if defined(CONFIG_BLK_ASYNC) && !defined(CONFIG_SYS_FSL_ESDHC_USE_PIO)
+static int esdhc_data_poll(struct mmc *mmc, struct mmc_data *data)
+{
+	return esdhc_data_check(mmc, data, DATA_COMPLETE);
+}
+#endif
+
 static void set_sysctl(struct mmc *mmc, uint clock)
 {
 	int div, pre_div;
@@ -881,6 +1118,9 @@ static int esdhc_execute_tuning(struct mmc *mmc, uint32_t opcode)
 
 	/* This is readw/writew SDHCI_HOST_CONTROL2 when tuning */
 	if (priv->flags & ESDHC_FLAG_STD_TUNING) {
+		/* esdhc_set_tuning() turns standard tuning off */
+		esdhc_setbits32(&regs->tuning_ctrl, ESDHC_STD_TUNING_EN);
+
 		v = readl(&regs->autoc12err);
 		m = readl(&regs->mixctrl);
 		v &= ~MIX_CTRL_SMPCLK_SEL;
@@ -942,6 +1182,56 @@ static int esdhc_execute_tuning(struct mmc *mmc, uint32_t opcode)
 	return ret;
 }
 
+#ifdef CONFIG_FSL_ESDHC_RESTORE_TUNING
+/* Read back the delay cells that standard tuning settled on */
+static int esdhc_get_tuning(struct mmc *mmc, u32 *tuning)
+{
+	struct fsl_esdhc_priv *priv = mmc->priv;
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	u32 v;
+
+	if (!(priv->flags & ESDHC_FLAG_STD_TUNING))
+		return -ENOSYS;
+	/* Not tuned, e.g. at 52MHz or below */
+	if (!(readl(&regs->autoc12err) & MIX_CTRL_SMPCLK_SEL))
+		return -EINVAL;
+
+	v = readl(&regs->clktunectrlstatus);
+	*tuning = (v & ESDHC_TUNE_CTRL_STATUS_TAP_SEL_PRE_MASK) >>
+		ESDHC_TUNE_CTRL_STATUS_TAP_SEL_PRE_SHIFT;
+
+	return 0;
+}
+
+/*
+ * Set the delay cells from esdhc_get_tuning() by hand and sample with the
+ * tuned clock, as after a successful standard tuning
+ */
+static int esdhc_set_tuning(struct mmc *mmc, u32 tuning)
+{
+	struct fsl_esdhc_priv *priv = mmc->priv;
+	struct fsl_esdhc *regs = priv->esdhc_regs;
+	u32 v;
+
+	if (!(priv->flags & ESDHC_FLAG_STD_TUNING))
+		return -ENOSYS;
+	if (tuning > (ESDHC_TUNE_CTRL_STATUS_DLY_CELL_SET_PRE_MASK >>
+		      ESDHC_TUNE_CTRL_STATUS_DLY_CELL_SET_PRE_SHIFT))
+		return -EINVAL;
+
+	esdhc_clrbits32(&regs->tuning_ctrl, ESDHC_STD_TUNING_EN);
+	esdhc_setbits32(&regs->mixctrl, MIX_CTRL_FBCLK_SEL);
+	v = readl(&regs->autoc12err);
+	v &= ~MIX_CTRL_EXE_TUNE;
+	v |= MIX_CTRL_SMPCLK_SEL;
+	writel(v, &regs->autoc12err);
+	writel(tuning << ESDHC_TUNE_CTRL_STATUS_DLY_CELL_SET_PRE_SHIFT,
+	       &regs->clktunectrlstatus);
+
+	return 0;
+}
+#endif
+
 static void esdhc_hs400_enhanced_strobe(struct mmc *mmc)
 {
 	struct fsl_esdhc_priv *priv = mmc->priv;
@@ -1073,6 +1363,9 @@ static int esdhc_init(struct mmc *mmc)
 
 	/* Put the PROCTL reg back to the default */
 	esdhc_write32(&regs->proctl, PROCTL_INIT);
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	esdhc_clrsetbits32(&regs->proctl, PROCTL_DMAS_MASK, PROCTL_DMAS_ADMA2);
+#endif
 
 	/* Set timout to the maximum value */
 	esdhc_clrsetbits32(&regs->sysctl, SYSCTL_TIMEOUT_MASK, 14 << 16);
@@ -1125,10 +1418,18 @@ static const struct mmc_ops esdhc_ops = {
 	.set_ios	= esdhc_set_ios,
 	.init		= esdhc_init,
 	.getcd		= esdhc_getcd,
+#if defined(CONFIG_BLK_ASYNC) && !defined(CONFIG_SYS_FSL_ESDHC_USE_PIO)
+	.send_cmd_start	= esdhc_cmd_start,
+	.data_poll	= esdhc_data_poll,
+#endif
 #if CONFIG_IS_ENABLED(DM_MMC)
 	.execute_tuning	= esdhc_execute_tuning,
 	.set_vdd = esdhc_set_vdd,
 	.hs400_enhanced_strobe = esdhc_hs400_enhanced_strobe,
+#ifdef CONFIG_FSL_ESDHC_RESTORE_TUNING
+	.get_tuning	= esdhc_get_tuning,
+	.set_tuning	= esdhc_set_tuning,
+#endif
 #endif
 };
 
@@ -1243,6 +1544,11 @@ static int fsl_esdhc_init(struct fsl_esdhc_priv *priv)
 
 	priv->cfg.b_max = CONFIG_SYS_MMC_MAX_BLK_COUNT;
 
+#ifdef CONFIG_FSL_ESDHC_ADMA
+	if (esdhc_adma_init(priv))
+		return -ENOMEM;
+#endif
+
 	writel(0, &regs->dllctrl);
 	if (priv->flags & ESDHC_FLAG_USDHC) {
 		if (priv->flags & ESDHC_FLAG_STD_TUNING) {
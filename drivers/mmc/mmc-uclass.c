@@ -35,9 +35,53 @@ int dm_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 
 int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
+#ifdef CONFIG_BLK_ASYNC
+	if (mmc->async_req)
+		mmc_read_finish(mmc);
+#endif
 	return dm_mmc_send_cmd(mmc->dev, cmd, data);
 }
 
+#ifdef CONFIG_BLK_ASYNC
+int dm_mmc_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+			  struct mmc_data *data)
+{
+	struct mmc *mmc = mmc_get_mmc_dev(dev);
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+	int ret;
+
+	if (!ops->send_cmd_start || !ops->data_poll)
+		return -ENOSYS;
+	mmmc_trace_before_send(mmc, cmd);
+	ret = ops->send_cmd_start(dev, cmd, data);
+	mmmc_trace_after_send(mmc, cmd, ret);
+
+	return ret;
+}
+
+int mmc_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data)
+{
+	if (mmc->async_req)
+		mmc_read_finish(mmc);
+	return dm_mmc_send_cmd_start(mmc->dev, cmd, data);
+}
+
+int dm_mmc_data_poll(struct udevice *dev, struct mmc_data *data)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->data_poll)
+		return -ENOSYS;
+	return ops->data_poll(dev, data);
+}
+
+int mmc_data_poll(struct mmc *mmc, struct mmc_data *data)
+{
+	return dm_mmc_data_poll(mmc->dev, data);
+}
+#endif
+
 int dm_mmc_set_ios(struct udevice *dev)
 {
 	struct dm_mmc_ops *ops = mmc_get_ops(dev);
@@ -121,6 +165,36 @@ int mmc_execute_tuning(struct mmc *mmc, uint opcode)
 {
 	return dm_mmc_execute_tuning(mmc->dev, opcode);
 }
+
+#ifdef CONFIG_MMC_MODE_CACHE
+int dm_mmc_get_tuning(struct udevice *dev, u32 *tuning)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->get_tuning)
+		return -ENOSYS;
+	return ops->get_tuning(dev, tuning);
+}
+
+int mmc_get_tuning(struct mmc *mmc, u32 *tuning)
+{
+	return dm_mmc_get_tuning(mmc->dev, tuning);
+}
+
+int dm_mmc_set_tuning(struct udevice *dev, u32 tuning)
+{
+	struct dm_mmc_ops *ops = mmc_get_ops(dev);
+
+	if (!ops->set_tuning)
+		return -ENOSYS;
+	return ops->set_tuning(dev, tuning);
+}
+
+int mmc_set_tuning(struct mmc *mmc, u32 tuning)
+{
+	return dm_mmc_set_tuning(mmc->dev, tuning);
+}
+#endif
 #endif
 
 struct mmc *mmc_get_mmc_dev(struct udevice *dev)
@@ -190,7 +264,8 @@ void mmc_do_preinit(void)
 
 		if (!m)
 			continue;
-#ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
+#if defined(CONFIG_FSL_ESDHC_ADAPTER_IDENT) || \
+	CONFIG_IS_ENABLED(MMC_EARLY_INIT)
 		mmc_set_preinit(m, 1);
 #endif
 		if (m->preinit)
@@ -314,6 +389,10 @@ static const struct blk_ops mmc_blk_ops = {
 	.erase	= mmc_berase,
 #endif
 	.select_hwpart	= mmc_select_hwpart,
+#ifdef CONFIG_BLK_ASYNC
+	.read_start	= mmc_bread_start,
+	.read_poll	= mmc_bread_poll,
+#endif
 };
 
 U_BOOT_DRIVER(mmc_blk) = {
@@ -21,6 +21,7 @@
 #include <memalign.h>
 #include <linux/list.h>
 #include <div64.h>
+#include <watchdog.h>
 #include "mmc_private.h"
 
 static const unsigned int sd_au_size[] = {
@@ -45,7 +46,8 @@ struct mmc *find_mmc_device(int dev_num)
 void mmc_do_preinit(void)
 {
 	struct mmc *m = &mmc_static;
-#ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
+#if defined(CONFIG_FSL_ESDHC_ADAPTER_IDENT) || \
+	CONFIG_IS_ENABLED(MMC_EARLY_INIT)
 	mmc_set_preinit(m, 1);
 #endif
 	if (m->preinit)
@@ -220,6 +222,10 @@ int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd, struct mmc_data *data)
 {
 	int ret;
 
+#ifdef CONFIG_BLK_ASYNC
+	if (mmc->async_req)
+		mmc_read_finish(mmc);
+#endif
 	mmmc_trace_before_send(mmc, cmd);
 	ret = mmc->cfg->ops->send_cmd(mmc, cmd, data);
 	mmmc_trace_after_send(mmc, cmd, ret);
@@ -231,6 +237,45 @@ int mmc_execute_tuning(struct mmc *mmc, uint opcode)
 {
 	return mmc->cfg->ops->execute_tuning(mmc, opcode);
 }
+
+#ifdef CONFIG_BLK_ASYNC
+int mmc_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data)
+{
+	int ret;
+
+	if (!mmc->cfg->ops->send_cmd_start || !mmc->cfg->ops->data_poll)
+		return -ENOSYS;
+	if (mmc->async_req)
+		mmc_read_finish(mmc);
+	mmmc_trace_before_send(mmc, cmd);
+	ret = mmc->cfg->ops->send_cmd_start(mmc, cmd, data);
+	mmmc_trace_after_send(mmc, cmd, ret);
+
+	return ret;
+}
+
+int mmc_data_poll(struct mmc *mmc, struct mmc_data *data)
+{
+	return mmc->cfg->ops->data_poll(mmc, data);
+}
+#endif
+
+#ifdef CONFIG_MMC_MODE_CACHE
+int mmc_get_tuning(struct mmc *mmc, u32 *tuning)
+{
+	if (!mmc->cfg->ops->get_tuning)
+		return -ENOSYS;
+	return mmc->cfg->ops->get_tuning(mmc, tuning);
+}
+
+int mmc_set_tuning(struct mmc *mmc, u32 tuning)
+{
+	if (!mmc->cfg->ops->set_tuning)
+		return -ENOSYS;
+	return mmc->cfg->ops->set_tuning(mmc, tuning);
+}
+#endif
 #endif
 
 int mmc_send_status(struct mmc *mmc, int timeout)
@@ -367,45 +412,89 @@ int mmc_send_tuning(struct mmc *mmc, u32 opcode, int *cmd_error)
 }
 
 
-static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+static void mmc_read_setup(struct mmc *mmc, struct mmc_cmd *cmd,
+			   struct mmc_data *data, void *dst, lbaint_t start,
 			   lbaint_t blkcnt)
 {
-	struct mmc_cmd cmd;
-	struct mmc_data data;
-
 	if (blkcnt > 1)
-		cmd.cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_MULTIPLE_BLOCK;
 	else
-		cmd.cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
+		cmd->cmdidx = MMC_CMD_READ_SINGLE_BLOCK;
 
 	if (mmc->high_capacity)
-		cmd.cmdarg = start;
+		cmd->cmdarg = start;
 	else
-		cmd.cmdarg = start * mmc->read_bl_len;
+		cmd->cmdarg = start * mmc->read_bl_len;
 
-	cmd.resp_type = MMC_RSP_R1;
+	cmd->resp_type = MMC_RSP_R1;
 
-	data.dest = dst;
-	data.blocks = blkcnt;
-	data.blocksize = mmc->read_bl_len;
-	data.flags = MMC_DATA_READ;
+	data->dest = dst;
+	data->blocks = blkcnt;
+	data->blocksize = mmc->read_bl_len;
+	data->flags = MMC_DATA_READ;
+}
+
+static int mmc_read_stop(struct mmc *mmc)
+{
+	struct mmc_cmd cmd;
+
+	cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
+	cmd.cmdarg = 0;
+	cmd.resp_type = MMC_RSP_R1b;
+	if (mmc_send_cmd(mmc, &cmd, NULL)) {
+#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
+		printf("mmc fail to send stop cmd\n");
+#endif
+		return -EIO;
+	}
+
+	return 0;
+}
 
+static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
+			   lbaint_t blkcnt)
+{
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+
+	mmc_read_setup(mmc, &cmd, &data, dst, start, blkcnt);
 	if (mmc_send_cmd(mmc, &cmd, &data))
 		return 0;
 
-	if (blkcnt > 1) {
-		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
-		cmd.cmdarg = 0;
-		cmd.resp_type = MMC_RSP_R1b;
-		if (mmc_send_cmd(mmc, &cmd, NULL)) {
+	if (blkcnt > 1 && mmc_read_stop(mmc))
+		return 0;
+
+	return blkcnt;
+}
+
+/* Select the hardware partition and check the range before a read */
+static int mmc_bread_prepare(struct mmc *mmc, struct blk_desc *block_dev,
+			     lbaint_t start, lbaint_t blkcnt)
+{
+	int err;
+
+	if (CONFIG_IS_ENABLED(MMC_TINY))
+		err = mmc_switch_part(mmc, block_dev->hwpart);
+	else
+		err = blk_dselect_hwpart(block_dev, block_dev->hwpart);
+
+	if (err < 0)
+		return err;
+
+	if ((start + blkcnt) > block_dev->lba) {
 #if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
-			printf("mmc fail to send stop cmd\n");
+		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
+			start + blkcnt, block_dev->lba);
 #endif
-			return 0;
-		}
+		return -EINVAL;
 	}
 
-	return blkcnt;
+	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
+		debug("%s: Failed to set blocklen\n", __func__);
+		return -EIO;
+	}
+
+	return 0;
 }
 
 #ifdef CONFIG_BLK
@@ -429,26 +518,9 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	if (!mmc)
 		return 0;
 
-	if (CONFIG_IS_ENABLED(MMC_TINY))
-		err = mmc_switch_part(mmc, block_dev->hwpart);
-	else
-		err = blk_dselect_hwpart(block_dev, block_dev->hwpart);
-
-	if (err < 0)
-		return 0;
-
-	if ((start + blkcnt) > block_dev->lba) {
-#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
-		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
-			start + blkcnt, block_dev->lba);
-#endif
-		return 0;
-	}
-
-	if (mmc_set_blocklen(mmc, mmc->read_bl_len)) {
-		debug("%s: Failed to set blocklen\n", __func__);
+	err = mmc_bread_prepare(mmc, block_dev, start, blkcnt);
+	if (err)
 		return 0;
-	}
 
 	do {
 		cur = (blocks_todo > mmc->cfg->b_max) ?
@@ -465,6 +537,123 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	return blkcnt;
 }
 
+#ifdef CONFIG_BLK_ASYNC
+/*
+ * Start the next transfer of @req, of at most b_max blocks. Other commands
+ * may have been sent since the last one, so select the hardware partition
+ * and block length again first.
+ */
+static int mmc_read_next(struct mmc *mmc, struct blk_desc *block_dev,
+			 struct blk_req *req)
+{
+	lbaint_t start = req->start + req->done;
+	lbaint_t cur = req->blkcnt - req->done;
+	void *dst = req->buffer + req->done * mmc->read_bl_len;
+	struct mmc_cmd cmd;
+	int err;
+
+	if (mmc->async_req && mmc->async_req != req)
+		mmc_read_finish(mmc);
+
+	err = mmc_bread_prepare(mmc, block_dev, req->start, req->blkcnt);
+	if (err)
+		return err;
+
+	if (cur > mmc->cfg->b_max)
+		cur = mmc->cfg->b_max;
+
+	mmc_read_setup(mmc, &cmd, &mmc->async_data, dst, start, cur);
+	err = mmc_send_cmd_start(mmc, &cmd, &mmc->async_data);
+	if (err == -ENOSYS) {
+		/* The host cannot leave a transfer running: read it now */
+		if (mmc_read_blocks(mmc, dst, start, cur) != cur)
+			return -EIO;
+		req->done += cur;
+		return 0;
+	}
+	if (err)
+		return err;
+
+	req->cur = cur;
+	mmc->async_req = req;
+
+	return 0;
+}
+
+/* Account for the transfer in flight once its data is in, or has failed */
+static int mmc_read_end(struct mmc *mmc, int err)
+{
+	struct blk_req *req = mmc->async_req;
+
+	/* Cleared first, as the stop command goes through mmc_send_cmd() */
+	mmc->async_req = NULL;
+	if (!err && req->cur > 1)
+		err = mmc_read_stop(mmc);
+	if (err)
+		req->err = err;
+	else
+		req->done += req->cur;
+	req->cur = 0;
+
+	return err;
+}
+
+/*
+ * Another command has to be sent while a read is in flight: wait for its
+ * data first. The rest of the request is started by the next poll.
+ */
+int mmc_read_finish(struct mmc *mmc)
+{
+	int err;
+
+	while ((err = mmc_data_poll(mmc, &mmc->async_data)) == -EBUSY)
+		WATCHDOG_RESET();
+
+	return mmc_read_end(mmc, err);
+}
+
+int mmc_bread_start(struct udevice *dev, struct blk_req *req)
+{
+	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+
+	if (!mmc)
+		return -ENODEV;
+
+	return mmc_read_next(mmc, block_dev, req);
+}
+
+long mmc_bread_poll(struct udevice *dev, struct blk_req *req)
+{
+	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+	int err;
+
+	if (!mmc)
+		return -ENODEV;
+
+	if (mmc->async_req == req) {
+		err = mmc_data_poll(mmc, &mmc->async_data);
+		if (err == -EBUSY)
+			return err;
+		mmc_read_end(mmc, err);
+	}
+
+	/* Keep the host busy while the caller works on what it has */
+	if (!req->err && req->done < req->blkcnt) {
+		req->err = mmc_read_next(mmc, block_dev, req);
+		if (!req->err)
+			return -EBUSY;
+	}
+	if (req->err) {
+		debug("%s: Failed to read blocks\n", __func__);
+		return req->err;
+	}
+
+	return req->done;
+}
+#endif
+
 static int mmc_go_idle(struct mmc *mmc)
 {
 	struct mmc_cmd cmd;
@@ -547,53 +736,64 @@ fail:
 	return -EIO;
 }
 
-static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
+static int sd_send_op_cond_iter(struct mmc *mmc, bool uhs_en)
 {
-	int timeout = 1000;
-	int err;
 	struct mmc_cmd cmd;
+	int err;
 
-	while (1) {
-		cmd.cmdidx = MMC_CMD_APP_CMD;
-		cmd.resp_type = MMC_RSP_R1;
-		cmd.cmdarg = 0;
+	cmd.cmdidx = MMC_CMD_APP_CMD;
+	cmd.resp_type = MMC_RSP_R1;
+	cmd.cmdarg = 0;
 
-		err = mmc_send_cmd(mmc, &cmd, NULL);
+	err = mmc_send_cmd(mmc, &cmd, NULL);
 
-		if (err)
-			return err;
+	if (err)
+		return err;
 
-		cmd.cmdidx = SD_CMD_APP_SEND_OP_COND;
-		cmd.resp_type = MMC_RSP_R3;
+	cmd.cmdidx = SD_CMD_APP_SEND_OP_COND;
+	cmd.resp_type = MMC_RSP_R3;
 
-		/*
-		 * Most cards do not answer if some reserved bits
-		 * in the ocr are set. However, Some controller
-		 * can set bit 7 (reserved for low voltages), but
-		 * how to manage low voltages SD card is not yet
-		 * specified.
-		 */
-		cmd.cmdarg = mmc_host_is_spi(mmc) ? 0 :
-			(mmc->cfg->voltages & 0xff8000);
+	/*
+	 * Most cards do not answer if some reserved bits
+	 * in the ocr are set. However, Some controller
+	 * can set bit 7 (reserved for low voltages), but
+	 * how to manage low voltages SD card is not yet
+	 * specified.
+	 */
+	cmd.cmdarg = mmc_host_is_spi(mmc) ? 0 :
+		(mmc->cfg->voltages & 0xff8000);
 
-		if (mmc->version == SD_VERSION_2)
-			cmd.cmdarg |= OCR_HCS;
+	if (mmc->version == SD_VERSION_2)
+		cmd.cmdarg |= OCR_HCS;
 
-		if (uhs_en)
-			cmd.cmdarg |= OCR_S18R;
+	if (uhs_en)
+		cmd.cmdarg |= OCR_S18R;
 
-		err = mmc_send_cmd(mmc, &cmd, NULL);
+	err = mmc_send_cmd(mmc, &cmd, NULL);
 
-		if (err)
-			return err;
+	if (err)
+		return err;
 
-		if (cmd.response[0] & OCR_BUSY)
-			break;
+	mmc->ocr = cmd.response[0];
+	return 0;
+}
 
+static int sd_complete_op_cond(struct mmc *mmc, bool uhs_en)
+{
+	int timeout = 1000;
+	int err;
+	struct mmc_cmd cmd;
+
+	mmc->sd_op_cond_pending = 0;
+	while (!(mmc->ocr & OCR_BUSY)) {
 		if (timeout-- <= 0)
 			return -EOPNOTSUPP;
 
 		udelay(1000);
+
+		err = sd_send_op_cond_iter(mmc, uhs_en);
+		if (err)
+			return err;
 	}
 
 	if (mmc->version != SD_VERSION_2)
@@ -608,11 +808,11 @@ static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
 
 		if (err)
 			return err;
-	}
 
-	mmc->ocr = cmd.response[0];
+		mmc->ocr = cmd.response[0];
+	}
 
-	if (!(mmc_host_is_spi(mmc)) && (cmd.response[0] & 0x41000000)
+	if (!(mmc_host_is_spi(mmc)) && (mmc->ocr & 0x41000000)
 	    == 0x41000000) {
 		err = mmc_switch_voltage(mmc, MMC_SIGNAL_VOLTAGE_180);
 		if (err)
@@ -625,6 +825,27 @@ static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
 	return 0;
 }
 
+/*
+ * Send the first ACMD41 only. If the card is still busy powering up, the
+ * polling is left to sd_complete_op_cond(), called from mmc_complete_init().
+ */
+static int sd_send_op_cond(struct mmc *mmc, bool uhs_en)
+{
+	int err;
+
+	err = sd_send_op_cond_iter(mmc, uhs_en);
+	if (err)
+		return err;
+
+	if (!(mmc->ocr & OCR_BUSY)) {
+		mmc->sd_op_cond_pending = 1;
+		mmc->sd_op_cond_uhs = uhs_en;
+		return 0;
+	}
+
+	return sd_complete_op_cond(mmc, uhs_en);
+}
+
 static int mmc_send_op_cond_iter(struct mmc *mmc, int use_arg)
 {
 	struct mmc_cmd cmd;
@@ -1748,7 +1969,17 @@ static int mmc_select_hs400es(struct mmc *mmc)
 	return 0;
 }
 
-static int mmc_select_hs400(struct mmc *mmc)
+/* Tune the host, or apply the result of an earlier tuning if @tuning */
+static int mmc_tune(struct mmc *mmc, uint opcode, const u32 *tuning)
+{
+#if CONFIG_IS_ENABLED(MMC_MODE_CACHE)
+	if (tuning)
+		return mmc_set_tuning(mmc, *tuning);
+#endif
+	return mmc_execute_tuning(mmc, opcode);
+}
+
+static int mmc_select_hs400(struct mmc *mmc, const u32 *tuning)
 {
 	int err;
 
@@ -1762,7 +1993,7 @@ static int mmc_select_hs400(struct mmc *mmc)
 	mmc_set_clock(mmc, mmc->tran_speed, false);
 
 	/* execute tuning if needed */
-	err = mmc_execute_tuning(mmc, MMC_SEND_TUNING_BLOCK_HS200);
+	err = mmc_tune(mmc, MMC_SEND_TUNING_BLOCK_HS200, tuning);
 	if (err) {
 		debug("tuning failed\n");
 		return err;
@@ -1787,6 +2018,200 @@ static int mmc_select_hs400(struct mmc *mmc)
 	return 0;
 }
 
+/*
+ * Switch the card and host to @mwt->mode with the bus width of @ecbw, then
+ * check the configuration with a transfer. If @tuning is not NULL it is
+ * applied instead of tuning the host.
+ */
+static int mmc_select_mode_width(struct mmc *mmc,
+				 const struct mode_width_tuning *mwt,
+				 const struct ext_csd_bus_width *ecbw,
+				 const u32 *tuning)
+{
+	int err;
+
+	/* configure the bus width (card + host) */
+	err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_BUS_WIDTH,
+			 ecbw->ext_csd_bits & ~EXT_CSD_DDR);
+	if (err)
+		return err;
+	mmc_set_bus_width(mmc, bus_width(ecbw->cap));
+
+	if (mwt->mode == MMC_HS_400) {
+		err = mmc_select_hs400(mmc, tuning);
+		if (err)
+			return err;
+	} else if (mwt->mode == MMC_HS_400_ES) {
+		err = mmc_select_hs400es(mmc);
+		if (err)
+			return err;
+	} else {
+		/* configure the bus speed (card) */
+		err = mmc_set_card_speed(mmc, mwt->mode);
+		if (err)
+			return err;
+
+		/*
+		 * configure the bus width AND the ddr mode (card)
+		 * The host side will be taken care of in the next step
+		 */
+		if (ecbw->ext_csd_bits & EXT_CSD_DDR) {
+			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+					 EXT_CSD_BUS_WIDTH, ecbw->ext_csd_bits);
+			if (err)
+				return err;
+		}
+
+		/* configure the bus mode (host) */
+		mmc_select_mode(mmc, mwt->mode);
+		mmc_set_clock(mmc, mmc->tran_speed, false);
+
+		/* execute tuning if needed */
+		if (mwt->tuning) {
+			err = mmc_tune(mmc, mwt->tuning, tuning);
+			if (err) {
+				debug("tuning failed\n");
+				return err;
+			}
+		}
+	}
+
+	/* do a transfer to check the configuration */
+	return mmc_read_and_compare_ext_csd(mmc);
+}
+
+/* Revert to a safe bus mode after an error */
+static void mmc_select_safe_mode(struct mmc *mmc)
+{
+	mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
+		   EXT_CSD_BUS_WIDTH, EXT_CSD_BUS_WIDTH_1);
+	mmc_select_mode(mmc, MMC_LEGACY);
+	mmc_set_bus_width(mmc, 1);
+}
+
+#if CONFIG_IS_ENABLED(MMC_MODE_CACHE)
+/*
+ * Mode last selected for a card, kept in the environment variable
+ * mmcmode<devnum> as "<CID>:<mode>:<bus width>[:<tuning>]", with the CID
+ * and tuning in hex
+ */
+struct mmc_mode_cache {
+	u32 cid[4];
+	enum bus_mode mode;
+	uint width;
+	bool tuned;
+	u32 tuning;
+};
+
+#define MMC_MODE_CACHE_CID_LEN	32
+
+static void mmc_mode_cache_name(struct mmc *mmc, char *name)
+{
+	sprintf(name, "mmcmode%d", mmc_get_blk_desc(mmc)->devnum);
+}
+
+static int mmc_mode_cache_load(struct mmc *mmc, struct mmc_mode_cache *rec)
+{
+	char name[16], word[9];
+	const char *s;
+	char *end;
+	int i;
+
+	mmc_mode_cache_name(mmc, name);
+	s = getenv(name);
+	if (!s)
+		return -ENOENT;
+	if (strlen(s) <= MMC_MODE_CACHE_CID_LEN)
+		return -EINVAL;
+
+	for (i = 0; i < ARRAY_SIZE(rec->cid); i++) {
+		strlcpy(word, s + i * 8, sizeof(word));
+		rec->cid[i] = simple_strtoul(word, &end, 16);
+		if (*end)
+			return -EINVAL;
+	}
+	s += MMC_MODE_CACHE_CID_LEN;
+	if (*s != ':')
+		return -EINVAL;
+	rec->mode = simple_strtoul(s + 1, &end, 10);
+	if (*end != ':')
+		return -EINVAL;
+	rec->width = simple_strtoul(end + 1, &end, 10);
+	rec->tuned = *end == ':';
+	if (rec->tuned)
+		rec->tuning = simple_strtoul(end + 1, &end, 16);
+	if (*end)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void mmc_mode_cache_save(struct mmc *mmc,
+				const struct mode_width_tuning *mwt,
+				const struct ext_csd_bus_width *ecbw)
+{
+	char name[16], rec[64];
+	const char *old;
+	u32 tuning;
+	int len;
+
+	len = sprintf(rec, "%08x%08x%08x%08x:%d:%d", mmc->cid[0], mmc->cid[1],
+		      mmc->cid[2], mmc->cid[3], mwt->mode,
+		      bus_width(ecbw->cap));
+	/* Without the host's tuning result, tuning is done every time */
+	if (mwt->tuning && !mmc_get_tuning(mmc, &tuning))
+		sprintf(rec + len, ":%x", tuning);
+
+	mmc_mode_cache_name(mmc, name);
+	old = getenv(name);
+	if (!old || strcmp(old, rec))
+		setenv(name, rec);
+}
+
+/* Switch straight to the mode recorded for this card, if there is one */
+static int mmc_select_cached_mode(struct mmc *mmc, uint card_caps)
+{
+	const struct mode_width_tuning *mwt;
+	const struct ext_csd_bus_width *ecbw;
+	struct mmc_mode_cache rec;
+	char name[16];
+	int err;
+
+	if (mmc_mode_cache_load(mmc, &rec))
+		return -ENOENT;
+	if (memcmp(rec.cid, mmc->cid, sizeof(rec.cid)))
+		goto stale;
+
+	for_each_mmc_mode_by_pref(card_caps, mwt) {
+		if (mwt->mode != rec.mode)
+			continue;
+		for_each_supported_width(card_caps & mwt->widths,
+					 mmc_is_mode_ddr(mwt->mode), ecbw) {
+			if (bus_width(ecbw->cap) != rec.width)
+				continue;
+			debug("using recorded mode %s width %d\n",
+			      mmc_mode_name(mwt->mode), rec.width);
+
+			err = mmc_select_mode_width(mmc, mwt, ecbw,
+						    rec.tuned ? &rec.tuning :
+						    NULL);
+			if (!err)
+				return 0;
+			mmc_select_safe_mode(mmc);
+			goto stale;
+		}
+	}
+
+stale:
+	/* Negotiate from scratch; success leaves a new record */
+	debug("recorded mode does not match, renegotiating\n");
+	mmc_mode_cache_name(mmc, name);
+	setenv(name, NULL);
+
+	return -ESTALE;
+}
+#endif
+
 static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 {
 	int err;
@@ -1809,6 +2234,11 @@ static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 
 	mmc_set_clock(mmc, mmc->legacy_speed, false);
 
+#if CONFIG_IS_ENABLED(MMC_MODE_CACHE)
+	if (!mmc_select_cached_mode(mmc, card_caps))
+		return 0;
+#endif
+
 	for_each_mmc_mode_by_pref(card_caps, mwt) {
 		for_each_supported_width(card_caps & mwt->widths,
 					 mmc_is_mode_ddr(mwt->mode), ecbw) {
@@ -1817,63 +2247,16 @@ static int mmc_select_mode_and_width(struct mmc *mmc, uint card_caps)
 			      bus_width(ecbw->cap),
 			      mmc_mode2freq(mmc, mwt->mode) / 1000000);
 
-			/* configure the bus width (card + host) */
-			err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-				EXT_CSD_BUS_WIDTH,
-				ecbw->ext_csd_bits & ~EXT_CSD_DDR);
-			if (err)
-				goto error;
-			mmc_set_bus_width(mmc, bus_width(ecbw->cap));
-
-			if (mwt->mode == MMC_HS_400) {
-				err = mmc_select_hs400(mmc);
-				if (err)
-					goto error;
-			} else if (mwt->mode == MMC_HS_400_ES) {
-				err = mmc_select_hs400es(mmc);
-				if (err)
-					goto error;
-			} else {
-				/* configure the bus speed (card) */
-				err = mmc_set_card_speed(mmc, mwt->mode);
-				if (err)
-					goto error;
-
-				/*
-				 * configure the bus width AND the ddr mode (card)
-				 * The host side will be taken care of in the next step
-				 */
-				if (ecbw->ext_csd_bits & EXT_CSD_DDR) {
-					err = mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-						EXT_CSD_BUS_WIDTH, ecbw->ext_csd_bits);
-					if (err)
-						goto error;
-				}
-
-				/* configure the bus mode (host) */
-				mmc_select_mode(mmc, mwt->mode);
-				mmc_set_clock(mmc, mmc->tran_speed, false);
-
-				/* execute tuning if needed */
-				if (mwt->tuning) {
-					err = mmc_execute_tuning(mmc, mwt->tuning);
-					if (err) {
-						debug("tuning failed\n");
-						goto error;
-					}
-				}
+			err = mmc_select_mode_width(mmc, mwt, ecbw, NULL);
+			if (!err) {
+#if CONFIG_IS_ENABLED(MMC_MODE_CACHE)
+				mmc_mode_cache_save(mmc, mwt, ecbw);
+#endif
+				return 0;
 			}
 
-			/* do a transfer to check the configuration */
-			err = mmc_read_and_compare_ext_csd(mmc);
-			if (!err)
-				return 0;
-error:
 			/* if an error occured, revert to a safer bus mode */
-			mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL,
-				   EXT_CSD_BUS_WIDTH, EXT_CSD_BUS_WIDTH_1);
-			mmc_select_mode(mmc, MMC_LEGACY);
-			mmc_set_bus_width(mmc, 1);
+			mmc_select_safe_mode(mmc);
 		}
 	}
 
@@ -2363,45 +2746,14 @@ static void mmc_power_cycle(struct mmc *mmc)
 	mmc_power_up(mmc);
 }
 
-int mmc_start_init(struct mmc *mmc)
+/*
+ * Power cycle the card and send it the commands that start its power-up,
+ * without waiting for it to finish
+ */
+static int mmc_start_op_cond(struct mmc *mmc, bool uhs_en)
 {
-	bool no_card;
-	bool uhs_en = supports_uhs(mmc->cfg->host_caps);
 	int err;
 
-	/* we pretend there's no card when init is NULL */
-	no_card = mmc_getcd(mmc) == 0;
-#ifndef CONFIG_DM_MMC_OPS
-	no_card = no_card || (mmc->cfg->ops->init == NULL);
-#endif
-	if (no_card) {
-		mmc->has_init = 0;
-#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
-		printf("MMC: no card present\n");
-#endif
-		return -ENOMEDIUM;
-	}
-
-	if (mmc->has_init)
-		return 0;
-
-#ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
-	mmc_adapter_card_type_ident();
-#endif
-	err = mmc_power_init(mmc);
-	if (err)
-		return err;
-
-#ifdef CONFIG_DM_MMC_OPS
-	/* The device has already been probed ready for use */
-#else
-	/* made sure it's not NULL earlier */
-	err = mmc->cfg->ops->init(mmc);
-	if (err)
-		return err;
-#endif
-	mmc->ddr_mode = 0;
-
 retry:
 	mmc_power_cycle(mmc);
 
@@ -2442,12 +2794,71 @@ retry:
 	return err;
 }
 
+int mmc_start_init(struct mmc *mmc)
+{
+	bool no_card;
+	bool uhs_en = supports_uhs(mmc->cfg->host_caps);
+	int err;
+
+	/* we pretend there's no card when init is NULL */
+	no_card = mmc_getcd(mmc) == 0;
+#ifndef CONFIG_DM_MMC_OPS
+	no_card = no_card || (mmc->cfg->ops->init == NULL);
+#endif
+	if (no_card) {
+		mmc->has_init = 0;
+#if !defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_LIBCOMMON_SUPPORT)
+		printf("MMC: no card present\n");
+#endif
+		return -ENOMEDIUM;
+	}
+
+	if (mmc->has_init)
+		return 0;
+
+#ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
+	mmc_adapter_card_type_ident();
+#endif
+	err = mmc_power_init(mmc);
+	if (err)
+		return err;
+
+#ifdef CONFIG_DM_MMC_OPS
+	/* The device has already been probed ready for use */
+#else
+	/* made sure it's not NULL earlier */
+	err = mmc->cfg->ops->init(mmc);
+	if (err)
+		return err;
+#endif
+	mmc->ddr_mode = 0;
+
+	bootstage_start(BOOTSTAGE_ID_ACCUM_MMC_START, "mmc_start_init");
+	err = mmc_start_op_cond(mmc, uhs_en);
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC_START);
+
+	return err;
+}
+
 static int mmc_complete_init(struct mmc *mmc)
 {
 	int err = 0;
 
+	bootstage_start(BOOTSTAGE_ID_ACCUM_MMC_COMPLETE, "mmc_complete_init");
 	mmc->init_in_progress = 0;
-	if (mmc->op_cond_pending)
+	if (mmc->sd_op_cond_pending) {
+		bool uhs_en = mmc->sd_op_cond_uhs;
+
+		err = sd_complete_op_cond(mmc, uhs_en);
+		/* Start again without UHS if the card failed to switch */
+		if (err && uhs_en) {
+			err = mmc_start_op_cond(mmc, false);
+			mmc->init_in_progress = 0;
+			if (!err && mmc->sd_op_cond_pending)
+				err = sd_complete_op_cond(mmc, false);
+		}
+	}
+	if (!err && mmc->op_cond_pending)
 		err = mmc_complete_op_cond(mmc);
 
 	if (!err)
@@ -2456,6 +2867,7 @@ static int mmc_complete_init(struct mmc *mmc)
 		mmc->has_init = 0;
 	else
 		mmc->has_init = 1;
+	bootstage_accum(BOOTSTAGE_ID_ACCUM_MMC_COMPLETE);
 	return err;
 }
 
@@ -2512,6 +2924,12 @@ static int mmc_probe(bd_t *bis)
 {
 	return 0;
 }
+#elif defined(CONFIG_DM_MMC) && defined(CONFIG_DM_PROBE_LAZY)
+static int mmc_probe(bd_t *bis)
+{
+	/* Each controller is probed when its block device is first used */
+	return 0;
+}
 #elif defined(CONFIG_DM_MMC)
 static int mmc_probe(bd_t *bis)
 {
@@ -2568,7 +2986,9 @@ int mmc_initialize(bd_t *bis)
 	if (ret)
 		return ret;
 
-#ifndef CONFIG_SPL_BUILD
+#if !defined(CONFIG_SPL_BUILD) && \
+	!(defined(CONFIG_DM_MMC) && defined(CONFIG_DM_PROBE_LAZY))
+	/* Listing the controllers would probe them all */
 	print_mmc_devices(',');
 #endif
 
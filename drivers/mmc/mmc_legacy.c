@@ -56,7 +56,8 @@ void mmc_do_preinit(void)
 	list_for_each(entry, &mmc_devices) {
 		m = list_entry(entry, struct mmc, link);
 
-#ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
+#if defined(CONFIG_FSL_ESDHC_ADAPTER_IDENT) || \
+	CONFIG_IS_ENABLED(MMC_EARLY_INIT)
 		mmc_set_preinit(m, 1);
 #endif
 		if (m->preinit)
@@ -16,6 +16,18 @@ extern int mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 			struct mmc_data *data);
 extern int mmc_send_status(struct mmc *mmc, int timeout);
 extern int mmc_set_blocklen(struct mmc *mmc, int len);
+#ifdef CONFIG_BLK_ASYNC
+int mmc_send_cmd_start(struct mmc *mmc, struct mmc_cmd *cmd,
+		       struct mmc_data *data);
+int mmc_data_poll(struct mmc *mmc, struct mmc_data *data);
+int mmc_read_finish(struct mmc *mmc);
+int mmc_bread_start(struct udevice *dev, struct blk_req *req);
+long mmc_bread_poll(struct udevice *dev, struct blk_req *req);
+#endif
+#ifdef CONFIG_MMC_MODE_CACHE
+int mmc_get_tuning(struct mmc *mmc, u32 *tuning);
+int mmc_set_tuning(struct mmc *mmc, u32 tuning);
+#endif
 #ifdef CONFIG_FSL_ESDHC_ADAPTER_IDENT
 void mmc_adapter_card_type_ident(void);
 #endif
@@ -127,6 +127,16 @@ ulong mmc_berase(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt)
 	return blk;
 }
 
+int mmc_erased_byte(struct mmc *mmc)
+{
+	if (IS_SD(mmc))
+		return mmc->scr[0] & SD_DATA_STAT_AFTER_ERASE ? 0xff : 0;
+	if (!mmc->ext_csd)
+		return -ENOSYS;
+
+	return mmc->ext_csd[EXT_CSD_ERASED_MEM_CONT] ? 0xff : 0;
+}
+
 static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 		lbaint_t blkcnt, const void *src)
 {
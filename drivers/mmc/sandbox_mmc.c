@@ -17,8 +17,87 @@ DECLARE_GLOBAL_DATA_PTR;
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
+#ifdef CONFIG_BLK_ASYNC
+	ulong data_end_us;	/* when the data of a started read is in */
+#endif
+	bool emmc;		/* emulate an eMMC rather than an SD card */
+	u8 ext_csd[MMC_MAX_BLOCK_LEN];
+	u32 tuning;		/* host tuning tap, reset with the card */
+	uint tunings;		/* number of times the host was tuned */
 };
 
+static const u32 sandbox_emmc_cid[4] = {
+	0x15010053, 0x414e4442, 0x4f581012, 0x34567800
+};
+
+/* Data is garbled at HS200/HS400 unless the host has the right tap */
+static bool sandbox_emmc_data_ok(struct sandbox_mmc_plat *plat)
+{
+	switch (plat->ext_csd[EXT_CSD_HS_TIMING] & 0xf) {
+	case EXT_CSD_TIMING_HS200:
+	case EXT_CSD_TIMING_HS400:
+		return plat->tuning == SANDBOX_MMC_TUNING_TAP;
+	default:
+		return true;
+	}
+}
+
+/*
+ * Emulate the commands where an eMMC (version 5.1, HS200) differs from the
+ * SD card. Returns -ENOENT for the commands that are the same.
+ */
+static int sandbox_emmc_send_cmd(struct sandbox_mmc_plat *plat,
+				 struct mmc_cmd *cmd, struct mmc_data *data)
+{
+	if (data && !sandbox_emmc_data_ok(plat))
+		return -EILSEQ;
+
+	switch (cmd->cmdidx) {
+	case MMC_CMD_GO_IDLE_STATE:
+		plat->ext_csd[EXT_CSD_HS_TIMING] = EXT_CSD_TIMING_LEGACY;
+		plat->ext_csd[EXT_CSD_BUS_WIDTH] = EXT_CSD_BUS_WIDTH_1;
+		plat->tuning = 0;
+		return 0;
+	case MMC_CMD_APP_CMD:
+		return -ETIMEDOUT;
+	case MMC_CMD_SEND_OP_COND:
+		cmd->response[0] = OCR_BUSY | OCR_HCS | 0x00ff8080;
+		return 0;
+	case MMC_CMD_ALL_SEND_CID:
+		memcpy(cmd->response, sandbox_emmc_cid,
+		       sizeof(sandbox_emmc_cid));
+		return 0;
+	case MMC_CMD_SEND_CSD:
+		cmd->response[0] = 4 << 26 | 0x32;	/* version 4, 25MHz */
+		cmd->response[1] = 9 << 16;		/* 512-byte blocks */
+		cmd->response[2] = 0;
+		cmd->response[3] = 9 << 22;
+		return 0;
+	case MMC_CMD_SWITCH:
+		plat->ext_csd[(cmd->cmdarg >> 16) & 0xff] = cmd->cmdarg >> 8;
+		return 0;
+	case MMC_CMD_SEND_EXT_CSD:
+		/* Without data this is the SD card's SEND_IF_COND */
+		if (!data)
+			return -ETIMEDOUT;
+		memcpy(data->dest, plat->ext_csd, MMC_MAX_BLOCK_LEN);
+		return 0;
+	default:
+		return -ENOENT;
+	}
+}
+
+/* Reads take SANDBOX_MMC_US_PER_BLOCK per block, like a real transfer */
+static uint sandbox_mmc_read_blocks(struct mmc_cmd *cmd,
+				    struct mmc_data *data)
+{
+	if (cmd->cmdidx != MMC_CMD_READ_SINGLE_BLOCK &&
+	    cmd->cmdidx != MMC_CMD_READ_MULTIPLE_BLOCK)
+		return 0;
+
+	return data->blocks;
+}
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
@@ -28,6 +107,15 @@ struct sandbox_mmc_plat {
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	int ret;
+
+	if (plat->emmc) {
+		ret = sandbox_emmc_send_cmd(plat, cmd, data);
+		if (ret != -ENOENT)
+			return ret;
+	}
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		break;
@@ -85,6 +173,86 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	return 0;
 }
 
+static int sandbox_mmc_send_cmd_sync(struct udevice *dev, struct mmc_cmd *cmd,
+				     struct mmc_data *data)
+{
+	int ret;
+
+	ret = sandbox_mmc_send_cmd(dev, cmd, data);
+	if (!ret && data)
+		udelay(sandbox_mmc_read_blocks(cmd, data) *
+		       SANDBOX_MMC_US_PER_BLOCK);
+
+	return ret;
+}
+
+#ifdef CONFIG_BLK_ASYNC
+static int sandbox_mmc_send_cmd_start(struct udevice *dev,
+				      struct mmc_cmd *cmd,
+				      struct mmc_data *data)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+	int ret;
+
+	ret = sandbox_mmc_send_cmd(dev, cmd, data);
+	if (ret)
+		return ret;
+	plat->data_end_us = timer_get_us() +
+		sandbox_mmc_read_blocks(cmd, data) * SANDBOX_MMC_US_PER_BLOCK;
+
+	return 0;
+}
+
+static int sandbox_mmc_data_poll(struct udevice *dev, struct mmc_data *data)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	if ((long)(timer_get_us() - plat->data_end_us) < 0)
+		return -EBUSY;
+
+	return 0;
+}
+#endif
+
+/* Tuning sweeps the taps until the card returns good data */
+static int sandbox_mmc_execute_tuning(struct udevice *dev, uint opcode)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	udelay(SANDBOX_MMC_TUNING_US);
+	plat->tuning = SANDBOX_MMC_TUNING_TAP;
+	plat->tunings++;
+
+	return 0;
+}
+
+#ifdef CONFIG_MMC_MODE_CACHE
+static int sandbox_mmc_get_tuning(struct udevice *dev, u32 *tuning)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	*tuning = plat->tuning;
+
+	return 0;
+}
+
+static int sandbox_mmc_set_tuning(struct udevice *dev, u32 tuning)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	plat->tuning = tuning;
+
+	return 0;
+}
+#endif
+
+uint sandbox_mmc_get_tunings(struct udevice *dev)
+{
+	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
+
+	return plat->tunings;
+}
+
 static int sandbox_mmc_set_ios(struct udevice *dev)
 {
 	return 0;
@@ -96,9 +264,18 @@ static int sandbox_mmc_get_cd(struct udevice *dev)
 }
 
 static const struct dm_mmc_ops sandbox_mmc_ops = {
-	.send_cmd = sandbox_mmc_send_cmd,
+	.send_cmd = sandbox_mmc_send_cmd_sync,
 	.set_ios = sandbox_mmc_set_ios,
 	.get_cd = sandbox_mmc_get_cd,
+	.execute_tuning = sandbox_mmc_execute_tuning,
+#ifdef CONFIG_BLK_ASYNC
+	.send_cmd_start = sandbox_mmc_send_cmd_start,
+	.data_poll = sandbox_mmc_data_poll,
+#endif
+#ifdef CONFIG_MMC_MODE_CACHE
+	.get_tuning = sandbox_mmc_get_tuning,
+	.set_tuning = sandbox_mmc_set_tuning,
+#endif
 };
 
 int sandbox_mmc_probe(struct udevice *dev)
@@ -120,6 +297,19 @@ int sandbox_mmc_bind(struct udevice *dev)
 	cfg->f_max = 52000000;
 	cfg->b_max = U32_MAX;
 
+	plat->emmc = fdtdec_get_bool(gd->fdt_blob, dev_of_offset(dev),
+				     "sandbox,emmc");
+	if (plat->emmc) {
+		u8 *ext_csd = plat->ext_csd;
+
+		cfg->host_caps |= MMC_MODE_HS200 | MMC_MODE_DDR_52MHz;
+		ext_csd[EXT_CSD_REV] = 8;
+		ext_csd[EXT_CSD_CARD_TYPE] = EXT_CSD_CARD_TYPE_26 |
+			EXT_CSD_CARD_TYPE_52 | EXT_CSD_CARD_TYPE_DDR_1_8V |
+			EXT_CSD_CARD_TYPE_HS200_1_8V;
+		ext_csd[EXT_CSD_SEC_CNT + 1] = 0x08;	/* 1MiB */
+	}
+
 	return mmc_bind(dev, &plat->mmc, cfg);
 }
 
@@ -72,7 +72,7 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 				unsigned int start_addr)
 {
 	unsigned int stat, rdy, mask, timeout, block = 0;
-#ifdef CONFIG_MMC_SDHCI_SDMA
+#if defined(CONFIG_MMC_SDHCI_SDMA) && !defined(CONFIG_MMC_SDHCI_ADMA)
 	unsigned char ctrl;
 	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
 	ctrl &= ~SDHCI_CTRL_DMA_MASK;
@@ -87,6 +87,11 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 		if (stat & SDHCI_INT_ERROR) {
 			printf("%s: Error detected in status(0x%X)!\n",
 			       __func__, stat);
+#ifdef CONFIG_MMC_SDHCI_ADMA
+			if (stat & SDHCI_INT_ADMA_ERROR)
+				printf("%s: ADMA error status 0x%X\n", __func__,
+				       sdhci_readb(host, SDHCI_ADMA_ERROR));
+#endif
 			return -EIO;
 		}
 		if (stat & rdy) {
@@ -98,7 +103,7 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 			if (++block >= data->blocks)
 				break;
 		}
-#ifdef CONFIG_MMC_SDHCI_SDMA
+#if defined(CONFIG_MMC_SDHCI_SDMA) && !defined(CONFIG_MMC_SDHCI_ADMA)
 		if (stat & SDHCI_INT_DMA_END) {
 			sdhci_writel(host, SDHCI_INT_DMA_END, SDHCI_INT_STATUS);
 			start_addr &= ~(SDHCI_DEFAULT_BOUNDARY_SIZE - 1);
@@ -116,6 +121,132 @@ static int sdhci_transfer_data(struct sdhci_host *host, struct mmc_data *data,
 	return 0;
 }
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+static void sdhci_adma_write_desc(struct sdhci_host *host, void **desc,
+				  unsigned long addr, int len, bool end)
+{
+	struct sdhci_adma_desc *dma_desc = *desc;
+	u16 attr = SDHCI_ADMA_VALID | SDHCI_ADMA_TRAN;
+
+	if (end)
+		attr |= SDHCI_ADMA_END;
+
+	/* A 64KiB chunk wraps to 0, which the controller reads as 64KiB */
+	dma_desc->attr = cpu_to_le16(attr);
+	dma_desc->len = cpu_to_le16(len);
+	dma_desc->addr_lo = cpu_to_le32(lower_32_bits(addr));
+	if (host->adma_desc_size == SDHCI_ADMA_DESC_64BIT_SIZE)
+		dma_desc->addr_hi = cpu_to_le32(upper_32_bits(addr));
+
+	*desc += host->adma_desc_size;
+}
+
+/*
+ * Describe the whole transfer in the ADMA2 descriptor table so that the
+ * controller moves every block without CPU intervention. ADMA2 data
+ * addresses must be 32-bit aligned: if the buffer is not, its first (up
+ * to three) bytes go through the adma_align bounce buffer and the rest is
+ * transferred in place.
+ *
+ * Returns the number of bounced bytes, or a negative error code.
+ */
+static int sdhci_adma_prepare(struct sdhci_host *host, struct mmc_data *data,
+			      int trans_bytes)
+{
+	bool is_read = data->flags == MMC_DATA_READ;
+	unsigned long start, addr;
+	void *desc = host->adma_desc_table;
+	int offset, len, left;
+
+	start = is_read ? (unsigned long)data->dest : (unsigned long)data->src;
+	addr = start;
+	offset = (SDHCI_ADMA_ALIGN - (addr & SDHCI_ADMA_MASK)) &
+		 SDHCI_ADMA_MASK;
+	offset = min(offset, trans_bytes);
+
+	if (1 + DIV_ROUND_UP(trans_bytes - offset, SDHCI_ADMA_MAX_LEN) >
+	    host->adma_desc_count) {
+		printf("%s: %d bytes do not fit the descriptor table\n",
+		       __func__, trans_bytes);
+		return -EINVAL;
+	}
+
+	left = trans_bytes;
+	if (offset) {
+		if (!is_read)
+			memcpy(host->adma_align, data->src, offset);
+		left -= offset;
+		sdhci_adma_write_desc(host, &desc,
+				      (unsigned long)host->adma_align, offset,
+				      !left);
+		flush_cache((unsigned long)host->adma_align,
+			    ALIGN(SDHCI_ADMA_ALIGN, CONFIG_SYS_CACHELINE_SIZE));
+	}
+
+	addr += offset;
+	while (left) {
+		len = min(left, SDHCI_ADMA_MAX_LEN);
+		left -= len;
+		sdhci_adma_write_desc(host, &desc, addr, len, !left);
+		addr += len;
+	}
+
+	flush_cache((unsigned long)host->adma_desc_table,
+		    ALIGN(desc - host->adma_desc_table,
+			  CONFIG_SYS_CACHELINE_SIZE));
+	addr = rounddown(start, CONFIG_SYS_CACHELINE_SIZE);
+	flush_cache(addr, ALIGN(start + trans_bytes - addr,
+				CONFIG_SYS_CACHELINE_SIZE));
+
+	return offset;
+}
+
+static void sdhci_adma_start(struct sdhci_host *host)
+{
+	unsigned long addr = (unsigned long)host->adma_desc_table;
+	u8 ctrl;
+
+	sdhci_writel(host, lower_32_bits(addr), SDHCI_ADMA_ADDRESS);
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL) & ~SDHCI_CTRL_DMA_MASK;
+	if (host->adma_desc_size == SDHCI_ADMA_DESC_64BIT_SIZE) {
+		sdhci_writel(host, upper_32_bits(addr), SDHCI_ADMA_ADDRESS_HI);
+		ctrl |= SDHCI_CTRL_ADMA64;
+	} else {
+		ctrl |= SDHCI_CTRL_ADMA32;
+	}
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+}
+
+static int sdhci_adma_init(struct mmc *mmc)
+{
+	struct sdhci_host *host = mmc->priv;
+	uint count, size;
+
+	if (host->adma_desc_table)
+		return 0;
+
+	/* One descriptor per 64KiB of the largest transfer, plus the head */
+	count = DIV_ROUND_UP(mmc->cfg->b_max * MMC_MAX_BLOCK_LEN,
+			     SDHCI_ADMA_MAX_LEN) + 1;
+	size = ALIGN(count * host->adma_desc_size, ARCH_DMA_MINALIGN);
+	host->adma_desc_table = memalign(ARCH_DMA_MINALIGN, size);
+	host->adma_align = memalign(ARCH_DMA_MINALIGN,
+				    ALIGN(SDHCI_ADMA_ALIGN, ARCH_DMA_MINALIGN));
+	if (!host->adma_desc_table || !host->adma_align) {
+		printf("%s: ADMA descriptor table alloc failed!!!\n",
+		       __func__);
+		free(host->adma_desc_table);
+		free(host->adma_align);
+		host->adma_desc_table = NULL;
+		host->adma_align = NULL;
+		return -ENOMEM;
+	}
+	host->adma_desc_count = count;
+
+	return 0;
+}
+#endif
+
 /*
  * No command will be sent by driver if card is busy, so driver must wait
  * for card ready state.
@@ -142,6 +273,9 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	unsigned int stat = 0;
 	int ret = 0;
 	int trans_bytes = 0, is_aligned = 1;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	int adma_offset = 0;
+#endif
 	u32 mask, flags, mode;
 	unsigned int time = 0, start_addr = 0;
 	int mmc_dev = mmc_get_blk_desc(mmc)->devnum;
@@ -204,7 +338,13 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 		if (data->flags == MMC_DATA_READ)
 			mode |= SDHCI_TRNS_READ;
 
-#ifdef CONFIG_MMC_SDHCI_SDMA
+#ifdef CONFIG_MMC_SDHCI_ADMA
+		adma_offset = sdhci_adma_prepare(host, data, trans_bytes);
+		if (adma_offset < 0)
+			return adma_offset;
+		sdhci_adma_start(host);
+		mode |= SDHCI_TRNS_DMA;
+#elif defined(CONFIG_MMC_SDHCI_SDMA)
 		if (data->flags == MMC_DATA_READ)
 			start_addr = (unsigned long)data->dest;
 		else
@@ -241,7 +381,7 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	}
 
 	sdhci_writel(host, cmd->cmdarg, SDHCI_ARGUMENT);
-#ifdef CONFIG_MMC_SDHCI_SDMA
+#if defined(CONFIG_MMC_SDHCI_SDMA) && !defined(CONFIG_MMC_SDHCI_ADMA)
 	trans_bytes = ALIGN(trans_bytes, CONFIG_SYS_CACHELINE_SIZE);
 	flush_cache(start_addr, trans_bytes);
 #endif
@@ -278,6 +418,10 @@ static int sdhci_send_command(struct mmc *mmc, struct mmc_cmd *cmd,
 	stat = sdhci_readl(host, SDHCI_INT_STATUS);
 	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
 	if (!ret) {
+#ifdef CONFIG_MMC_SDHCI_ADMA
+		if (adma_offset && data->flags == MMC_DATA_READ)
+			memcpy(data->dest, host->adma_align, adma_offset);
+#endif
 		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
 				!is_aligned && (data->flags == MMC_DATA_READ))
 			memcpy(data->dest, aligned_buffer, trans_bytes);
@@ -468,6 +612,7 @@ static int sdhci_set_ios(struct mmc *mmc)
 static int sdhci_init(struct mmc *mmc)
 {
 	struct sdhci_host *host = mmc->priv;
+	int __maybe_unused ret;
 
 	sdhci_reset(host, SDHCI_RESET_ALL);
 
@@ -480,6 +625,12 @@ static int sdhci_init(struct mmc *mmc)
 		}
 	}
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	ret = sdhci_adma_init(mmc);
+	if (ret)
+		return ret;
+#endif
+
 	sdhci_set_power(host, fls(mmc->cfg->voltages) - 1);
 
 	if (host->ops && host->ops->get_cd)
@@ -521,7 +672,13 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 
 	caps = sdhci_readl(host, SDHCI_CAPABILITIES);
 
-#ifdef CONFIG_MMC_SDHCI_SDMA
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	if (!(caps & SDHCI_CAN_DO_ADMA2)) {
+		printf("%s: Your controller doesn't support ADMA2!!\n",
+		       __func__);
+		return -EINVAL;
+	}
+#elif defined(CONFIG_MMC_SDHCI_SDMA)
 	if (!(caps & SDHCI_CAN_DO_SDMA)) {
 		printf("%s: Your controller doesn't support SDMA!!\n",
 		       __func__);
@@ -534,6 +691,16 @@ int sdhci_setup_cfg(struct mmc_config *cfg, struct sdhci_host *host,
 	else
 		host->version = sdhci_readw(host, SDHCI_HOST_VERSION);
 
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	/* 64-bit descriptors need a 3.00 controller and 64-bit addresses */
+	host->adma_desc_size = SDHCI_ADMA_DESC_32BIT_SIZE;
+	if (IS_ENABLED(CONFIG_PHYS_64BIT) &&
+	    SDHCI_GET_VERSION(host) >= SDHCI_SPEC_300 &&
+	    (caps & SDHCI_CAN_64BIT) &&
+	    !(host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR))
+		host->adma_desc_size = SDHCI_ADMA_DESC_64BIT_SIZE;
+#endif
+
 	cfg->name = host->name;
 #ifndef CONFIG_DM_MMC_OPS
 	cfg->ops = &sdhci_ops;
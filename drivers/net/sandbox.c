@@ -11,25 +11,114 @@
 #include <dm.h>
 #include <malloc.h>
 #include <net.h>
+#include <asm/eth.h>
 #include <asm/test.h>
+#include <asm/unaligned.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
 /**
  * struct eth_sandbox_priv - memory for sandbox mock driver
  *
+ * Packets returned as received are queued in net_rx_packets[], as a
+ * real controller would queue them in its receive ring. The packet most
+ * recently returned is still in use until the next one is asked for, so
+ * at most PKTBUFSRX - 1 packets can be queued; any more are dropped.
+ *
  * fake_host_hwaddr: MAC address of mocked machine
  * fake_host_ipaddr: IP address of mocked machine
- * recv_packet_buffer: buffer of the packet returned as received
- * recv_packet_length: length of the packet returned as received
+ * recv_packet_first: index in net_rx_packets[] of the first queued packet
+ * recv_packets: number of packets queued
+ * recv_packet_length: length of each packet queued
+ * recv_packet_time: time (in ms) at which each packet queued arrives
  */
 struct eth_sandbox_priv {
 	uchar fake_host_hwaddr[ARP_HLEN];
 	struct in_addr fake_host_ipaddr;
-	uchar *recv_packet_buffer;
-	int recv_packet_length;
+	int recv_packet_first;
+	int recv_packets;
+	int recv_packet_length[PKTBUFSRX];
+	ulong recv_packet_time[PKTBUFSRX];
 };
 
+/* Largest IP payload in one frame, a multiple of 8 as fragments need */
+#define SANDBOX_FRAG_SIZE	1480
+
+/* TFTP opcodes and block sizes, as in net/tftp.c */
+#define TFTP_RRQ		1
+#define TFTP_DATA		3
+#define TFTP_ACK		4
+#define TFTP_OACK		6
+#define TFTP_BLOCK_SIZE		512
+#define TFTP_MAX_BLOCK_SIZE	1468
+
+/* UDP ports the fake TFTP server listens on and sends from */
+#define TFTP_PORT		69
+#define SANDBOX_TFTP_PORT	5069
+
+/**
+ * struct sandbox_tftp - state of the fake TFTP server
+ *
+ * size: size of the file served, 0 if the server is not running
+ * max_windowsize: largest window size to agree to
+ * drop_block: block to lose the first time it is sent, 0 for none
+ * rtt_ms: round-trip time to add for each ACK
+ * blksize: block size agreed with the client
+ * windowsize: window size agreed with the client
+ * client_port: UDP port of the client
+ * acked: number of blocks acknowledged by the client
+ * done: true once the last block has been acknowledged
+ */
+static struct sandbox_tftp {
+	ulong size;
+	int max_windowsize;
+	ulong drop_block;
+	int rtt_ms;
+	int blksize;
+	int windowsize;
+	int client_port;
+	ulong acked;
+	bool done;
+} tftp;
+
+/* ONC RPC and NFS values, as in net/nfs.h */
+#define RPC_MSG_REPLY		1
+#define RPC_PROG_MISMATCH	2
+#define RPC_PROG_PORTMAP	100000
+#define RPC_PROG_NFS		100003
+#define RPC_PROG_MOUNT		100005
+#define PORTMAP_GETPORT		3
+#define MOUNT_ADDENTRY		1
+#define MOUNT_UMOUNTALL		4
+#define NFS_LOOKUP		4
+#define NFS_READ		6
+#define NFS3PROC_LOOKUP		3
+#define NFS3PROC_FSINFO		19
+#define NFS_FHSIZE		32
+#define NFS_MAX_READ_SIZE	8192
+
+/* UDP ports the fake NFS server listens on */
+#define RPC_PORTMAP_PORT	111
+#define SANDBOX_MOUNT_PORT	5635
+#define SANDBOX_NFS_PORT	2049
+
+/**
+ * struct sandbox_nfs - state of the fake NFS server
+ *
+ * size: size of the file served, 0 if the server is not running
+ * version: NFS version served, 2 or 3
+ * read_size: largest and preferred read size, for NFSv3
+ * drop_offset: offset of a read to lose the first time, 0 for none
+ * rtt_ms: round-trip time of each call
+ */
+static struct sandbox_nfs {
+	ulong size;
+	int version;
+	int read_size;
+	ulong drop_offset;
+	int rtt_ms;
+} nfs;
+
 static bool disabled[8] = {false};
 static bool skip_timeout;
 
@@ -54,6 +143,444 @@ void sandbox_eth_skip_timeout(void)
 	skip_timeout = true;
 }
 
+/*
+ * sandbox_eth_tftp_serve()
+ *
+ * Start a fake TFTP server which serves any file name, with contents
+ * given by sandbox_eth_file_byte(). The server supports the blksize,
+ * tsize and windowsize options.
+ *
+ * size - Size of the file to serve, 0 to stop the server
+ * max_windowsize - Largest window size to agree to
+ * drop_block - Block to lose the first time it is sent, 0 for none
+ * rtt_ms - Time to add for each round trip, to model a slow network
+ */
+void sandbox_eth_tftp_serve(ulong size, int max_windowsize, ulong drop_block,
+			    int rtt_ms)
+{
+	memset(&tftp, '\0', sizeof(tftp));
+	tftp.size = size;
+	tftp.max_windowsize = max_windowsize;
+	tftp.drop_block = drop_block;
+	tftp.rtt_ms = rtt_ms;
+}
+
+/*
+ * sandbox_eth_nfs_serve()
+ *
+ * Start a fake NFS server which serves any file name, with contents given
+ * by sandbox_eth_file_byte(). Each reply arrives a round trip after its
+ * call, so calls sent together share the wait.
+ *
+ * size - Size of the file to serve, 0 to stop the server
+ * version - NFS version to serve, 2 or 3
+ * read_size - Read size to offer to an NFSv3 client
+ * drop_offset - Offset of a read to lose the first time, 0 for none
+ * rtt_ms - Round-trip time of each call, to model a slow network
+ */
+void sandbox_eth_nfs_serve(ulong size, int version, int read_size,
+			   ulong drop_offset, int rtt_ms)
+{
+	memset(&nfs, '\0', sizeof(nfs));
+	nfs.size = size;
+	nfs.version = version;
+	nfs.read_size = min(read_size, NFS_MAX_READ_SIZE);
+	nfs.drop_offset = drop_offset;
+	nfs.rtt_ms = rtt_ms;
+}
+
+/* Get a buffer for a packet to return as received, or NULL if none */
+static void *sb_eth_recv_alloc(struct eth_sandbox_priv *priv)
+{
+	if (priv->recv_packets >= PKTBUFSRX - 1)
+		return NULL;
+
+	return net_rx_packets[(priv->recv_packet_first + priv->recv_packets) %
+			      PKTBUFSRX];
+}
+
+/* Queue the packet in the buffer from sb_eth_recv_alloc() */
+static void sb_eth_recv_queue(struct eth_sandbox_priv *priv, int length)
+{
+	int i = (priv->recv_packet_first + priv->recv_packets) % PKTBUFSRX;
+
+	priv->recv_packet_length[i] = length;
+	priv->recv_packet_time[i] = 0;
+	priv->recv_packets++;
+}
+
+/* Hold back the packets queued after the first @queued until @ms from now */
+static void sb_eth_recv_delay(struct eth_sandbox_priv *priv, int queued,
+			      int ms)
+{
+	ulong time = get_timer(0) + ms;
+	int n;
+
+	for (n = queued; n < priv->recv_packets; n++)
+		priv->recv_packet_time[(priv->recv_packet_first + n) %
+				       PKTBUFSRX] = time;
+}
+
+/* Set up the headers of a UDP packet from the fake host, before @payload */
+static void sb_eth_udp_header(struct eth_sandbox_priv *priv,
+			      struct ethernet_hdr *eth, uchar *payload,
+			      int sport, int dport, int len)
+{
+	struct ethernet_hdr *eth_recv = (void *)(payload - IP_UDP_HDR_SIZE -
+						 ETHER_HDR_SIZE);
+	struct ip_udp_hdr *ipr = (void *)(payload - IP_UDP_HDR_SIZE);
+	struct ip_udp_hdr *ip = (void *)eth + ETHER_HDR_SIZE;
+
+	memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
+	memcpy(eth_recv->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+	eth_recv->et_protlen = htons(PROT_IP);
+
+	net_set_udp_header((uchar *)ipr, net_read_ip(&ip->ip_src), dport,
+			   sport, len);
+	net_copy_ip((void *)&ipr->ip_src, &ip->ip_dst);
+	ipr->ip_sum = 0;
+	ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+}
+
+/* Queue a UDP packet from the fake host, with @len bytes at @payload */
+static void sb_eth_udp_reply(struct eth_sandbox_priv *priv,
+			     struct ethernet_hdr *eth, uchar *payload,
+			     int sport, int dport, int len)
+{
+	sb_eth_udp_header(priv, eth, payload, sport, dport, len);
+	sb_eth_recv_queue(priv, ETHER_HDR_SIZE + IP_UDP_HDR_SIZE + len);
+}
+
+/*
+ * Queue a UDP packet from the fake host with @len bytes copied from @data,
+ * as IP fragments if it does not fit in one frame
+ */
+static void sb_eth_udp_reply_frag(struct eth_sandbox_priv *priv,
+				  struct ethernet_hdr *eth, const void *data,
+				  int sport, int dport, int len)
+{
+	uchar hdr[ETHER_HDR_SIZE + IP_HDR_SIZE];
+	struct ip_udp_hdr *ipr;
+	int offset, size;
+	uchar *frame;
+
+	/* The first fragment has the UDP header and the start of the data */
+	frame = sb_eth_recv_alloc(priv);
+	if (!frame)
+		return;
+	size = min(len, SANDBOX_FRAG_SIZE - (int)UDP_HDR_SIZE);
+	memcpy(frame + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE, data, size);
+	if (size == len) {
+		sb_eth_udp_reply(priv, eth, frame + ETHER_HDR_SIZE +
+				 IP_UDP_HDR_SIZE, sport, dport, len);
+		return;
+	}
+	sb_eth_udp_header(priv, eth, frame + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE,
+			  sport, dport, size);
+	ipr = (void *)frame + ETHER_HDR_SIZE;
+	ipr->udp_len = htons(UDP_HDR_SIZE + len);
+	memcpy(hdr, frame, sizeof(hdr));
+
+	/* Offsets count from the UDP header, which the data follows */
+	for (offset = 0; offset < UDP_HDR_SIZE + len; offset += size) {
+		if (offset) {
+			frame = sb_eth_recv_alloc(priv);
+			if (!frame)
+				return;
+			memcpy(frame, hdr, sizeof(hdr));
+			size = min(SANDBOX_FRAG_SIZE,
+				   (int)UDP_HDR_SIZE + len - offset);
+			memcpy(frame + sizeof(hdr),
+			       data + offset - UDP_HDR_SIZE, size);
+		} else {
+			size = SANDBOX_FRAG_SIZE;
+		}
+		ipr = (void *)frame + ETHER_HDR_SIZE;
+		ipr->ip_len = htons(IP_HDR_SIZE + size);
+		ipr->ip_off = htons(offset / 8 |
+				    (offset + size < UDP_HDR_SIZE + len ?
+				     IP_FLAGS_MFRAG : 0));
+		ipr->ip_sum = 0;
+		ipr->ip_sum = compute_ip_checksum(ipr, IP_HDR_SIZE);
+		sb_eth_recv_queue(priv, sizeof(hdr) + size);
+	}
+}
+
+/* Send the next window of data blocks after the last one acknowledged */
+static void sb_eth_tftp_send_window(struct eth_sandbox_priv *priv,
+				    struct ethernet_hdr *eth)
+{
+	ulong block, offset;
+	uchar *payload;
+	int i, len;
+
+	for (block = tftp.acked + 1;
+	     block <= tftp.acked + tftp.windowsize; block++) {
+		offset = (block - 1) * tftp.blksize;
+		len = min((ulong)tftp.blksize, tftp.size - offset);
+		if (block == tftp.drop_block) {
+			tftp.drop_block = 0;
+		} else {
+			payload = sb_eth_recv_alloc(priv);
+			if (!payload)
+				return;
+			payload += ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+			put_unaligned_be16(TFTP_DATA, payload);
+			put_unaligned_be16(block, payload + 2);
+			for (i = 0; i < len; i++)
+				payload[4 + i] = sandbox_eth_file_byte(offset +
+								       i);
+			sb_eth_udp_reply(priv, eth, payload, SANDBOX_TFTP_PORT,
+					 tftp.client_port, 4 + len);
+		}
+		if (len < tftp.blksize)
+			break;
+	}
+}
+
+/* Handle a read request, replying with options or the first block */
+static void sb_eth_tftp_rrq(struct eth_sandbox_priv *priv,
+			    struct ethernet_hdr *eth, char *req, int len)
+{
+	char *end = req + len, *opt, *val;
+	uchar *payload, *oack;
+	bool options = false;
+
+	tftp.blksize = TFTP_BLOCK_SIZE;
+	tftp.windowsize = 1;
+	tftp.acked = 0;
+	tftp.done = false;
+
+	payload = sb_eth_recv_alloc(priv);
+	if (!payload)
+		return;
+	payload += ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+	put_unaligned_be16(TFTP_OACK, payload);
+	oack = payload + 2;
+
+	/* Skip the file name and mode, then look at each option */
+	req += strnlen(req, end - req) + 1;
+	req += strnlen(req, end - req) + 1;
+	while (req < end) {
+		opt = req;
+		val = opt + strnlen(opt, end - opt) + 1;
+		if (val >= end)
+			break;
+		req = val + strnlen(val, end - val) + 1;
+
+		if (!strcmp(opt, "blksize")) {
+			tftp.blksize = min(simple_strtoul(val, NULL, 10),
+					   (ulong)TFTP_MAX_BLOCK_SIZE);
+			oack += sprintf((char *)oack, "blksize%c%d%c", 0,
+					tftp.blksize, 0);
+		} else if (!strcmp(opt, "windowsize")) {
+			tftp.windowsize = min(simple_strtoul(val, NULL, 10),
+					      (ulong)tftp.max_windowsize);
+			oack += sprintf((char *)oack, "windowsize%c%d%c", 0,
+					tftp.windowsize, 0);
+		} else if (!strcmp(opt, "tsize")) {
+			oack += sprintf((char *)oack, "tsize%c%lu%c", 0,
+					tftp.size, 0);
+		} else {
+			continue;
+		}
+		options = true;
+	}
+
+	if (options)
+		sb_eth_udp_reply(priv, eth, payload, SANDBOX_TFTP_PORT,
+				 tftp.client_port, oack - payload);
+	else
+		sb_eth_tftp_send_window(priv, eth);
+}
+
+/* Handle a packet sent to the fake TFTP server */
+static void sb_eth_tftp(struct eth_sandbox_priv *priv,
+			struct ethernet_hdr *eth)
+{
+	struct ip_udp_hdr *ip = (void *)eth + ETHER_HDR_SIZE;
+	uchar *pkt = (uchar *)ip + IP_UDP_HDR_SIZE;
+	int len = ntohs(ip->udp_len) - UDP_HDR_SIZE;
+	ulong last = DIV_ROUND_UP(tftp.size + 1, tftp.blksize);
+	ushort block;
+
+	if (len < 4)
+		return;
+
+	if (ntohs(ip->udp_dst) == TFTP_PORT &&
+	    get_unaligned_be16(pkt) == TFTP_RRQ) {
+		tftp.client_port = ntohs(ip->udp_src);
+		sb_eth_tftp_rrq(priv, eth, (char *)pkt + 2, len - 2);
+		return;
+	}
+	if (ntohs(ip->udp_dst) != SANDBOX_TFTP_PORT ||
+	    ntohs(ip->udp_src) != tftp.client_port ||
+	    get_unaligned_be16(pkt) != TFTP_ACK || tftp.done)
+		return;
+
+	/* Each ACK takes a round trip */
+	if (tftp.rtt_ms)
+		sandbox_timer_add_offset(tftp.rtt_ms);
+
+	/* Work out the full block number, which wraps on the wire */
+	block = get_unaligned_be16(pkt + 2);
+	if ((ushort)(block - tftp.acked) < 0x8000)
+		tftp.acked += (ushort)(block - tftp.acked);
+	if (tftp.acked >= last)
+		tftp.done = true;
+	else
+		sb_eth_tftp_send_window(priv, eth);
+}
+
+/* Fill in NFS file attributes from @fattr, returning the words after them */
+static u32 *sb_eth_nfs_fattr(u32 *fattr)
+{
+	int words = nfs.version == 2 ? 17 : 21;
+
+	memset(fattr, '\0', words * sizeof(u32));
+	fattr[0] = cpu_to_be32(1);	/* regular file */
+	if (nfs.version == 2) {
+		fattr[5] = cpu_to_be32(nfs.size);
+	} else {
+		fattr[5] = cpu_to_be32(upper_32_bits(nfs.size));
+		fattr[6] = cpu_to_be32(lower_32_bits(nfs.size));
+	}
+
+	return fattr + words;
+}
+
+/* Handle a READ call, returning the end of the reply or NULL for none */
+static u32 *sb_eth_nfs_read(u32 *args, u32 *reply)
+{
+	ulong offset;
+	int count, i;
+	uchar *data;
+
+	if (nfs.version == 2) {
+		args += NFS_FHSIZE / 4;
+		offset = be32_to_cpu(args[0]);
+		count = min(be32_to_cpu(args[1]), (u32)NFS_MAX_READ_SIZE);
+	} else {
+		args += 1 + be32_to_cpu(args[0]) / 4;
+		offset = be32_to_cpu(args[1]);
+		count = min(be32_to_cpu(args[2]), (u32)nfs.read_size);
+	}
+	if (offset && offset == nfs.drop_offset) {
+		nfs.drop_offset = 0;
+		return NULL;
+	}
+	count = min((ulong)count, offset < nfs.size ? nfs.size - offset : 0);
+
+	*reply++ = 0;			/* NFS_OK */
+	if (nfs.version == 3)
+		*reply++ = cpu_to_be32(1);	/* attributes follow */
+	reply = sb_eth_nfs_fattr(reply);
+	*reply++ = cpu_to_be32(count);
+	if (nfs.version == 3) {
+		*reply++ = cpu_to_be32(offset + count >= nfs.size);
+		*reply++ = cpu_to_be32(count);
+	}
+	data = (uchar *)reply;
+	for (i = 0; i < count; i++)
+		data[i] = sandbox_eth_file_byte(offset + i);
+	memset(data + count, '\0', -count & 3);
+
+	return reply + DIV_ROUND_UP(count, 4);
+}
+
+/* Handle a packet sent to the fake NFS server */
+static void sb_eth_nfs(struct eth_sandbox_priv *priv,
+		       struct ethernet_hdr *eth)
+{
+	static u32 reply[64 + NFS_MAX_READ_SIZE / 4];
+	struct ip_udp_hdr *ip = (void *)eth + ETHER_HDR_SIZE;
+	int len = ntohs(ip->udp_len) - UDP_HDR_SIZE;
+	int dport = ntohs(ip->udp_dst);
+	int queued = priv->recv_packets;
+	u32 call[256], *args, *p;
+	u32 prog, vers, proc;
+
+	if (dport != RPC_PORTMAP_PORT && dport != SANDBOX_MOUNT_PORT &&
+	    dport != SANDBOX_NFS_PORT)
+		return;
+	if (len < 10 * sizeof(u32) || len > sizeof(call))
+		return;
+	memcpy(call, (uchar *)ip + IP_UDP_HDR_SIZE, len);
+	prog = be32_to_cpu(call[3]);
+	vers = be32_to_cpu(call[4]);
+	proc = be32_to_cpu(call[5]);
+
+	/* Skip the credential and the verifier */
+	args = call + 6;
+	args += 2 + DIV_ROUND_UP(be32_to_cpu(args[1]), 4);
+	if (args + 2 > call + len / 4)
+		return;
+	args += 2 + DIV_ROUND_UP(be32_to_cpu(args[1]), 4);
+	if (args > call + len / 4)
+		return;
+
+	/* Accepted reply with an AUTH_NONE verifier */
+	reply[0] = call[0];
+	reply[1] = cpu_to_be32(RPC_MSG_REPLY);
+	reply[2] = 0;
+	reply[3] = 0;
+	reply[4] = 0;
+	reply[5] = 0;
+	p = reply + 6;
+
+	if (prog == RPC_PROG_PORTMAP && proc == PORTMAP_GETPORT) {
+		if (be32_to_cpu(args[0]) == RPC_PROG_MOUNT)
+			*p++ = cpu_to_be32(SANDBOX_MOUNT_PORT);
+		else
+			*p++ = cpu_to_be32(SANDBOX_NFS_PORT);
+	} else if (prog == RPC_PROG_MOUNT && proc == MOUNT_ADDENTRY) {
+		*p++ = 0;			/* MNT_OK */
+		if (vers == 3)
+			*p++ = cpu_to_be32(NFS_FHSIZE);
+		memset(p, '\0', NFS_FHSIZE);
+		p += NFS_FHSIZE / 4;
+		if (vers == 3)
+			*p++ = 0;		/* no auth flavors */
+	} else if (prog == RPC_PROG_MOUNT && proc == MOUNT_UMOUNTALL) {
+		/* Nothing to say */
+	} else if (prog == RPC_PROG_NFS && vers != nfs.version) {
+		reply[5] = cpu_to_be32(RPC_PROG_MISMATCH);
+		*p++ = cpu_to_be32(nfs.version);
+		*p++ = cpu_to_be32(nfs.version);
+	} else if (prog == RPC_PROG_NFS && vers == 2 && proc == NFS_LOOKUP) {
+		*p++ = 0;			/* NFS_OK */
+		memset(p, '\0', NFS_FHSIZE);
+		p += NFS_FHSIZE / 4;
+		p = sb_eth_nfs_fattr(p);
+	} else if (prog == RPC_PROG_NFS && vers == 3 &&
+		   proc == NFS3PROC_LOOKUP) {
+		*p++ = 0;			/* NFS3_OK */
+		*p++ = cpu_to_be32(NFS_FHSIZE);
+		memset(p, '\0', NFS_FHSIZE);
+		p += NFS_FHSIZE / 4;
+		*p++ = 0;			/* no object attributes */
+		*p++ = 0;			/* no directory attributes */
+	} else if (prog == RPC_PROG_NFS && vers == 3 &&
+		   proc == NFS3PROC_FSINFO) {
+		*p++ = 0;			/* NFS3_OK */
+		*p++ = 0;			/* no attributes */
+		*p++ = cpu_to_be32(nfs.read_size);	/* rtmax */
+		*p++ = cpu_to_be32(nfs.read_size);	/* rtpref */
+		memset(p, '\0', 10 * sizeof(u32));
+		p += 10;
+	} else if (prog == RPC_PROG_NFS && proc == NFS_READ) {
+		p = sb_eth_nfs_read(args, p);
+		if (!p)
+			return;
+	} else {
+		return;
+	}
+
+	sb_eth_udp_reply_frag(priv, eth, reply, dport, ntohs(ip->udp_src),
+			      (uchar *)p - (uchar *)reply);
+	sb_eth_recv_delay(priv, queued, nfs.rtt_ms);
+}
+
 static int sb_eth_start(struct udevice *dev)
 {
 	struct eth_sandbox_priv *priv = dev_get_priv(dev);
@@ -63,7 +590,8 @@ static int sb_eth_start(struct udevice *dev)
 	fdtdec_get_byte_array(gd->fdt_blob, dev_of_offset(dev),
 			      "fake-host-hwaddr", priv->fake_host_hwaddr,
 			      ARP_HLEN);
-	priv->recv_packet_buffer = net_rx_packets[0];
+	priv->recv_packet_first = 0;
+	priv->recv_packets = 0;
 	return 0;
 }
 
@@ -88,14 +616,15 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 			/* store this as the assumed IP of the fake host */
 			priv->fake_host_ipaddr = net_read_ip(&arp->ar_tpa);
 			/* Formulate a fake response */
-			eth_recv = (void *)priv->recv_packet_buffer;
+			eth_recv = sb_eth_recv_alloc(priv);
+			if (!eth_recv)
+				return 0;
 			memcpy(eth_recv->et_dest, eth->et_src, ARP_HLEN);
 			memcpy(eth_recv->et_src, priv->fake_host_hwaddr,
 			       ARP_HLEN);
 			eth_recv->et_protlen = htons(PROT_ARP);
 
-			arp_recv = (void *)priv->recv_packet_buffer +
-				ETHER_HDR_SIZE;
+			arp_recv = (void *)eth_recv + ETHER_HDR_SIZE;
 			arp_recv->ar_hrd = htons(ARP_ETHER);
 			arp_recv->ar_pro = htons(PROT_IP);
 			arp_recv->ar_hln = ARP_HLEN;
@@ -107,8 +636,7 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 			memcpy(&arp_recv->ar_tha, &arp->ar_sha, ARP_HLEN);
 			net_copy_ip(&arp_recv->ar_tpa, &arp->ar_spa);
 
-			priv->recv_packet_length = ETHER_HDR_SIZE +
-				ARP_HDR_SIZE;
+			sb_eth_recv_queue(priv, ETHER_HDR_SIZE + ARP_HDR_SIZE);
 		}
 	} else if (ntohs(eth->et_protlen) == PROT_IP) {
 		struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
@@ -122,11 +650,11 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 				struct icmp_hdr *icmpr;
 
 				/* reply to the ping */
-				memcpy(priv->recv_packet_buffer, packet,
-				       length);
-				eth_recv = (void *)priv->recv_packet_buffer;
-				ipr = (void *)priv->recv_packet_buffer +
-					ETHER_HDR_SIZE;
+				eth_recv = sb_eth_recv_alloc(priv);
+				if (!eth_recv)
+					return 0;
+				memcpy(eth_recv, packet, length);
+				ipr = (void *)eth_recv + ETHER_HDR_SIZE;
 				icmpr = (struct icmp_hdr *)&ipr->udp_src;
 				memcpy(eth_recv->et_dest, eth->et_src,
 				       ARP_HLEN);
@@ -145,8 +673,12 @@ static int sb_eth_send(struct udevice *dev, void *packet, int length)
 				icmpr->checksum = compute_ip_checksum(icmpr,
 					ICMP_HDR_SIZE);
 
-				priv->recv_packet_length = length;
+				sb_eth_recv_queue(priv, length);
 			}
+		} else if (ip->ip_p == IPPROTO_UDP && tftp.size) {
+			sb_eth_tftp(priv, eth);
+		} else if (ip->ip_p == IPPROTO_UDP && nfs.size) {
+			sb_eth_nfs(priv, eth);
 		}
 	}
 
@@ -162,14 +694,21 @@ static int sb_eth_recv(struct udevice *dev, int flags, uchar **packetp)
 		skip_timeout = false;
 	}
 
-	if (priv->recv_packet_length) {
-		int lcl_recv_packet_length = priv->recv_packet_length;
+	if (priv->recv_packets) {
+		int i = priv->recv_packet_first;
+		ulong now = get_timer(0);
+
+		/* Wait for the packet to arrive */
+		if (priv->recv_packet_time[i] > now)
+			sandbox_timer_add_offset(priv->recv_packet_time[i] -
+						 now);
 
 		debug("eth_sandbox: received packet %d\n",
-		      priv->recv_packet_length);
-		priv->recv_packet_length = 0;
-		*packetp = priv->recv_packet_buffer;
-		return lcl_recv_packet_length;
+		      priv->recv_packet_length[i]);
+		priv->recv_packet_first = (i + 1) % PKTBUFSRX;
+		priv->recv_packets--;
+		*packetp = net_rx_packets[i];
+		return priv->recv_packet_length[i];
 	}
 	return 0;
 }
@@ -20,6 +20,7 @@
 #include <asm/arch/clock.h>
 #include <asm/arch/periph.h>
 #include <dm/pinctrl.h>
+#include <dm/uclass-internal.h>
 #include "rk_spi.h"
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -153,6 +154,7 @@ static int conv_of_platdata(struct udevice *dev)
 	if (ret < 0)
 		return ret;
 	dev->req_seq = 0;
+	uclass_index_device(dev);
 
 	return 0;
 }
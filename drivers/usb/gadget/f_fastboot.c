@@ -813,6 +813,19 @@ static lbaint_t mmc_sparse_reserve(struct sparse_storage *info,
 	return blkcnt;
 }
 
+#ifdef CONFIG_FASTBOOT_MMC_SPARSE_ERASE
+static lbaint_t mmc_sparse_erase(struct sparse_storage *info,
+		lbaint_t blk, lbaint_t blkcnt)
+{
+	struct blk_desc *dev_desc = (struct blk_desc *)info->priv;
+	lbaint_t blks;
+
+	blks = blk_derase(dev_desc, blk, blkcnt);
+
+	return blks == blkcnt ? blks : 0;
+}
+#endif
+
 /*judge wether the gpt image and bootloader image are overlay*/
 bool bootloader_gpt_overlay(void)
 {
@@ -935,6 +948,15 @@ static void process_flash_mmc(const char *cmdbuf)
 				sparse.size = info.size;
 				sparse.write = mmc_sparse_write;
 				sparse.reserve = mmc_sparse_reserve;
+				sparse.erase = NULL;
+#ifdef CONFIG_FASTBOOT_MMC_SPARSE_ERASE
+				if (mmc) {
+					sparse.erase = mmc_sparse_erase;
+					sparse.erase_grp = mmc->erase_grp_size;
+					sparse.erase_zeroes =
+						mmc_erased_byte(mmc) == 0;
+				}
+#endif
 				printf("Flashing sparse image at offset " LBAFU "\n",
 				       sparse.start);
 
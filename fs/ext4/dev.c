@@ -28,6 +28,7 @@
 #include <config.h>
 #include <memalign.h>
 #include <ext4fs.h>
+#include <fs.h>
 #include <ext_common.h>
 #include "ext4_common.h"
 
@@ -43,6 +44,7 @@ void ext4fs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info)
 	get_fs()->dev_desc = rbdd;
 	part_info = info;
 	part_offset = info->start;
+	fs_dcache_set_dev(rbdd, info->start);
 	get_fs()->total_sect = ((uint64_t)info->size * info->blksz) >>
 		get_fs()->dev_desc->log2blksz;
 }
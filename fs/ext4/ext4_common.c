@@ -22,6 +22,7 @@
 #include <common.h>
 #include <ext_common.h>
 #include <ext4fs.h>
+#include <fs.h>
 #include <inttypes.h>
 #include <malloc.h>
 #include <memalign.h>
@@ -46,6 +47,19 @@ int ext4fs_indir3_blkno = -1;
 struct ext2_inode *g_parent_inode;
 static int symlinknest;
 
+/*
+ * Most recently used extent tree index/leaf blocks. The extent tree of a
+ * large file is walked once per extent, and its index nodes are shared
+ * between all of those walks.
+ */
+#define EXT4_EXT_CACHE_NODES	4
+
+static struct ext4_ext_cache_node {
+	lbaint_t sector;		/* 0 if unused */
+	char *buf;
+} ext4_ext_cache[EXT4_EXT_CACHE_NODES];
+static int ext4_ext_cache_next;
+
 #if defined(CONFIG_EXT4_WRITE)
 struct ext2_block_group *ext4fs_get_group_descriptor
 	(const struct ext_filesystem *fs, uint32_t bg_idx)
@@ -208,6 +222,8 @@ void put_ext4(uint64_t off, void *buf, uint32_t size)
 	if (fs->dev_desc == NULL)
 		return;
 
+	ext4fs_ext_cache_invalidate();
+
 	if ((startblock + (size >> log2blksz)) >
 	    (part_offset + fs->total_sect)) {
 		printf("part_offset is " LBAFU "\n", part_offset);
@@ -1509,9 +1525,54 @@ void ext4fs_allocate_blocks(struct ext2_inode *file_inode,
 
 #endif
 
+void ext4fs_ext_cache_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < EXT4_EXT_CACHE_NODES; i++)
+		ext4_ext_cache[i].sector = 0;
+}
+
+static void ext4fs_ext_cache_free(void)
+{
+	int i;
+
+	for (i = 0; i < EXT4_EXT_CACHE_NODES; i++) {
+		free(ext4_ext_cache[i].buf);
+		ext4_ext_cache[i].buf = NULL;
+		ext4_ext_cache[i].sector = 0;
+	}
+	ext4_ext_cache_next = 0;
+}
+
+/* Read an extent tree node, returning a cached copy where possible */
+static char *ext4fs_ext_cache_read(lbaint_t sector, int blksz)
+{
+	struct ext4_ext_cache_node *node;
+	int i;
+
+	for (i = 0; i < EXT4_EXT_CACHE_NODES; i++) {
+		if (ext4_ext_cache[i].sector == sector)
+			return ext4_ext_cache[i].buf;
+	}
+
+	node = &ext4_ext_cache[ext4_ext_cache_next];
+	if (!node->buf) {
+		node->buf = malloc(blksz);
+		if (!node->buf)
+			return NULL;
+	}
+	node->sector = 0;
+	if (!ext4fs_devread(sector, 0, blksz, node->buf))
+		return NULL;
+	node->sector = sector;
+	ext4_ext_cache_next = (ext4_ext_cache_next + 1) % EXT4_EXT_CACHE_NODES;
+
+	return node->buf;
+}
+
 static struct ext4_extent_header *ext4fs_get_extent_block
-	(struct ext2_data *data, char *buf,
-		struct ext4_extent_header *ext_block,
+	(struct ext2_data *data, struct ext4_extent_header *ext_block,
 		uint32_t fileblock, int log2_blksz)
 {
 	struct ext4_extent_idx *index;
@@ -1540,10 +1601,10 @@ static struct ext4_extent_header *ext4fs_get_extent_block
 		block = le16_to_cpu(index[i].ei_leaf_hi);
 		block = (block << 32) + le32_to_cpu(index[i].ei_leaf_lo);
 
-		if (ext4fs_devread((lbaint_t)block << log2_blksz, 0, blksz,
-				   buf))
-			ext_block = (struct ext4_extent_header *)buf;
-		else
+		ext_block = (struct ext4_extent_header *)
+			ext4fs_ext_cache_read((lbaint_t)block << log2_blksz,
+					      blksz);
+		if (!ext_block)
 			return NULL;
 	}
 }
@@ -1601,6 +1662,80 @@ int ext4fs_read_inode(struct ext2_data *data, int ino, struct ext2_inode *inode)
 	return 1;
 }
 
+/*
+ * Map @fileblock of an extent-mapped inode. On return *@lenp holds the
+ * number of following blocks, at most @maxblocks, which are either
+ * physically contiguous or all part of the same hole.
+ */
+static long int ext4fs_map_extent(struct ext2_inode *inode, int fileblock,
+				  int maxblocks, int *lenp)
+{
+	struct ext4_extent_header *ext_block;
+	struct ext4_extent *extent;
+	long int startblock, endblock;
+	unsigned long long start;
+	int log2_blksz;
+	int i;
+
+	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
+		- get_fs()->dev_desc->log2blksz;
+	ext_block = ext4fs_get_extent_block(ext4fs_root,
+					    (struct ext4_extent_header *)
+					    inode->b.blocks.dir_blocks,
+					    fileblock, log2_blksz);
+	if (!ext_block) {
+		printf("invalid extent block\n");
+		return -EINVAL;
+	}
+
+	/* Unless proven otherwise, this is a single-block hole */
+	*lenp = 1;
+	extent = (struct ext4_extent *)(ext_block + 1);
+
+	for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
+		startblock = le32_to_cpu(extent[i].ee_block);
+		endblock = startblock + le16_to_cpu(extent[i].ee_len);
+
+		if (startblock > fileblock) {
+			/* Sparse file */
+			*lenp = min_t(long int, startblock - fileblock,
+				      maxblocks);
+			return 0;
+
+		} else if (fileblock < endblock) {
+			start = le16_to_cpu(extent[i].ee_start_hi);
+			start = (start << 32) +
+				le32_to_cpu(extent[i].ee_start_lo);
+			*lenp = min_t(long int, endblock - fileblock,
+				      maxblocks);
+			return (fileblock - startblock) + start;
+		}
+	}
+
+	return 0;
+}
+
+long int ext4fs_map_blocks(struct ext2_inode *inode, int fileblock,
+			   int maxblocks, int *lenp)
+{
+	long int blknr, next;
+	int len;
+
+	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL)
+		return ext4fs_map_extent(inode, fileblock, maxblocks, lenp);
+
+	/* Indirect maps: the map blocks are cached, so just probe ahead */
+	blknr = read_allocated_block(inode, fileblock);
+	for (len = 1; blknr > 0 && len < maxblocks; len++) {
+		next = read_allocated_block(inode, fileblock + len);
+		if (next != blknr + len)
+			break;
+	}
+	*lenp = len;
+
+	return blknr;
+}
+
 long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 {
 	long int blknr;
@@ -1610,53 +1745,15 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
 	long int rblock;
 	long int perblock_parent;
 	long int perblock_child;
-	unsigned long long start;
 	/* get the blocksize of the filesystem */
 	blksz = EXT2_BLOCK_SIZE(ext4fs_root);
 	log2_blksz = LOG2_BLOCK_SIZE(ext4fs_root)
 		- get_fs()->dev_desc->log2blksz;
 
 	if (le32_to_cpu(inode->flags) & EXT4_EXTENTS_FL) {
-		long int startblock, endblock;
-		char *buf = zalloc(blksz);
-		if (!buf)
-			return -ENOMEM;
-		struct ext4_extent_header *ext_block;
-		struct ext4_extent *extent;
-		int i;
-		ext_block =
-			ext4fs_get_extent_block(ext4fs_root, buf,
-						(struct ext4_extent_header *)
-						inode->b.blocks.dir_blocks,
-						fileblock, log2_blksz);
-		if (!ext_block) {
-			printf("invalid extent block\n");
-			free(buf);
-			return -EINVAL;
-		}
-
-		extent = (struct ext4_extent *)(ext_block + 1);
-
-		for (i = 0; i < le16_to_cpu(ext_block->eh_entries); i++) {
-			startblock = le32_to_cpu(extent[i].ee_block);
-			endblock = startblock + le16_to_cpu(extent[i].ee_len);
-
-			if (startblock > fileblock) {
-				/* Sparse file */
-				free(buf);
-				return 0;
-
-			} else if (fileblock < endblock) {
-				start = le16_to_cpu(extent[i].ee_start_hi);
-				start = (start << 32) +
-					le32_to_cpu(extent[i].ee_start_lo);
-				free(buf);
-				return (fileblock - startblock) + start;
-			}
-		}
+		int len;
 
-		free(buf);
-		return 0;
+		return ext4fs_map_extent(inode, fileblock, 1, &len);
 	}
 
 	/* Direct blocks. */
@@ -1958,6 +2055,7 @@ long int read_allocated_block(struct ext2_inode *inode, int fileblock)
  */
 void ext4fs_reinit_global(void)
 {
+	ext4fs_ext_cache_free();
 	if (ext4fs_indir1_block != NULL) {
 		free(ext4fs_indir1_block);
 		ext4fs_indir1_block = NULL;
@@ -1991,6 +2089,9 @@ void ext4fs_close(void)
 	ext4fs_reinit_global();
 }
 
+/* Set when ext4fs_iterate_dir() has read a whole directory */
+static int ext4fs_dir_scanned;
+
 int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 				struct ext2fs_node **fnode, int *ftype)
 {
@@ -2123,6 +2224,7 @@ int ext4fs_iterate_dir(struct ext2fs_node *dir, char *name,
 		}
 		fpos += le16_to_cpu(dirent.direntlen);
 	}
+	ext4fs_dir_scanned = 1;
 	return 0;
 }
 
@@ -2282,6 +2384,114 @@ int ext4fs_find_file(const char *path, struct ext2fs_node *rootnode,
 	return 1;
 }
 
+/* Record kept in the lookup cache for each path */
+struct ext4fs_dcache_ent {
+	int ino;
+	int type;
+};
+
+static int ext4fs_dcache_get(const char *path, struct ext2fs_node **nodep,
+			     int expecttype)
+{
+	struct ext4fs_dcache_ent ent;
+	struct ext2fs_node *node;
+	int ret;
+
+	ret = fs_dcache_lookup(path, &ent, sizeof(ent));
+	if (ret <= 0)
+		return ret;
+	if (ent.type != expecttype)
+		return -ENOENT;
+
+	node = malloc(sizeof(struct ext2fs_node));
+	if (!node)
+		return -ENOMEM;
+	node->data = ext4fs_root;
+	node->ino = ent.ino;
+	node->inode_read = 0;
+	*nodep = node;
+
+	return 1;
+}
+
+/*
+ * Cache the result of a lookup. A failed lookup is only cached when the
+ * last directory searched was read to its end, not after an error.
+ */
+static void ext4fs_dcache_put(const char *path, struct ext2fs_node *node,
+			      int type)
+{
+	struct ext4fs_dcache_ent ent;
+
+	if (!node) {
+		if (ext4fs_dir_scanned)
+			fs_dcache_add(path, NULL, 0);
+		return;
+	}
+	ent.ino = node->ino;
+	ent.type = type;
+	fs_dcache_add(path, &ent, sizeof(ent));
+}
+
+/*
+ * Look up a regular file through the lookup cache. A miss is resolved in
+ * two steps, first the directory holding the file and then the file
+ * itself, so that other files in the same directory can start from the
+ * cached directory.
+ */
+static int ext4fs_find_file_cached(const char *filename,
+				   struct ext2fs_node **foundnode)
+{
+	struct ext2fs_node *root = &ext4fs_root->diropen;
+	struct ext2fs_node *dir = root;
+	char path[strlen(filename) + 1];
+	char *name, *leaf;
+	int status;
+
+	while (*filename == '/')
+		filename++;
+	strcpy(path, filename);
+
+	status = ext4fs_dcache_get(path, foundnode, FILETYPE_REG);
+	if (status)
+		return status > 0;
+
+	name = path;
+	leaf = strrchr(path, '/');
+	if (leaf && leaf[1]) {
+		*leaf = '\0';
+		status = ext4fs_dcache_get(path, &dir, FILETYPE_DIRECTORY);
+		if (!status) {
+			dir = NULL;
+			ext4fs_dir_scanned = 0;
+			status = ext4fs_find_file(path, root, &dir,
+						  FILETYPE_DIRECTORY);
+			if (!status)
+				ext4fs_free_node(dir, root);
+			ext4fs_dcache_put(path, status ? dir : NULL,
+					  FILETYPE_DIRECTORY);
+		}
+		*leaf = '/';
+		if (status <= 0) {
+			/* No directory, so no file either, unless it failed */
+			if (status == -ENOENT)
+				fs_dcache_add(path, NULL, 0);
+			else if (!status)
+				ext4fs_dcache_put(path, NULL, FILETYPE_REG);
+			return 0;
+		}
+		name = leaf + 1;
+	}
+
+	*foundnode = NULL;
+	ext4fs_dir_scanned = 0;
+	status = ext4fs_find_file(name, dir, foundnode, FILETYPE_REG);
+	ext4fs_dcache_put(path, status ? *foundnode : NULL, FILETYPE_REG);
+	ext4fs_free_node(dir, root);
+
+	return status;
+}
+
 int ext4fs_open(const char *filename, loff_t *len)
 {
 	struct ext2fs_node *fdiro = NULL;
@@ -2290,9 +2500,15 @@ int ext4fs_open(const char *filename, loff_t *len)
 	if (ext4fs_root == NULL)
 		return -1;
 
+	/* A file may still be open if the filesystem was not closed */
+	if (ext4fs_file)
+		ext4fs_free_node(ext4fs_file, &ext4fs_root->diropen);
 	ext4fs_file = NULL;
-	status = ext4fs_find_file(filename, &ext4fs_root->diropen, &fdiro,
-				  FILETYPE_REG);
+	if (CONFIG_IS_ENABLED(FS_DCACHE))
+		status = ext4fs_find_file_cached(filename, &fdiro);
+	else
+		status = ext4fs_find_file(filename, &ext4fs_root->diropen,
+					  &fdiro, FILETYPE_REG);
 	if (status == 0)
 		goto fail;
 
@@ -26,6 +26,7 @@
 #include <memalign.h>
 #include <linux/stat.h>
 #include <div64.h>
+#include <fs.h>
 #include "ext4_common.h"
 
 static inline void ext4fs_sb_free_inodes_inc(struct ext2_sblock *sb)
@@ -1009,6 +1010,7 @@ int ext4_write_file(const char *filename, void *buf, loff_t offset,
 		return -1;
 	}
 
+	fs_dcache_invalidate();
 	ret = ext4fs_write(filename, buf, len);
 	if (ret) {
 		printf("** Error ext4fs_write() **\n");
@@ -50,18 +50,18 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		loff_t len, char *buf, loff_t *actread)
 {
 	struct ext_filesystem *fs = get_fs();
-	int i;
-	lbaint_t blockcnt;
+	int i, run;
+	lbaint_t blockcnt, firstblock;
 	int log2blksz = fs->dev_desc->log2blksz;
 	int log2_fs_blocksize = LOG2_BLOCK_SIZE(node->data) - log2blksz;
 	int blocksize = (1 << (log2_fs_blocksize + log2blksz));
 	unsigned int filesize = le32_to_cpu(node->inode.size);
-	lbaint_t previous_block_number = -1;
 	lbaint_t delayed_start = 0;
 	lbaint_t delayed_extent = 0;
 	lbaint_t delayed_skipfirst = 0;
 	lbaint_t delayed_next = 0;
 	char *delayed_buf = NULL;
+	int delayed = 0;
 	short status;
 
 	/* Adjust len so it we can't read past the end of the file. */
@@ -69,65 +69,59 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 		len = (filesize - pos);
 
 	blockcnt = lldiv(((len + pos) + blocksize - 1), blocksize);
-
-	for (i = lldiv(pos, blocksize); i < blockcnt; i++) {
+	firstblock = lldiv(pos, blocksize);
+
+	/*
+	 * Map whole runs of blocks at a time, so that the extent tree is
+	 * walked once per extent, and read each physically contiguous run
+	 * with a single ext4fs_devread().
+	 */
+	for (i = firstblock; i < blockcnt; i += run) {
 		lbaint_t blknr;
-		int blockoff = pos - (blocksize * i);
-		int blockend = blocksize;
+		long int ret;
 		int skipfirst = 0;
-		blknr = read_allocated_block(&(node->inode), i);
-		if (blknr < 0)
-			return -1;
+		lbaint_t bytes;
 
-		blknr = blknr << log2_fs_blocksize;
-
-		/* Last block.  */
-		if (i == blockcnt - 1) {
-			blockend = (len + pos) - (blocksize * i);
+		ret = ext4fs_map_blocks(&node->inode, i, blockcnt - i, &run);
+		if (ret < 0)
+			return -1;
 
-			/* The last portion is exactly blocksize. */
-			if (!blockend)
-				blockend = blocksize;
-		}
+		blknr = (lbaint_t)ret << log2_fs_blocksize;
+		bytes = (lbaint_t)run * blocksize;
 
 		/* First block. */
-		if (i == lldiv(pos, blocksize)) {
-			skipfirst = blockoff;
-			blockend -= skipfirst;
+		if (i == firstblock) {
+			skipfirst = pos - ((loff_t)blocksize * i);
+			bytes -= skipfirst;
 		}
+
+		/* Last block.  */
+		if (i + run == blockcnt)
+			bytes -= (loff_t)blocksize * blockcnt - (len + pos);
+
 		if (blknr) {
-			int status;
-
-			if (previous_block_number != -1) {
-				if (delayed_next == blknr) {
-					delayed_extent += blockend;
-					delayed_next += blockend >> log2blksz;
-				} else {	/* spill */
-					status = ext4fs_devread(delayed_start,
+			if (delayed && delayed_next == blknr) {
+				delayed_extent += bytes;
+				delayed_next += run << log2_fs_blocksize;
+				buf += bytes;
+				continue;
+			}
+			if (delayed) {	/* spill */
+				status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
 							delayed_extent,
 							delayed_buf);
-					if (status == 0)
-						return -1;
-					previous_block_number = blknr;
-					delayed_start = blknr;
-					delayed_extent = blockend;
-					delayed_skipfirst = skipfirst;
-					delayed_buf = buf;
-					delayed_next = blknr +
-						(blockend >> log2blksz);
-				}
-			} else {
-				previous_block_number = blknr;
-				delayed_start = blknr;
-				delayed_extent = blockend;
-				delayed_skipfirst = skipfirst;
-				delayed_buf = buf;
-				delayed_next = blknr +
-					(blockend >> log2blksz);
+				if (status == 0)
+					return -1;
 			}
+			delayed = 1;
+			delayed_start = blknr;
+			delayed_extent = bytes;
+			delayed_skipfirst = skipfirst;
+			delayed_buf = buf;
+			delayed_next = blknr + (run << log2_fs_blocksize);
 		} else {
-			if (previous_block_number != -1) {
+			if (delayed) {
 				/* spill */
 				status = ext4fs_devread(delayed_start,
 							delayed_skipfirst,
@@ -135,20 +129,19 @@ int ext4fs_read_file(struct ext2fs_node *node, loff_t pos,
 							delayed_buf);
 				if (status == 0)
 					return -1;
-				previous_block_number = -1;
+				delayed = 0;
 			}
-			memset(buf, 0, blocksize - skipfirst);
+			memset(buf, 0, bytes);
 		}
-		buf += blocksize - skipfirst;
+		buf += bytes;
 	}
-	if (previous_block_number != -1) {
+	if (delayed) {
 		/* spill */
 		status = ext4fs_devread(delayed_start,
 					delayed_skipfirst, delayed_extent,
 					delayed_buf);
 		if (status == 0)
 			return -1;
-		previous_block_number = -1;
 	}
 
 	*actread  = len;
@@ -14,6 +14,7 @@
 #include <config.h>
 #include <exports.h>
 #include <fat.h>
+#include <fs.h>
 #include <asm/byteorder.h>
 #include <part.h>
 #include <malloc.h>
@@ -66,6 +67,7 @@ int fat_set_blk_dev(struct blk_desc *dev_desc, disk_partition_t *info)
 
 	cur_dev = dev_desc;
 	cur_part_info = *info;
+	fs_dcache_set_dev(dev_desc, info->start);
 
 	/* Make sure it has a valid FAT header */
 	if (disk_read(0, 1, buffer) != 1) {
@@ -172,6 +174,84 @@ int flush_dirty_fat_buffer(fsdata *mydata)
 }
 #endif
 
+/*
+ * Allocate the FAT window cache. The first window becomes the current
+ * FAT buffer. The windows only last for one do_fat_read_at() call, which
+ * frees them with fat_free_buffers() on the way out.
+ */
+static int fat_alloc_buffers(fsdata *mydata)
+{
+	int i;
+
+	mydata->fatbufnum = -1;
+	mydata->fat_dirty = 0;
+	mydata->fatcachenext = 0;
+	for (i = 0; i < FATBUFWINDOWS; i++)
+		mydata->fatcachenum[i] = -1;
+	mydata->fatcache = memalign(ARCH_DMA_MINALIGN,
+				    FATBUFSIZE * FATBUFWINDOWS);
+	mydata->fatbuf = mydata->fatcache;
+
+	return mydata->fatcache ? 0 : -1;
+}
+
+static void fat_free_buffers(fsdata *mydata)
+{
+	free(mydata->fatcache);
+	mydata->fatcache = NULL;
+	mydata->fatbuf = NULL;
+}
+
+/*
+ * Make window 'bufnum' of the FAT the current FAT buffer, reading it from
+ * disk unless it is still cached. Only the current buffer can be dirty,
+ * so it is written back before switching.
+ * Return 0 on success, -1 otherwise.
+ */
+static int fat_load_buffer(fsdata *mydata, __u32 bufnum)
+{
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 fatlength = mydata->fatlength;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	int i;
+
+	if (bufnum == mydata->fatbufnum)
+		return 0;
+
+	/* Write back the fatbuf to the disk */
+	if (flush_dirty_fat_buffer(mydata) < 0)
+		return -1;
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		if (mydata->fatcachenum[i] == bufnum) {
+			mydata->fatbuf = mydata->fatcache + i * FATBUFSIZE;
+			mydata->fatbufnum = bufnum;
+			return 0;
+		}
+	}
+
+	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+	if (startblock + getsize > fatlength)
+		getsize = fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	i = mydata->fatcachenext;
+	mydata->fatcachenext = (i + 1) % FATBUFWINDOWS;
+	mydata->fatcachenum[i] = -1;
+	mydata->fatbuf = mydata->fatcache + i * FATBUFSIZE;
+	mydata->fatbufnum = -1;
+
+	if (disk_read(startblock, getsize, mydata->fatbuf) < 0) {
+		debug("Error reading FAT blocks\n");
+		return -1;
+	}
+	mydata->fatcachenum[i] = bufnum;
+	mydata->fatbufnum = bufnum;
+
+	return 0;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -210,28 +290,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	       mydata->fatsize, entry, entry, offset, offset);
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	if (fat_load_buffer(mydata, bufnum) < 0)
+		return ret;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
@@ -256,6 +316,67 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	return ret;
 }
 
+__u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
+	__aligned(ARCH_DMA_MINALIGN);
+
+/*
+ * The file last read and where in its cluster chain that read stopped, so
+ * that reading a file in pieces (see fs_read_gz()) neither looks it up
+ * again nor walks its cluster chain from the start for every piece. It is
+ * only used on the same partition and while nothing has been written to
+ * the device, and is dropped by fat_invalidate_open_file() when the device
+ * is (re)initialised.
+ */
+static struct {
+	struct blk_desc *dev;
+	lbaint_t part_start;
+	unsigned int write_gen;
+	char *path;		/* NULL if no file is held */
+	dir_entry dent;
+	__u32 clust;		/* Cluster at offset 'clustpos' of the file */
+	loff_t clustpos;
+} fat_open_file;
+
+static dir_entry *fat_open_file_get(const char *path)
+{
+	if (!fat_open_file.path || fat_open_file.dev != cur_dev ||
+	    fat_open_file.part_start != cur_part_info.start ||
+	    fat_open_file.write_gen != cur_dev->write_gen ||
+	    strcmp(fat_open_file.path, path))
+		return NULL;
+
+	return &fat_open_file.dent;
+}
+
+static void fat_open_file_set(fsdata *mydata, const char *path,
+			      dir_entry *dentptr)
+{
+	free(fat_open_file.path);
+	fat_open_file.path = strdup(path);
+	fat_open_file.dev = cur_dev;
+	fat_open_file.part_start = cur_part_info.start;
+	fat_open_file.write_gen = cur_dev->write_gen;
+	fat_open_file.dent = *dentptr;
+	fat_open_file.clust = START(dentptr);
+	fat_open_file.clustpos = 0;
+}
+
+void fat_invalidate_open_file(void)
+{
+	free(fat_open_file.path);
+	memset(&fat_open_file, '\0', sizeof(fat_open_file));
+}
+
+/* Remember that cluster 'clust' is at offset 'clustpos' of the file */
+static void fat_open_file_seek(fsdata *mydata, dir_entry *dentptr,
+			       __u32 clust, loff_t clustpos)
+{
+	if (fat_open_file.path && START(&fat_open_file.dent) == START(dentptr)) {
+		fat_open_file.clust = clust;
+		fat_open_file.clustpos = clustpos;
+	}
+}
+
 /*
  * Read at most 'size' bytes from the specified cluster into 'buffer'.
  * Return 0 on success, -1 otherwise.
@@ -277,20 +398,26 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	debug("gc - clustnum: %d, startsect: %d\n", clustnum, startsect);
 
 	if ((unsigned long)buffer & (ARCH_DMA_MINALIGN - 1)) {
-		ALLOC_CACHE_ALIGN_BUFFER(__u8, tmpbuf, mydata->sect_size);
+		__u8 *tmpbuf = get_contents_vfatname_block;
+		__u32 maxsect = MAX_CLUSTSIZE / mydata->sect_size;
 
 		printf("FAT: Misaligned buffer address (%p)\n", buffer);
 
+		/* Bounce through the cluster buffer, as much as fits */
 		while (size >= mydata->sect_size) {
-			ret = disk_read(startsect++, 1, tmpbuf);
-			if (ret != 1) {
+			idx = min_t(unsigned long, size / mydata->sect_size,
+				    maxsect);
+			ret = disk_read(startsect, idx, tmpbuf);
+			if (ret != idx) {
 				debug("Error reading data (got %d)\n", ret);
 				return -1;
 			}
 
-			memcpy(buffer, tmpbuf, mydata->sect_size);
-			buffer += mydata->sect_size;
-			size -= mydata->sect_size;
+			startsect += idx;
+			idx *= mydata->sect_size;
+			memcpy(buffer, tmpbuf, idx);
+			buffer += idx;
+			size -= idx;
 		}
 	} else {
 		idx = size / mydata->sect_size;
@@ -324,9 +451,6 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
  * into 'buffer'.
  * Update the number of bytes read in *gotsize or return -1 on fatal errors.
  */
-__u8 get_contents_vfatname_block[MAX_CLUSTSIZE]
-	__aligned(ARCH_DMA_MINALIGN);
-
 static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 			__u8 *buffer, loff_t maxsize, loff_t *gotsize)
 {
@@ -334,7 +458,7 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 	__u32 curclust = START(dentptr);
 	__u32 endclust, newclust;
-	loff_t actsize;
+	loff_t actsize, clustpos;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -351,6 +475,14 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	actsize = bytesperclust;
 
+	/* Carry on from where the last read of this file stopped */
+	if (fat_open_file.path &&
+	    START(&fat_open_file.dent) == START(dentptr) &&
+	    fat_open_file.clustpos <= pos) {
+		curclust = fat_open_file.clust;
+		actsize += fat_open_file.clustpos;
+	}
+
 	/* go to cluster at pos */
 	while (actsize <= pos) {
 		curclust = get_fatent(mydata, curclust);
@@ -364,6 +496,7 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	/* actsize > pos */
 	actsize -= bytesperclust;
+	clustpos = actsize;
 	filesize -= actsize;
 	pos -= actsize;
 
@@ -371,7 +504,7 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 	if (pos) {
 		actsize = min(filesize, (loff_t)bytesperclust);
 		if (get_cluster(mydata, curclust, get_contents_vfatname_block,
-				(int)actsize) != 0) {
+				actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
@@ -379,6 +512,7 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 		actsize -= pos;
 		memcpy(buffer, get_contents_vfatname_block + pos, actsize);
 		*gotsize += actsize;
+		fat_open_file_seek(mydata, dentptr, curclust, clustpos);
 		if (!filesize)
 			return 0;
 		buffer += actsize;
@@ -389,6 +523,7 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 			debug("Invalid FAT entry\n");
 			return 0;
 		}
+		clustpos += bytesperclust;
 	}
 
 	actsize = bytesperclust;
@@ -411,20 +546,23 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 		/* get remaining bytes */
 		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		if (get_cluster(mydata, curclust, buffer, actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
 		*gotsize += actsize;
+		fat_open_file_seek(mydata, dentptr, endclust, clustpos +
+				   (loff_t)(endclust - curclust) * bytesperclust);
 		return 0;
 getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+		if (get_cluster(mydata, curclust, buffer, actsize) != 0) {
 			printf("Error reading cluster\n");
 			return -1;
 		}
-		*gotsize += (int)actsize;
+		*gotsize += actsize;
 		filesize -= actsize;
 		buffer += actsize;
+		clustpos += actsize;
 
 		curclust = get_fatent(mydata, endclust);
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
@@ -432,6 +570,7 @@ getit:
 			printf("Invalid FAT entry\n");
 			return 0;
 		}
+		fat_open_file_seek(mydata, dentptr, curclust, clustpos);
 		actsize = bytesperclust;
 		endclust = curclust;
 	} while (1);
@@ -572,16 +711,22 @@ static __u8 mkcksum(const char name[8], const char ext[3])
 	return ret;
 }
 
+/* True if cluster number 'x' ends a chain, as opposed to being invalid */
+#define CLUST_IS_EOC(x, fatsize) ((x) >= ((fatsize) != 32 ? \
+				  ((fatsize) != 16 ? 0xff8 : 0xfff8) : \
+				  0xffffff8))
+
 /*
  * Get the directory entry associated with 'filename' from the directory
- * starting at 'startsect'
+ * starting at 'startsect'. If it is not there, *notfound is set when the
+ * whole directory was read, and left alone on errors.
  */
 __u8 get_dentfromdir_block[MAX_CLUSTSIZE]
 	__aligned(ARCH_DMA_MINALIGN);
 
 static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 				  char *filename, dir_entry *retdent,
-				  int dols)
+				  int dols, int *notfound)
 {
 	__u16 prevcksum = 0xffff;
 	__u32 curclust = START(retdent);
@@ -664,6 +809,7 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 						files, dirs);
 				}
 				debug("Dentname == NULL - %d\n", i);
+				*notfound = 1;
 				return NULL;
 			}
 			if (vfat_enabled) {
@@ -730,6 +876,8 @@ static dir_entry *get_dentfromdir(fsdata *mydata, int startsect,
 		if (CHECK_CLUST(curclust, mydata->fatsize)) {
 			debug("curclust: 0x%x\n", curclust);
 			printf("Invalid FAT entry\n");
+			if (CLUST_IS_EOC(curclust, mydata->fatsize))
+				*notfound = 1;
 			return NULL;
 		}
 	}
@@ -833,6 +981,10 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	int buffer_blk_cnt;
 	int do_read;
 	__u8 *dir_ptr;
+	dir_entry dcache_dent;
+	char *dcache_path = NULL;	/* full path, if lookups are cached */
+	char *dcache_leaf = NULL;	/* last '/' in dcache_path */
+	int notfound = 0;
 
 	if (read_bootsectandvi(&bs, &volinfo, &mydata->fatsize)) {
 		debug("Error: reading boot sector\n");
@@ -872,10 +1024,7 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 					(mydata->clust_size * 2);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	if (fat_alloc_buffers(mydata) < 0) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
@@ -901,6 +1050,49 @@ int do_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	strcpy(fnamecopy, filename);
 	downcase(fnamecopy);
 
+	/* Reading on from the file last read needs no lookup */
+	if (!dols) {
+		dentptr = fat_open_file_get(filename);
+		if (dentptr)
+			goto file_found;
+	}
+
+	/*
+	 * Try the lookup cache for the file itself, then for its directory.
+	 * Paths with backslashes or a trailing delimiter are not cached.
+	 */
+	if (CONFIG_IS_ENABLED(FS_DCACHE) && !dols && *fnamecopy &&
+	    !strchr(fnamecopy, '\\') &&
+	    fnamecopy[strlen(fnamecopy) - 1] != '/') {
+		int found;
+
+		found = fs_dcache_lookup(fnamecopy, &dcache_dent,
+					 sizeof(dcache_dent));
+		if (found == -ENOENT)
+			goto exit;
+		if (found > 0) {
+			dentptr = &dcache_dent;
+			goto file_found;
+		}
+
+		dcache_path = strdup(fnamecopy);
+		if (dcache_path)
+			dcache_leaf = strrchr(dcache_path, '/');
+		if (dcache_leaf) {
+			*dcache_leaf = '\0';
+			found = fs_dcache_lookup(dcache_path, &dcache_dent,
+						 sizeof(dcache_dent));
+			*dcache_leaf = '/';
+			if (found > 0) {
+				dentptr = &dcache_dent;
+				subname = fnamecopy + (dcache_leaf + 1 -
+						       dcache_path);
+				isdir = 1;
+				goto rootdir_done;
+			}
+		}
+	}
+
 root_reparse:
 	if (*fnamecopy == '\0') {
 		if (!dols)
@@ -1040,6 +1232,7 @@ root_reparse:
 						files, dirs);
 					ret = 0;
 				}
+				notfound = 1;
 				goto exit;
 			}
 			else if (vfat_enabled &&
@@ -1091,8 +1284,10 @@ root_reparse:
 				continue;
 			}
 
-			if (isdir && !(dentptr->attr & ATTR_DIR))
+			if (isdir && !(dentptr->attr & ATTR_DIR)) {
+				notfound = 1;
 				goto exit;
+			}
 
 			debug("RootName: %s", s_name);
 			debug(", start: 0x%x", START(dentptr));
@@ -1143,6 +1338,9 @@ root_reparse:
 				       files, dirs);
 				*size = 0;
 			}
+			/* A broken cluster chain is an error, not a miss */
+			notfound = mydata->fatsize != 32 ||
+				   CLUST_IS_EOC(root_cluster, 32);
 			goto exit;
 		}
 	}
@@ -1177,15 +1375,24 @@ rootdir_done:
 			}
 		}
 
+		/* Remember the directory holding the file */
+		if (dcache_leaf && !isdir) {
+			*dcache_leaf = '\0';
+			fs_dcache_add(dcache_path, &dent, sizeof(dent));
+			*dcache_leaf = '/';
+		}
+
 		if (get_dentfromdir(mydata, startsect, subname, dentptr,
-				     isdir ? 0 : dols) == NULL) {
+				     isdir ? 0 : dols, &notfound) == NULL) {
 			if (dols && !isdir)
 				*size = 0;
 			goto exit;
 		}
 
-		if (isdir && !(dentptr->attr & ATTR_DIR))
+		if (isdir && !(dentptr->attr & ATTR_DIR)) {
+			notfound = 1;
 			goto exit;
+		}
 
 		/*
 		 * If we are looking for a directory, and found a directory
@@ -1212,6 +1419,10 @@ rootdir_done:
 			subname = "";
 			cursect = mydata->rootdir_sect;
 			isdir = 0;
+			/* The path went back through the root, don't cache */
+			free(dcache_path);
+			dcache_path = NULL;
+			dcache_leaf = NULL;
 			goto root_reparse;
 		}
 
@@ -1219,6 +1430,13 @@ rootdir_done:
 			subname = nextname;
 	}
 
+	if (dcache_path)
+		fs_dcache_add(dcache_path, dentptr, sizeof(*dentptr));
+
+file_found:
+	if (!dols && dentptr != &fat_open_file.dent)
+		fat_open_file_set(mydata, filename, dentptr);
+
 	if (dogetsize) {
 		*size = FAT2CPU32(dentptr->size);
 		ret = 0;
@@ -1228,7 +1446,10 @@ rootdir_done:
 	debug("Size: %u, got: %llu\n", FAT2CPU32(dentptr->size), *size);
 
 exit:
-	free(mydata->fatbuf);
+	if (dcache_path && notfound)
+		fs_dcache_add(dcache_path, NULL, 0);
+	free(dcache_path);
+	fat_free_buffers(mydata);
 	return ret;
 }
 
@@ -387,27 +387,8 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 	}
 
 	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		startblock += mydata->fat_sect;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	if (fat_load_buffer(mydata, bufnum) < 0)
+		return -1;
 
 	/* Mark as dirty */
 	mydata->fat_dirty = 1;
@@ -958,10 +939,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 					(mydata->clust_size * 2);
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = memalign(ARCH_DMA_MINALIGN, FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
+	if (fat_alloc_buffers(mydata) < 0) {
 		debug("Error: allocating memory\n");
 		return -1;
 	}
@@ -1073,7 +1051,7 @@ static int do_fat_write(const char *filename, void *buffer, loff_t size,
 		printf("Error: writing directory entry\n");
 
 exit:
-	free(mydata->fatbuf);
+	fat_free_buffers(mydata);
 	return ret;
 }
 
@@ -1086,5 +1064,6 @@ int file_fat_write(const char *filename, void *buffer, loff_t offset,
 	}
 
 	printf("writing %s\n", filename);
+	fs_dcache_invalidate();
 	return do_fat_write(filename, buffer, maxsize, actwrite);
 }
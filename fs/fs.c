@@ -321,6 +321,7 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	void *buf;
 	int ret;
 
+	fs_dcache_invalidate();
 	buf = map_sysmem(addr, len);
 	ret = info->write(filename, buf, offset, len, actwrite);
 	unmap_sysmem(buf);
@@ -334,6 +335,71 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return ret;
 }
 
+#ifdef CONFIG_GZIP
+struct fs_gz_priv {
+	struct fstype_info *info;
+	const char *filename;
+	loff_t pos;
+	loff_t size;
+};
+
+/*
+ * The filesystem stays mounted from one chunk to the next. FAT carries on
+ * from the cluster where the previous chunk ended; ext4 maps each block
+ * through the extent tree.
+ */
+static int fs_gz_read(void *priv, void *buf, int size)
+{
+	struct fs_gz_priv *gz = priv;
+	loff_t actread;
+	int ret;
+
+	if (gz->pos >= gz->size)
+		return 0;
+	if (size > gz->size - gz->pos)
+		size = gz->size - gz->pos;
+
+	ret = gz->info->read(gz->filename, buf, gz->pos, size, &actread);
+	if (ret < 0)
+		return ret;
+
+	gz->pos += actread;
+
+	return actread;
+}
+
+int fs_read_gz(const char *filename, ulong addr, loff_t maxlen,
+	       loff_t *actread)
+{
+	struct fs_gz_priv gz = {
+		.info = fs_get_info(fs_type),
+		.filename = filename,
+	};
+	unsigned long len = 0;
+	void *buf;
+	int ret;
+
+	ret = gz.info->size(filename, &gz.size);
+	if (ret < 0) {
+		printf("** File not found %s **\n", filename);
+		fs_close();
+		return ret;
+	}
+
+	/* gunzip_stream() takes an int length */
+	if (!maxlen || maxlen > INT_MAX)
+		maxlen = INT_MAX;
+	buf = map_sysmem(addr, maxlen);
+	ret = gunzip_stream(buf, maxlen, fs_gz_read, &gz, &len);
+	unmap_sysmem(buf);
+
+	fs_close();
+	*actread = len;
+
+	return ret ? -EIO : 0;
+}
+#endif
+
 int do_size(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype)
 {
@@ -353,8 +419,8 @@ int do_size(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	return 0;
 }
 
-int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
-		int fstype)
+static int fs_do_load(cmd_tbl_t *cmdtp, int flag, int argc,
+		      char * const argv[], int fstype, bool gz)
 {
 	unsigned long addr;
 	const char *addr_str;
@@ -368,7 +434,7 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 
 	if (argc < 2)
 		return CMD_RET_USAGE;
-	if (argc > 7)
+	if (argc > (gz ? 6 : 7))
 		return CMD_RET_USAGE;
 
 	if (fs_set_blk_dev(argv[1], (argc >= 3) ? argv[2] : NULL, fstype))
@@ -404,7 +470,12 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		pos = 0;
 
 	time = get_timer(0);
-	ret = fs_read(filename, addr, pos, bytes, &len_read);
+#ifdef CONFIG_GZIP
+	if (gz)
+		ret = fs_read_gz(filename, addr, bytes, &len_read);
+	else
+#endif
+		ret = fs_read(filename, addr, pos, bytes, &len_read);
 	time = get_timer(time);
 	if (ret < 0)
 		return 1;
@@ -423,6 +494,20 @@ int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	return 0;
 }
 
+int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+		int fstype)
+{
+	return fs_do_load(cmdtp, flag, argc, argv, fstype, false);
+}
+
+#ifdef CONFIG_GZIP
+int do_gzload(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+		int fstype)
+{
+	return fs_do_load(cmdtp, flag, argc, argv, fstype, true);
+}
+#endif
+
 int do_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 	int fstype)
 {
@@ -0,0 +1,153 @@
+/*
+ * Cache of path lookups for the filesystem last selected by the fs layer
+ *
+ * Each entry maps a path to a small filesystem-specific record, such as
+ * a FAT directory entry or an ext4 inode number, or records that the
+ * path does not exist.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <fs.h>
+#include <malloc.h>
+
+struct fs_dcache_entry {
+	char *path;		/* NULL if unused */
+	u32 hash;
+	int size;		/* 0 if the path does not exist */
+	ulong used;		/* Time of last use, for LRU replacement */
+	u8 data[FS_DCACHE_DATA_MAX];
+};
+
+static struct fs_dcache_entry fs_dcache[CONFIG_FS_DCACHE_ENTRIES];
+static ulong fs_dcache_clock;
+static struct blk_desc *fs_dcache_desc;
+static int fs_dcache_hwpart;
+static lbaint_t fs_dcache_start;
+static unsigned int fs_dcache_gen;	/* write_gen of the device when filled */
+
+static u32 fs_dcache_hash(const char *path)
+{
+	u32 hash = 5381;
+
+	while (*path)
+		hash = hash * 33 + *path++;
+
+	return hash;
+}
+
+static struct fs_dcache_entry *fs_dcache_find(const char *path, u32 hash)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_FS_DCACHE_ENTRIES; i++) {
+		struct fs_dcache_entry *ent = &fs_dcache[i];
+
+		if (ent->path && ent->hash == hash && !strcmp(ent->path, path))
+			return ent;
+	}
+
+	return NULL;
+}
+
+void fs_dcache_invalidate(void)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_FS_DCACHE_ENTRIES; i++) {
+		free(fs_dcache[i].path);
+		fs_dcache[i].path = NULL;
+	}
+}
+
+void fs_dcache_set_dev(struct blk_desc *dev_desc, lbaint_t start)
+{
+	int hwpart = dev_desc ? dev_desc->hwpart : 0;
+
+	if (dev_desc == fs_dcache_desc && hwpart == fs_dcache_hwpart &&
+	    start == fs_dcache_start)
+		return;
+
+	fs_dcache_invalidate();
+	fs_dcache_desc = dev_desc;
+	fs_dcache_hwpart = hwpart;
+	fs_dcache_start = start;
+	fs_dcache_gen = dev_desc ? dev_desc->write_gen : 0;
+}
+
+/*
+ * Drop the cache if anything was written to the device since it was
+ * filled, whether through a filesystem or raw, e.g. by "mmc write", ums
+ * or fastboot
+ */
+static void fs_dcache_check_gen(void)
+{
+	if (!fs_dcache_desc || fs_dcache_desc->write_gen == fs_dcache_gen)
+		return;
+
+	debug("%s: device written, dropping cache\n", __func__);
+	fs_dcache_invalidate();
+	fs_dcache_gen = fs_dcache_desc->write_gen;
+}
+
+int fs_dcache_lookup(const char *path, void *data, int size)
+{
+	struct fs_dcache_entry *ent;
+
+	fs_dcache_check_gen();
+	ent = fs_dcache_find(path, fs_dcache_hash(path));
+	if (!ent) {
+		debug("%s: miss '%s'\n", __func__, path);
+		return 0;
+	}
+
+	ent->used = ++fs_dcache_clock;
+	if (!ent->size) {
+		debug("%s: '%s' does not exist\n", __func__, path);
+		return -ENOENT;
+	}
+	if (ent->size > size)
+		return 0;
+	memcpy(data, ent->data, ent->size);
+	debug("%s: hit '%s'\n", __func__, path);
+
+	return ent->size;
+}
+
+void fs_dcache_add(const char *path, const void *data, int size)
+{
+	struct fs_dcache_entry *ent;
+	u32 hash = fs_dcache_hash(path);
+	int i;
+
+	if (size > FS_DCACHE_DATA_MAX || !*path)
+		return;
+
+	fs_dcache_check_gen();
+
+	ent = fs_dcache_find(path, hash);
+	if (!ent) {
+		/* Use a free entry, or replace the least recently used one */
+		ent = &fs_dcache[0];
+		for (i = 0; i < CONFIG_FS_DCACHE_ENTRIES; i++) {
+			if (!fs_dcache[i].path) {
+				ent = &fs_dcache[i];
+				break;
+			}
+			if (fs_dcache[i].used < ent->used)
+				ent = &fs_dcache[i];
+		}
+		free(ent->path);
+		ent->path = strdup(path);
+		if (!ent->path)
+			return;
+		ent->hash = hash;
+	}
+
+	ent->used = ++fs_dcache_clock;
+	ent->size = data ? size : 0;
+	if (data)
+		memcpy(ent->data, data, size);
+}
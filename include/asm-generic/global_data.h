@@ -22,6 +22,7 @@
 
 #ifndef __ASSEMBLY__
 #include <membuff.h>
+#include <dm/stats.h>
 #include <linux/list.h>
 
 typedef struct global_data {
@@ -64,6 +65,16 @@ typedef struct global_data {
 	struct udevice	*dm_root;	/* Root instance for Driver Model */
 	struct udevice	*dm_root_f;	/* Pre-relocation root instance */
 	struct list_head uclass_root;	/* Head of core tree */
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct uclass	**uclass_table;	/* Uclasses by ID, or NULL if none */
+#endif
+#if CONFIG_IS_ENABLED(DM_COMPAT_HASH)
+	/* Drivers by compatible string, or NULL if not built yet */
+	struct driver_compat_table *driver_compat_table;
+#endif
+#if CONFIG_IS_ENABLED(DM_STATS)
+	struct dm_stats dm_stats;	/* Driver model statistics */
+#endif
 #endif
 #ifdef CONFIG_TIMER
 	struct udevice	*timer;		/* Timer instance for Driver Model */
@@ -62,6 +62,7 @@ struct blk_desc {
 	char		vendor[40+1];	/* IDE model, SCSI Vendor */
 	char		product[20+1];	/* IDE Serial no, SCSI product */
 	char		revision[8+1];	/* firmware revision */
+	unsigned int	write_gen;	/* bumped by each write and erase */
 #ifdef CONFIG_BLK
 	/*
 	 * For now we have a few functions which take struct blk_desc as a
@@ -134,10 +135,12 @@ void blkcache_invalidate(int iftype, int dev);
 /**
  * blkcache_configure() - configure block cache
  *
- * @param blocks - maximum blocks per entry
- * @param entries - maximum entries in cache
+ * Changing either limit discards all cached data.
+ *
+ * @param max_bytes - total size of the cache in bytes
+ * @param entry_bytes - maximum size in bytes of a single entry
  */
-void blkcache_configure(unsigned blocks, unsigned entries);
+void blkcache_configure(unsigned max_bytes, unsigned entry_bytes);
 
 /*
  * statistics of the block cache
@@ -145,9 +148,11 @@ void blkcache_configure(unsigned blocks, unsigned entries);
 struct block_cache_stats {
 	unsigned hits;
 	unsigned misses;
+	unsigned evictions;
 	unsigned entries; /* current entry count */
-	unsigned max_blocks_per_entry;
-	unsigned max_entries;
+	unsigned max_entries; /* max_bytes / entry_bytes */
+	unsigned max_bytes;
+	unsigned entry_bytes;
 };
 
 /**
@@ -177,6 +182,32 @@ static inline void blkcache_invalidate(int iftype, int dev) {}
 #ifdef CONFIG_BLK
 struct udevice;
 
+/**
+ * struct blk_req - an asynchronous block read
+ *
+ * Filled in by blk_read_submit(). A driver may split the request into
+ * several transfers, keeping one of them in flight at a time.
+ *
+ * @dev:	Block device being read
+ * @start:	Start block number to read (0=first)
+ * @blkcnt:	Number of blocks to read
+ * @buffer:	Destination buffer for data read
+ * @done:	Number of blocks read so far
+ * @cur:	Number of blocks in the transfer in flight (0 if none)
+ * @err:	Error from a finished transfer, or 0
+ * @busy:	true until blk_read_poll() has reported the result
+ */
+struct blk_req {
+	struct udevice *dev;
+	lbaint_t start;
+	lbaint_t blkcnt;
+	void *buffer;
+	lbaint_t done;
+	lbaint_t cur;
+	int err;
+	bool busy;
+};
+
 /* Operations on block devices */
 struct blk_ops {
 	/**
@@ -235,6 +266,34 @@ struct blk_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*select_hwpart)(struct udevice *dev, int hwpart);
+
+#ifdef CONFIG_BLK_ASYNC
+	/**
+	 * read_start() - start reading from a block device
+	 *
+	 * Start the transfer of the first blocks of @req and return without
+	 * waiting for the data. Until read_poll() has reported completion,
+	 * any other operation on the device must first finish this one.
+	 *
+	 * @dev:	Device to read from
+	 * @req:	Read request, with @start, @blkcnt and @buffer set
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*read_start)(struct udevice *dev, struct blk_req *req);
+
+	/**
+	 * read_poll() - check on a read started with read_start()
+	 *
+	 * If the transfer in flight has finished and blocks are left, the
+	 * next transfer is started before returning.
+	 *
+	 * @dev:	Device being read
+	 * @req:	Read request
+	 * @return -EBUSY while blocks are still to come, then the number of
+	 * blocks read, or another -ve error number
+	 */
+	long (*read_poll)(struct udevice *dev, struct blk_req *req);
+#endif
 };
 
 #define blk_get_ops(dev)	((struct blk_ops *)(dev)->driver->ops)
@@ -252,6 +311,44 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
 
+#ifdef CONFIG_BLK_ASYNC
+/**
+ * blk_read_submit() - start reading blocks without waiting for them
+ *
+ * The CPU is free to do other work, e.g. process the previous chunk of
+ * data, while the device fills @buffer. Devices without asynchronous
+ * support are read synchronously here, so callers need no fallback.
+ * Only one request per device may be in flight.
+ *
+ * @block_dev:	Block device to read from
+ * @start:	Start block number to read (0=first)
+ * @blkcnt:	Number of blocks to read
+ * @buffer:	Destination buffer, which must stay valid until the request
+ *		has completed
+ * @req:	Returns the request, to pass to blk_read_poll()/blk_read_wait()
+ * @return 0 if OK, -ve on error
+ */
+int blk_read_submit(struct blk_desc *block_dev, lbaint_t start,
+		    lbaint_t blkcnt, void *buffer, struct blk_req *req);
+
+/**
+ * blk_read_poll() - check whether a submitted read has completed
+ *
+ * @req:	Request from blk_read_submit()
+ * @return -EBUSY if still in flight, else the number of blocks read or
+ * another -ve error number
+ */
+long blk_read_poll(struct blk_req *req);
+
+/**
+ * blk_read_wait() - wait for a submitted read to complete
+ *
+ * @req:	Request from blk_read_submit()
+ * @return number of blocks read, or -ve error number
+ */
+long blk_read_wait(struct blk_req *req);
+#endif
+
 /**
  * blk_get_device() - Find and probe a block device ready for use
  *
@@ -353,6 +450,63 @@ int blk_unbind_all(int if_type);
  */
 int blk_find_max_devnum(enum if_type if_type);
 
+#ifdef CONFIG_BLOCK_READAHEAD
+/**
+ * struct blk_readahead - read-ahead state of a block device
+ *
+ * This is the uclass-private data of each UCLASS_BLK device.
+ *
+ * @buf:	Staging buffer, CONFIG_BLOCK_READAHEAD_WINDOW blocks long
+ * @blksz:	Block size @buf was allocated for
+ * @start:	First block held in @buf
+ * @count:	Number of valid blocks in @buf (0 if empty)
+ * @next:	Block that follows the previous read
+ * @seq:	Number of consecutive adjacent reads seen so far
+ */
+struct blk_readahead {
+	char *buf;
+	unsigned long blksz;
+	lbaint_t start;
+	lbaint_t count;
+	lbaint_t next;
+	uint seq;
+};
+
+/**
+ * blk_readahead_read() - read blocks through the read-ahead buffer
+ *
+ * Small sequential reads are merged into transfers of
+ * CONFIG_BLOCK_READAHEAD_WINDOW blocks. Other reads go straight to the
+ * driver.
+ *
+ * @dev:	Block device to read from
+ * @start:	Start block number to read (0=first)
+ * @blkcnt:	Number of blocks to read
+ * @buffer:	Destination buffer for data read
+ * @return number of blocks read, or -ve error number
+ */
+ulong blk_readahead_read(struct udevice *dev, lbaint_t start,
+			 lbaint_t blkcnt, void *buffer);
+
+/**
+ * blk_readahead_invalidate() - discard any read-ahead data
+ *
+ * This must be called whenever the device contents may have changed.
+ *
+ * @dev:	Block device to invalidate
+ */
+void blk_readahead_invalidate(struct udevice *dev);
+
+/**
+ * blk_readahead_free() - free the read-ahead buffer of a device
+ *
+ * @dev:	Block device being removed
+ */
+void blk_readahead_free(struct udevice *dev);
+#else
+static inline void blk_readahead_invalidate(struct udevice *dev) {}
+#endif
+
 /**
  * blk_select_hwpart() - select a hardware partition
  *
@@ -397,6 +551,7 @@ static inline ulong blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt, const void *buffer)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->write_gen++;
 	return block_dev->block_write(block_dev, start, blkcnt, buffer);
 }
 
@@ -404,6 +559,7 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			       lbaint_t blkcnt)
 {
 	blkcache_invalidate(block_dev->if_type, block_dev->devnum);
+	block_dev->write_gen++;
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
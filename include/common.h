@@ -786,6 +786,49 @@ int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
 
+/**
+ * gunzip_read_func - supply the next piece of compressed input
+ *
+ * @param	priv		caller's context, as passed to gunzip_stream()
+ * @param	buf		buffer to fill
+ * @param	size		bytes available in @buf
+ * @return number of bytes placed in @buf, 0 at end of input or a negative
+ *	   error code
+ */
+typedef int (*gunzip_read_func)(void *priv, void *buf, int size);
+
+/**
+ * gunzip_stream() - decompress gzip data as it is read in
+ *
+ * Unlike gunzip() the compressed data does not need to be in memory: it is
+ * fetched a chunk at a time through @read and inflated straight to @dst,
+ * so reading and decompressing are interleaved and no staging copy of the
+ * whole compressed image is needed.
+ *
+ * @param	dst		destination buffer
+ * @param	dstlen		size of @dst
+ * @param	read		called to fetch compressed input
+ * @param	priv		passed to @read
+ * @param	lenp		returns the number of bytes decompressed
+ * @return 0 if OK, -1 on error
+ */
+int gunzip_stream(void *dst, int dstlen, gunzip_read_func read, void *priv,
+		  unsigned long *lenp);
+
+/**
+ * gunzip_blk() - decompress gzip data read from a block device
+ *
+ * @param	dst		destination buffer
+ * @param	dstlen		size of @dst
+ * @param	desc		block device holding the compressed data
+ * @param	start		first block of the compressed data
+ * @param	blkcnt		number of blocks of compressed data
+ * @param	lenp		returns the number of bytes decompressed
+ * @return 0 if OK, -1 on error
+ */
+int gunzip_blk(void *dst, int dstlen, struct blk_desc *desc, lbaint_t start,
+	       lbaint_t blkcnt, unsigned long *lenp);
+
 /**
  * gzwrite progress indicators: defined weak to allow board-specific
  * overrides:
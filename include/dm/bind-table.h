@@ -0,0 +1,134 @@
+/*
+ * Device binding table generated from the device tree at build time
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _DM_BIND_TABLE_H
+#define _DM_BIND_TABLE_H
+
+/* Flags for struct dm_bind_node */
+/* status was absent or "okay" at build time; not used at run time */
+#define DM_BIND_NODE_ENABLED	(1 << 0)
+#define DM_BIND_NODE_PRE_RELOC	(1 << 1)	/* has u-boot,dm-pre-reloc */
+
+/**
+ * struct dm_bind_node - A device tree node which could be bound to a driver
+ *
+ * The root node comes first, followed by every node with a compatible
+ * string, in the order they appear in the device tree. So the table is
+ * sorted by @offset.
+ *
+ * @offset:		Offset of the node in the device tree
+ * @first_child:	Index of the first child node in the table, 0 if none
+ * @next_sibling:	Index of the next node in the table with the same
+ *			parent, 0 if none
+ * @compats:		Index of the node's first compatible string in
+ *			the table's compat_list[]
+ * @compat_count:	Number of compatible strings the node has
+ * @flags:		DM_BIND_NODE_... flags
+ */
+struct dm_bind_node {
+	int offset;
+	u16 first_child;
+	u16 next_sibling;
+	u16 compats;
+	u8 compat_count;
+	u8 flags;
+};
+
+/**
+ * struct dm_bind_compat - A compatible string used in the device tree
+ *
+ * @hash:	Hash of the string, see dm_hash_str()
+ * @name:	Offset of the string in the table's strings[]
+ */
+struct dm_bind_compat {
+	u32 hash;
+	u32 name;
+};
+
+/**
+ * struct dm_bind_table - A binding table
+ *
+ * The table is generated by dtoc from a device tree (see dts/Makefile) and
+ * is only used if the device tree in use has the same size and CRC32 as
+ * the one it was built from.
+ *
+ * @fdt_size:		Total size of the device tree
+ * @fdt_struct_size:	Size of its structure block
+ * @fdt_crc:		CRC32 of the whole device tree
+ * @node_count:		Number of entries in @nodes
+ * @compat_count:	Number of entries in @compats
+ * @index_mask:		Number of entries in @index, less one
+ * @nodes:		Nodes which could be bound to a driver
+ * @compat_list:	For each node, the @compats index of each of its
+ *			compatible strings
+ * @compats:		Compatible strings used in the device tree
+ * @index:		Open-addressed hash table of @compats indexes plus one
+ * @strings:		The compatible strings themselves
+ */
+struct dm_bind_table {
+	u32 fdt_size;
+	u32 fdt_struct_size;
+	u32 fdt_crc;
+	uint node_count;
+	uint compat_count;
+	uint index_mask;
+	const struct dm_bind_node *nodes;
+	const u16 *compat_list;
+	const struct dm_bind_compat *compats;
+	const u16 *index;
+	const char *strings;
+};
+
+/* The table built from the control device tree */
+extern const struct dm_bind_table dm_bind_table;
+
+/**
+ * dm_bind_table_lookup() - Find a compatible string in the binding table
+ *
+ * @compat:	Compatible string to look up
+ * @return index in the compats[] of the table in use, or -ENOENT if the
+ * device tree does not use this string
+ */
+int dm_bind_table_lookup(const char *compat);
+
+/**
+ * dm_bind_table_scan() - Bind the subnodes of a node using the table
+ *
+ * This does the same as dm_scan_fdt_node(), but without walking the device
+ * tree or matching compatible strings against every driver.
+ *
+ * @parent:		Parent device for the devices bound
+ * @blob:		Device tree blob
+ * @offset:		Offset of the node whose subnodes are to be bound
+ * @pre_reloc_only:	If true, bind only nodes with special devicetree
+ *			properties, or drivers with the DM_FLAG_PRE_RELOC flag.
+ * @return 0 if OK, -ENOSYS if the table cannot be used for this blob or
+ * node, other -ve on error
+ */
+int dm_bind_table_scan(struct udevice *parent, const void *blob, int offset,
+		       bool pre_reloc_only);
+
+/**
+ * dm_bind_table_recheck() - Check the device tree against the table again
+ *
+ * The CRC32 of a device tree is only worked out the first time it is
+ * scanned. This makes the next scan work it out again, so that a device
+ * tree changed in place since is not bound from a stale table.
+ */
+void dm_bind_table_recheck(void);
+
+/**
+ * dm_bind_table_select() - Bind from another table
+ *
+ * This is for tests, which use a device tree other than the control one.
+ * The table built from the control device tree is used again when this is
+ * called with &dm_bind_table.
+ *
+ * @table:	Table to use from now on
+ */
+void dm_bind_table_select(const struct dm_bind_table *table);
+
+#endif
@@ -89,6 +89,39 @@ int device_bind_by_name(struct udevice *parent, bool pre_reloc_only,
  */
 int device_probe(struct udevice *dev);
 
+/**
+ * device_probe_deps() - Probe the devices a device depends on
+ *
+ * With CONFIG_DM_PROBE_DEPS, this probes the clock, reset, power-domain and
+ * regulator providers that the device's node refers to, so that they are
+ * ready before the device's own probe method runs. A provider node with no
+ * device bound to it is skipped, leaving the driver to report the problem
+ * when it looks for the provider.
+ *
+ * @dev: Device whose providers should be probed
+ * @return 0 if OK, or the error from the first provider which failed to probe
+ */
+#if CONFIG_IS_ENABLED(DM_PROBE_DEPS)
+int device_probe_deps(struct udevice *dev);
+
+/**
+ * device_probe_dep() - Probe one provider of a device
+ *
+ * @dev: Device which depends on the provider, for messages
+ * @id: Uclass of the provider
+ * @node: Device tree offset of the provider's node
+ * @return 0 if OK or if there is no such provider (no device is bound to
+ * @node in that uclass, or the uclass is not built in), else the error
+ * from probing it
+ */
+int device_probe_dep(struct udevice *dev, enum uclass_id id, int node);
+#else
+static inline int device_probe_deps(struct udevice *dev)
+{
+	return 0;
+}
+#endif
+
 /**
  * device_remove() - Remove a device, de-activating it
  *
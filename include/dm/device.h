@@ -46,6 +46,17 @@ struct driver_info;
 
 #define DM_FLAG_OF_PLATDATA		(1 << 8)
 
+/* Keys by which a uclass indexes its devices, see uclass_index_device() */
+enum uclass_index_key {
+	UCLASS_INDEX_SEQ,
+	UCLASS_INDEX_REQ_SEQ,
+	UCLASS_INDEX_NAME,
+	UCLASS_INDEX_NODE,
+	UCLASS_INDEX_PHANDLE,
+
+	UCLASS_INDEX_COUNT,
+};
+
 /**
  * struct udevice - An instance of a driver
  *
@@ -87,6 +98,11 @@ struct driver_info;
  *		When CONFIG_DEVRES is enabled, devm_kmalloc() and friends will
  *		add to this list. Memory so-allocated will be freed
  *		automatically when the device is removed / unbound
+ * @uclass_index: Used by uclass to link its devices in each of its indexes
+ * @probe_order: With CONFIG_DM_STATS, position of this device in the order
+ *		devices were probed, starting at 1 (0 = never probed)
+ * @probe_us: With CONFIG_DM_STATS, time taken to probe this device in
+ *		microseconds, not counting other devices probed meanwhile
  */
 struct udevice {
 	const struct driver *driver;
@@ -110,6 +126,13 @@ struct udevice {
 #ifdef CONFIG_DEVRES
 	struct list_head devres_head;
 #endif
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct hlist_node uclass_index[UCLASS_INDEX_COUNT];
+#endif
+#if CONFIG_IS_ENABLED(DM_STATS)
+	uint probe_order;
+	ulong probe_us;
+#endif
 };
 
 /* Maximum sequence number supported */
@@ -126,10 +149,13 @@ static inline int dev_of_offset(const struct udevice *dev)
 	return dev->of_offset;
 }
 
-static inline void dev_set_of_offset(struct udevice *dev, int of_offset)
-{
-	dev->of_offset = of_offset;
-}
+/**
+ * dev_set_of_offset() - set the device tree node of a device
+ *
+ * @dev:	Device to update
+ * @of_offset:	Device tree node offset, or -1 for none
+ */
+void dev_set_of_offset(struct udevice *dev, int of_offset);
 
 /**
  * struct udevice_id - Lists the compatible strings supported by a driver
@@ -32,6 +32,51 @@ struct driver *lists_driver_lookup_name(const char *name);
  */
 struct uclass_driver *lists_uclass_lookup(enum uclass_id id);
 
+/**
+ * struct driver_compat_entry - A compatible string in driver_compat_table
+ *
+ * @hash:	Hash of the compatible string
+ * @driver:	First driver in the list with this string, NULL if unused
+ * @of_id:	Entry in that driver's of_match table
+ */
+struct driver_compat_entry {
+	u32 hash;
+	struct driver *driver;
+	const struct udevice_id *of_id;
+};
+
+/**
+ * struct driver_compat_table - Drivers by compatible string
+ *
+ * This open-addressed hash table is built from the driver list with
+ * CONFIG_DM_COMPAT_HASH, the first time it is needed once the full
+ * malloc() is available.
+ *
+ * @mask:	Number of entries in @slot, less one
+ * @count:	Number of entries in use
+ * @max_probe:	Most entries checked to find a compatible string
+ * @slot:	Entries
+ */
+struct driver_compat_table {
+	uint mask;
+	uint count;
+	uint max_probe;
+	struct driver_compat_entry slot[];
+};
+
+/**
+ * lists_driver_lookup_compat() - Find the driver for a compatible string
+ *
+ * This returns the first driver in the list which has @compat in its
+ * of_match table, which is the driver lists_bind_fdt() binds to.
+ *
+ * @compat:	Compatible string to look up
+ * @of_idp:	Returns the entry in the driver's of_match table
+ * @return pointer to driver, or NULL if not found
+ */
+struct driver *lists_driver_lookup_compat(const char *compat,
+					  const struct udevice_id **of_idp);
+
 /**
  * lists_bind_drivers() - search for and bind all drivers to parent
  *
@@ -0,0 +1,64 @@
+/*
+ * Driver model statistics
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#ifndef _DM_STATS_H
+#define _DM_STATS_H
+
+/**
+ * struct dm_stats - Figures collected with CONFIG_DM_STATS
+ *
+ * These are kept in global_data, so that they can be updated before
+ * relocation and survive it.
+ *
+ * @bind_nodes:		Nodes with a compatible string passed to lists_bind_fdt()
+ * @bind_devices:	Devices bound by lists_bind_fdt()
+ * @bind_nomatch:	Nodes for which no driver was found
+ * @bind_us:		Time spent in lists_bind_fdt(), in microseconds. This
+ *			only counts calls made while a timer is running.
+ * @compat_lookups:	Compatible strings looked up
+ * @compat_hashed:	Of those, the ones looked up in the hash table
+ * @compat_compares:	Compatible strings compared to do the lookups
+ * @probe_count:	Devices probed
+ * @probe_us:		Time spent probing devices, in microseconds
+ * @probe_nested_us:	Time spent so far in nested probes of the device
+ *			being probed, used to work out its own time
+ */
+struct dm_stats {
+	uint bind_nodes;
+	uint bind_devices;
+	uint bind_nomatch;
+	ulong bind_us;
+	uint compat_lookups;
+	uint compat_hashed;
+	ulong compat_compares;
+	uint probe_count;
+	ulong probe_us;
+	ulong probe_nested_us;
+};
+
+#if CONFIG_IS_ENABLED(DM_STATS)
+#define dm_stats_add(field, n)	(gd->dm_stats.field += (n))
+#else
+#define dm_stats_add(field, n)	do { } while (0)
+#endif
+
+/**
+ * dm_stats_timer_us() - Read the timer, if it is safe to do so
+ *
+ * Before the timer is set up, reading it could probe a timer device or use
+ * uninitialised hardware, so this returns 0 instead.
+ *
+ * @return time in microseconds, or 0 if the timer cannot be read yet
+ */
+ulong dm_stats_timer_us(void);
+
+/* Print the statistics collected so far */
+void dm_dump_stats(void);
+
+/* Print the devices probed so far, in order, with the time each took */
+void dm_dump_probes(void);
+
+#endif
@@ -138,6 +138,21 @@ int uclass_unbind_device(struct udevice *dev);
 static inline int uclass_unbind_device(struct udevice *dev) { return 0; }
 #endif
 
+/**
+ * uclass_index_device() - Update a device's entries in its uclass's indexes
+ *
+ * This must be called after changing the name, device tree node, seq or
+ * req_seq of a device which is bound to a uclass, so that it can still be
+ * found by those. Devices which are not bound yet are ignored.
+ *
+ * @dev:	Pointer to the device
+ */
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+void uclass_index_device(struct udevice *dev);
+#else
+static inline void uclass_index_device(struct udevice *dev) {}
+#endif
+
 /**
  * uclass_pre_probe_device() - Deal with a device that is about to be probed
  *
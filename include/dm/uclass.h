@@ -30,12 +30,21 @@
  * @dev_head: List of devices in this uclass (devices are attached to their
  * uclass when their bind method is called)
  * @sibling_node: Next uclass in the linked list of uclasses
+ * @index: Hash tables of devices, one for each enum uclass_index_key, each
+ * with @index_mask + 1 buckets. NULL if the devices are not indexed.
+ * @index_mask: Mask to apply to a hash to get the bucket number
+ * @dev_count: Number of devices in @dev_head
  */
 struct uclass {
 	void *priv;
 	struct uclass_driver *uc_drv;
 	struct list_head dev_head;
 	struct list_head sibling_node;
+#if CONFIG_IS_ENABLED(DM_UCLASS_INDEX)
+	struct hlist_head *index;
+	uint index_mask;
+	uint dev_count;
+#endif
 };
 
 struct driver;
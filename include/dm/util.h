@@ -33,6 +33,24 @@ struct list_head;
  */
 int list_count_items(struct list_head *head);
 
+/**
+ * dm_hash_str() - Hash a string, e.g. a compatible string
+ *
+ * This is the djb2 hash, as used by libfdt. dtoc's BindHash() must match it.
+ *
+ * @str:	String to hash
+ * @return 32-bit hash value
+ */
+static inline u32 dm_hash_str(const char *str)
+{
+	u32 hash = 5381;
+
+	while (*str)
+		hash = hash * 33 + (unsigned char)*str++;
+
+	return hash;
+}
+
 /* Dump out a tree of all devices */
 void dm_dump_all(void);
 
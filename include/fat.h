@@ -29,6 +29,8 @@
 
 #define FATBUFBLOCKS	6
 #define FATBUFSIZE	(mydata->sect_size * FATBUFBLOCKS)
+/* Number of FATBUFBLOCKS windows of the FAT kept in memory */
+#define FATBUFWINDOWS	8
 #define FAT12BUFSIZE	((FATBUFSIZE*2)/3)
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
@@ -168,6 +170,9 @@ typedef struct dir_slot {
  */
 typedef struct {
 	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatcache;	/* FATBUFWINDOWS buffers, fatbuf is one of them */
+	int	fatcachenum[FATBUFWINDOWS]; /* bufnum held by each, or -1 */
+	int	fatcachenext;	/* Next buffer to replace */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
@@ -214,4 +219,17 @@ int file_fat_write(const char *filename, void *buf, loff_t offset, loff_t len,
 int fat_read_file(const char *filename, void *buf, loff_t offset, loff_t len,
 		  loff_t *actread);
 void fat_close(void);
+
+#if defined(CONFIG_FS_FAT) && \
+	(!defined(CONFIG_SPL_BUILD) || defined(CONFIG_SPL_FAT_SUPPORT))
+/*
+ * fat_invalidate_open_file - Forget the file kept between reads
+ *
+ * This must be called whenever the block device may hold a different
+ * filesystem, e.g. when it is (re)initialised.
+ */
+void fat_invalidate_open_file(void);
+#else
+static inline void fat_invalidate_open_file(void) {}
+#endif
 #endif /* _FAT_H_ */
@@ -11,12 +11,130 @@
 #ifdef CONFIG_OF_LIBFDT
 
 #include <libfdt.h>
+#include <linux/list.h>
 
 u32 fdt_getprop_u32_default_node(const void *fdt, int off, int cell,
 				const char *prop, const u32 dflt);
 u32 fdt_getprop_u32_default(const void *fdt, const char *path,
 				const char *prop, const u32 dflt);
 
+/**
+ * struct fdt_batch - A set of changes to make to an FDT in one go
+ *
+ * Each fdt_setprop() or fdt_add_subnode() moves everything after the point
+ * of change along, so making many changes to a large tree copies it many
+ * times over. A batch instead records the changes and then writes out the
+ * changed tree in a single pass when committed.
+ *
+ * Nodes are given by their full path. Until the batch is committed the
+ * tree itself is not changed, so node offsets stay valid and reading the
+ * tree gives the values from before the batch.
+ *
+ * @fdt:	FDT the changes are to
+ * @nodes:	Nodes with changes, struct fdt_batch_node
+ * @props:	Property changes in the order they were made,
+ *		struct fdt_batch_prop
+ * @err:	First error when recording a change, or 0
+ */
+struct fdt_batch {
+	void *fdt;
+	struct list_head nodes;
+	struct list_head props;
+	int err;
+};
+
+/**
+ * fdt_batch_init() - Start a batch of changes to an FDT
+ *
+ * @batch:	Batch to set up
+ * @fdt:	FDT to change
+ */
+void fdt_batch_init(struct fdt_batch *batch, void *fdt);
+
+/**
+ * fdt_batch_add_node() - Add a node unless it exists already
+ *
+ * Any missing parent nodes are added too.
+ *
+ * @batch:	Batch to add to
+ * @path:	Full path of the node, e.g. "/chosen"
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_batch_add_node(struct fdt_batch *batch, const char *path);
+
+/**
+ * fdt_batch_setprop() - Set a property, adding the node if needed
+ *
+ * @batch:	Batch to add to
+ * @path:	Full path of the node, which is added if it does not exist
+ * @name:	Name of the property
+ * @val:	Value of the property, which is copied, or NULL to set it
+ *		to zeroes
+ * @len:	Length of @val in bytes
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_batch_setprop(struct fdt_batch *batch, const char *path,
+		      const char *name, const void *val, int len);
+
+static inline int fdt_batch_setprop_u32(struct fdt_batch *batch,
+					const char *path, const char *name,
+					uint32_t val)
+{
+	fdt32_t tmp = cpu_to_fdt32(val);
+
+	return fdt_batch_setprop(batch, path, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_u64(struct fdt_batch *batch,
+					const char *path, const char *name,
+					uint64_t val)
+{
+	fdt64_t tmp = cpu_to_fdt64(val);
+
+	return fdt_batch_setprop(batch, path, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_batch_setprop_string(struct fdt_batch *batch,
+					   const char *path, const char *name,
+					   const char *str)
+{
+	return fdt_batch_setprop(batch, path, name, str, strlen(str) + 1);
+}
+
+/**
+ * fdt_batch_delprop() - Delete a property, if it exists
+ *
+ * @batch:	Batch to add to
+ * @path:	Full path of the node
+ * @name:	Name of the property
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_batch_delprop(struct fdt_batch *batch, const char *path,
+		      const char *name);
+
+/**
+ * fdt_batch_commit() - Make the changes in a batch and free it
+ *
+ * The changed tree is built in a buffer of exactly the size needed and then
+ * copied over the old one, so the tree must have room for the changes as
+ * with fdt_setprop(). If any change could not be recorded, or there is not
+ * enough room, the tree is left as it was.
+ *
+ * The result is the same as making the changes one at a time with
+ * fdt_add_subnode(), fdt_setprop() and fdt_delprop() in the same order.
+ *
+ * @batch:	Batch to commit
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_batch_commit(struct fdt_batch *batch);
+
+/**
+ * fdt_batch_abort() - Free a batch without making its changes
+ *
+ * @batch:	Batch to free
+ */
+void fdt_batch_abort(struct fdt_batch *batch);
+
 /**
  * Add data to the root of the FDT before booting the OS.
  *
@@ -27,6 +145,14 @@ u32 fdt_getprop_u32_default(const void *fdt, const char *path,
  */
 int fdt_root(void *fdt);
 
+/**
+ * Add data to the root of the FDT as part of a batch of changes.
+ *
+ * @param batch		Batch of changes to add to
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_root_batch(struct fdt_batch *batch);
+
 /**
  * Add chosen data the FDT before booting the OS.
  *
@@ -37,6 +163,14 @@ int fdt_root(void *fdt);
  */
 int fdt_chosen(void *fdt);
 
+/**
+ * Add chosen data to the FDT as part of a batch of changes.
+ *
+ * @param batch		Batch of changes to add to
+ * @return 0 if ok, or -FDT_ERR_... on error
+ */
+int fdt_chosen_batch(struct fdt_batch *batch);
+
 /**
  * Add initrd information to the FDT before booting the OS.
  *
@@ -95,15 +229,25 @@ int fdt_fixup_memory(void *blob, u64 start, u64 size);
  */
 #ifdef CONFIG_ARCH_FIXUP_FDT_MEMORY
 int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[], int banks);
+int fdt_fixup_memory_banks_batch(struct fdt_batch *batch, u64 start[],
+				 u64 size[], int banks);
 #else
 static inline int fdt_fixup_memory_banks(void *blob, u64 start[], u64 size[],
 					 int banks)
 {
 	return 0;
 }
+
+static inline int fdt_fixup_memory_banks_batch(struct fdt_batch *batch,
+					       u64 start[], u64 size[],
+					       int banks)
+{
+	return 0;
+}
 #endif
 
 void fdt_fixup_ethernet(void *fdt);
+void fdt_fixup_ethernet_batch(struct fdt_batch *batch);
 int fdt_find_and_setprop(void *fdt, const char *node, const char *prop,
 			 const void *val, int len, int create);
 void fdt_fixup_qe_firmware(void *fdt);
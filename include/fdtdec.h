@@ -1015,4 +1015,20 @@ int fdtdec_setup_memory_banksize(void);
  */
 int fdtdec_setup(void);
 
+/**
+ * fdtdec_build_index() - Index a device tree to speed up lookups
+ *
+ * This builds an index of the tree with fdt_index_init(), in memory from
+ * malloc(), so that libfdt can find nodes by path, phandle and compatible
+ * string without scanning the tree. Any previous index is freed. The index
+ * is dropped automatically if the tree is changed.
+ *
+ * This must only be called once the full malloc() is available.
+ *
+ * @blob:	Device tree to index
+ * @return 0 if OK, -ENOMEM if out of memory, -EINVAL if the tree cannot
+ * be indexed
+ */
+int fdtdec_build_index(const void *blob);
+
 #endif
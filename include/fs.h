@@ -64,6 +64,20 @@ int fs_size(const char *filename, loff_t *size);
 int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	    loff_t *actread);
 
+/*
+ * fs_read_gz - Read and decompress a gzip file from the partition previously
+ * set by fs_set_blk_dev(). The file is inflated as it is read, so it never
+ * needs to be held in memory in compressed form.
+ *
+ * @filename: Name of file to read from
+ * @addr: The address to decompress into
+ * @maxlen: Space available at @addr. Maybe 0 for no limit
+ * @actread: Returns the number of bytes decompressed
+ * @return 0 if ok with valid *actread, negative on error conditions
+ */
+int fs_read_gz(const char *filename, ulong addr, loff_t maxlen,
+	       loff_t *actread);
+
 /*
  * fs_write - Write file to the partition previously set by fs_set_blk_dev()
  * Note that not all filesystem types support offset!=0.
@@ -86,6 +100,8 @@ int do_size(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype);
 int do_load(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype);
+int do_gzload(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
+		int fstype);
 int do_ls(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
 		int fstype);
 int file_exists(const char *dev_type, const char *dev_part, const char *file,
@@ -106,4 +122,60 @@ int do_fs_uuid(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[],
  */
 int do_fs_type(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[]);
 
+/* Largest filesystem-specific record held by the dentry cache */
+#define FS_DCACHE_DATA_MAX	32
+
+#if CONFIG_IS_ENABLED(FS_DCACHE)
+/*
+ * fs_dcache_set_dev - Select the device whose lookups are cached
+ *
+ * The cache only ever holds lookups for one partition. Selecting a
+ * different device, hardware partition or partition empties it, and so
+ * does any write or erase of the device (see write_gen in struct
+ * blk_desc).
+ *
+ * @dev_desc: Block device holding the filesystem
+ * @start: First block of the partition
+ */
+void fs_dcache_set_dev(struct blk_desc *dev_desc, lbaint_t start);
+
+/*
+ * fs_dcache_lookup - Look up a path in the dentry cache
+ *
+ * @path: Path as normalised by the filesystem, without leading slashes
+ * @data: Returns the record stored by fs_dcache_add()
+ * @size: Size of @data
+ * @return size of the record if found, -ENOENT if the path is known not
+ * to exist, 0 if the path is not cached
+ */
+int fs_dcache_lookup(const char *path, void *data, int size);
+
+/*
+ * fs_dcache_add - Add the result of a path lookup to the dentry cache
+ *
+ * @path: Path as normalised by the filesystem, without leading slashes
+ * @data: Filesystem-specific record for the path, or NULL if it does not
+ * exist
+ * @size: Size of @data, at most FS_DCACHE_DATA_MAX
+ */
+void fs_dcache_add(const char *path, const void *data, int size);
+
+/*
+ * fs_dcache_invalidate - Drop all cached lookups
+ *
+ * This must be called whenever the filesystem is modified.
+ */
+void fs_dcache_invalidate(void);
+#else
+static inline void fs_dcache_set_dev(struct blk_desc *dev_desc,
+				     lbaint_t start) {}
+static inline int fs_dcache_lookup(const char *path, void *data, int size)
+{
+	return 0;
+}
+static inline void fs_dcache_add(const char *path, const void *data,
+				 int size) {}
+static inline void fs_dcache_invalidate(void) {}
+#endif
+
 #endif /* _FS_H */
@@ -74,6 +74,12 @@
 #define ESDHC_TUNING_STEP_MASK		0x00070000
 #define ESDHC_TUNING_STEP_SHIFT		16
 
+/* clock tune control/status register */
+#define ESDHC_TUNE_CTRL_STATUS_DLY_CELL_SET_PRE_MASK	0x00007f00
+#define ESDHC_TUNE_CTRL_STATUS_DLY_CELL_SET_PRE_SHIFT	8
+#define ESDHC_TUNE_CTRL_STATUS_TAP_SEL_PRE_MASK		0x7f000000
+#define ESDHC_TUNE_CTRL_STATUS_TAP_SEL_PRE_SHIFT	24
+
 #define IRQSTAT			0x0002e030
 #define IRQSTAT_DMAE		(0x10000000)
 #define IRQSTAT_AC12E		(0x01000000)
@@ -139,6 +145,9 @@
 #define PROCTL_INIT		0x00000020
 #define PROCTL_DTW_4		0x00000002
 #define PROCTL_DTW_8		0x00000004
+#define PROCTL_DMAS_MASK	0x00000300
+#define PROCTL_DMAS_SDMA	0x00000000
+#define PROCTL_DMAS_ADMA2	0x00000200
 
 #define CMDARG			0x0002e008
 
@@ -206,6 +215,20 @@
 
 #define ESDHC_VENDORSPEC_VSELECT 0x00000002 /* Use 1.8V */
 
+/* ADMA2 descriptor, 32-bit addressing */
+struct fsl_esdhc_adma_desc {
+	__le16	attr;
+	__le16	len;
+	__le32	addr;
+};
+
+#define ESDHC_ADMA_VALID	0x0001
+#define ESDHC_ADMA_END		0x0002
+#define ESDHC_ADMA_TRAN		0x0020
+
+/* A zero length field means 64KiB */
+#define ESDHC_ADMA_MAX_LEN	65536
+
 struct fsl_esdhc_cfg {
 	phys_addr_t esdhc_base;
 	u32	sdhc_clk;
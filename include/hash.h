@@ -6,6 +6,10 @@
 #ifndef _HASH_H
 #define _HASH_H
 
+#ifndef USE_HOSTCC
+#include <linker_lists.h>
+#endif
+
 /*
  * Maximum digest size for all algorithms we support. Having this value
  * avoids a malloc() or C99 local declaration in common/cmd_hash.c.
@@ -21,6 +25,18 @@ enum {
 #define CONFIG_HASH_VERIFY
 #endif
 
+/*
+ * Priorities of hash providers. Where several providers of an algorithm can
+ * be used, the lookup functions pick the one with the highest priority.
+ * CPU instructions come before engines, which need setting up and cache
+ * maintenance for each request.
+ */
+enum {
+	HASH_PRIO_SW	= 0,	/* Portable C code in lib/ */
+	HASH_PRIO_HW	= 100,	/* Hash engine */
+	HASH_PRIO_CPU	= 200,	/* CPU instructions */
+};
+
 struct hash_algo {
 	const char *name;			/* Name of algorithm */
 	int digest_size;			/* Length of digest */
@@ -74,8 +90,37 @@ struct hash_algo {
 	 */
 	int (*hash_finish)(struct hash_algo *algo, void *ctx, void *dest_buf,
 			   int size);
+	const char *driver;			/* Name of the provider */
+	int priority;				/* HASH_PRIO_... */
+	/*
+	 * probe: Check whether the provider can be used (optional)
+	 *
+	 * This lets a provider depend on a CPU feature, or on an engine
+	 * which has been set up, rather than just on the build.
+	 *
+	 * @algo: Pointer to the hash_algo struct
+	 * @return 0 if the provider can be used, -ve if not
+	 */
+	int (*probe)(struct hash_algo *algo);
 };
 
+#ifndef USE_HOSTCC
+/*
+ * Declare a hash provider. It is used in place of the software
+ * implementation of the same algorithm when it has a higher priority and
+ * its probe() method succeeds, e.g.:
+ *
+ * U_BOOT_HASH_ALGO(sha256_caam) = {
+ *	.name = "sha256",
+ *	.driver = "caam",
+ *	.priority = HASH_PRIO_HW,
+ *	...
+ * };
+ */
+#define U_BOOT_HASH_ALGO(__name) \
+	ll_entry_declare(struct hash_algo, __name, hash_algo)
+#endif
+
 #ifndef USE_HOSTCC
 /**
  * hash_command: Process a hash command for a particular algorithm
@@ -120,7 +165,8 @@ int hash_block(const char *algo_name, const void *data, unsigned int len,
  * hash_lookup_algo() - Look up the hash_algo struct for an algorithm
  *
  * The function returns the pointer to the struct or -EPROTONOSUPPORT if the
- * algorithm is not available.
+ * algorithm is not available. Where there are several providers of the
+ * algorithm, the usable one with the highest priority is returned.
  *
  * @algo_name: Hash algorithm to look up
  * @algop: Pointer to the hash_algo struct if found
@@ -133,7 +179,8 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
  * hash_progressive_lookup_algo() - Look up hash_algo for prog. hash support
  *
  * The function returns the pointer to the struct or -EPROTONOSUPPORT if the
- * algorithm is not available with progressive hash support.
+ * algorithm is not available with progressive hash support. Providers are
+ * picked as for hash_lookup_algo().
  *
  * @algo_name: Hash algorithm to look up
  * @algop: Pointer to the hash_algo struct if found
@@ -143,6 +190,90 @@ int hash_lookup_algo(const char *algo_name, struct hash_algo **algop);
 int hash_progressive_lookup_algo(const char *algo_name,
 				 struct hash_algo **algop);
 
+/**
+ * struct hash_stream - a hash worked out a chunk at a time
+ *
+ * This lets data be hashed in the same pass that reads, copies or
+ * decompresses it, rather than going over it again afterwards.
+ *
+ * @algo:	Algorithm in use, NULL if the stream is not active
+ * @ctx:	Progressive hash context for @algo
+ */
+struct hash_stream {
+	struct hash_algo *algo;
+	void *ctx;
+};
+
+/**
+ * hash_stream_init() - Start hashing a stream of data
+ *
+ * @hs: Stream to set up
+ * @algo_name: Hash algorithm to use, which must support progressive hashing
+ * @return 0 if ok, -EPROTONOSUPPORT for an unknown algorithm, -ENOMEM if
+ * the context could not be allocated
+ */
+int hash_stream_init(struct hash_stream *hs, const char *algo_name);
+
+/**
+ * hash_stream_update() - Add the next chunk of data to a hash
+ *
+ * On error the stream is no longer active and need not be aborted.
+ *
+ * @hs: Stream to update
+ * @buf: Data to hash
+ * @size: Number of bytes in @buf
+ * @return 0 if ok, -ve on error
+ */
+int hash_stream_update(struct hash_stream *hs, const void *buf,
+		       unsigned int size);
+
+/**
+ * hash_stream_finish() - Finish a stream and write out its hash value
+ *
+ * The value is in the form the algorithm produces it, so a crc32 is a
+ * native-endian 32-bit word.
+ *
+ * @hs: Stream to finish
+ * @output: Place to put the hash value
+ * @size: Number of bytes available at @output
+ * @return number of bytes written to @output, or -ENOSPC if @size is too
+ * small, or other -ve value on error
+ */
+int hash_stream_finish(struct hash_stream *hs, void *output, int size);
+
+/**
+ * hash_stream_abort() - Give up on a stream without finishing it
+ *
+ * This is safe to call on a stream which is no longer active.
+ *
+ * @hs: Stream to abort
+ */
+void hash_stream_abort(struct hash_stream *hs);
+
+/**
+ * hash_lookup_provider() - Look up a particular provider of an algorithm
+ *
+ * @algo_name: Hash algorithm to look up
+ * @driver: Name of the provider, e.g. "sw"
+ * @algop: Pointer to the hash_algo struct if found
+ *
+ * @return 0 if ok, -EPROTONOSUPPORT if there is no such provider, -ENODEV
+ * if its probe() method fails
+ */
+int hash_lookup_provider(const char *algo_name, const char *driver,
+			 struct hash_algo **algop);
+
+/**
+ * hash_get_provider() - Get a hash provider by index
+ *
+ * This allows all providers of all algorithms to be listed, whether they
+ * can be used or not.
+ *
+ * @index: Index of the provider, from 0
+ * @return pointer to the provider, or NULL if @index is past the end
+ */
+struct hash_algo *hash_get_provider(int index);
+
 /**
  * hash_parse_string() - Parse hash string into a binary array
  *
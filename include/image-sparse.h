@@ -23,6 +23,17 @@ struct sparse_storage {
 	lbaint_t	(*reserve)(struct sparse_storage *info,
 				 lbaint_t blk,
 				 lbaint_t blkcnt);
+
+	/*
+	 * Optional: erase whole groups of @erase_grp blocks instead of
+	 * writing zero fills, if @erase_zeroes. Don't-care ranges are never
+	 * erased. Returns the number of blocks erased.
+	 */
+	lbaint_t	(*erase)(struct sparse_storage *info,
+				 lbaint_t blk,
+				 lbaint_t blkcnt);
+	lbaint_t	erase_grp;
+	bool		erase_zeroes;	/* erased blocks read back as 0 */
 };
 
 static inline int is_sparse_image(void *buf)
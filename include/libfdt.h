@@ -1815,6 +1815,79 @@ int fdt_del_node(void *fdt, int nodeoffset);
  */
 int fdt_overlay_apply(void *fdt, void *fdto);
 
+struct fdt_overlay_ref;
+
+/**
+ * struct fdt_overlay_session - state for applying a list of overlays
+ *
+ * This is set up by fdt_overlay_session_init() and is private to
+ * fdt_overlay.c.
+ *
+ * @fdt:		Base device tree the overlays are applied to
+ * @max_phandle:	Highest phandle in use in @fdt
+ * @symbols:		Node offset of /__symbols__ in @fdt, or -ve
+ * @phandle_count:	Number of entries in @phandle
+ * @symbol_count:	Number of entries in @symbol
+ * @phandle:		Base nodes with a phandle, sorted by phandle
+ * @symbol:		Properties of /__symbols__, sorted by name hash
+ */
+struct fdt_overlay_session {
+	void *fdt;
+	uint32_t max_phandle;
+	int symbols;
+	int phandle_count;
+	int symbol_count;
+	struct fdt_overlay_ref *phandle;
+	struct fdt_overlay_ref *symbol;
+};
+
+/**
+ * fdt_overlay_session_size() - work out the memory needed for a session
+ *
+ * @fdt:	Base device tree
+ * @return number of bytes needed by fdt_overlay_session_init(), or -ve
+ * FDT_ERR_...
+ */
+int fdt_overlay_session_size(const void *fdt);
+
+/**
+ * fdt_overlay_session_init() - start applying overlays to a tree
+ *
+ * This scans the base tree once, noting its highest phandle and, if @buf
+ * is given, indexing its phandles and the labels in /__symbols__. Each
+ * overlay then applied with fdt_overlay_session_apply() finds the nodes
+ * it refers to from the index rather than by scanning the base tree,
+ * which grows with each overlay applied. Labels are only looked up in
+ * the tree the first time an overlay uses them.
+ *
+ * The base tree must not be changed other than through the session
+ * until the last overlay is applied. @buf must be kept until then.
+ *
+ * @session:	Session to set up
+ * @fdt:	Base device tree
+ * @buf:	Memory for the index, aligned as for a pointer, or NULL to
+ *		look up nodes by scanning the tree
+ * @bufsize:	Size of @buf, at least fdt_overlay_session_size() bytes
+ * @return 0 if OK, -FDT_ERR_NOSPACE if @buf is too small, other -ve
+ * FDT_ERR_...
+ */
+int fdt_overlay_session_init(struct fdt_overlay_session *session, void *fdt,
+			     void *buf, int bufsize);
+
+/**
+ * fdt_overlay_session_apply() - apply an overlay to the session's tree
+ *
+ * This is the same as fdt_overlay_apply() on the session's base tree.
+ * As there, the overlay is damaged whatever the result, and on error the
+ * base tree is too, so no more overlays can be applied.
+ *
+ * @session:	Session set up by fdt_overlay_session_init()
+ * @fdto:	Device tree overlay blob
+ * @return 0 if OK, or -ve FDT_ERR_... as for fdt_overlay_apply()
+ */
+int fdt_overlay_session_apply(struct fdt_overlay_session *session,
+			      void *fdto);
+
 /**********************************************************************/
 /* Debugging / informational functions                                */
 /**********************************************************************/
@@ -2134,4 +2207,32 @@ int fdt_next_region(const void *fdt,
 int fdt_add_alias_regions(const void *fdt, struct fdt_region *region, int count,
 			  int max_regions, struct fdt_region_state *info);
 
+/**
+ * fdt_index_size() - work out how much memory is needed to index a tree
+ *
+ * @fdt:	Device tree to index
+ * @return number of bytes needed by fdt_index_init(), or -ve FDT_ERR_...
+ */
+int fdt_index_size(const void *fdt);
+
+/**
+ * fdt_index_init() - index a tree, and use the index from now on
+ *
+ * This builds an index of the tree's nodes, phandles and compatible
+ * strings in @buf. From then on fdt_path_offset(), fdt_subnode_offset(),
+ * fdt_node_offset_by_phandle() and fdt_node_offset_by_compatible() use it
+ * rather than scanning the tree. One tree can be indexed at a time.
+ *
+ * Any change made to the tree through libfdt drops the index, after which
+ * lookups scan the tree again. @buf must be kept until then, or until
+ * another tree is indexed.
+ *
+ * @fdt:	Device tree to index
+ * @buf:	Memory for the index, aligned as for a pointer
+ * @bufsize:	Size of @buf, at least fdt_index_size() bytes
+ * @return 0 if OK, -FDT_ERR_NOSPACE if @buf is too small,
+ * -FDT_ERR_BADSTRUCTURE if the tree is too deep, other -ve FDT_ERR_...
+ */
+int fdt_index_init(const void *fdt, void *buf, int bufsize);
+
 #endif /* _LIBFDT_H */
@@ -29,6 +29,13 @@ typedef __be64 fdt64_t;
 #define strtoul(cp, endp, base)	simple_strtoul(cp, endp, base)
 #endif
 
+/* Lookups can use an index of the tree, see fdt_index_init() */
+#ifdef USE_HOSTCC
+#define FDT_INDEX	1
+#elif CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+#define FDT_INDEX	1
+#endif
+
 /* adding a ramdisk needs 0x44 bytes in version 2008.10 */
 #define FDT_RAMDISK_OVERHEAD	0x80
 
@@ -67,6 +67,7 @@
 
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_DATA_STAT_AFTER_ERASE	0x00800000
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -212,6 +213,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_ERASE_GROUP_DEF		175	/* R/W */
 #define EXT_CSD_BOOT_BUS_WIDTH		177
 #define EXT_CSD_PART_CONF		179	/* R/W */
+#define EXT_CSD_ERASED_MEM_CONT		181	/* RO */
 #define EXT_CSD_BUS_WIDTH		183	/* R/W */
 #define EXT_CSD_STROBE_SUPPORT		184	/* R/W */
 #define EXT_CSD_HS_TIMING		185	/* R/W */
@@ -439,6 +441,53 @@ struct dm_mmc_ops {
 
 	/* hs400_enhanced_strobe() - set enhanced strobe */
 	void (*hs400_enhanced_strobe)(struct udevice *dev);
+
+#ifdef CONFIG_BLK_ASYNC
+	/**
+	 * send_cmd_start() - Send a data command without waiting for the data
+	 *
+	 * Like send_cmd(), but returns as soon as the response has arrived
+	 * and the data transfer is running. data_poll() must then be called
+	 * until it no longer returns -EBUSY before any other command is sent.
+	 *
+	 * @dev:	Device to receive the command
+	 * @cmd:	Command to send
+	 * @data:	Data to receive, which must stay valid until completion
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*send_cmd_start)(struct udevice *dev, struct mmc_cmd *cmd,
+			      struct mmc_data *data);
+
+	/**
+	 * data_poll() - Check on the data of a send_cmd_start() command
+	 *
+	 * @dev:	Device that received the command
+	 * @data:	Data passed to send_cmd_start()
+	 * @return 0 once the transfer is complete, -EBUSY while it is still
+	 * running, other -ve on error
+	 */
+	int (*data_poll)(struct udevice *dev, struct mmc_data *data);
+#endif
+
+#ifdef CONFIG_MMC_MODE_CACHE
+	/**
+	 * get_tuning() - Read back the result of execute_tuning()
+	 *
+	 * @dev:	Device that was tuned
+	 * @tuning:	Returns the host's tuning settings, e.g. a tap number
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*get_tuning)(struct udevice *dev, u32 *tuning);
+
+	/**
+	 * set_tuning() - Apply a result of get_tuning() instead of tuning
+	 *
+	 * @dev:	Device to update
+	 * @tuning:	Tuning settings from get_tuning()
+	 * @return 0 if OK, -ve on error
+	 */
+	int (*set_tuning)(struct udevice *dev, u32 tuning);
+#endif
 };
 
 #define mmc_get_ops(dev)        ((struct dm_mmc_ops *)(dev)->driver->ops)
@@ -451,6 +500,15 @@ int dm_mmc_get_cd(struct udevice *dev);
 int dm_mmc_get_wp(struct udevice *dev);
 int dm_mmc_execute_tuning(struct udevice *dev, uint opcode);
 int dm_mmc_card_busy(struct udevice *dev);
+#ifdef CONFIG_BLK_ASYNC
+int dm_mmc_send_cmd_start(struct udevice *dev, struct mmc_cmd *cmd,
+			  struct mmc_data *data);
+int dm_mmc_data_poll(struct udevice *dev, struct mmc_data *data);
+#endif
+#ifdef CONFIG_MMC_MODE_CACHE
+int dm_mmc_get_tuning(struct udevice *dev, u32 *tuning);
+int dm_mmc_set_tuning(struct udevice *dev, u32 tuning);
+#endif
 
 /* Transition functions for compatibility */
 int mmc_set_ios(struct mmc *mmc);
@@ -472,6 +530,15 @@ struct mmc_ops {
 	int (*execute_tuning)(struct mmc *mmc, uint opcode);
 	int (*card_busy)(struct mmc *mmc);
 	void (*hs400_enhanced_strobe)(struct mmc *mmc);
+#ifdef CONFIG_BLK_ASYNC
+	int (*send_cmd_start)(struct mmc *mmc,
+			      struct mmc_cmd *cmd, struct mmc_data *data);
+	int (*data_poll)(struct mmc *mmc, struct mmc_data *data);
+#endif
+#ifdef CONFIG_MMC_MODE_CACHE
+	int (*get_tuning)(struct mmc *mmc, u32 *tuning);
+	int (*set_tuning)(struct mmc *mmc, u32 tuning);
+#endif
 };
 #endif
 
@@ -583,6 +650,8 @@ struct mmc {
 	struct blk_desc block_dev;
 #endif
 	char op_cond_pending;	/* 1 if we are waiting on an op_cond command */
+	char sd_op_cond_pending; /* 1 if we are waiting on an SD ACMD41 */
+	char sd_op_cond_uhs;	/* 1 if that ACMD41 asked for 1.8V signalling */
 	char init_in_progress;	/* 1 if we have done mmc_start_init() */
 	char preinit;		/* start init as early as possible */
 	int ddr_mode;
@@ -592,6 +661,10 @@ struct mmc {
 	u8 *ext_csd;
 	enum bus_mode selected_mode;
 	enum bus_mode best_mode;
+#ifdef CONFIG_BLK_ASYNC
+	struct blk_req *async_req;	/* read in flight, if any */
+	struct mmc_data async_data;	/* data of the transfer in flight */
+#endif
 };
 
 struct mmc_hwpart_conf {
@@ -666,6 +739,8 @@ int board_mmc_getwp(struct mmc *mmc);
 #endif
 
 int mmc_set_dsr(struct mmc *mmc, u16 val);
+/* Value of the bytes of erased blocks: 0, 0xff, or -ve if unknown */
+int mmc_erased_byte(struct mmc *mmc);
 /* Function to change the size of boot partition and rpmb partitions */
 int mmc_boot_partition_size_change(struct mmc *mmc, unsigned long bootsize,
 					unsigned long rpmbsize);
@@ -32,6 +32,12 @@
 
 #ifdef CONFIG_SYS_RX_ETH_BUFFER
 # define PKTBUFSRX	CONFIG_SYS_RX_ETH_BUFFER
+#elif CONFIG_TFTP_WINDOWSIZE >= 2
+/*
+ * Room for a TFTP window sent again after a lost block, the rest of the
+ * window before it, and the packet being handled
+ */
+# define PKTBUFSRX	(2 * CONFIG_TFTP_WINDOWSIZE + 1)
 #else
 # define PKTBUFSRX	4
 #endif
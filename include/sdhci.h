@@ -182,6 +182,7 @@
 /* 55-57 reserved */
 
 #define SDHCI_ADMA_ADDRESS	0x58
+#define SDHCI_ADMA_ADDRESS_HI	0x5C
 
 /* 60-FB reserved */
 
@@ -224,6 +225,33 @@ struct sdhci_host;
  */
 #define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG	(7)
+
+/*
+ * ADMA2 descriptor. The 32-bit form is 8 bytes long and stops after
+ * addr_lo; the 64-bit form (SDHCI 3.00, SDHCI_CAN_64BIT) is 12 bytes.
+ */
+struct sdhci_adma_desc {
+	__le16	attr;
+	__le16	len;
+	__le32	addr_lo;
+	__le32	addr_hi;
+} __packed;
+
+#define SDHCI_ADMA_DESC_32BIT_SIZE	8
+#define SDHCI_ADMA_DESC_64BIT_SIZE	12
+
+#define SDHCI_ADMA_VALID	BIT(0)
+#define SDHCI_ADMA_END		BIT(1)
+#define SDHCI_ADMA_INT		BIT(2)
+#define SDHCI_ADMA_NOP		0x00
+#define SDHCI_ADMA_TRAN		0x20
+#define SDHCI_ADMA_LINK		0x30
+
+/* A zero length field means 64KiB; data addresses must be 32-bit aligned */
+#define SDHCI_ADMA_MAX_LEN	65536
+#define SDHCI_ADMA_ALIGN	4
+#define SDHCI_ADMA_MASK		(SDHCI_ADMA_ALIGN - 1)
+
 struct sdhci_ops {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 	u32	(*read_l)(struct sdhci_host *host, int reg);
@@ -259,6 +287,12 @@ struct sdhci_host {
 	uint	voltages;
 
 	struct mmc_config cfg;
+#ifdef CONFIG_MMC_SDHCI_ADMA
+	void *adma_desc_table;	/* ADMA2 descriptor table */
+	uint adma_desc_size;	/* Size of one descriptor, 8 or 12 bytes */
+	uint adma_desc_count;	/* Number of descriptors in the table */
+	void *adma_align;	/* Bounce buffer for an unaligned head */
+#endif
 };
 
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
@@ -17,6 +17,19 @@ uint32_t crc32 (uint32_t, const unsigned char *, uint);
 uint32_t crc32_wd (uint32_t, const unsigned char *, uint, uint);
 uint32_t crc32_no_comp (uint32_t, const unsigned char *, uint);
 
+/**
+ * crc32_arch() - CRC32 without ones complement, using CPU instructions
+ *
+ * This is provided by the architecture when CONFIG_CRC32_ARCH is set, and
+ * crc32_no_comp() then simply calls it.
+ *
+ * @crc:	Previous CRC32 value, or seed
+ * @buf:	Data to process
+ * @len:	Number of bytes in @buf
+ * @return updated CRC32 value
+ */
+uint32_t crc32_arch(uint32_t crc, const unsigned char *buf, uint len);
+
 /**
  * crc32_wd_buf - Perform CRC32 on a buffer and return result in buffer
  *
@@ -1262,4 +1262,31 @@ int fdtdec_setup(void)
 	return fdtdec_prepare_fdt();
 }
 
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+int fdtdec_build_index(const void *blob)
+{
+	static void *index;
+	void *buf;
+	int size;
+
+	size = fdt_index_size(blob);
+	if (size < 0)
+		return -EINVAL;
+	buf = malloc(size);
+	if (!buf)
+		return -ENOMEM;
+
+	/* Keep the old index until the new one has replaced it */
+	if (fdt_index_init(blob, buf, size)) {
+		free(buf);
+		return -EINVAL;
+	}
+	free(index);
+	index = buf;
+	debug("%s: %d bytes of index for %p\n", __func__, size, blob);
+
+	return 0;
+}
+#endif
+
 #endif /* !USE_HOSTCC */
@@ -25,6 +25,13 @@
 #define RESERVED		0xe0
 #define DEFLATED		8
 
+/* Compressed input is pulled in this many bytes at a time */
+#ifdef CONFIG_SPL_BUILD
+#define GUNZIP_CHUNK_SIZE	(32 << 10)
+#else
+#define GUNZIP_CHUNK_SIZE	(256 << 10)
+#endif
+
 void *gzalloc(void *x, unsigned items, unsigned size)
 {
 	void *p;
@@ -42,10 +49,17 @@ void gzfree(void *x, void *addr, unsigned nb)
 	free (addr);
 }
 
-int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+/*
+ * Return the length of the gzip header at @src, or -1 if it is malformed
+ * or does not fit in the @len bytes available
+ */
+static int gzip_header_len(const unsigned char *src, unsigned long len)
 {
 	int i, flags;
 
+	if (len < 10)
+		goto short_header;
+
 	/* skip header */
 	i = 10;
 	flags = src[3];
@@ -53,24 +67,237 @@ int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
 		puts ("Error: Bad gzipped data\n");
 		return (-1);
 	}
-	if ((flags & EXTRA_FIELD) != 0)
+	if ((flags & EXTRA_FIELD) != 0) {
+		if (len < 12)
+			goto short_header;
 		i = 12 + src[10] + (src[11] << 8);
+	}
 	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & HEAD_CRC) != 0)
 		i += 2;
-	if (i >= *lenp) {
-		puts ("Error: gunzip out of data in header\n");
+	if (i >= len)
+		goto short_header;
+
+	return i;
+
+short_header:
+	puts ("Error: gunzip out of data in header\n");
+	return (-1);
+}
+
+int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+{
+	int i;
+
+	i = gzip_header_len(src, *lenp);
+	if (i < 0)
 		return (-1);
-	}
 
 	return zunzip(dst, dstlen, src, lenp, 1, i);
 }
 
+/* Fill @buf as far as possible, so that the gzip header is all there */
+static int gunzip_fill(gunzip_read_func read, void *priv, void *buf, int size)
+{
+	int len = 0;
+	int n;
+
+	while (len < size) {
+		n = read(priv, buf + len, size - len);
+		if (n < 0)
+			return n;
+		if (!n)
+			break;
+		len += n;
+	}
+
+	return len;
+}
+
+int gunzip_stream(void *dst, int dstlen, gunzip_read_func read, void *priv,
+		  unsigned long *lenp)
+{
+	unsigned char *buf;
+	z_stream s;
+	int len, i, r;
+	int err = -1;
+
+	buf = malloc_cache_aligned(GUNZIP_CHUNK_SIZE);
+	if (!buf) {
+		puts("Error: gunzip out of memory\n");
+		return -1;
+	}
+
+	len = gunzip_fill(read, priv, buf, GUNZIP_CHUNK_SIZE);
+	if (len < 0) {
+		printf("Error: gunzip read failed (%d)\n", len);
+		goto out_free;
+	}
+	i = gzip_header_len(buf, len);
+	if (i < 0)
+		goto out_free;
+
+	s.zalloc = gzalloc;
+	s.zfree = gzfree;
+
+	r = inflateInit2(&s, -MAX_WBITS);
+	if (r != Z_OK) {
+		printf("Error: inflateInit2() returned %d\n", r);
+		goto out_free;
+	}
+	s.next_in = buf + i;
+	s.avail_in = len - i;
+	s.next_out = dst;
+	s.avail_out = dstlen;
+
+	/* inflate what we have, then fetch the next chunk of input */
+	for (;;) {
+		r = inflate(&s, Z_NO_FLUSH);
+		if (r == Z_STREAM_END) {
+			err = 0;
+			break;
+		}
+		if (r != Z_OK && r != Z_BUF_ERROR) {
+			printf("Error: inflate() returned %d\n", r);
+			break;
+		}
+		if (s.avail_out == 0) {
+			puts("Error: gunzip output buffer too small\n");
+			break;
+		}
+		if (s.avail_in == 0) {
+			len = read(priv, buf, GUNZIP_CHUNK_SIZE);
+			if (len <= 0) {
+				if (len)
+					printf("Error: gunzip read failed (%d)\n",
+					       len);
+				else
+					puts("Error: gunzip out of data\n");
+				break;
+			}
+			s.next_in = buf;
+			s.avail_in = len;
+		}
+		WATCHDOG_RESET();
+	}
+	*lenp = s.next_out - (unsigned char *)dst;
+	inflateEnd(&s);
+
+out_free:
+	free(buf);
+
+	return err;
+}
+
+struct gunzip_blk_priv {
+	struct blk_desc *desc;
+	lbaint_t start;
+	lbaint_t blkcnt;
+#ifdef CONFIG_BLK_ASYNC
+	struct blk_req req;	/* Read of the next chunk into @next */
+	bool pending;		/* true if @req is in flight */
+	void *next;
+#endif
+};
+
+#ifdef CONFIG_BLK_ASYNC
+/* Start reading the chunk after the one being inflated */
+static int gunzip_blk_submit(struct gunzip_blk_priv *p, int size)
+{
+	lbaint_t n = size / p->desc->blksz;
+	int ret;
+
+	if (n > p->blkcnt)
+		n = p->blkcnt;
+	if (!n)
+		return 0;
+	if (!p->next) {
+		p->next = malloc_cache_aligned(size);
+		if (!p->next)
+			return -ENOMEM;
+	}
+	ret = blk_read_submit(p->desc, p->start, n, p->next, &p->req);
+	if (ret)
+		return ret;
+	p->pending = true;
+	p->start += n;
+	p->blkcnt -= n;
+
+	return n;
+}
+
+/*
+ * gunzip_stream() asks for the same @size every time, except after a short
+ * read at the end of the data, so each chunk fits in the caller's buffer.
+ */
+static int gunzip_blk_read(void *priv, void *buf, int size)
+{
+	struct gunzip_blk_priv *p = priv;
+	int len, ret;
+
+	if (!p->pending) {
+		ret = gunzip_blk_submit(p, size);
+		if (ret <= 0)
+			return ret;
+	}
+	p->pending = false;
+	if (blk_read_wait(&p->req) != p->req.blkcnt)
+		return -EIO;
+	len = p->req.blkcnt * p->desc->blksz;
+	memcpy(buf, p->next, len);
+
+	/* Keep the device busy while the caller inflates this chunk */
+	ret = gunzip_blk_submit(p, size);
+	if (ret < 0)
+		return ret;
+
+	return len;
+}
+#else
+static int gunzip_blk_read(void *priv, void *buf, int size)
+{
+	struct gunzip_blk_priv *p = priv;
+	lbaint_t n = size / p->desc->blksz;
+
+	if (n > p->blkcnt)
+		n = p->blkcnt;
+	if (!n)
+		return 0;
+	if (blk_dread(p->desc, p->start, n, buf) != n)
+		return -EIO;
+	p->start += n;
+	p->blkcnt -= n;
+
+	return n * p->desc->blksz;
+}
+#endif
+
+int gunzip_blk(void *dst, int dstlen, struct blk_desc *desc, lbaint_t start,
+	       lbaint_t blkcnt, unsigned long *lenp)
+{
+	struct gunzip_blk_priv priv = {
+		.desc = desc,
+		.start = start,
+		.blkcnt = blkcnt,
+	};
+	int ret;
+
+	ret = gunzip_stream(dst, dstlen, gunzip_blk_read, &priv, lenp);
+#ifdef CONFIG_BLK_ASYNC
+	/* The stream may end before the read-ahead chunk is used */
+	if (priv.pending)
+		blk_read_wait(&priv.req);
+	free(priv.next);
+#endif
+
+	return ret;
+}
+
 #ifdef CONFIG_CMD_UNZIP
 __weak
 void gzwrite_progress_init(u64 expectedsize)
@@ -111,7 +338,7 @@ int gzwrite(unsigned char *src, int len,
 	    u64 startoffs,
 	    u64 szexpected)
 {
-	int i, flags;
+	int i;
 	z_stream s;
 	int r = 0;
 	unsigned char *writebuf;
@@ -139,23 +366,9 @@ int gzwrite(unsigned char *src, int len,
 	blksperbuf = szwritebuf / dev->blksz;
 	outblock = lldiv(startoffs, dev->blksz);
 
-	/* skip header */
-	i = 10;
-	flags = src[3];
-	if (src[2] != DEFLATED || (flags & RESERVED) != 0) {
-		puts("Error: Bad gzipped data\n");
+	i = gzip_header_len(src, len);
+	if (i < 0)
 		return -1;
-	}
-	if ((flags & EXTRA_FIELD) != 0)
-		i = 12 + src[10] + (src[11] << 8);
-	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
-			;
-	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
-			;
-	if ((flags & HEAD_CRC) != 0)
-		i += 2;
 
 	if (i >= len-8) {
 		puts("Error: gunzip out of data in header");
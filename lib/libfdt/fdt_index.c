@@ -0,0 +1,228 @@
+/*
+ * libfdt - Flat Device Tree manipulation
+ *
+ * An index of a read-only tree, so that looking up a node by path,
+ * phandle or compatible string does not have to scan the tree from the
+ * start. The index holds each node's first child and next sibling, and
+ * tables of phandles and compatible strings sorted for binary search.
+ * Any change to the tree made through libfdt drops the index.
+ *
+ * SPDX-License-Identifier:	GPL-2.0+ BSD-2-Clause
+ */
+#include <libfdt_env.h>
+
+#ifndef USE_HOSTCC
+#include <fdt.h>
+#include <libfdt.h>
+#else
+#include "fdt_host.h"
+#endif
+
+#include "libfdt_internal.h"
+
+/* Deepest tree which can be indexed */
+#define FDT_INDEX_MAX_DEPTH	32
+
+#ifdef USE_HOSTCC
+static struct fdt_index *fdt_cur_index;
+#else
+/* This is read before relocation, when .bss cannot be used */
+static struct fdt_index *fdt_cur_index __attribute__((section(".data")));
+#endif
+
+static int _fdt_index_count(const void *fdt, int *nodesp, int *phandlesp,
+			    int *compatsp)
+{
+	int nodes = 0, phandles = 0, compats = 0;
+	int offset, depth = 0, len;
+	const char *list, *end;
+
+	for (offset = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+		if (depth >= FDT_INDEX_MAX_DEPTH)
+			return -FDT_ERR_BADSTRUCTURE;
+		nodes++;
+		if (fdt_get_phandle(fdt, offset))
+			phandles++;
+		list = fdt_getprop(fdt, offset, "compatible", &len);
+		for (end = list + len; list && list < end;
+		     list += strnlen(list, end - list) + 1)
+			compats++;
+	}
+	if (offset < 0 && offset != -FDT_ERR_NOTFOUND)
+		return offset;
+
+	*nodesp = nodes;
+	*phandlesp = phandles;
+	*compatsp = compats;
+
+	return 0;
+}
+
+static int _fdt_index_bytes(int nodes, int phandles, int compats)
+{
+	return sizeof(struct fdt_index) +
+		nodes * sizeof(struct fdt_index_node) +
+		(phandles + compats) * sizeof(struct fdt_index_entry);
+}
+
+int fdt_index_size(const void *fdt)
+{
+	int nodes, phandles, compats, err;
+
+	FDT_CHECK_HEADER(fdt);
+
+	err = _fdt_index_count(fdt, &nodes, &phandles, &compats);
+	if (err)
+		return err;
+
+	return _fdt_index_bytes(nodes, phandles, compats);
+}
+
+static int _fdt_index_entry_cmp(const struct fdt_index_entry *a,
+				const struct fdt_index_entry *b)
+{
+	if (a->key != b->key)
+		return a->key < b->key ? -1 : 1;
+
+	return a->node - b->node;
+}
+
+/* Shell sort, since libfdt has no qsort() */
+static void _fdt_index_sort(struct fdt_index_entry *entry, int count)
+{
+	struct fdt_index_entry tmp;
+	int gap, i, j;
+
+	for (gap = count / 2; gap > 0; gap /= 2) {
+		for (i = gap; i < count; i++) {
+			tmp = entry[i];
+			for (j = i; j >= gap &&
+			     _fdt_index_entry_cmp(&entry[j - gap], &tmp) > 0;
+			     j -= gap)
+				entry[j] = entry[j - gap];
+			entry[j] = tmp;
+		}
+	}
+}
+
+int fdt_index_init(const void *fdt, void *buf, int bufsize)
+{
+	int last[FDT_INDEX_MAX_DEPTH];
+	struct fdt_index *idx = buf;
+	struct fdt_index_node *node;
+	int nodes, phandles, compats, err;
+	int offset, depth = 0, len, i;
+	const char *list, *end;
+	uint32_t phandle;
+
+	FDT_CHECK_HEADER(fdt);
+
+	err = _fdt_index_count(fdt, &nodes, &phandles, &compats);
+	if (err)
+		return err;
+	if (bufsize < _fdt_index_bytes(nodes, phandles, compats))
+		return -FDT_ERR_NOSPACE;
+
+	_fdt_index_invalidate(fdt);
+	idx->fdt = fdt;
+	idx->struct_size = fdt_size_dt_struct(fdt);
+	idx->node = (struct fdt_index_node *)(idx + 1);
+	idx->phandle = (struct fdt_index_entry *)(idx->node + nodes);
+	idx->compat = idx->phandle + phandles;
+	idx->node_count = 0;
+	idx->phandle_count = 0;
+	idx->compat_count = 0;
+
+	/* @last holds the node most recently seen at each depth */
+	for (offset = 0; offset >= 0 && depth >= 0;
+	     offset = fdt_next_node(fdt, offset, &depth)) {
+		i = idx->node_count++;
+		node = &idx->node[i];
+		node->offset = offset;
+		node->first_child = -1;
+		node->next_sibling = -1;
+		if (depth > 0) {
+			if (last[depth] >= 0)
+				idx->node[last[depth]].next_sibling = i;
+			else
+				idx->node[last[depth - 1]].first_child = i;
+		}
+		last[depth] = i;
+		if (depth + 1 < FDT_INDEX_MAX_DEPTH)
+			last[depth + 1] = -1;
+
+		phandle = fdt_get_phandle(fdt, offset);
+		if (phandle) {
+			idx->phandle[idx->phandle_count].key = phandle;
+			idx->phandle[idx->phandle_count++].node = i;
+		}
+		list = fdt_getprop(fdt, offset, "compatible", &len);
+		for (end = list + len; list && list < end;
+		     list += strnlen(list, end - list) + 1) {
+			idx->compat[idx->compat_count].key =
+				_fdt_hash(list);
+			idx->compat[idx->compat_count++].node = i;
+		}
+	}
+	_fdt_index_sort(idx->phandle, idx->phandle_count);
+	_fdt_index_sort(idx->compat, idx->compat_count);
+	fdt_cur_index = idx;
+
+	return 0;
+}
+
+const struct fdt_index *_fdt_index(const void *fdt)
+{
+	const struct fdt_index *idx = fdt_cur_index;
+
+	/* Guard against the tree being changed behind libfdt's back */
+	if (!idx || idx->fdt != fdt ||
+	    idx->struct_size != fdt_size_dt_struct(fdt))
+		return NULL;
+
+	return idx;
+}
+
+void _fdt_index_invalidate(const void *fdt)
+{
+	if (fdt_cur_index && fdt_cur_index->fdt == fdt)
+		fdt_cur_index = NULL;
+}
+
+int _fdt_index_find_node(const struct fdt_index *idx, int offset)
+{
+	int low = 0, high = idx->node_count - 1;
+
+	while (low <= high) {
+		int mid = (low + high) / 2;
+
+		if (idx->node[mid].offset == offset)
+			return mid;
+		if (idx->node[mid].offset < offset)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+
+	return -1;
+}
+
+int _fdt_index_find_entry(const struct fdt_index_entry *entry, int count,
+			  uint32_t key, int after)
+{
+	struct fdt_index_entry want = { .key = key, .node = after + 1 };
+	int low = 0, high = count;
+
+	/* Find the first entry which is not less than @want */
+	while (low < high) {
+		int mid = (low + high) / 2;
+
+		if (_fdt_index_entry_cmp(&entry[mid], &want) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
@@ -5,6 +5,203 @@
 
 #include "libfdt_internal.h"
 
+/*
+ * An entry in a session's index. For a phandle, @key is the phandle and
+ * @offset the node. For a symbol, @key is the hash of the label, @offset
+ * the property in /__symbols__ and @node the node it points to, once
+ * looked up.
+ */
+struct fdt_overlay_ref {
+	uint32_t key;
+	int offset;
+	int node;
+};
+
+static int overlay_ref_cmp(const struct fdt_overlay_ref *a,
+			   const struct fdt_overlay_ref *b)
+{
+	if (a->key != b->key)
+		return a->key < b->key ? -1 : 1;
+
+	return a->offset - b->offset;
+}
+
+/* Shell sort, since libfdt has no qsort() */
+static void overlay_ref_sort(struct fdt_overlay_ref *ref, int count)
+{
+	struct fdt_overlay_ref tmp;
+	int gap, i, j;
+
+	for (gap = count / 2; gap > 0; gap /= 2) {
+		for (i = gap; i < count; i++) {
+			tmp = ref[i];
+			for (j = i; j >= gap &&
+			     overlay_ref_cmp(&ref[j - gap], &tmp) > 0; j -= gap)
+				ref[j] = ref[j - gap];
+			ref[j] = tmp;
+		}
+	}
+}
+
+/* Find the first entry with the given key, or @count if none */
+static int overlay_ref_find(const struct fdt_overlay_ref *ref, int count,
+			    uint32_t key)
+{
+	int low = 0, high = count;
+
+	while (low < high) {
+		int mid = (low + high) / 2;
+
+		if (ref[mid].key < key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low < count && ref[low].key == key ? low : count;
+}
+
+/**
+ * overlay_session_moved - Adjust a session's index after a base change
+ * @session: Overlay session
+ * @target: Node offset in the base device tree which was changed
+ * @old_size: Size of the structure block before the change
+ *
+ * Adding a property or subnode to @target, or resizing one of its
+ * properties, moves everything after @target's properties along by the
+ * same amount. Property offsets within @target itself may come out wrong
+ * here, which is why each lookup checks the entry it finds.
+ */
+static void overlay_session_moved(struct fdt_overlay_session *session,
+				  int target, int old_size)
+{
+	int delta = fdt_size_dt_struct(session->fdt) - old_size;
+	struct fdt_overlay_ref *ref;
+	int i;
+
+	if (!delta)
+		return;
+
+	if (session->symbols > target)
+		session->symbols += delta;
+
+	for (i = 0; i < session->phandle_count; i++) {
+		ref = &session->phandle[i];
+		if (ref->offset > target)
+			ref->offset += delta;
+	}
+
+	for (i = 0; i < session->symbol_count; i++) {
+		ref = &session->symbol[i];
+		if (ref->offset > target)
+			ref->offset += delta;
+		if (ref->node > target)
+			ref->node += delta;
+	}
+}
+
+/**
+ * overlay_node_by_phandle - Find a base node from its phandle
+ * @session: Overlay session
+ * @phandle: Phandle to look for
+ *
+ * returns:
+ *      the node offset in the base device tree
+ *      Negative error code on error
+ */
+static int overlay_node_by_phandle(struct fdt_overlay_session *session,
+				   uint32_t phandle)
+{
+	void *fdt = session->fdt;
+	int i;
+
+	i = overlay_ref_find(session->phandle, session->phandle_count,
+			     phandle);
+	if (i < session->phandle_count &&
+	    fdt_get_phandle(fdt, session->phandle[i].offset) == phandle)
+		return session->phandle[i].offset;
+
+	/* Not indexed, e.g. added by an earlier overlay */
+	return fdt_node_offset_by_phandle(fdt, phandle);
+}
+
+/**
+ * overlay_symbols_offset - Find /__symbols__ in the base device tree
+ * @session: Overlay session
+ *
+ * returns:
+ *      the node offset of /__symbols__ in the base device tree
+ *      Negative error code on error
+ */
+static int overlay_symbols_offset(struct fdt_overlay_session *session)
+{
+	const char *name;
+
+	if (session->symbols >= 0) {
+		name = fdt_get_name(session->fdt, session->symbols, NULL);
+		if (name && !strcmp(name, "__symbols__"))
+			return session->symbols;
+	}
+	session->symbols = fdt_path_offset(session->fdt, "/__symbols__");
+
+	return session->symbols;
+}
+
+/**
+ * overlay_symbol_node - Find the base node a label points to
+ * @session: Overlay session
+ * @symbols_off: Node offset of the symbols node in the base device tree
+ * @label: Label to look up in the symbols node
+ *
+ * returns:
+ *      the node offset in the base device tree
+ *      Negative error code on error
+ */
+static int overlay_symbol_node(struct fdt_overlay_session *session,
+			       int symbols_off, const char *label)
+{
+	struct fdt_overlay_ref *ref = NULL;
+	void *fdt = session->fdt;
+	const char *symbol_path;
+	const char *name;
+	uint32_t hash;
+	int prop_len;
+	int node;
+	int i;
+
+	if (symbols_off < 0)
+		return symbols_off;
+
+	hash = _fdt_hash(label);
+	for (i = overlay_ref_find(session->symbol, session->symbol_count,
+				  hash);
+	     i < session->symbol_count && session->symbol[i].key == hash;
+	     i++) {
+		symbol_path = fdt_getprop_by_offset(fdt,
+						    session->symbol[i].offset,
+						    &name, &prop_len);
+		if (symbol_path && !strcmp(name, label)) {
+			ref = &session->symbol[i];
+			break;
+		}
+	}
+
+	if (ref && ref->node >= 0)
+		return ref->node;
+
+	if (!ref) {
+		symbol_path = fdt_getprop(fdt, symbols_off, label, &prop_len);
+		if (!symbol_path)
+			return prop_len;
+	}
+
+	node = fdt_path_offset(fdt, symbol_path);
+	if (ref && node >= 0)
+		ref->node = node;
+
+	return node;
+}
+
 /**
  * overlay_get_target_phandle - retrieves the target phandle of a fragment
  * @fdto: pointer to the device tree overlay blob
@@ -36,7 +233,7 @@ static uint32_t overlay_get_target_phandle(const void *fdto, int fragment)
 
 /**
  * overlay_get_target - retrieves the offset of a fragment's target
- * @fdt: Base device tree blob
+ * @session: Overlay session
  * @fdto: Device tree overlay blob
  * @fragment: node offset of the fragment in the overlay
  *
@@ -48,8 +245,8 @@ static uint32_t overlay_get_target_phandle(const void *fdto, int fragment)
  *      the targetted node offset in the base device tree
  *      Negative error code on error
  */
-static int overlay_get_target(const void *fdt, const void *fdto,
-			      int fragment)
+static int overlay_get_target(struct fdt_overlay_session *session,
+			      const void *fdto, int fragment)
 {
 	uint32_t phandle;
 	const char *path;
@@ -61,7 +258,7 @@ static int overlay_get_target(const void *fdt, const void *fdto,
 		return -FDT_ERR_BADPHANDLE;
 
 	if (phandle)
-		return fdt_node_offset_by_phandle(fdt, phandle);
+		return overlay_node_by_phandle(session, phandle);
 
 	/* And then a path based lookup */
 	path = fdt_getprop(fdto, fragment, "target-path", &path_len);
@@ -79,7 +276,7 @@ static int overlay_get_target(const void *fdt, const void *fdto,
 		return path_len;
 	}
 
-	return fdt_path_offset(fdt, path);
+	return fdt_path_offset(session->fdt, path);
 }
 
 /**
@@ -327,7 +524,7 @@ static int overlay_update_local_references(void *fdto, uint32_t delta)
 
 /**
  * overlay_fixup_one_phandle - Set an overlay phandle to the base one
- * @fdt: Base Device Tree blob
+ * @session: Overlay session
  * @fdto: Device tree overlay blob
  * @symbols_off: Node offset of the symbols node in the base device tree
  * @path: Path to a node holding a phandle in the overlay
@@ -348,30 +545,20 @@ static int overlay_update_local_references(void *fdto, uint32_t delta)
  *      0 on success
  *      Negative error code on failure
  */
-static int overlay_fixup_one_phandle(void *fdt, void *fdto,
-				     int symbols_off,
+static int overlay_fixup_one_phandle(struct fdt_overlay_session *session,
+				     void *fdto, int symbols_off,
 				     const char *path, uint32_t path_len,
 				     const char *name, uint32_t name_len,
 				     int poffset, const char *label)
 {
-	const char *symbol_path;
 	uint32_t phandle;
 	int symbol_off, fixup_off;
-	int prop_len;
 
-	if (symbols_off < 0)
-		return symbols_off;
-
-	symbol_path = fdt_getprop(fdt, symbols_off, label,
-				  &prop_len);
-	if (!symbol_path)
-		return prop_len;
-
-	symbol_off = fdt_path_offset(fdt, symbol_path);
+	symbol_off = overlay_symbol_node(session, symbols_off, label);
 	if (symbol_off < 0)
 		return symbol_off;
 
-	phandle = fdt_get_phandle(fdt, symbol_off);
+	phandle = fdt_get_phandle(session->fdt, symbol_off);
 	if (!phandle)
 		return -FDT_ERR_NOTFOUND;
 
@@ -389,7 +576,7 @@ static int overlay_fixup_one_phandle(void *fdt, void *fdto,
 
 /**
  * overlay_fixup_phandle - Set an overlay phandle to the base one
- * @fdt: Base Device Tree blob
+ * @session: Overlay session
  * @fdto: Device tree overlay blob
  * @symbols_off: Node offset of the symbols node in the base device tree
  * @property: Property offset in the overlay holding the list of fixups
@@ -406,8 +593,8 @@ static int overlay_fixup_one_phandle(void *fdt, void *fdto,
  *      0 on success
  *      Negative error code on failure
  */
-static int overlay_fixup_phandle(void *fdt, void *fdto, int symbols_off,
-				 int property)
+static int overlay_fixup_phandle(struct fdt_overlay_session *session,
+				 void *fdto, int symbols_off, int property)
 {
 	const char *value;
 	const char *label;
@@ -461,7 +648,7 @@ static int overlay_fixup_phandle(void *fdt, void *fdto, int symbols_off,
 		if ((*endptr != '\0') || (endptr <= (sep + 1)))
 			return -FDT_ERR_BADOVERLAY;
 
-		ret = overlay_fixup_one_phandle(fdt, fdto, symbols_off,
+		ret = overlay_fixup_one_phandle(session, fdto, symbols_off,
 						path, path_len, name, name_len,
 						poffset, label);
 		if (ret)
@@ -474,7 +661,7 @@ static int overlay_fixup_phandle(void *fdt, void *fdto, int symbols_off,
 /**
  * overlay_fixup_phandles - Resolve the overlay phandles to the base
  *                          device tree
- * @fdt: Base Device Tree blob
+ * @session: Overlay session
  * @fdto: Device tree overlay blob
  *
  * overlay_fixup_phandles() resolves all the overlay phandles pointing
@@ -488,7 +675,8 @@ static int overlay_fixup_phandle(void *fdt, void *fdto, int symbols_off,
  *      0 on success
  *      Negative error code on failure
  */
-static int overlay_fixup_phandles(void *fdt, void *fdto)
+static int overlay_fixup_phandles(struct fdt_overlay_session *session,
+				  void *fdto)
 {
 	int fixups_off, symbols_off;
 	int property;
@@ -501,14 +689,15 @@ static int overlay_fixup_phandles(void *fdt, void *fdto)
 		return fixups_off;
 
 	/* And base DTs without symbols */
-	symbols_off = fdt_path_offset(fdt, "/__symbols__");
+	symbols_off = overlay_symbols_offset(session);
 	if ((symbols_off < 0 && (symbols_off != -FDT_ERR_NOTFOUND)))
 		return symbols_off;
 
 	fdt_for_each_property_offset(property, fdto, fixups_off) {
 		int ret;
 
-		ret = overlay_fixup_phandle(fdt, fdto, symbols_off, property);
+		ret = overlay_fixup_phandle(session, fdto, symbols_off,
+					    property);
 		if (ret)
 			return ret;
 	}
@@ -518,7 +707,7 @@ static int overlay_fixup_phandles(void *fdt, void *fdto)
 
 /**
  * overlay_apply_node - Merges a node into the base device tree
- * @fdt: Base Device Tree blob
+ * @session: Overlay session
  * @target: Node offset in the base device tree to apply the fragment to
  * @fdto: Device tree overlay blob
  * @node: Node offset in the overlay holding the changes to merge
@@ -535,9 +724,10 @@ static int overlay_fixup_phandles(void *fdt, void *fdto)
  *      0 on success
  *      Negative error code on failure
  */
-static int overlay_apply_node(void *fdt, int target,
-			      void *fdto, int node)
+static int overlay_apply_node(struct fdt_overlay_session *session,
+			      int target, void *fdto, int node)
 {
+	void *fdt = session->fdt;
 	int property;
 	int subnode;
 
@@ -545,6 +735,7 @@ static int overlay_apply_node(void *fdt, int target,
 		const char *name;
 		const void *prop;
 		int prop_len;
+		int size;
 		int ret;
 
 		prop = fdt_getprop_by_offset(fdto, property, &name,
@@ -554,27 +745,50 @@ static int overlay_apply_node(void *fdt, int target,
 		if (prop_len < 0)
 			return prop_len;
 
-		ret = fdt_setprop(fdt, target, name, prop, prop_len);
+		/*
+		 * Overwrite a property of the same size where it is, rather
+		 * than moving the rest of the tree about
+		 */
+		ret = fdt_setprop_inplace(fdt, target, name, prop, prop_len);
+		if (ret == -FDT_ERR_NOTFOUND || ret == -FDT_ERR_NOSPACE) {
+			size = fdt_size_dt_struct(fdt);
+			ret = fdt_setprop(fdt, target, name, prop, prop_len);
+			overlay_session_moved(session, target, size);
+		}
 		if (ret)
 			return ret;
+
+		if (prop_len == sizeof(uint32_t) &&
+		    (!strcmp(name, "phandle") ||
+		     !strcmp(name, "linux,phandle"))) {
+			uint32_t phandle = fdt32_to_cpu(*(fdt32_t *)prop);
+
+			if (phandle != (uint32_t)-1 &&
+			    phandle > session->max_phandle)
+				session->max_phandle = phandle;
+		}
 	}
 
 	fdt_for_each_subnode(subnode, fdto, node) {
 		const char *name = fdt_get_name(fdto, subnode, NULL);
 		int nnode;
+		int size;
 		int ret;
 
+		size = fdt_size_dt_struct(fdt);
 		nnode = fdt_add_subnode(fdt, target, name);
 		if (nnode == -FDT_ERR_EXISTS) {
 			nnode = fdt_subnode_offset(fdt, target, name);
 			if (nnode == -FDT_ERR_NOTFOUND)
 				return -FDT_ERR_INTERNAL;
+		} else {
+			overlay_session_moved(session, target, size);
 		}
 
 		if (nnode < 0)
 			return nnode;
 
-		ret = overlay_apply_node(fdt, nnode, fdto, subnode);
+		ret = overlay_apply_node(session, nnode, fdto, subnode);
 		if (ret)
 			return ret;
 	}
@@ -584,7 +798,7 @@ static int overlay_apply_node(void *fdt, int target,
 
 /**
  * overlay_merge - Merge an overlay into its base device tree
- * @fdt: Base Device Tree blob
+ * @session: Overlay session
  * @fdto: Device tree overlay blob
  *
  * overlay_merge() merges an overlay into its base device tree.
@@ -597,7 +811,7 @@ static int overlay_apply_node(void *fdt, int target,
  *      0 on success
  *      Negative error code on failure
  */
-static int overlay_merge(void *fdt, void *fdto)
+static int overlay_merge(struct fdt_overlay_session *session, void *fdto)
 {
 	int fragment;
 
@@ -617,11 +831,11 @@ static int overlay_merge(void *fdt, void *fdto)
 		if (overlay < 0)
 			return overlay;
 
-		target = overlay_get_target(fdt, fdto, fragment);
+		target = overlay_get_target(session, fdto, fragment);
 		if (target < 0)
 			return target;
 
-		ret = overlay_apply_node(fdt, target, fdto, overlay);
+		ret = overlay_apply_node(session, target, fdto, overlay);
 		if (ret)
 			return ret;
 	}
@@ -629,9 +843,144 @@ static int overlay_merge(void *fdt, void *fdto)
 	return 0;
 }
 
-int fdt_overlay_apply(void *fdt, void *fdto)
+/**
+ * overlay_session_count - Count what a session indexes in a base tree
+ * @fdt: Base Device Tree blob
+ * @symbols_off: Node offset of the symbols node in the base device tree
+ * @max_phandlep: Returns the highest phandle in the tree
+ * @phandlesp: Returns the number of nodes with a phandle
+ * @symbolsp: Returns the number of properties in the symbols node
+ *
+ * returns:
+ *      0 on success
+ *      Negative error code on failure
+ */
+static int overlay_session_count(const void *fdt, int symbols_off,
+				 uint32_t *max_phandlep, int *phandlesp,
+				 int *symbolsp)
+{
+	uint32_t max_phandle = 0;
+	int phandles = 0, symbols = 0;
+	int offset;
+
+	for (offset = fdt_next_node(fdt, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(fdt, offset, NULL)) {
+		uint32_t phandle = fdt_get_phandle(fdt, offset);
+
+		if (!phandle || phandle == (uint32_t)-1)
+			continue;
+		phandles++;
+		if (phandle > max_phandle)
+			max_phandle = phandle;
+	}
+	if (offset != -FDT_ERR_NOTFOUND)
+		return offset;
+
+	if (symbols_off >= 0) {
+		fdt_for_each_property_offset(offset, fdt, symbols_off)
+			symbols++;
+		if (offset != -FDT_ERR_NOTFOUND)
+			return offset;
+	}
+
+	*max_phandlep = max_phandle;
+	*phandlesp = phandles;
+	*symbolsp = symbols;
+
+	return 0;
+}
+
+int fdt_overlay_session_size(const void *fdt)
 {
-	uint32_t delta = fdt_get_max_phandle(fdt);
+	uint32_t max_phandle;
+	int phandles, symbols;
+	int symbols_off;
+	int ret;
+
+	FDT_CHECK_HEADER(fdt);
+
+	symbols_off = fdt_path_offset(fdt, "/__symbols__");
+	if (symbols_off < 0 && symbols_off != -FDT_ERR_NOTFOUND)
+		return symbols_off;
+
+	ret = overlay_session_count(fdt, symbols_off, &max_phandle,
+				    &phandles, &symbols);
+	if (ret)
+		return ret;
+
+	return (phandles + symbols) * sizeof(struct fdt_overlay_ref);
+}
+
+int fdt_overlay_session_init(struct fdt_overlay_session *session, void *fdt,
+			     void *buf, int bufsize)
+{
+	struct fdt_overlay_ref *ref;
+	int phandles, symbols;
+	const char *name;
+	int offset;
+	int ret;
+
+	FDT_CHECK_HEADER(fdt);
+
+	session->fdt = fdt;
+	session->phandle = NULL;
+	session->symbol = NULL;
+	session->phandle_count = 0;
+	session->symbol_count = 0;
+	session->symbols = fdt_path_offset(fdt, "/__symbols__");
+	if (session->symbols < 0 && session->symbols != -FDT_ERR_NOTFOUND)
+		return session->symbols;
+
+	ret = overlay_session_count(fdt, session->symbols,
+				    &session->max_phandle, &phandles,
+				    &symbols);
+	if (ret)
+		return ret;
+
+	/* Without an index, nodes are found by scanning the tree */
+	if (!buf)
+		return 0;
+	if (bufsize < (int)((phandles + symbols) *
+			    sizeof(struct fdt_overlay_ref)))
+		return -FDT_ERR_NOSPACE;
+
+	session->phandle = buf;
+	session->symbol = session->phandle + phandles;
+
+	for (offset = fdt_next_node(fdt, -1, NULL); offset >= 0;
+	     offset = fdt_next_node(fdt, offset, NULL)) {
+		uint32_t phandle = fdt_get_phandle(fdt, offset);
+
+		if (!phandle || phandle == (uint32_t)-1)
+			continue;
+		ref = &session->phandle[session->phandle_count++];
+		ref->key = phandle;
+		ref->offset = offset;
+		ref->node = -1;
+	}
+
+	if (session->symbols >= 0) {
+		fdt_for_each_property_offset(offset, fdt, session->symbols) {
+			if (!fdt_getprop_by_offset(fdt, offset, &name, NULL))
+				continue;
+			ref = &session->symbol[session->symbol_count++];
+			ref->key = _fdt_hash(name);
+			ref->offset = offset;
+			ref->node = -1;
+		}
+	}
+
+	overlay_ref_sort(session->phandle, session->phandle_count);
+	overlay_ref_sort(session->symbol, session->symbol_count);
+
+	return 0;
+}
+
+int fdt_overlay_session_apply(struct fdt_overlay_session *session,
+			      void *fdto)
+{
+	uint32_t delta = session->max_phandle;
+	void *fdt = session->fdt;
 	int ret;
 
 	FDT_CHECK_HEADER(fdt);
@@ -645,11 +994,11 @@ int fdt_overlay_apply(void *fdt, void *fdto)
 	if (ret)
 		goto err;
 
-	ret = overlay_fixup_phandles(fdt, fdto);
+	ret = overlay_fixup_phandles(session, fdto);
 	if (ret)
 		goto err;
 
-	ret = overlay_merge(fdt, fdto);
+	ret = overlay_merge(session, fdto);
 	if (ret)
 		goto err;
 
@@ -674,3 +1023,15 @@ err:
 
 	return ret;
 }
+
+int fdt_overlay_apply(void *fdt, void *fdto)
+{
+	struct fdt_overlay_session session;
+	int ret;
+
+	ret = fdt_overlay_session_init(&session, fdt, NULL, 0);
+	if (ret)
+		return ret;
+
+	return fdt_overlay_session_apply(&session, fdto);
+}
@@ -117,10 +117,23 @@ static int _nextprop(const void *fdt, int offset)
 int fdt_subnode_offset_namelen(const void *fdt, int offset,
 			       const char *name, int namelen)
 {
-	int depth;
+	const struct fdt_index *idx;
+	int depth, i;
 
 	FDT_CHECK_HEADER(fdt);
 
+	idx = _fdt_index(fdt);
+	i = idx ? _fdt_index_find_node(idx, offset) : -1;
+	if (i >= 0) {
+		for (i = idx->node[i].first_child; i >= 0;
+		     i = idx->node[i].next_sibling) {
+			if (_fdt_nodename_eq(fdt, idx->node[i].offset, name,
+					     namelen))
+				return idx->node[i].offset;
+		}
+		return -FDT_ERR_NOTFOUND;
+	}
+
 	for (depth = 0;
 	     (offset >= 0) && (depth >= 0);
 	     offset = fdt_next_node(fdt, offset, &depth))
@@ -503,13 +516,23 @@ int fdt_node_offset_by_prop_value(const void *fdt, int startoffset,
 
 int fdt_node_offset_by_phandle(const void *fdt, uint32_t phandle)
 {
-	int offset;
+	const struct fdt_index *idx;
+	int offset, i;
 
 	if ((phandle == 0) || (phandle == -1))
 		return -FDT_ERR_BADPHANDLE;
 
 	FDT_CHECK_HEADER(fdt);
 
+	idx = _fdt_index(fdt);
+	if (idx) {
+		i = _fdt_index_find_entry(idx->phandle, idx->phandle_count,
+					  phandle, -1);
+		if (i < idx->phandle_count && idx->phandle[i].key == phandle)
+			return idx->node[idx->phandle[i].node].offset;
+		return -FDT_ERR_NOTFOUND;
+	}
+
 	/* FIXME: The algorithm here is pretty horrible: we
 	 * potentially scan each property of a node in
 	 * fdt_get_phandle(), then if that didn't find what
@@ -659,10 +682,28 @@ int fdt_node_check_compatible(const void *fdt, int nodeoffset,
 int fdt_node_offset_by_compatible(const void *fdt, int startoffset,
 				  const char *compatible)
 {
-	int offset, err;
+	const struct fdt_index *idx;
+	int offset, err, after, i;
+	uint32_t hash;
 
 	FDT_CHECK_HEADER(fdt);
 
+	idx = _fdt_index(fdt);
+	after = idx && startoffset >= 0 ?
+		_fdt_index_find_node(idx, startoffset) : -1;
+	if (idx && (startoffset < 0 || after >= 0)) {
+		hash = _fdt_hash(compatible);
+		for (i = _fdt_index_find_entry(idx->compat, idx->compat_count,
+					       hash, after);
+		     i < idx->compat_count && idx->compat[i].key == hash;
+		     i++) {
+			offset = idx->node[idx->compat[i].node].offset;
+			if (!fdt_node_check_compatible(fdt, offset, compatible))
+				return offset;
+		}
+		return -FDT_ERR_NOTFOUND;
+	}
+
 	/* FIXME: The algorithm here is pretty horrible: we scan each
 	 * property of a node in fdt_node_check_compatible(), then if
 	 * that didn't find what we want, we scan over them again
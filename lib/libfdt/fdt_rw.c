@@ -28,6 +28,8 @@ static int _fdt_blocks_misordered(const void *fdt,
 
 static int _fdt_rw_check_header(void *fdt)
 {
+	/* Every change goes through here, so drop any index of the tree */
+	_fdt_index_invalidate(fdt);
 	FDT_CHECK_HEADER(fdt);
 
 	if (fdt_version(fdt) < 17)
@@ -379,6 +381,7 @@ int fdt_open_into(const void *fdt, void *buf, int bufsize)
 	const char *fdtend = fdtstart + fdt_totalsize(fdt);
 	char *tmp;
 
+	_fdt_index_invalidate(buf);
 	FDT_CHECK_HEADER(fdt);
 
 	mem_rsv_size = (fdt_num_mem_rsv(fdt)+1)
@@ -459,6 +462,7 @@ int fdt_remove_unused_strings(const void *old, void *new)
 	int tag = FDT_PROP;
 
 	/* Make a copy and remove the strings */
+	_fdt_index_invalidate(new);
 	memcpy(new, old, size);
 	fdt_set_size_dt_strings(new, 0);
 
@@ -14,6 +14,18 @@
 
 #include "libfdt_internal.h"
 
+/*
+ * Changing a property in place moves nothing, so an index of the tree is
+ * only out of date if the property is one that it records
+ */
+static void _fdt_index_prop_changed(void *fdt, const char *name, int namelen)
+{
+	if ((namelen == 7 && !memcmp(name, "phandle", 7)) ||
+	    (namelen == 13 && !memcmp(name, "linux,phandle", 13)) ||
+	    (namelen == 10 && !memcmp(name, "compatible", 10)))
+		_fdt_index_invalidate(fdt);
+}
+
 int fdt_setprop_inplace_namelen_partial(void *fdt, int nodeoffset,
 					const char *name, int namelen,
 					uint32_t idx, const void *val,
@@ -30,6 +42,7 @@ int fdt_setprop_inplace_namelen_partial(void *fdt, int nodeoffset,
 	if (proplen < (len + idx))
 		return -FDT_ERR_NOSPACE;
 
+	_fdt_index_prop_changed(fdt, name, namelen);
 	memcpy((char *)propval + idx, val, len);
 	return 0;
 }
@@ -69,6 +82,7 @@ int fdt_nop_property(void *fdt, int nodeoffset, const char *name)
 	if (!prop)
 		return len;
 
+	_fdt_index_prop_changed(fdt, name, strlen(name));
 	_fdt_nop_region(prop, len + sizeof(*prop));
 
 	return 0;
@@ -92,6 +106,7 @@ int fdt_nop_node(void *fdt, int nodeoffset)
 	if (endoffset < 0)
 		return endoffset;
 
+	_fdt_index_invalidate(fdt);
 	_fdt_nop_region(fdt_offset_ptr_w(fdt, nodeoffset, 0),
 			endoffset - nodeoffset);
 	return 0;
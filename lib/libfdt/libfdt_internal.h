@@ -47,4 +47,71 @@ static inline struct fdt_reserve_entry *_fdt_mem_rsv_w(void *fdt, int n)
 
 #define FDT_SW_MAGIC		(~FDT_MAGIC)
 
+/*
+ * Index of a tree, see fdt_index_init(). Nodes are in tree order, so
+ * sorted by offset. Phandle and compatible-string entries are sorted by
+ * key and then by node.
+ */
+struct fdt_index_node {
+	int offset;
+	int first_child;	/* node index, -1 if none */
+	int next_sibling;	/* node index, -1 if none */
+};
+
+struct fdt_index_entry {
+	uint32_t key;		/* phandle, or hash of compatible string */
+	int node;		/* node index */
+};
+
+struct fdt_index {
+	const void *fdt;
+	uint32_t struct_size;	/* to spot changes made without libfdt */
+	int node_count;
+	int phandle_count;
+	int compat_count;
+	struct fdt_index_node *node;
+	struct fdt_index_entry *phandle;
+	struct fdt_index_entry *compat;
+};
+
+/* djb2 hash of a string, used to key the index and overlay symbol tables */
+static inline uint32_t _fdt_hash(const char *str)
+{
+	uint32_t hash = 5381;
+
+	while (*str)
+		hash = hash * 33 + (unsigned char)*str++;
+
+	return hash;
+}
+
+#ifdef FDT_INDEX
+const struct fdt_index *_fdt_index(const void *fdt);
+void _fdt_index_invalidate(const void *fdt);
+int _fdt_index_find_node(const struct fdt_index *idx, int offset);
+int _fdt_index_find_entry(const struct fdt_index_entry *entry, int count,
+			  uint32_t key, int after);
+#else
+static inline const struct fdt_index *_fdt_index(const void *fdt)
+{
+	return NULL;
+}
+
+static inline void _fdt_index_invalidate(const void *fdt)
+{
+}
+
+static inline int _fdt_index_find_node(const struct fdt_index *idx,
+				       int offset)
+{
+	return -1;
+}
+
+static inline int _fdt_index_find_entry(const struct fdt_index_entry *entry,
+					int count, uint32_t key, int after)
+{
+	return 0;
+}
+#endif
+
 #endif /* _LIBFDT_INTERNAL_H */
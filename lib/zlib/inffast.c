@@ -65,7 +65,55 @@
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
       output space.
+
+    - With a 64-bit bit buffer, one refill at the top of the loop provides
+      at least 48 bits, enough for a whole length/distance pair, so the
+      refills further down are never taken.  While at least eight bytes of
+      input remain the refill is a single unaligned load.  The load may put
+      part of the next, unconsumed byte above the valid bits in hold; that
+      is harmless because bytes are always merged into hold with "|" and
+      the same byte is merged at the same position on the next refill.
+ */
+/*
+   Copy a match of len bytes from dist bytes back in the output, a machine
+   word at a time where possible.  When dist is smaller than a word the
+   source and destination overlap, and the output repeats with period dist.
+   In that case a few bytes are copied one at a time first, after which the
+   copy can continue from the nearest multiple of dist that is at least a
+   word back, with whole words again (like LZ4_copy8 in lib/lz4.c).
  */
+local inline void inflate_copy_match(unsigned char FAR *out, unsigned dist,
+                                     unsigned len)
+{
+    unsigned char FAR *from = out - dist;
+    unsigned step, n;
+
+    if (dist == 1) {                    /* run of a single byte */
+        memset(out, *from, len);
+        return;
+    }
+    if (dist < sizeof(unsigned long)) {
+        for (step = dist; step < sizeof(unsigned long); step += dist)
+            ;
+        n = step - dist;
+        if (n > len)
+            n = len;
+        len -= n;
+        while (n--)
+            *out++ = *from++;
+        from = out - step;
+    }
+    while (len >= sizeof(unsigned long)) {
+        put_unaligned(get_unaligned((unsigned long *)from),
+                      (unsigned long *)out);
+        out += sizeof(unsigned long);
+        from += sizeof(unsigned long);
+        len -= sizeof(unsigned long);
+    }
+    while (len--)
+        *out++ = *from++;
+}
+
 void inflate_fast(z_streamp strm, unsigned start)
 /* start: inflate()'s starting value for strm->avail_out */
 {
@@ -94,6 +142,7 @@ void inflate_fast(z_streamp strm, unsigned start)
     unsigned len;               /* match length, unused bytes */
     unsigned dist;              /* match distance */
     unsigned char FAR *from;    /* where to copy match from */
+    int direct;                 /* rest of match is from output */
 
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
@@ -127,12 +176,28 @@ void inflate_fast(z_streamp strm, unsigned start)
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
+#if BITS_PER_LONG == 64
+        if (bits < 48) {
+            if (last - in >= 3) {       /* at least eight bytes left */
+                hold |= get_unaligned_le64(in + OFF) << bits;
+                in += (63 - bits) >> 3;
+                bits |= 56;
+            }
+            else {
+                do {
+                    hold |= (unsigned long)(PUP(in)) << bits;
+                    bits += 8;
+                } while (bits < 48);
+            }
+        }
+#else
         if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
+            hold |= (unsigned long)(PUP(in)) << bits;
             bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
+            hold |= (unsigned long)(PUP(in)) << bits;
             bits += 8;
         }
+#endif
         this = lcode[hold & lmask];
       dolen:
         op = (unsigned)(this.bits);
@@ -150,7 +215,7 @@ void inflate_fast(z_streamp strm, unsigned start)
             op &= 15;                           /* number of extra bits */
             if (op) {
                 if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
+                    hold |= (unsigned long)(PUP(in)) << bits;
                     bits += 8;
                 }
                 len += (unsigned)hold & ((1U << op) - 1);
@@ -159,9 +224,9 @@ void inflate_fast(z_streamp strm, unsigned start)
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
             if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
+                hold |= (unsigned long)(PUP(in)) << bits;
                 bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
+                hold |= (unsigned long)(PUP(in)) << bits;
                 bits += 8;
             }
             this = dcode[hold & dmask];
@@ -174,10 +239,10 @@ void inflate_fast(z_streamp strm, unsigned start)
                 dist = (unsigned)(this.val);
                 op &= 15;                       /* number of extra bits */
                 if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
+                    hold |= (unsigned long)(PUP(in)) << bits;
                     bits += 8;
                     if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
+                        hold |= (unsigned long)(PUP(in)) << bits;
                         bits += 8;
                     }
                 }
@@ -201,14 +266,14 @@ void inflate_fast(z_streamp strm, unsigned start)
                         break;
                     }
                     from = window - OFF;
+                    direct = 0;
                     if (write == 0) {           /* very common case */
                         from += wsize - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
+                            zmemcpy(out + OFF, from + OFF, op);
+                            out += op;
+                            direct = 1;         /* rest from output */
                         }
                     }
                     else if (write < op) {      /* wrap around window */
@@ -216,17 +281,15 @@ void inflate_fast(z_streamp strm, unsigned start)
                         op -= write;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
+                            zmemcpy(out + OFF, from + OFF, op);
+                            out += op;
                             from = window - OFF;
                             if (write < len) {  /* some from start of window */
                                 op = write;
                                 len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
-                                from = out - dist;      /* rest from output */
+                                zmemcpy(out + OFF, from + OFF, op);
+                                out += op;
+                                direct = 1;     /* rest from output */
                             }
                         }
                     }
@@ -234,66 +297,21 @@ void inflate_fast(z_streamp strm, unsigned start)
                         from += write - op;
                         if (op < len) {         /* some from window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
+                            zmemcpy(out + OFF, from + OFF, op);
+                            out += op;
+                            direct = 1;         /* rest from output */
                         }
                     }
-                    while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    }
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
-                    }
+                    if (direct)
+                        inflate_copy_match(out + OFF, dist, len);
+                    else
+                        zmemcpy(out + OFF, from + OFF, len);
+                    out += len;
                 }
                 else {
-		    unsigned short *sout;
-		    unsigned long loops;
-
-                    from = out - dist;          /* copy direct from output */
-                    /* minimum length is three */
-		    /* Align out addr */
-		    if (!((long)(out - 1 + OFF) & 1)) {
-			PUP(out) = PUP(from);
-			len--;
-		    }
-		    sout = (unsigned short *)(out - OFF);
-		    if (dist > 2 ) {
-			unsigned short *sfrom;
-
-			sfrom = (unsigned short *)(from - OFF);
-			loops = len >> 1;
-			do
-			    PUP(sout) = get_unaligned(++sfrom);
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-			from = (unsigned char *)sfrom + OFF;
-		    } else { /* dist == 1 or dist == 2 */
-			unsigned short pat16;
-
-			pat16 = *(sout-2+2*OFF);
-			if (dist == 1)
-#if defined(__BIG_ENDIAN)
-			    pat16 = (pat16 & 0xff) | ((pat16 & 0xff ) << 8);
-#elif defined(__LITTLE_ENDIAN)
-			    pat16 = (pat16 & 0xff00) | ((pat16 & 0xff00 ) >> 8);
-#else
-#error __BIG_ENDIAN nor __LITTLE_ENDIAN is defined
-#endif
-			loops = len >> 1;
-			do
-			    PUP(sout) = pat16;
-			while (--loops);
-			out = (unsigned char *)sout + OFF;
-		    }
-		    if (len & 1)
-			PUP(out) = PUP(from);
+                    /* copy direct from output, minimum length is three */
+                    inflate_copy_match(out + OFF, dist, len);
+                    out += len;
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -351,6 +369,10 @@ void inflate_fast(z_streamp strm, unsigned start)
    - Swapping window/direct else
    - Larger unrolled copy loops (three is about right)
    - Moving len -= 3 statement into middle of loop
+
+   U-Boot: match copies now move a machine word at a time (see
+   inflate_copy_match()), which is what matters on ARM cores where the
+   byte loop dominated.
  */
 
 #endif /* !ASMINF */
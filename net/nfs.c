@@ -26,6 +26,12 @@
  * NFSv2 is still used by default. But if server does not support NFSv2, then
  * NFSv3 is used, if available on NFS server. */
 
+/* NOTE 5: Several READ requests may be in flight at once, each matched to
+ * its reply by the RPC transaction ID (XID). Replies are stored at the file
+ * offset of their request, so they may come in any order. A lost request or
+ * reply is sent again, with the same XID, on timeout. With NFSv3 the read
+ * size is the server's preferred one (FSINFO), up to NFS3_READ_SIZE. */
+
 #include <common.h>
 #include <command.h>
 #include <net.h>
@@ -45,11 +51,39 @@
 #define NFS_RPC_ERR	1
 #define NFS_RPC_DROP	124
 
+/* Largest IP payload in one Ethernet frame; the rest comes as fragments */
+#define NFS_FRAG_SIZE	1480
+
+/*
+ * Bytes of a READ reply before the data: the longest is the NFSv3 one,
+ * with status, attributes, count, eof flag and data length
+ */
+#define NFS_READ_REPLY_HDR	offsetof(struct rpc_t, u.reply.data[26])
+
+/**
+ * struct nfs_read - a READ request in flight
+ *
+ * @id: RPC transaction ID (XID) of the request, 0 if not in use
+ * @offset: offset in the file of the data requested
+ * @len: number of bytes requested
+ */
+struct nfs_read {
+	unsigned long id;
+	int offset;
+	int len;
+};
+
 static int fs_mounted;
 static unsigned long rpc_id;
 static int nfs_offset = -1;
 static int nfs_len;
+static int nfs_eof;
 static ulong nfs_timeout = NFS_TIMEOUT;
+static ulong nfs_read_bytes;
+static int nfs_hashes;
+
+static struct nfs_read nfs_reads[CONFIG_NFS_READ_WINDOW];
+static int nfs_read_window;
 
 static char dirfh[NFS_FHSIZE];	/* NFSv2 / NFSv3 file handle of directory */
 static char filefh[NFS3_FHSIZE]; /* NFSv2 / NFSv3 file handle */
@@ -69,6 +103,7 @@ static int nfs_state;
 #define STATE_LOOKUP_REQ		5
 #define STATE_READ_REQ			6
 #define STATE_READLINK_REQ		7
+#define STATE_FSINFO_REQ		8
 
 static char *nfs_filename;
 static char *nfs_path;
@@ -168,17 +203,16 @@ static uint32_t *rpc_add_credentials(uint32_t *p)
 }
 
 /**************************************************************************
-RPC_LOOKUP - Lookup RPC Port numbers
+RPC_SEND - Send an RPC call with the given transaction ID
 **************************************************************************/
-static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+static void rpc_send(int rpc_prog, int rpc_proc, unsigned long id,
+		     uint32_t *data, int datalen)
 {
 	struct rpc_t rpc_pkt;
-	unsigned long id;
 	uint32_t *p;
 	int pktlen;
 	int sport;
 
-	id = ++rpc_id;
 	rpc_pkt.u.call.id = htonl(id);
 	rpc_pkt.u.call.type = htonl(MSG_CALL);
 	rpc_pkt.u.call.rpcvers = htonl(2);	/* use RPC version 2 */
@@ -217,6 +251,14 @@ static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
 			    nfs_our_port, pktlen);
 }
 
+/**************************************************************************
+RPC_REQ - Send an RPC call with a new transaction ID
+**************************************************************************/
+static void rpc_req(int rpc_prog, int rpc_proc, uint32_t *data, int datalen)
+{
+	rpc_send(rpc_prog, rpc_proc, ++rpc_id, data, datalen);
+}
+
 /**************************************************************************
 RPC_LOOKUP - Lookup RPC Port numbers
 **************************************************************************/
@@ -353,10 +395,31 @@ static void nfs_lookup_req(char *fname)
 	}
 }
 
+/**************************************************************************
+NFS_FSINFO - Get the preferred read size of an NFSv3 server
+**************************************************************************/
+static void nfs3_fsinfo_req(void)
+{
+	uint32_t data[1024];
+	uint32_t *p;
+	int len;
+
+	p = &(data[0]);
+	p = rpc_add_credentials(p);
+
+	*p++ = htonl(filefh3_length);
+	memcpy(p, filefh, filefh3_length);
+	p += (filefh3_length / 4);
+
+	len = (uint32_t *)p - (uint32_t *)&(data[0]);
+
+	rpc_req(PROG_NFS, NFS3PROC_FSINFO, data, len);
+}
+
 /**************************************************************************
 NFS_READ - Read File on NFS Server
 **************************************************************************/
-static void nfs_read_req(int offset, int readlen)
+static void nfs_read_req(struct nfs_read *rd)
 {
 	uint32_t data[1024];
 	uint32_t *p;
@@ -368,22 +431,95 @@ static void nfs_read_req(int offset, int readlen)
 	if (supported_nfs_versions & NFSV2_FLAG) {
 		memcpy(p, filefh, NFS_FHSIZE);
 		p += (NFS_FHSIZE / 4);
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(rd->offset);
+		*p++ = htonl(rd->len);
 		*p++ = 0;
 	} else { /* NFSV3_FLAG */
 		*p++ = htonl(filefh3_length);
 		memcpy(p, filefh, filefh3_length);
 		p += (filefh3_length / 4);
 		*p++ = htonl(0); /* offset is 64-bit long, so fill with 0 */
-		*p++ = htonl(offset);
-		*p++ = htonl(readlen);
+		*p++ = htonl(rd->offset);
+		*p++ = htonl(rd->len);
 		*p++ = 0;
 	}
 
 	len = (uint32_t *)p - (uint32_t *)&(data[0]);
 
-	rpc_req(PROG_NFS, NFS_READ, data, len);
+	rpc_send(PROG_NFS, NFS_READ, rd->id, data, len);
+}
+
+/* Ask for the next part of the file in @rd, or free it if there is none */
+static void nfs_read_next(struct nfs_read *rd)
+{
+	if (nfs_offset >= nfs_eof) {
+		rd->id = 0;
+		return;
+	}
+
+	rd->id = ++rpc_id;
+	rd->offset = nfs_offset;
+	rd->len = min(nfs_len, nfs_eof - nfs_offset);
+	nfs_offset += rd->len;
+	nfs_read_req(rd);
+}
+
+/* Start reading the file, with a window of requests in flight */
+static void nfs_read_start(void)
+{
+	int frames, i;
+	char *s;
+
+	nfs_state = STATE_READ_REQ;
+	nfs_offset = 0;
+	nfs_eof = INT_MAX;
+	nfs_read_bytes = 0;
+	nfs_hashes = 0;
+
+	nfs_read_window = CONFIG_NFS_READ_WINDOW;
+	s = getenv("nfsreadwindow");
+	if (s)
+		nfs_read_window = simple_strtol(s, NULL, 10);
+	nfs_read_window = clamp(nfs_read_window, 1, CONFIG_NFS_READ_WINDOW);
+
+	/*
+	 * The replies to a window come as a burst, so they must fit in the
+	 * receive packet buffers, one per IP fragment
+	 */
+	frames = DIV_ROUND_UP(NFS_READ_REPLY_HDR + nfs_len, NFS_FRAG_SIZE);
+	nfs_read_window = min(nfs_read_window,
+			      max((PKTBUFSRX - 1) / frames, 1));
+	debug("NFS read size %d, window %d\n", nfs_len, nfs_read_window);
+
+	memset(nfs_reads, '\0', sizeof(nfs_reads));
+	for (i = 0; i < nfs_read_window; i++)
+		nfs_read_next(&nfs_reads[i]);
+}
+
+/* Find the READ request in flight with transaction ID @id */
+static struct nfs_read *nfs_read_find(unsigned long id)
+{
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_reads[i].id && nfs_reads[i].id == id)
+			return &nfs_reads[i];
+	}
+
+	return NULL;
+}
+
+/* Check whether any READ request is still in flight */
+static bool nfs_read_pending(void)
+{
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_reads[i].id)
+			return true;
+	}
+
+	return false;
 }
 
 /**************************************************************************
@@ -391,6 +527,8 @@ RPC request dispatcher
 **************************************************************************/
 static void nfs_send(void)
 {
+	int i;
+
 	debug("%s\n", __func__);
 
 	switch (nfs_state) {
@@ -416,11 +554,18 @@ static void nfs_send(void)
 		nfs_lookup_req(nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req(nfs_offset, nfs_len);
+		/* Send again each request still waiting for a reply */
+		for (i = 0; i < nfs_read_window; i++) {
+			if (nfs_reads[i].id)
+				nfs_read_req(&nfs_reads[i]);
+		}
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req();
 		break;
+	case STATE_FSINFO_REQ:
+		nfs3_fsinfo_req();
+		break;
 	}
 }
 
@@ -652,21 +797,71 @@ static int nfs_readlink_reply(uchar *pkt, unsigned len)
 	return 0;
 }
 
-static int nfs_read_reply(uchar *pkt, unsigned len)
+static int nfs3_fsinfo_reply(uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
-	uchar *data_ptr;
+	int nfsv3_data_offset;
+	int rtmax, rtpref;
 
 	debug("%s\n", __func__);
 
-	memcpy(&rpc_pkt.u.data[0], pkt, sizeof(rpc_pkt.u.reply));
+	memcpy(&rpc_pkt.u.data[0], pkt, len);
 
 	if (ntohl(rpc_pkt.u.reply.id) > rpc_id)
 		return -NFS_RPC_ERR;
 	else if (ntohl(rpc_pkt.u.reply.id) < rpc_id)
 		return -NFS_RPC_DROP;
 
+	if (rpc_pkt.u.reply.rstatus  ||
+	    rpc_pkt.u.reply.verifier ||
+	    rpc_pkt.u.reply.astatus  ||
+	    rpc_pkt.u.reply.data[0])
+		return -1;
+
+	nfsv3_data_offset = nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
+	rtmax = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
+	rtpref = ntohl(rpc_pkt.u.reply.data[2 + nfsv3_data_offset]);
+
+	if (rtpref > 0)
+		nfs_len = min(rtpref, NFS3_READ_SIZE);
+	if (rtmax > 0)
+		nfs_len = min(rtmax, nfs_len);
+
+	return 0;
+}
+
+static void nfs_show_progress(unsigned len)
+{
+	nfs_read_bytes += len;
+	while (nfs_hashes * (NFS_READ_SIZE / 2 * 10) < nfs_read_bytes) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts("\n\t ");
+		putc('#');
+		nfs_hashes++;
+	}
+}
+
+static int nfs_read_reply(uchar *pkt, unsigned len)
+{
+	struct rpc_t rpc_pkt;
+	struct nfs_read *rd;
+	int size = INT_MAX;
+	bool eof = false;
+	int rlen;
+	int hdr;
+
+	debug("%s\n", __func__);
+
+	/* Only the header is copied; the data is stored from the packet */
+	memcpy(&rpc_pkt.u.data[0], pkt, min_t(unsigned, len,
+					      NFS_READ_REPLY_HDR));
+
+	if (len < offsetof(struct rpc_t, u.reply.data[1]))
+		return -NFS_RPC_DROP;
+	rd = nfs_read_find(ntohl(rpc_pkt.u.reply.id));
+	if (!rd)
+		return -NFS_RPC_DROP;
+
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
 	    rpc_pkt.u.reply.astatus  ||
@@ -678,31 +873,50 @@ static int nfs_read_reply(uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);
 	}
 
-	if ((nfs_offset != 0) && !((nfs_offset) %
-			(NFS_READ_SIZE / 2 * 10 * HASHES_PER_LINE)))
-		puts("\n\t ");
-	if (!(nfs_offset % ((NFS_READ_SIZE / 2) * 10)))
-		putc('#');
-
 	if (supported_nfs_versions & NFSV2_FLAG) {
+		/* The file size is in the attributes */
+		size = min_t(uint, ntohl(rpc_pkt.u.reply.data[6]), INT_MAX);
 		rlen = ntohl(rpc_pkt.u.reply.data[18]);
-		data_ptr = (uchar *)&(rpc_pkt.u.reply.data[19]);
+		hdr = offsetof(struct rpc_t, u.reply.data[19]);
 	} else {  /* NFSV3_FLAG */
 		int nfsv3_data_offset =
 			nfs3_get_attributes_offset(rpc_pkt.u.reply.data);
 
+		/* The file size is in the attributes, if there are any */
+		if (nfsv3_data_offset > 1 && !rpc_pkt.u.reply.data[7])
+			size = min_t(uint, ntohl(rpc_pkt.u.reply.data[8]),
+				     INT_MAX);
 		/* count value */
 		rlen = ntohl(rpc_pkt.u.reply.data[1 + nfsv3_data_offset]);
-		/* Skip unused values :
-			EOF:		32 bits value,
+		eof = rpc_pkt.u.reply.data[2 + nfsv3_data_offset] != 0;
+		/* Skip unused value :
 			data_size:	32 bits value,
 		*/
-		data_ptr = (uchar *)
-			&(rpc_pkt.u.reply.data[4 + nfsv3_data_offset]);
+		hdr = offsetof(struct rpc_t,
+			       u.reply.data[4 + nfsv3_data_offset]);
 	}
 
-	if (store_block(data_ptr, nfs_offset, rlen))
-			return -9999;
+	if (rlen < 0 || rlen > rd->len || hdr + rlen > len)
+		return -9999;
+
+	if (rlen && store_block(pkt + hdr, rd->offset, rlen))
+		return -9999;
+	nfs_show_progress(rlen);
+
+	/* Stop asking for data beyond the end of the file */
+	if (eof || !rlen)
+		size = rd->offset + rlen;
+	nfs_eof = min(nfs_eof, size);
+
+	if (rlen < rd->len && rd->offset + rlen < nfs_eof) {
+		/* Short read: ask again for the rest */
+		rd->id = ++rpc_id;
+		rd->offset += rlen;
+		rd->len -= rlen;
+		nfs_read_req(rd);
+	} else {
+		nfs_read_next(rd);
+	}
 
 	return rlen;
 }
@@ -735,6 +949,10 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 	if (dest != nfs_our_port)
 		return;
 
+	/* Only READ replies may be bigger than struct rpc_t */
+	if (len > sizeof(struct rpc_t) && nfs_state != STATE_READ_REQ)
+		return;
+
 	switch (nfs_state) {
 	case STATE_PRCLOOKUP_PROG_MOUNT_REQ:
 		if (rpc_lookup_reply(PROG_MOUNT, pkt, len) == -NFS_RPC_DROP)
@@ -794,10 +1012,12 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			/* And retry with another supported version */
 			nfs_state = STATE_PRCLOOKUP_PROG_MOUNT_REQ;
 			nfs_send();
-		} else {
-			nfs_state = STATE_READ_REQ;
-			nfs_offset = 0;
+		} else if (supported_nfs_versions & NFSV2_FLAG) {
 			nfs_len = NFS_READ_SIZE;
+			nfs_read_start();
+		} else {  /* NFSV3_FLAG */
+			nfs_len = NFS_READ_SIZE;
+			nfs_state = STATE_FSINFO_REQ;
 			nfs_send();
 		}
 		break;
@@ -820,21 +1040,31 @@ static void nfs_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		}
 		break;
 
+	case STATE_FSINFO_REQ:
+		reply = nfs3_fsinfo_reply(pkt, len);
+		if (reply == -NFS_RPC_DROP)
+			break;
+		/* Without the server's preference, use the default size */
+		nfs_read_start();
+		break;
+
 	case STATE_READ_REQ:
 		rlen = nfs_read_reply(pkt, len);
+		if (rlen == -NFS_RPC_DROP)
+			break;
 		net_set_timeout_handler(nfs_timeout, nfs_timeout_handler);
-		if (rlen > 0) {
-			nfs_offset += rlen;
+		if (rlen >= 0) {
+			if (nfs_read_pending())
+				break;
+			nfs_download_state = NETLOOP_SUCCESS;
+			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		} else if ((rlen == -NFSERR_ISDIR) || (rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			nfs_state = STATE_READLINK_REQ;
 			nfs_send();
 		} else {
-			if (!rlen)
-				nfs_download_state = NETLOOP_SUCCESS;
-			if (rlen < 0)
-				debug("NFS READ error (%d)\n", rlen);
+			debug("NFS READ error (%d)\n", rlen);
 			nfs_state = STATE_UMOUNT_REQ;
 			nfs_send();
 		}
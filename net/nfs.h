@@ -26,6 +26,7 @@
 #define NFS_READ        6
 
 #define NFS3PROC_LOOKUP 3
+#define NFS3PROC_FSINFO 19
 
 #define NFS_FHSIZE      32
 #define NFS3_FHSIZE     64
@@ -47,6 +48,16 @@
 #define NFS_READ_SIZE 1024 /* biggest power of two that fits Ether frame */
 #endif
 
+/* Largest block size for NFSv3 reads, which use the size the server prefers
+ * if it is smaller. A bigger reply comes as IP fragments, so this needs
+ * CONFIG_IP_DEFRAG.
+ */
+#if defined(CONFIG_IP_DEFRAG) && defined(CONFIG_NFS3_READ_SIZE)
+#define NFS3_READ_SIZE CONFIG_NFS3_READ_SIZE
+#else
+#define NFS3_READ_SIZE NFS_READ_SIZE
+#endif
+
 /* Values for Accept State flag on RPC answers (See: rfc1831) */
 enum rpc_accept_stat {
 	NFS_RPC_SUCCESS = 0,	/* RPC executed successfully */
@@ -134,6 +134,22 @@ static char tftp_filename[MAX_LEN];
 static unsigned short tftp_block_size = TFTP_BLOCK_SIZE;
 static unsigned short tftp_block_size_option = TFTP_MTU_BLOCKSIZE;
 
+/*
+ * Number of blocks the server sends for each ACK (RFC 7440). A window
+ * arrives as a burst, and after a lost block may arrive while the rest of
+ * the previous one is still waiting, so two must fit in the receive
+ * packet buffers.
+ */
+#define TFTP_WINDOWSIZE		1
+#define TFTP_MAX_WINDOWSIZE	((PKTBUFSRX - 1) / 2)
+
+static unsigned short tftp_windowsize = TFTP_WINDOWSIZE;
+static unsigned short tftp_windowsize_option = CONFIG_TFTP_WINDOWSIZE;
+/* block number at which the next ACK is due */
+static ushort	tftp_next_ack;
+/* last in-order block for which lost blocks were reported, or -1 */
+static int	tftp_last_nack;
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -211,6 +227,8 @@ static void new_transfer(void)
 	tftp_prev_block = 0;
 	tftp_block_wrap = 0;
 	tftp_block_wrap_offset = 0;
+	tftp_next_ack = tftp_windowsize;
+	tftp_last_nack = -1;
 #ifdef CONFIG_CMD_TFTPPUT
 	tftp_put_final_block_sent = 0;
 #endif
@@ -372,6 +390,9 @@ static void tftp_send(void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt, "blksize%c%d%c",
 				0, tftp_block_size_option, 0);
+		if (tftp_windowsize_option > 1)
+			pkt += sprintf((char *)pkt, "windowsize%c%d%c",
+					0, tftp_windowsize_option, 0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!tftp_mcast_disabled) {
@@ -414,6 +435,8 @@ static void tftp_send(void)
 			tftp_put_final_block_sent = (loaded < toload);
 		}
 #endif
+		if (!tftp_put_active)
+			tftp_next_ack = tftp_cur_block + tftp_windowsize;
 		len = pkt - xp;
 		break;
 
@@ -445,6 +468,31 @@ static void tftp_send(void)
 			    tftp_remote_port, tftp_our_port, len);
 }
 
+/*
+ * A block other than the next one has arrived. If it is one already
+ * received, ignore it. If it is further on, blocks have been lost, so
+ * acknowledge the last block received in order, which makes the server
+ * send the window again from there. The rest of the window will be out
+ * of order too, so only do this again once the window should have ended.
+ */
+static void tftp_data_out_of_order(void)
+{
+	ushort block = tftp_cur_block;
+
+	/* Only ever acknowledge what was received in order */
+	tftp_cur_block = tftp_prev_block;
+
+	if ((ushort)(tftp_prev_block - block) < TFTP_SEQUENCE_SIZE / 2)
+		return;
+
+	if (tftp_last_nack == (int)tftp_prev_block && block != tftp_next_ack)
+		return;
+
+	debug("Lost blocks after %lu, got %u\n", tftp_prev_block, block);
+	tftp_last_nack = tftp_prev_block;
+	tftp_send();
+}
+
 #ifdef CONFIG_CMD_TFTPPUT
 static void icmp_handler(unsigned type, unsigned code, unsigned dest,
 			 struct in_addr sip, unsigned src, uchar *pkt,
@@ -540,6 +588,13 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				debug("Blocksize ack: %s, %d\n",
 				      (char *)pkt + i + 8, tftp_block_size);
 			}
+			if (strcmp((char *)pkt + i, "windowsize") == 0) {
+				tftp_windowsize = (unsigned short)
+					simple_strtoul((char *)pkt + i + 11,
+						       NULL, 10);
+				debug("Windowsize ack: %s, %d\n",
+				      (char *)pkt + i + 11, tftp_windowsize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp((char *)pkt+i, "tsize") == 0) {
 				tftp_tsize = simple_strtoul((char *)pkt + i + 6,
@@ -549,8 +604,15 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 #endif
 		}
+		/* Guard against a server which sends more than we asked for */
+		if (tftp_windowsize < 1 ||
+		    tftp_windowsize > tftp_windowsize_option)
+			tftp_windowsize = TFTP_WINDOWSIZE;
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt, len - 1);
+		/* The master client acknowledges every block */
+		if (tftp_mcast_active)
+			tftp_windowsize = TFTP_WINDOWSIZE;
 		if ((tftp_mcast_active) && (!tftp_mcast_master_client))
 			tftp_state = STATE_DATA;	/* passive.. */
 		else
@@ -570,8 +632,6 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		len -= 2;
 		tftp_cur_block = ntohs(*(__be16 *)pkt);
 
-		update_block_number();
-
 		if (tftp_state == STATE_SEND_RRQ)
 			debug("Server did not acknowledge timeout option!\n");
 
@@ -587,7 +647,8 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 				tftp_prev_block = tftp_cur_block - 1;
 			} else
 #endif
-			if (tftp_cur_block != 1) {	/* Assertion */
+			/* With a window, block 1 may just be late */
+			if (tftp_cur_block != 1 && tftp_windowsize == 1) {
 				puts("\nTFTP error: ");
 				printf("First block is not block 1 (%ld)\n",
 				       tftp_cur_block);
@@ -597,11 +658,21 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 		}
 
-		if (tftp_cur_block == tftp_prev_block) {
-			/* Same block again; ignore it. */
+#ifdef CONFIG_MCAST_TFTP
+		if (tftp_mcast_active) {
+			if (tftp_cur_block == tftp_prev_block) {
+				/* Same block again; ignore it. */
+				break;
+			}
+		} else
+#endif
+		if (tftp_cur_block != (ushort)(tftp_prev_block + 1)) {
+			tftp_data_out_of_order();
 			break;
 		}
 
+		update_block_number();
+
 		tftp_prev_block = tftp_cur_block;
 		timeout_count_max = tftp_timeout_count_max;
 		net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
@@ -609,8 +680,9 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 		store_block(tftp_cur_block - 1, pkt + 2, len);
 
 		/*
-		 *	Acknowledge the block just received, which will prompt
-		 *	the remote for the next one.
+		 *	Acknowledge the last block of each window, which will
+		 *	prompt the remote for the next window, and the final
+		 *	block.
 		 */
 #ifdef CONFIG_MCAST_TFTP
 		/* if I am the MasterClient, actively calculate what my next
@@ -638,7 +710,9 @@ static void tftp_handler(uchar *pkt, unsigned dest, struct in_addr sip,
 			}
 		}
 #endif
-		tftp_send();
+		if (tftp_windowsize == 1 || tftp_cur_block == tftp_next_ack ||
+		    len < tftp_block_size)
+			tftp_send();
 
 #ifdef CONFIG_MCAST_TFTP
 		if (tftp_mcast_active) {
@@ -710,6 +784,10 @@ void tftp_start(enum proto_t protocol)
 	if (ep != NULL)
 		tftp_block_size_option = simple_strtol(ep, NULL, 10);
 
+	ep = getenv("tftpwindowsize");
+	if (ep != NULL)
+		tftp_windowsize_option = simple_strtol(ep, NULL, 10);
+
 	ep = getenv("tftptimeout");
 	if (ep != NULL)
 		timeout_ms = simple_strtol(ep, NULL, 10);
@@ -731,8 +809,16 @@ void tftp_start(enum proto_t protocol)
 	}
 #endif
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-	      tftp_block_size_option, timeout_ms);
+	if (tftp_windowsize_option > TFTP_MAX_WINDOWSIZE) {
+		printf("TFTP window size (%d) too large, set max = %d\n",
+		       tftp_windowsize_option, TFTP_MAX_WINDOWSIZE);
+		tftp_windowsize_option = TFTP_MAX_WINDOWSIZE;
+	}
+	if (tftp_windowsize_option < 1)
+		tftp_windowsize_option = TFTP_WINDOWSIZE;
+
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+	      tftp_block_size_option, tftp_windowsize_option, timeout_ms);
 
 	tftp_remote_ip = net_server_ip;
 	if (net_boot_file_name[0] == '\0') {
@@ -833,8 +919,9 @@ void tftp_start(enum proto_t protocol)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(net_server_ethaddr, 0, 6);
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = TFTP_WINDOWSIZE;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -862,8 +949,9 @@ void tftp_start_server(void)
 	timeout_ms = TIMEOUT;
 	net_set_timeout_handler(timeout_ms, tftp_timeout_handler);
 
-	/* Revert tftp_block_size to dflt */
+	/* Revert tftp_block_size and tftp_windowsize to dflt */
 	tftp_block_size = TFTP_BLOCK_SIZE;
+	tftp_windowsize = TFTP_WINDOWSIZE;
 	tftp_cur_block = 0;
 	tftp_our_port = WELL_KNOWN_PORT;
 
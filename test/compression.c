@@ -12,6 +12,7 @@
 #include <malloc.h>
 #include <mapmem.h>
 #include <asm/io.h>
+#include <div64.h>
 
 #include <u-boot/zlib.h>
 #include <bzlib.h>
@@ -465,6 +466,108 @@ static int do_ut_image_decomp(cmd_tbl_t *cmdtp, int flag, int argc,
 	return 0;
 }
 
+/* Size of the generated data used to benchmark gzip */
+#define BENCH_GZIP_SIZE		(1 << 20)
+
+/* Total amount of data each benchmark decompresses */
+#define BENCH_TOTAL_SIZE	(16 << 20)
+
+/**
+ * run_bench() - Measure decompression speed
+ *
+ * @name:	Name of the compression method
+ * @orig_buf:	Data to compress
+ * @orig_size:	Size of @orig_buf
+ * @compress:	Our function to compress data
+ * @uncompress:	Our function to decompress data
+ * @return 0 if OK, non-zero on failure
+ */
+static int run_bench(char *name, void *orig_buf, ulong orig_size,
+		     mutate_func compress, mutate_func uncompress)
+{
+	ulong compressed_size, uncompressed_size;
+	void *compressed_buf, *uncompressed_buf;
+	ulong start, elapsed, loops, i;
+	u64 total;
+	int ret = 1;
+
+	compressed_size = orig_size + 1024;
+	compressed_buf = malloc(compressed_size);
+	uncompressed_buf = malloc(orig_size);
+	if (!compressed_buf || !uncompressed_buf)
+		goto out;
+
+	if (compress(orig_buf, orig_size, compressed_buf, compressed_size,
+		     &compressed_size))
+		goto out;
+
+	loops = max(BENCH_TOTAL_SIZE / orig_size, 1UL);
+	start = timer_get_us();
+	for (i = 0; i < loops; i++) {
+		if (uncompress(compressed_buf, compressed_size,
+			       uncompressed_buf, orig_size,
+			       &uncompressed_size) ||
+		    uncompressed_size != orig_size)
+			goto out;
+	}
+	elapsed = max(timer_get_us() - start, 1UL);
+
+	if (memcmp(orig_buf, uncompressed_buf, orig_size))
+		goto out;
+
+	/* bytes per microsecond is MB/s */
+	total = (u64)orig_size * loops;
+	printf(" %-6s %8lu -> %8lu bytes, %5lu loops: %lu MB/s\n", name,
+	       compressed_size, orig_size, loops,
+	       (ulong)lldiv(total, elapsed));
+	ret = 0;
+
+out:
+	if (ret)
+		printf(" %s: FAILED\n", name);
+	free(uncompressed_buf);
+	free(compressed_buf);
+
+	return ret;
+}
+
+static int do_ut_compression_bench(cmd_tbl_t *cmdtp, int flag, int argc,
+				   char *const argv[])
+{
+	char *gzip_buf;
+	ulong plain_size = strlen(plain);
+	ulong i;
+	int err = 0;
+
+	/*
+	 * Only gzip can compress here, so it gets a larger buffer of text
+	 * with some variation; the others decompress their canned copies
+	 * of plain[] many times over.
+	 */
+	gzip_buf = malloc(BENCH_GZIP_SIZE);
+	if (!gzip_buf)
+		return CMD_RET_FAILURE;
+	for (i = 0; i < BENCH_GZIP_SIZE; i += plain_size + 9)
+		snprintf(gzip_buf + i, BENCH_GZIP_SIZE - i, "%s%08lx\n",
+			 plain, i);
+
+	err += run_bench("gzip", gzip_buf, BENCH_GZIP_SIZE,
+			 compress_using_gzip, uncompress_using_gzip);
+	err += run_bench("bzip2", (void *)plain, plain_size,
+			 compress_using_bzip2, uncompress_using_bzip2);
+	err += run_bench("lzma", (void *)plain, plain_size,
+			 compress_using_lzma, uncompress_using_lzma);
+	err += run_bench("lzo", (void *)plain, plain_size,
+			 compress_using_lzo, uncompress_using_lzo);
+	err += run_bench("lz4", (void *)plain, plain_size,
+			 compress_using_lz4, uncompress_using_lz4);
+	free(gzip_buf);
+
+	printf("ut_compression_bench %s\n", err == 0 ? "ok" : "FAILED");
+
+	return err;
+}
+
 U_BOOT_CMD(
 	ut_compression,	5,	1,	do_ut_compression,
 	"Basic test of compressors: gzip bzip2 lzma lzo", ""
@@ -474,3 +577,8 @@ U_BOOT_CMD(
 	ut_image_decomp,	5,	1, do_ut_image_decomp,
 	"Basic test of bootm decompression", ""
 );
+
+U_BOOT_CMD(
+	ut_compression_bench,	5,	1,	do_ut_compression_bench,
+	"Decompression speed of gzip bzip2 lzma lzo lz4 in MB/s", ""
+);
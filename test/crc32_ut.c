@@ -0,0 +1,111 @@
+/*
+ * Tests for CRC32
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <div64.h>
+#include <errno.h>
+#include <malloc.h>
+#include <u-boot/crc.h>
+
+#define BENCH_SIZE	(1 << 20)
+#define BENCH_LOOPS	64
+
+/* One bit at a time, straight from the polynomial */
+static uint32_t crc32_ref(uint32_t crc, const unsigned char *buf, uint len)
+{
+	int i;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+	}
+
+	return ~crc;
+}
+
+static int crc32_check(void)
+{
+	unsigned char buf[300];
+	uint32_t crc, ref;
+	int ret = 0;
+	int off, len;
+
+	crc = crc32(0, (const unsigned char *)"123456789", 9);
+	if (crc != 0xcbf43926) {
+		printf("%s: check value %08x, expected cbf43926\n", __func__,
+		       crc);
+		ret = -EINVAL;
+	}
+
+	for (off = 0; off < sizeof(buf); off++)
+		buf[off] = off * 7 + (off >> 3);
+
+	/* Cover every alignment and all the tails of the 8-byte steps */
+	for (off = 0; off < 16; off++) {
+		for (len = 0; len <= sizeof(buf) - off; len++) {
+			crc = crc32(0x1234, buf + off, len);
+			ref = crc32_ref(0x1234, buf + off, len);
+			if (crc != ref) {
+				printf("%s: offset %d, len %d: %08x, expected %08x\n",
+				       __func__, off, len, crc, ref);
+				return -EINVAL;
+			}
+		}
+	}
+
+	/* crc32_no_comp() is the same engine without the complement */
+	crc = crc32_no_comp(0, buf, sizeof(buf));
+	ref = ~crc32_ref(~0, buf, sizeof(buf));
+	if (crc != ref) {
+		printf("%s: no_comp %08x, expected %08x\n", __func__, crc, ref);
+		ret = -EINVAL;
+	}
+
+	return ret;
+}
+
+static int crc32_bench(void)
+{
+	unsigned char *buf;
+	ulong start, elapsed;
+	uint32_t crc = 0;
+	int i;
+
+	buf = malloc(BENCH_SIZE);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; i < BENCH_SIZE; i++)
+		buf[i] = i ^ (i >> 9);
+
+	start = timer_get_us();
+	for (i = 0; i < BENCH_LOOPS; i++)
+		crc = crc32(crc, buf, BENCH_SIZE);
+	elapsed = max(timer_get_us() - start, 1UL);
+	free(buf);
+
+	/* bytes per microsecond is MB/s */
+	printf("%s: %d x %d bytes: %lu MB/s (crc %08x)\n", __func__,
+	       BENCH_LOOPS, BENCH_SIZE,
+	       (ulong)lldiv((u64)BENCH_SIZE * BENCH_LOOPS, elapsed), crc);
+
+	return 0;
+}
+
+int do_ut_crc32(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	int ret;
+
+	ret = crc32_check();
+	if (!ret)
+		ret = crc32_bench();
+
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
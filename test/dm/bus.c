@@ -125,6 +125,34 @@ static int dm_test_bus_children(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_bus_children, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
 
+#if CONFIG_IS_ENABLED(DM_STATS)
+/* Test that probing a child records its parent as probed before it */
+static int dm_test_bus_probe_order(struct unit_test_state *uts)
+{
+	uint count = gd->dm_stats.probe_count;
+	struct udevice *bus, *dev;
+
+	ut_assertok(uclass_find_device(UCLASS_TEST_BUS, 0, &bus));
+	ut_assertok(device_find_first_child(bus, &dev));
+	ut_assertnonnull(dev);
+	ut_asserteq(0, bus->probe_order);
+	ut_asserteq(0, dev->probe_order);
+
+	ut_assertok(device_probe(dev));
+	ut_assert(bus->probe_order > count);
+	ut_assert(dev->probe_order > bus->probe_order);
+	ut_assert(gd->dm_stats.probe_count >= count + 2);
+
+	/* Probing again changes nothing */
+	count = dev->probe_order;
+	ut_assertok(device_probe(dev));
+	ut_asserteq(count, dev->probe_order);
+
+	return 0;
+}
+DM_TEST(dm_test_bus_probe_order, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
+
 /* Test our functions for accessing children */
 static int dm_test_bus_children_funcs(struct unit_test_state *uts)
 {
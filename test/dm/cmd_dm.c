@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <asm/io.h>
 #include <dm/root.h>
+#include <dm/stats.h>
 #include <dm/util.h>
 
 static int do_dm_dump_all(cmd_tbl_t *cmdtp, int flag, int argc,
@@ -41,10 +42,32 @@ static int do_dm_dump_devres(cmd_tbl_t *cmdtp, int flag, int argc,
 	return 0;
 }
 
+#ifdef CONFIG_DM_STATS
+static int do_dm_dump_stats(cmd_tbl_t *cmdtp, int flag, int argc,
+			    char * const argv[])
+{
+	dm_dump_stats();
+
+	return 0;
+}
+
+static int do_dm_dump_probes(cmd_tbl_t *cmdtp, int flag, int argc,
+			     char * const argv[])
+{
+	dm_dump_probes();
+
+	return 0;
+}
+#endif
+
 static cmd_tbl_t test_commands[] = {
 	U_BOOT_CMD_MKENT(tree, 0, 1, do_dm_dump_all, "", ""),
 	U_BOOT_CMD_MKENT(uclass, 1, 1, do_dm_dump_uclass, "", ""),
 	U_BOOT_CMD_MKENT(devres, 1, 1, do_dm_dump_devres, "", ""),
+#ifdef CONFIG_DM_STATS
+	U_BOOT_CMD_MKENT(stats, 1, 1, do_dm_dump_stats, "", ""),
+	U_BOOT_CMD_MKENT(probes, 1, 1, do_dm_dump_probes, "", ""),
+#endif
 };
 
 static __maybe_unused void dm_reloc(void)
@@ -86,4 +109,8 @@ U_BOOT_CMD(
 	"tree         Dump driver model tree ('*' = activated)\n"
 	"dm uclass        Dump list of instances for each uclass\n"
 	"dm devres        Dump list of device resources for each device"
+#ifdef CONFIG_DM_STATS
+	"\ndm stats         Show device binding and probing statistics"
+	"\ndm probes        List devices in the order probed, with times"
+#endif
 );
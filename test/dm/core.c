@@ -12,6 +12,7 @@
 #include <fdtdec.h>
 #include <malloc.h>
 #include <dm/device-internal.h>
+#include <dm/lists.h>
 #include <dm/root.h>
 #include <dm/util.h>
 #include <dm/test.h>
@@ -796,3 +797,116 @@ static int dm_test_device_get_uclass_id(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_device_get_uclass_id, DM_TESTF_SCAN_PDATA);
+
+#define INDEX_COUNT	100
+
+/* Test that lookups through the uclass indexes follow changes to devices */
+static int dm_test_uclass_index(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *child[INDEX_COUNT];
+	struct udevice *dev;
+	char name[20];
+	int i;
+
+	/* Enough devices to make the indexes grow a few times */
+	ut_assertok(create_children(uts, dms->root, INDEX_COUNT, 0, child));
+	for (i = 0; i < INDEX_COUNT; i++) {
+		snprintf(name, sizeof(name), "index-%d", i);
+		ut_assertok(device_set_name(child[i], name));
+		child[i]->req_seq = INDEX_COUNT - i;
+		uclass_index_device(child[i]);
+	}
+
+	for (i = 0; i < INDEX_COUNT; i++) {
+		snprintf(name, sizeof(name), "index-%d", i);
+		ut_assertok(uclass_find_device_by_name(UCLASS_TEST, name, &dev));
+		ut_asserteq_ptr(child[i], dev);
+		ut_assertok(uclass_find_device_by_seq(UCLASS_TEST,
+						      INDEX_COUNT - i, true,
+						      &dev));
+		ut_asserteq_ptr(child[i], dev);
+	}
+
+	/* An exact match wins over an earlier device with a longer name */
+	ut_assertok(device_set_name(child[10], "exact-not"));
+	ut_assertok(device_set_name(child[50], "exact"));
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "exact", &dev));
+	ut_asserteq_ptr(child[50], dev);
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "exact-", &dev));
+	ut_asserteq_ptr(child[10], dev);
+	ut_assertok(uclass_find_device_by_name(UCLASS_TEST, "inde", &dev));
+	ut_asserteq_ptr(child[0], dev);
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST,
+							"index-10", &dev));
+
+	/* The sequence number is allocated on probe and dropped on remove */
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST,
+						       INDEX_COUNT - 3, false,
+						       &dev));
+	ut_assertok(device_probe(child[3]));
+	ut_assertok(uclass_find_device_by_seq(UCLASS_TEST, INDEX_COUNT - 3,
+					      false, &dev));
+	ut_asserteq_ptr(child[3], dev);
+	ut_assertok(device_remove(child[3]));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST,
+						       INDEX_COUNT - 3, false,
+						       &dev));
+
+	dev_set_of_offset(child[5], 1234);
+	ut_assertok(uclass_find_device_by_of_offset(UCLASS_TEST, 1234, &dev));
+	ut_asserteq_ptr(child[5], dev);
+	dev_set_of_offset(child[5], -1);
+	ut_asserteq(-ENODEV, uclass_find_device_by_of_offset(UCLASS_TEST, 1234,
+							     &dev));
+
+	/* Unbound devices are gone from the indexes */
+	ut_assertok(device_unbind(child[7]));
+	ut_asserteq(-ENODEV, uclass_find_device_by_name(UCLASS_TEST, "index-7",
+							&dev));
+	ut_asserteq(-ENODEV, uclass_find_device_by_seq(UCLASS_TEST,
+						       INDEX_COUNT - 7, true,
+						       &dev));
+
+	return 0;
+}
+DM_TEST(dm_test_uclass_index, 0);
+
+/* Test that drivers are found by compatible string as a linear search would */
+static int dm_test_lists_compat(struct unit_test_state *uts)
+{
+	struct driver *driver = ll_entry_start(struct driver, driver);
+	const int n_ents = ll_entry_count(struct driver, driver);
+	const struct udevice_id *of_id, *found_id, *first_id = NULL;
+	struct driver *entry, *first;
+
+	for (entry = driver; entry != driver + n_ents; entry++) {
+		for (of_id = entry->of_match; of_id && of_id->compatible;
+		     of_id++) {
+			/* Stops at @entry at the latest */
+			for (first = driver; first <= entry; first++) {
+				for (first_id = first->of_match;
+				     first_id && first_id->compatible;
+				     first_id++) {
+					if (!strcmp(first_id->compatible,
+						    of_id->compatible))
+						break;
+				}
+				if (first_id && first_id->compatible)
+					break;
+			}
+
+			ut_asserteq_ptr(first, lists_driver_lookup_compat(
+					of_id->compatible, &found_id));
+			ut_asserteq_ptr(first_id, found_id);
+		}
+	}
+	ut_asserteq_ptr(NULL, lists_driver_lookup_compat("denx,no-such-device",
+							 &found_id));
+#if CONFIG_IS_ENABLED(DM_COMPAT_HASH)
+	ut_assertnonnull(gd->driver_compat_table);
+#endif
+
+	return 0;
+}
+DM_TEST(dm_test_lists_compat, 0);
@@ -11,6 +11,7 @@
 #include <dm.h>
 #include <fdtdec.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <net.h>
 #include <dm/test.h>
 #include <dm/device-internal.h>
@@ -259,3 +260,136 @@ static int dm_test_net_retry(struct unit_test_state *uts)
 	return retval;
 }
 DM_TEST(dm_test_net_retry, DM_TESTF_SCAN_FDT);
+
+/* File loaded from the fake TFTP server, and round-trip time to model */
+#define TFTP_TEST_ADDR		0x100000
+#define TFTP_TEST_SIZE		(1 << 20)
+#define TFTP_TEST_RTT_MS	1
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_eth_tftp(struct unit_test_state *uts, int windowsize,
+			     ulong drop_block, ulong *timep)
+{
+	ulong start, i;
+	uchar *buf;
+
+	sandbox_eth_tftp_serve(TFTP_TEST_SIZE, windowsize, drop_block,
+			       TFTP_TEST_RTT_MS);
+	setenv_ulong("tftpwindowsize", windowsize);
+	load_addr = TFTP_TEST_ADDR;
+	copy_filename(net_boot_file_name, "test.bin",
+		      sizeof(net_boot_file_name));
+
+	start = get_timer(0);
+	ut_asserteq(TFTP_TEST_SIZE, net_loop(TFTPGET));
+	*timep = get_timer(start);
+
+	buf = map_sysmem(TFTP_TEST_ADDR, TFTP_TEST_SIZE);
+	for (i = 0; i < TFTP_TEST_SIZE; i++) {
+		if (buf[i] != sandbox_eth_file_byte(i))
+			break;
+	}
+	unmap_sysmem(buf);
+	ut_asserteq(TFTP_TEST_SIZE, i);
+
+	return 0;
+}
+
+static int dm_test_eth_tftp(struct unit_test_state *uts)
+{
+	ulong lockstep_ms, window_ms, lost_ms;
+	int retval;
+
+	setenv("ethact", "eth@10002000");
+	setenv("serverip", "1.1.2.2");
+
+	retval = _dm_test_eth_tftp(uts, 1, 0, &lockstep_ms);
+	if (!retval)
+		retval = _dm_test_eth_tftp(uts, 8, 0, &window_ms);
+	/* A lost block is sent again without waiting for a timeout */
+	if (!retval)
+		retval = _dm_test_eth_tftp(uts, 8, 100, &lost_ms);
+
+	/* Restore the env */
+	sandbox_eth_tftp_serve(0, 0, 0, 0);
+	setenv("tftpwindowsize", NULL);
+	if (retval)
+		return retval;
+
+	printf("TFTP %d KiB, %d ms round trip: %lu ms lock-step, %lu ms with a window of 8, %lu ms with a lost block\n",
+	       TFTP_TEST_SIZE >> 10, TFTP_TEST_RTT_MS, lockstep_ms, window_ms,
+	       lost_ms);
+	ut_assert(window_ms < lockstep_ms);
+	ut_assert(lost_ms < 1000);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_tftp, DM_TESTF_SCAN_FDT);
+
+/* File loaded from the fake NFS server, and round-trip time to model */
+#define NFS_TEST_ADDR		0x100000
+#define NFS_TEST_SIZE		((1 << 20) + 100)
+#define NFS_TEST_RTT_MS		1
+
+/* The asserts include a return on fail; cleanup in the caller */
+static int _dm_test_eth_nfs(struct unit_test_state *uts, int version,
+			    int readwindow, ulong drop_offset, ulong *timep)
+{
+	ulong start, i;
+	uchar *buf;
+
+	sandbox_eth_nfs_serve(NFS_TEST_SIZE, version, 8192, drop_offset,
+			      NFS_TEST_RTT_MS);
+	setenv_ulong("nfsreadwindow", readwindow);
+	load_addr = NFS_TEST_ADDR;
+	copy_filename(net_boot_file_name, "/export/test.bin",
+		      sizeof(net_boot_file_name));
+
+	start = get_timer(0);
+	ut_asserteq(NFS_TEST_SIZE, net_loop(NFS));
+	*timep = get_timer(start);
+
+	buf = map_sysmem(NFS_TEST_ADDR, NFS_TEST_SIZE);
+	for (i = 0; i < NFS_TEST_SIZE; i++) {
+		if (buf[i] != sandbox_eth_file_byte(i))
+			break;
+	}
+	unmap_sysmem(buf);
+	ut_asserteq(NFS_TEST_SIZE, i);
+
+	return 0;
+}
+
+static int dm_test_eth_nfs(struct unit_test_state *uts)
+{
+	ulong lockstep_ms, window_ms, lost_ms, v3_ms;
+	int retval;
+
+	setenv("ethact", "eth@10002000");
+	setenv("serverip", "1.1.2.2");
+
+	retval = _dm_test_eth_nfs(uts, 2, 1, 0, &lockstep_ms);
+	if (!retval)
+		retval = _dm_test_eth_nfs(uts, 2, 8, 0, &window_ms);
+	/* A lost reply is asked for again after a timeout */
+	if (!retval)
+		retval = _dm_test_eth_nfs(uts, 2, 8, 100 * 1024, &lost_ms);
+	/* NFSv3 uses the larger read size the server offers */
+	if (!retval)
+		retval = _dm_test_eth_nfs(uts, 3, 8, 0, &v3_ms);
+
+	/* Restore the env */
+	sandbox_eth_nfs_serve(0, 0, 0, 0, 0);
+	setenv("nfsreadwindow", NULL);
+	if (retval)
+		return retval;
+
+	printf("NFS %d KiB, %d ms round trip: %lu ms lock-step, %lu ms with 8 reads in flight, %lu ms with a lost reply, %lu ms with NFSv3\n",
+	       NFS_TEST_SIZE >> 10, NFS_TEST_RTT_MS, lockstep_ms, window_ms,
+	       lost_ms, v3_ms);
+	ut_assert(window_ms < lockstep_ms);
+	ut_assert(v3_ms < window_ms);
+
+	return 0;
+}
+DM_TEST(dm_test_eth_nfs, DM_TESTF_SCAN_FDT);
@@ -6,7 +6,9 @@
 
 #include <common.h>
 #include <dm.h>
+#include <malloc.h>
 #include <mmc.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/ut.h>
 
@@ -44,3 +46,137 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_BLK_ASYNC
+/* Blocks read per chunk when overlapping reads with processing */
+#define ASYNC_CHUNK_BLKS	64
+#define ASYNC_CHUNKS		8
+
+static int mmc_async_check(struct unit_test_state *uts,
+			   struct blk_desc *dev_desc, char *buf, char *cmp,
+			   struct blk_req *req)
+{
+	int i;
+
+	/* The read completes in the background */
+	memset(buf, '\0', 16 * dev_desc->blksz);
+	ut_assertok(blk_read_submit(dev_desc, 0, 16, buf, req));
+	ut_asserteq(-EBUSY, blk_read_poll(req));
+	ut_asserteq(16, blk_read_wait(req));
+	ut_assertok(strcmp(buf, "this is a test"));
+
+	/* Another access to the device finishes the read first */
+	memset(buf, '\0', 16 * dev_desc->blksz);
+	memset(cmp, '\0', 2 * dev_desc->blksz);
+	ut_assertok(blk_read_submit(dev_desc, 16, 16, buf, req));
+	ut_asserteq(2, blk_dread(dev_desc, 32, 2, cmp));
+	ut_assertok(strcmp(cmp, "this is a test"));
+	ut_asserteq(16, blk_read_wait(req));
+	ut_assertok(strcmp(buf, "this is a test"));
+
+	/*
+	 * Read in chunks, each into one buffer while the other is in use:
+	 * every chunk is still in flight when the previous one is done with
+	 */
+	ut_assertok(blk_read_submit(dev_desc, 1024, ASYNC_CHUNK_BLKS, buf,
+				    req));
+	for (i = 0; i < ASYNC_CHUNKS; i++) {
+		ut_asserteq(ASYNC_CHUNK_BLKS, blk_read_wait(req));
+		if (i == ASYNC_CHUNKS - 1)
+			break;
+		ut_assertok(blk_read_submit(dev_desc,
+			1024 + (i + 1) * ASYNC_CHUNK_BLKS, ASYNC_CHUNK_BLKS,
+			i & 1 ? buf : cmp, req));
+		ut_asserteq(-EBUSY, blk_read_poll(req));
+	}
+
+	return 0;
+}
+
+static int dm_test_mmc_async(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	struct blk_req req;
+	char *buf;
+	int ret;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	buf = malloc(2 * ASYNC_CHUNK_BLKS * dev_desc->blksz);
+	ut_assertnonnull(buf);
+
+	/* Do not leave a read running into freed memory if a check fails */
+	memset(&req, '\0', sizeof(req));
+	ret = mmc_async_check(uts, dev_desc, buf,
+			      buf + ASYNC_CHUNK_BLKS * dev_desc->blksz, &req);
+	if (req.busy)
+		blk_read_wait(&req);
+	free(buf);
+
+	return ret;
+}
+DM_TEST(dm_test_mmc_async, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
+
+#ifdef CONFIG_MMC_MODE_CACHE
+static int mmc_reinit(struct mmc *mmc)
+{
+	mmc->has_init = 0;
+
+	return mmc_init(mmc);
+}
+
+/* Test recording the bus mode of an eMMC and falling back on a mismatch */
+static int dm_test_mmc_mode_cache(struct unit_test_state *uts)
+{
+	const char *expect = "15010053414e44424f58101234567800:11:8:1a";
+	struct udevice *dev;
+	struct mmc *mmc;
+	char name[16], rec[64];
+	uint tunings;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_MMC, "emmc", &dev));
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assertnonnull(mmc);
+	sprintf(name, "mmcmode%d", mmc_get_blk_desc(mmc)->devnum);
+	tunings = sandbox_mmc_get_tunings(dev);
+
+	/* Without a record the card is tuned for HS200, which is recorded */
+	setenv(name, NULL);
+	ut_assertok(mmc_reinit(mmc));
+	ut_asserteq(MMC_HS_200, mmc->selected_mode);
+	ut_asserteq(8, mmc->bus_width);
+	ut_asserteq(++tunings, sandbox_mmc_get_tunings(dev));
+	ut_asserteq_str(expect, getenv(name));
+
+	/* With it, the host is set up without tuning */
+	ut_assertok(mmc_reinit(mmc));
+	ut_asserteq(MMC_HS_200, mmc->selected_mode);
+	ut_asserteq(8, mmc->bus_width);
+	ut_asserteq(tunings, sandbox_mmc_get_tunings(dev));
+	ut_asserteq_str(expect, getenv(name));
+
+	/* A stale tap fails the check, so the card is negotiated again */
+	strcpy(rec, expect);
+	strcpy(strrchr(rec, ':'), ":3");
+	setenv(name, rec);
+	ut_assertok(mmc_reinit(mmc));
+	ut_asserteq(MMC_HS_200, mmc->selected_mode);
+	ut_asserteq(++tunings, sandbox_mmc_get_tunings(dev));
+	ut_asserteq_str(expect, getenv(name));
+
+	/* So is a different card */
+	setenv(name, "15010053414e44424f58101200000000:11:8:1a");
+	ut_assertok(mmc_reinit(mmc));
+	ut_asserteq(++tunings, sandbox_mmc_get_tunings(dev));
+	ut_asserteq_str(expect, getenv(name));
+
+	/* And a record that cannot be parsed */
+	setenv(name, "11:8:1a");
+	ut_assertok(mmc_reinit(mmc));
+	ut_asserteq(++tunings, sandbox_mmc_get_tunings(dev));
+	ut_asserteq_str(expect, getenv(name));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_mode_cache, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
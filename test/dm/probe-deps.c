@@ -0,0 +1,142 @@
+/*
+ * Tests for probing the providers a device depends on
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <clk-uclass.h>
+#include <dm.h>
+#include <dm/device-internal.h>
+#include <dm/test.h>
+#include <dm/uclass-internal.h>
+#include <test/ut.h>
+
+static struct unit_test_state *probe_deps_uts = &global_dm_test_state;
+
+struct probe_deps_test_priv {
+	bool clk_ready;
+	bool reset_ready;
+};
+
+static int probe_deps_clk_probe(struct udevice *dev)
+{
+	struct dm_test_state *dms = probe_deps_uts->priv;
+
+	return dms->force_fail_alloc ? -ENOMEM : 0;
+}
+
+static const struct clk_ops probe_deps_clk_ops = {
+};
+
+static const struct udevice_id probe_deps_clk_ids[] = {
+	{ .compatible = "denx,u-boot-probe-deps-clk" },
+	{ }
+};
+
+U_BOOT_DRIVER(probe_deps_clk) = {
+	.name	= "probe_deps_clk",
+	.id	= UCLASS_CLK,
+	.of_match = probe_deps_clk_ids,
+	.probe	= probe_deps_clk_probe,
+	.ops	= &probe_deps_clk_ops,
+};
+
+/* Note which providers were already active when this device was probed */
+static int probe_deps_test_probe(struct udevice *dev)
+{
+	struct probe_deps_test_priv *priv = dev_get_priv(dev);
+	struct udevice *dep;
+
+	if (!uclass_find_device_by_name(UCLASS_CLK, "probe-deps-clk", &dep))
+		priv->clk_ready = device_active(dep);
+	if (!uclass_find_device_by_name(UCLASS_RESET, "reset-ctl", &dep))
+		priv->reset_ready = device_active(dep);
+
+	return 0;
+}
+
+static const struct udevice_id probe_deps_test_ids[] = {
+	{ .compatible = "denx,u-boot-probe-deps-test" },
+	{ }
+};
+
+U_BOOT_DRIVER(probe_deps_test) = {
+	.name	= "probe_deps_test",
+	.id	= UCLASS_MISC,
+	.of_match = probe_deps_test_ids,
+	.probe	= probe_deps_test_probe,
+	.priv_auto_alloc_size = sizeof(struct probe_deps_test_priv),
+};
+
+/* Test that a device's providers are probed before the device */
+static int dm_test_probe_deps(struct unit_test_state *uts)
+{
+	struct probe_deps_test_priv *priv;
+	struct udevice *dev, *clk, *fixed;
+
+	ut_assertok(uclass_find_device_by_name(UCLASS_MISC, "probe-deps-test",
+					       &dev));
+	ut_assertok(uclass_find_device_by_name(UCLASS_CLK, "probe-deps-clk",
+					       &clk));
+	ut_assertok(uclass_find_device_by_name(UCLASS_CLK, "clk-fixed",
+					       &fixed));
+	ut_assert(!device_active(clk));
+	ut_assert(!device_active(fixed));
+
+	ut_assertok(device_probe(dev));
+	ut_assert(device_active(clk));
+	ut_assert(device_active(fixed));
+	priv = dev_get_priv(dev);
+	ut_assert(priv->clk_ready);
+	ut_assert(priv->reset_ready);
+
+	return 0;
+}
+DM_TEST(dm_test_probe_deps, DM_TESTF_SCAN_FDT);
+
+/* Test that a provider which fails to probe stops the device probing */
+static int dm_test_probe_deps_fail(struct unit_test_state *uts)
+{
+	struct dm_test_state *dms = uts->priv;
+	struct udevice *dev, *clk;
+
+	ut_assertok(uclass_find_device_by_name(UCLASS_MISC, "probe-deps-test",
+					       &dev));
+	ut_assertok(uclass_find_device_by_name(UCLASS_CLK, "probe-deps-clk",
+					       &clk));
+
+	dms->force_fail_alloc = 1;
+	ut_asserteq(-ENOMEM, device_probe(dev));
+	ut_assert(!device_active(clk));
+	ut_assert(!device_active(dev));
+
+	/* Once the provider can probe, so can the device */
+	dms->force_fail_alloc = 0;
+	ut_assertok(device_probe(dev));
+	ut_assert(device_active(clk));
+	ut_assert(device_active(dev));
+
+	return 0;
+}
+DM_TEST(dm_test_probe_deps_fail, DM_TESTF_SCAN_FDT);
+
+/* Test that a provider in a uclass which is not built in is skipped */
+static int dm_test_probe_deps_no_uclass(struct unit_test_state *uts)
+{
+	struct udevice *dev, *clk;
+	struct uclass *uc;
+
+	ut_assertok(uclass_find_device_by_name(UCLASS_MISC, "probe-deps-test",
+					       &dev));
+	ut_assertok(uclass_find_device_by_name(UCLASS_CLK, "probe-deps-clk",
+					       &clk));
+
+	/* Sandbox has no thermal uclass */
+	ut_asserteq(-EPFNOSUPPORT, uclass_get(UCLASS_THERMAL, &uc));
+	ut_assertok(device_probe_dep(dev, UCLASS_THERMAL, dev_of_offset(clk)));
+	ut_assert(!device_active(clk));
+
+	return 0;
+}
+DM_TEST(dm_test_probe_deps_no_uclass, DM_TESTF_SCAN_FDT);
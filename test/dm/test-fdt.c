@@ -8,8 +8,10 @@
 #include <dm.h>
 #include <errno.h>
 #include <fdtdec.h>
+#include <fdt_support.h>
 #include <malloc.h>
 #include <asm/io.h>
+#include <dm/bind-table.h>
 #include <dm/test.h>
 #include <dm/root.h>
 #include <dm/uclass-internal.h>
@@ -266,3 +268,244 @@ static int dm_test_fdt_offset(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_fdt_offset, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+/* Test that lookups give the same results with an index of the tree */
+static int dm_test_fdt_index(struct unit_test_state *uts)
+{
+	const void *orig = gd->fdt_blob;
+	int size = fdt_totalsize(orig) + 256;
+	int node, depth, phandle;
+	const char *compat;
+	char path[256];
+	void *blob;
+
+	blob = malloc(size);
+	ut_assertnonnull(blob);
+	ut_assertok(fdt_open_into(orig, blob, size));
+	ut_assertok(fdtdec_build_index(blob));
+
+	/* Node offsets are the same in the copy, which is not indexed */
+	for (node = 0, depth = 0; node >= 0 && depth >= 0;
+	     node = fdt_next_node(blob, node, &depth)) {
+		ut_assertok(fdt_get_path(blob, node, path, sizeof(path)));
+		ut_asserteq(node, fdt_path_offset(blob, path));
+		phandle = fdt_get_phandle(blob, node);
+		if (phandle)
+			ut_asserteq(node,
+				    fdt_node_offset_by_phandle(blob, phandle));
+		compat = fdt_getprop(blob, node, "compatible", NULL);
+		if (compat) {
+			ut_asserteq(fdt_node_offset_by_compatible(orig, -1,
+								  compat),
+				    fdt_node_offset_by_compatible(blob, -1,
+								  compat));
+			ut_asserteq(fdt_node_offset_by_compatible(orig, node,
+								  compat),
+				    fdt_node_offset_by_compatible(blob, node,
+								  compat));
+		}
+	}
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_path_offset(blob, "/index-test"));
+
+	/* Changing the tree must drop the index */
+	node = fdt_add_subnode(blob, 0, "index-test");
+	ut_assert(node >= 0);
+	ut_asserteq(node, fdt_path_offset(blob, "/index-test"));
+	ut_assertok(fdt_setprop_string(blob, node, "compatible",
+				       "denx,index-test"));
+	ut_asserteq(node, fdt_node_offset_by_compatible(blob, -1,
+							"denx,index-test"));
+
+	/* Index the original tree again, which frees the other index */
+	ut_assertok(fdtdec_build_index(orig));
+	free(blob);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_index, 0);
+#endif
+
+/* Test that a batch of changes gives the same tree as making them singly */
+static int dm_test_fdt_batch(struct unit_test_state *uts)
+{
+	int size = fdt_totalsize(gd->fdt_blob) + 1024;
+	struct fdt_batch batch;
+	void *single, *batched;
+	int node, parent;
+
+	single = malloc(size);
+	batched = malloc(size);
+	ut_assertnonnull(single);
+	ut_assertnonnull(batched);
+	ut_assertok(fdt_open_into(gd->fdt_blob, single, size));
+	ut_assertok(fdt_open_into(gd->fdt_blob, batched, size));
+
+	node = fdt_path_offset(single, "/a-test");
+	ut_assertok(fdt_setprop_u32(single, node, "ping-add", 5));
+	ut_assertok(fdt_setprop_u32(single, node, "reg", 1));
+	node = fdt_path_offset(single, "/junk");
+	ut_assertok(fdt_setprop_string(single, node, "batch-prop", "abc"));
+	ut_assertok(fdt_delprop(single, node, "compatible"));
+	parent = fdt_path_offset(single, "/some-bus");
+	node = fdt_add_subnode(single, parent, "c-test@7");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_u32(single, node, "reg", 7));
+	node = fdt_add_subnode(single, 0, "batch-test");
+	ut_assert(node >= 0);
+	node = fdt_add_subnode(single, node, "child");
+	ut_assert(node >= 0);
+	ut_assertok(fdt_setprop_string(single, node, "batch-name", "abcdefg"));
+	node = fdt_path_offset(single, "/no-compatible");
+	ut_assertok(fdt_delprop(single, node, "reg"));
+	ut_assertok(fdt_setprop_u32(single, node, "reg", 2));
+
+	fdt_batch_init(&batch, batched);
+	ut_assertok(fdt_batch_setprop_u32(&batch, "/a-test", "ping-add", 5));
+	ut_assertok(fdt_batch_setprop_u32(&batch, "/a-test", "reg", 1));
+	ut_assertok(fdt_batch_setprop_string(&batch, "/junk", "batch-prop",
+					     "abc"));
+	ut_assertok(fdt_batch_delprop(&batch, "/junk", "compatible"));
+	ut_assertok(fdt_batch_setprop_u32(&batch, "/some-bus/c-test@7", "reg",
+					  7));
+	ut_assertok(fdt_batch_setprop_string(&batch, "/batch-test/child",
+					     "batch-name", "abcdefg"));
+	ut_assertok(fdt_batch_delprop(&batch, "/no-compatible", "reg"));
+	ut_assertok(fdt_batch_setprop_u32(&batch, "/no-compatible", "reg", 2));
+
+	/* Nothing changes until the batch is committed */
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_path_offset(batched, "/batch-test"));
+	ut_assertok(fdt_batch_commit(&batch));
+
+	ut_asserteq(fdt_totalsize(single), fdt_totalsize(batched));
+	ut_asserteq(fdt_off_dt_strings(single), fdt_off_dt_strings(batched));
+	ut_asserteq(fdt_size_dt_strings(single), fdt_size_dt_strings(batched));
+	ut_assertok(memcmp(single, batched, fdt_off_dt_strings(single) +
+			   fdt_size_dt_strings(single)));
+
+	/* A batch which does not fit leaves the tree alone */
+	memcpy(single, batched, size);
+	fdt_batch_init(&batch, batched);
+	ut_assertok(fdt_batch_setprop(&batch, "/a-test", "big", NULL, size));
+	ut_asserteq(-FDT_ERR_NOSPACE, fdt_batch_commit(&batch));
+	ut_assertok(memcmp(single, batched, size));
+
+	/* So does one which does not fit an older version of tree */
+	fdt_set_version(batched, 16);
+	memcpy(single, batched, size);
+	fdt_batch_init(&batch, batched);
+	ut_assertok(fdt_batch_setprop(&batch, "/a-test", "big", NULL, size));
+	ut_asserteq(-FDT_ERR_NOSPACE, fdt_batch_commit(&batch));
+	ut_assertok(memcmp(single, batched, size));
+
+	free(batched);
+	free(single);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_batch, 0);
+
+#ifdef CONFIG_DM_BIND_TABLE
+/* Test the binding table generated by dtoc, and the fallback to a scan */
+static int dm_test_fdt_bind_table(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+
+	/* The table holds the compatible strings of the built-in tree */
+	ut_assert(dm_bind_table_lookup("sandbox,gpio") >= 0);
+	ut_asserteq(-ENOENT, dm_bind_table_lookup("sandbox,no-such-device"));
+
+	/*
+	 * The test device tree is not the one the table was built from, so
+	 * the table is refused and the devices are bound by walking the tree
+	 */
+	ut_asserteq(-ENOSYS, dm_bind_table_scan(gd->dm_root, gd->fdt_blob, 0,
+						false));
+	ut_assertok(uclass_get_device(UCLASS_TEST_FDT, 0, &dev));
+
+	/* The same holds after a recheck, as at the start of every scan */
+	dm_bind_table_recheck();
+	ut_asserteq(-ENOSYS, dm_bind_table_scan(gd->dm_root, gd->fdt_blob, 0,
+						false));
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_bind_table, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+
+/* Built by dtoc from test.dtb, see dts/Makefile */
+extern const struct dm_bind_table dm_test_bind_table;
+
+#define BIND_TABLE_MAX_DEVS	256
+
+struct bind_table_dev {
+	const struct driver *driver;
+	int of_offset;
+	int depth;
+};
+
+/* Record the devices below @parent, depth first, in the order bound */
+static int bind_table_list(struct udevice *parent, int depth,
+			   struct bind_table_dev *list, int count)
+{
+	struct udevice *dev;
+
+	for (device_find_first_child(parent, &dev);
+	     dev;
+	     device_find_next_child(&dev)) {
+		if (count == BIND_TABLE_MAX_DEVS)
+			return -ENOSPC;
+		list[count].driver = dev->driver;
+		list[count].of_offset = dev_of_offset(dev);
+		list[count].depth = depth;
+		count = bind_table_list(dev, depth + 1, list, count + 1);
+		if (count < 0)
+			return count;
+	}
+
+	return count;
+}
+
+/* Binding test.dtb from its table gives the same devices as a scan */
+static int dm_test_fdt_bind_table_same(struct unit_test_state *uts)
+{
+	struct bind_table_dev *scanned, *bound;
+	const void *blob = gd->fdt_blob;
+	int count, i;
+
+	scanned = calloc(BIND_TABLE_MAX_DEVS, sizeof(*scanned));
+	bound = calloc(BIND_TABLE_MAX_DEVS, sizeof(*bound));
+	ut_assertnonnull(scanned);
+	ut_assertnonnull(bound);
+
+	/* The control table does not match, so this was a normal scan */
+	count = bind_table_list(gd->dm_root, 0, scanned, 0);
+	ut_assert(count > 0);
+
+	/* Start again, binding from the table built from test.dtb */
+	ut_assertok(dm_uninit());
+	gd->dm_root = NULL;
+	ut_assertok(dm_init());
+	dm_bind_table_select(&dm_test_bind_table);
+	ut_assertok(dm_scan_platdata(false));
+	ut_assertok(dm_scan_fdt(blob, false));
+
+	/* Check that the table was used: this would be -ENOSYS otherwise */
+	ut_assertok(dm_bind_table_scan(gd->dm_root, blob,
+				       fdt_path_offset(blob, "/b-test"),
+				       false));
+	dm_bind_table_select(&dm_bind_table);
+
+	ut_asserteq(count, bind_table_list(gd->dm_root, 0, bound, 0));
+	for (i = 0; i < count; i++) {
+		ut_asserteq_ptr(scanned[i].driver, bound[i].driver);
+		ut_asserteq(scanned[i].of_offset, bound[i].of_offset);
+		ut_asserteq(scanned[i].depth, bound[i].depth);
+	}
+
+	free(bound);
+	free(scanned);
+
+	return 0;
+}
+DM_TEST(dm_test_fdt_bind_table_same, DM_TESTF_SCAN_PDATA | DM_TESTF_SCAN_FDT);
+#endif
@@ -0,0 +1,191 @@
+/*
+ * Tests for hash providers
+ *
+ * SPDX-License-Identifier:	GPL-2.0+
+ */
+
+#include <common.h>
+#include <command.h>
+#include <div64.h>
+#include <errno.h>
+#include <hash.h>
+#include <image.h>
+#include <malloc.h>
+#include <u-boot/sha256.h>
+
+#define BENCH_SIZE	(1 << 20)
+#define BENCH_LOOPS	16
+
+/* Whether the test provider below may be used */
+static bool test_provider_ok;
+
+static int test_provider_probe(struct hash_algo *algo)
+{
+	return test_provider_ok ? 0 : -ENODEV;
+}
+
+static int test_provider_init(struct hash_algo *algo, void **ctxp)
+{
+	sha256_context *ctx = malloc(sizeof(*ctx));
+
+	if (!ctx)
+		return -ENOMEM;
+	sha256_starts(ctx);
+	*ctxp = ctx;
+
+	return 0;
+}
+
+static int test_provider_update(struct hash_algo *algo, void *ctx,
+				const void *buf, unsigned int size, int is_last)
+{
+	sha256_update(ctx, buf, size);
+
+	return 0;
+}
+
+static int test_provider_finish(struct hash_algo *algo, void *ctx,
+				void *dest_buf, int size)
+{
+	if (size < algo->digest_size) {
+		free(ctx);
+		return -ENOSPC;
+	}
+	sha256_finish(ctx, dest_buf);
+	free(ctx);
+
+	return 0;
+}
+
+/* A provider which would beat everything else, but only when enabled */
+U_BOOT_HASH_ALGO(sha256_test) = {
+	.name		= "sha256",
+	.digest_size	= SHA256_SUM_LEN,
+	.hash_func_ws	= sha256_csum_wd,
+	.chunk_size	= CHUNKSZ_SHA256,
+	.hash_init	= test_provider_init,
+	.hash_update	= test_provider_update,
+	.hash_finish	= test_provider_finish,
+	.driver		= "test",
+	.priority	= HASH_PRIO_CPU + 1,
+	.probe		= test_provider_probe,
+};
+
+static int hash_check_lookup(const char *driver, bool progressive)
+{
+	struct hash_algo *algo;
+	int ret;
+
+	if (progressive)
+		ret = hash_progressive_lookup_algo("sha256", &algo);
+	else
+		ret = hash_lookup_algo("sha256", &algo);
+	if (ret) {
+		printf("%s: lookup failed: %d\n", __func__, ret);
+		return ret;
+	}
+	if (strcmp(algo->driver, driver)) {
+		printf("%s: got provider '%s', expected '%s'\n", __func__,
+		       algo->driver, driver);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int hash_check_providers(void)
+{
+	struct hash_algo *algo;
+	int ret = 0;
+
+	/* Not usable, so the best of the rest is picked */
+	test_provider_ok = false;
+	if (hash_lookup_provider("sha256", "test", &algo) != -ENODEV) {
+		printf("%s: test provider should not be usable\n", __func__);
+		ret = -EINVAL;
+	}
+	if (!ret)
+		ret = hash_check_lookup("sw", false);
+
+	test_provider_ok = true;
+	if (!ret)
+		ret = hash_check_lookup("test", false);
+	if (!ret)
+		ret = hash_check_lookup("test", true);
+	test_provider_ok = false;
+
+	if (!ret && hash_lookup_provider("sha256", "none", &algo) !=
+	    -EPROTONOSUPPORT) {
+		printf("%s: found a provider which does not exist\n",
+		       __func__);
+		ret = -EINVAL;
+	}
+
+	return ret;
+}
+
+/* Time each usable provider, checking its result against software */
+static int hash_bench_providers(void)
+{
+	uint8_t ref[HASH_MAX_DIGEST_SIZE], out[HASH_MAX_DIGEST_SIZE];
+	struct hash_algo *algo, *sw;
+	ulong start, elapsed;
+	unsigned char *buf;
+	int ret = 0;
+	int i, j;
+
+	buf = malloc(BENCH_SIZE);
+	if (!buf)
+		return -ENOMEM;
+	for (i = 0; i < BENCH_SIZE; i++)
+		buf[i] = i ^ (i >> 11);
+
+	test_provider_ok = true;
+	for (i = 0; (algo = hash_get_provider(i)); i++) {
+		if (hash_lookup_provider(algo->name, algo->driver, &algo)) {
+			printf(" %-8s %-10s not usable\n", algo->name,
+			       algo->driver);
+			continue;
+		}
+		if (hash_lookup_provider(algo->name, "sw", &sw)) {
+			ret = -ENOENT;
+			break;
+		}
+		sw->hash_func_ws(buf, BENCH_SIZE, ref, sw->chunk_size);
+
+		start = timer_get_us();
+		for (j = 0; j < BENCH_LOOPS; j++)
+			algo->hash_func_ws(buf, BENCH_SIZE, out,
+					   algo->chunk_size);
+		elapsed = max(timer_get_us() - start, 1UL);
+
+		if (memcmp(out, ref, algo->digest_size)) {
+			printf(" %-8s %-10s wrong result\n", algo->name,
+			       algo->driver);
+			ret = -EINVAL;
+			continue;
+		}
+
+		/* bytes per microsecond is MB/s */
+		printf(" %-8s %-10s priority %3d: %lu MB/s\n", algo->name,
+		       algo->driver, algo->priority,
+		       (ulong)lldiv((u64)BENCH_SIZE * BENCH_LOOPS, elapsed));
+	}
+	test_provider_ok = false;
+	free(buf);
+
+	return ret;
+}
+
+int do_ut_hash(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
+{
+	int ret;
+
+	ret = hash_check_providers();
+	if (!ret)
+		ret = hash_bench_providers();
+
+	printf("Test %s\n", ret ? "failed" : "passed");
+
+	return ret ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
@@ -201,6 +201,71 @@ static int fdt_overlay_local_phandles(struct unit_test_state *uts)
 }
 OVERLAY_TEST(fdt_overlay_local_phandles, 0);
 
+/* Number of times the test overlay is stacked up */
+#define STACKED_OVERLAYS	12
+
+static int fdt_overlay_stacked(struct unit_test_state *uts)
+{
+	void *fdt_base = &__dtb_test_fdt_base_begin;
+	void *fdt_overlay = &__dtb_test_fdt_overlay_begin;
+	struct fdt_overlay_session session;
+	void *one, *stacked, *overlay, *buf;
+	unsigned long one_us, stacked_us, start;
+	int i, size;
+
+	one = malloc(STACKED_OVERLAYS * FDT_COPY_SIZE);
+	stacked = malloc(STACKED_OVERLAYS * FDT_COPY_SIZE);
+	overlay = malloc(FDT_COPY_SIZE);
+	ut_assertnonnull(one);
+	ut_assertnonnull(stacked);
+	ut_assertnonnull(overlay);
+
+	/* Apply the overlays one at a time */
+	ut_assertok(fdt_open_into(fdt_base, one,
+				  STACKED_OVERLAYS * FDT_COPY_SIZE));
+	one_us = 0;
+	for (i = 0; i < STACKED_OVERLAYS; i++) {
+		ut_assertok(fdt_open_into(fdt_overlay, overlay,
+					  FDT_COPY_SIZE));
+		start = timer_get_us();
+		ut_assertok(fdt_overlay_apply(one, overlay));
+		one_us += timer_get_us() - start;
+	}
+
+	/* Apply the same overlays in one session */
+	ut_assertok(fdt_open_into(fdt_base, stacked,
+				  STACKED_OVERLAYS * FDT_COPY_SIZE));
+	size = fdt_overlay_session_size(stacked);
+	ut_assert(size >= 0);
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	stacked_us = 0;
+	start = timer_get_us();
+	ut_assertok(fdt_overlay_session_init(&session, stacked, buf, size));
+	stacked_us += timer_get_us() - start;
+	for (i = 0; i < STACKED_OVERLAYS; i++) {
+		ut_assertok(fdt_open_into(fdt_overlay, overlay,
+					  FDT_COPY_SIZE));
+		start = timer_get_us();
+		ut_assertok(fdt_overlay_session_apply(&session, overlay));
+		stacked_us += timer_get_us() - start;
+	}
+
+	/* Both ways must give the same tree, phandles included */
+	ut_asserteq(fdt_totalsize(one), fdt_totalsize(stacked));
+	ut_asserteq(0, memcmp(one, stacked, fdt_totalsize(one)));
+	printf("%d overlays: %lu us one at a time, %lu us in one session\n",
+	       STACKED_OVERLAYS, one_us, stacked_us);
+
+	free(buf);
+	free(overlay);
+	free(stacked);
+	free(one);
+
+	return CMD_RET_SUCCESS;
+}
+OVERLAY_TEST(fdt_overlay_stacked, 0);
+
 int do_ut_overlay(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
 	struct unit_test *tests = ll_entry_start(struct unit_test,
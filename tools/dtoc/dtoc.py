@@ -11,6 +11,7 @@ from optparse import OptionError, OptionParser
 import os
 import struct
 import sys
+import zlib
 
 # Bring in the patman libraries
 our_path = os.path.dirname(os.path.realpath(__file__))
@@ -43,6 +44,18 @@ TYPE_NAMES = {
 STRUCT_PREFIX = 'dtd_'
 VAL_PREFIX = 'dtv_'
 
+# Flattened device tree header and structure block tokens
+FDT_MAGIC = 0xd00dfeed
+FDT_BEGIN_NODE = 1
+FDT_END_NODE = 2
+FDT_PROP = 3
+FDT_NOP = 4
+FDT_END = 9
+
+# Node flags for the binding table, see include/dm/bind-table.h
+BIND_NODE_ENABLED = 1 << 0
+BIND_NODE_PRE_RELOC = 1 << 1
+
 def Conv_name_to_c(name):
     """Convert a device-tree name to a C identifier
 
@@ -63,6 +76,126 @@ def TabTo(num_tabs, str):
         return str + ' '
     return str + '\t' * (num_tabs - len(str) // 8)
 
+def BindHash(str):
+    """Hash a string in the same way as dm_hash_str() in U-Boot
+
+    Args:
+        str: String to hash
+    Return:
+        32-bit hash value
+    """
+    hash = 5381
+    for ch in str:
+        hash = (hash * 33 + ord(ch)) & 0xffffffff
+    return hash
+
+def BytesToStr(data):
+    """Convert bytes read from a file to a string, for Python 2 and 3"""
+    if sys.version_info > (3, 0):
+        return data.decode('latin-1')
+    return data
+
+class BindNode:
+    """A device tree node, as needed for the binding table
+
+    Properties:
+        offset: Offset of the node within the structure block, as used by
+            libfdt
+        name: Node name
+        path: Full path to the node
+        props: A dict of property values (as strings) keyed by property name
+        subnodes: A list of subnodes, each a BindNode object
+    """
+    def __init__(self, offset, name, path):
+        self.offset = offset
+        self.name = name
+        self.path = path
+        self.props = {}
+        self.subnodes = []
+
+    def GetStrings(self, propname):
+        """Get the strings in a string-list property
+
+        Args:
+            propname: Name of property
+        Return:
+            List of strings, empty if the property does not exist
+        """
+        value = self.props.get(propname)
+        if value is None:
+            return []
+        return [s for s in value.split('\0') if s]
+
+def ScanBlobNodes(data):
+    """Scan a device tree blob for its nodes and their offsets
+
+    This walks the structure block directly, since the node offsets have to
+    be exactly those which libfdt will see at run time.
+
+    Args:
+        data: Contents of the device tree blob
+    Return:
+        Tuple:
+            Root BindNode
+            Header values, as a dict keyed by field name
+    """
+    fields = ['magic', 'totalsize', 'off_dt_struct', 'off_dt_strings',
+              'off_mem_rsvmap', 'version', 'last_comp_version',
+              'boot_cpuid_phys', 'size_dt_strings', 'size_dt_struct']
+    header = dict(zip(fields, struct.unpack('>10I', data[:40])))
+    if header['magic'] != FDT_MAGIC:
+        raise ValueError('Not a device tree blob (magic %#x)' %
+                         header['magic'])
+    if header['version'] < 17:
+        raise ValueError('Device tree version %d is too old' %
+                         header['version'])
+
+    base = header['off_dt_struct']
+    strings = header['off_dt_strings']
+    pos = 0
+    stack = []
+    root = None
+    while True:
+        tag_pos = pos
+        tag, = struct.unpack('>I', data[base + pos:base + pos + 4])
+        pos += 4
+        if tag == FDT_BEGIN_NODE:
+            end = data.index(b'\0', base + pos)
+            name = BytesToStr(data[base + pos:end])
+            pos = (end + 1 - base + 3) & ~3
+            if stack:
+                parent = stack[-1]
+                sep = '' if parent.path == '/' else '/'
+                node = BindNode(tag_pos, name, parent.path + sep + name)
+                parent.subnodes.append(node)
+            else:
+                node = BindNode(tag_pos, '/', '/')
+                root = node
+            stack.append(node)
+        elif tag == FDT_END_NODE:
+            stack.pop()
+        elif tag == FDT_PROP:
+            size, nameoff = struct.unpack('>II',
+                                          data[base + pos:base + pos + 8])
+            pos += 8
+            end = data.index(b'\0', strings + nameoff)
+            name = BytesToStr(data[strings + nameoff:end])
+            stack[-1].props[name] = BytesToStr(data[base + pos:
+                                                    base + pos + size])
+            pos = (pos + size + 3) & ~3
+        elif tag == FDT_NOP:
+            pass
+        elif tag == FDT_END:
+            break
+        else:
+            raise ValueError('Bad device tree tag %d at offset %#x' %
+                             (tag, tag_pos))
+    return root, header
+
+def CString(str):
+    """Quote a string for use in C source"""
+    return '"%s"' % str.replace('\\', '\\\\').replace('"', '\\"')
+
 class DtbPlatdata:
     """Provide a means to convert device tree binary data to platform data
 
@@ -352,6 +485,144 @@ class DtbPlatdata:
         for node_txt in node_txt_list:
             self.Out(''.join(node_txt))
 
+    def GenerateBindTable(self):
+        """Generate a table for binding devices in U-Boot proper
+
+        This writes out the nodes which have a compatible string, linked to
+        their parents, and a hash table of all the compatible strings, in
+        the form described in include/dm/bind-table.h. Node offsets and the
+        CRC32 of the whole blob are included, so that U-Boot can check that
+        the device tree it is using is this one.
+        """
+        fname = fdt_util.EnsureCompiled(self._dtb_fname)
+        with open(fname, 'rb') as fd:
+            data = fd.read()
+        root, header = ScanBlobNodes(data)
+        data = data[:header['totalsize']]
+
+        # The root node, then each node with a compatible string in order
+        nodes = [root]
+        children = {root.offset: []}
+        def _AddNodes(parent):
+            for node in parent.subnodes:
+                if 'compatible' in node.props:
+                    if parent.offset in children:
+                        children[parent.offset].append(len(nodes))
+                    children[node.offset] = []
+                    nodes.append(node)
+                _AddNodes(node)
+        _AddNodes(root)
+        if len(nodes) > 0xffff:
+            raise ValueError('Too many nodes (%d) for the binding table' %
+                             len(nodes))
+
+        compats = []
+        compat_idx = {}
+        compat_list = []
+        node_info = []
+        for node in nodes:
+            names = node.GetStrings('compatible') if node != root else []
+            for name in names:
+                if name not in compat_idx:
+                    compat_idx[name] = len(compats)
+                    compats.append(name)
+            status = node.props.get('status')
+            flags = 0
+            if status is None or status.split('\0')[0] == 'okay':
+                flags |= BIND_NODE_ENABLED
+            if 'u-boot,dm-pre-reloc' in node.props:
+                flags |= BIND_NODE_PRE_RELOC
+            if len(names) > 0xff:
+                raise ValueError("Too many compatible strings (%d) in node "
+                                 "'%s' for the binding table" %
+                                 (len(names), node.path))
+            node_info.append((len(compat_list), len(names), flags))
+            compat_list += [compat_idx[name] for name in names]
+
+        # Node compatible-string indexes and hash slots are u16
+        if len(compat_list) > 0xffff:
+            raise ValueError('Too many compatible strings in nodes (%d) for '
+                             'the binding table' % len(compat_list))
+        if len(compats) > 0xffff:
+            raise ValueError('Too many different compatible strings (%d) '
+                             'for the binding table' % len(compats))
+
+        next_sibling = {}
+        first_child = {}
+        for node in nodes:
+            kids = children.get(node.offset, [])
+            if kids:
+                first_child[node.offset] = kids[0]
+            for this, next in zip(kids, kids[1:]):
+                next_sibling[this] = next
+
+        # Open-addressed hash table, at most half full
+        index_size = 1
+        while index_size < len(compats) * 2:
+            index_size <<= 1
+        index = [0] * index_size
+        for idx, name in enumerate(compats):
+            slot = BindHash(name) & (index_size - 1)
+            while index[slot]:
+                slot = (slot + 1) & (index_size - 1)
+            index[slot] = idx + 1
+
+        self.Out('#include <common.h>\n')
+        self.Out('#include <dm/bind-table.h>\n')
+        self.Out('\n')
+        self.Out('static const struct dm_bind_node dm_bind_nodes[] = {\n')
+        for idx, node in enumerate(nodes):
+            compat_start, compat_count, flags = node_info[idx]
+            self.Out('\t/* %d: %s */\n' % (idx, node.path))
+            self.Out('\t{ %#x, %d, %d, %d, %d, %#x },\n' %
+                     (node.offset, first_child.get(node.offset, 0),
+                      next_sibling.get(idx, 0), compat_start, compat_count,
+                      flags))
+        self.Out('};\n')
+        self.Out('\n')
+
+        self.Out('static const u16 dm_bind_compat_list[] = {')
+        for idx, compat in enumerate(compat_list):
+            self.Out('%s%d,' % ('\n\t' if idx % 16 == 0 else ' ', compat))
+        self.Out('\n};\n')
+        self.Out('\n')
+
+        offset = 0
+        self.Out('static const struct dm_bind_compat dm_bind_compats[] = {\n')
+        for name in compats:
+            self.Out('\t{ %#010x, %d },\t/* %s */\n' %
+                     (BindHash(name), offset, name))
+            offset += len(name) + 1
+        self.Out('};\n')
+        self.Out('\n')
+
+        self.Out('static const u16 dm_bind_index[] = {')
+        for idx, slot in enumerate(index):
+            self.Out('%s%d,' % ('\n\t' if idx % 16 == 0 else ' ', slot))
+        self.Out('\n};\n')
+        self.Out('\n')
+
+        self.Out('static const char dm_bind_strings[] =')
+        for name in compats:
+            self.Out('\n\t%s "\\0"' % CString(name))
+        self.Out('\n\t"";\n')
+        self.Out('\n')
+
+        self.Out('const struct dm_bind_table %s = {\n' %
+                 self._options.bind_name)
+        self.Out('\t.fdt_size\t\t= %#x,\n' % header['totalsize'])
+        self.Out('\t.fdt_struct_size\t= %#x,\n' % header['size_dt_struct'])
+        self.Out('\t.fdt_crc\t\t= %#x,\n' % (zlib.crc32(data) & 0xffffffff))
+        self.Out('\t.node_count\t\t= %d,\n' % len(nodes))
+        self.Out('\t.compat_count\t\t= %d,\n' % len(compats))
+        self.Out('\t.index_mask\t\t= %#x,\n' % (index_size - 1))
+        self.Out('\t.nodes\t\t\t= dm_bind_nodes,\n')
+        self.Out('\t.compat_list\t\t= dm_bind_compat_list,\n')
+        self.Out('\t.compats\t\t= dm_bind_compats,\n')
+        self.Out('\t.index\t\t\t= dm_bind_index,\n')
+        self.Out('\t.strings\t\t= dm_bind_strings,\n')
+        self.Out('};\n')
+
 
 if __name__ != "__main__":
     pass
@@ -359,6 +630,8 @@ if __name__ != "__main__":
 parser = OptionParser()
 parser.add_option('-d', '--dtb-file', action='store',
                   help='Specify the .dtb input file')
+parser.add_option('--bind-name', action='store', default='dm_bind_table',
+                  help='Name of the table written by bindtable')
 parser.add_option('--include-disabled', action='store_true',
                   help='Include disabled nodes')
 parser.add_option('-o', '--output', action='store', default='-',
@@ -366,18 +639,25 @@ parser.add_option('-o', '--output', action='store', default='-',
 (options, args) = parser.parse_args()
 
 if not args:
-    raise ValueError('Please specify a command: struct, platdata')
+    raise ValueError('Please specify a command: struct, platdata, bindtable')
 
 plat = DtbPlatdata(options.dtb_file, options)
-plat.ScanDtb()
-plat.ScanTree()
 plat.SetupOutput(options.output)
-structs = plat.ScanStructs()
+structs = None
 
 for cmd in args[0].split(','):
+    # The binding table does not need the platform data structures
+    if cmd == 'bindtable':
+        plat.GenerateBindTable()
+        continue
+    if structs is None:
+        plat.ScanDtb()
+        plat.ScanTree()
+        structs = plat.ScanStructs()
     if cmd == 'struct':
         plat.GenerateStructs(structs)
     elif cmd == 'platdata':
         plat.GenerateTables()
     else:
-        raise ValueError("Unknown command '%s': (use: struct, platdata)" % cmd)
+        raise ValueError("Unknown command '%s': (use: struct, platdata, "
+                         "bindtable)" % cmd)